@@ -68,6 +68,11 @@ endif()
 set(HAVE_FCNTL 1)
 set(HAVE_FCNTL_H 1)
 set(HAVE_FCNTL_O_NONBLOCK 1)
+if(APPLE)
+  set(HAVE_FDATASYNC 0)
+else()
+  set(HAVE_FDATASYNC 1)
+endif()
 set(HAVE_FILE_OFFSET_BITS 1)
 set(HAVE_FNMATCH 1)
 set(HAVE_FREEADDRINFO 1)
@@ -203,12 +208,19 @@ elseif(CMAKE_SYSTEM_NAME STREQUAL "Linux" OR
 endif()
 set(HAVE_POLL 1)
 set(HAVE_POLL_H 1)
+if(APPLE OR
+   CMAKE_SYSTEM_NAME STREQUAL "OpenBSD")
+  set(HAVE_POSIX_FALLOCATE 0)
+else()
+  set(HAVE_POSIX_FALLOCATE 1)
+endif()
 if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
   set(HAVE_POSIX_STRERROR_R 0)
 else()
   set(HAVE_POSIX_STRERROR_R 1)
 endif()
 set(HAVE_PWD_H 1)
+set(HAVE_PWRITE 1)
 set(HAVE_REALPATH 1)
 set(HAVE_RECV 1)
 set(HAVE_SA_FAMILY_T 1)
@@ -276,10 +288,17 @@ else()
   set(HAVE_SYS_FILIO_H 1)
 endif()
 set(HAVE_SYS_IOCTL_H 1)
+set(HAVE_SYS_MMAN_H 1)
 set(HAVE_SYS_PARAM_H 1)
 set(HAVE_SYS_POLL_H 1)
 set(HAVE_SYS_RESOURCE_H 1)
 set(HAVE_SYS_SELECT_H 1)
+if(CMAKE_SYSTEM_NAME STREQUAL "Linux" OR
+   CMAKE_SYSTEM_NAME STREQUAL "SunOS")
+  set(HAVE_SYS_SENDFILE_H 1)
+else()
+  set(HAVE_SYS_SENDFILE_H 0)
+endif()
 if(CYGWIN OR
    CMAKE_SYSTEM_NAME STREQUAL "Linux")
   set(HAVE_SYS_SOCKIO_H 0)
@@ -306,6 +325,7 @@ set(HAVE_UTIME 1)
 set(HAVE_UTIMES 1)
 set(HAVE_UTIME_H 1)
 set(HAVE_WRITABLE_ARGV 1)
+set(HAVE_WRITEV 1)
 if(CYGWIN)
   set(HAVE__SETMODE 1)
 endif()
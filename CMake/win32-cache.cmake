@@ -92,6 +92,7 @@ set(HAVE_EVENTFD 0)
 set(HAVE_FCNTL 0)
 set(HAVE_FCNTL_H 1)
 set(HAVE_FCNTL_O_NONBLOCK 0)
+set(HAVE_FDATASYNC 0)
 set(HAVE_FNMATCH 0)
 set(HAVE_FREEADDRINFO 1)  # Available in Windows XP and newer
 set(HAVE_FSETXATTR 0)
@@ -125,6 +126,7 @@ set(HAVE_IOCTLSOCKET_FIONBIO 1)
 set(HAVE_IOCTL_FIONBIO 0)
 set(HAVE_IOCTL_SIOCGIFADDR 0)
 set(HAVE_IO_H 1)
+set(HAVE_LINUX_IO_URING_H 0)
 set(HAVE_LINUX_TCP_H 0)
 set(HAVE_LOCALE_H 1)
 set(HAVE_MEMRCHR 0)
@@ -139,8 +141,10 @@ set(HAVE_PIPE 0)
 set(HAVE_PIPE2 0)
 set(HAVE_POLL 0)
 set(HAVE_POLL_H 0)
+set(HAVE_POSIX_FALLOCATE 0)
 set(HAVE_POSIX_STRERROR_R 0)
 set(HAVE_PWD_H 0)
+set(HAVE_PWRITE 0)
 set(HAVE_RECV 1)
 set(HAVE_SELECT 1)
 set(HAVE_SEND 1)
@@ -165,9 +169,11 @@ set(HAVE_STRUCT_TIMEVAL 1)
 set(HAVE_SYS_EVENTFD_H 0)
 set(HAVE_SYS_FILIO_H 0)
 set(HAVE_SYS_IOCTL_H 0)
+set(HAVE_SYS_MMAN_H 0)
 set(HAVE_SYS_POLL_H 0)
 set(HAVE_SYS_RESOURCE_H 0)
 set(HAVE_SYS_SELECT_H 0)
+set(HAVE_SYS_SENDFILE_H 0)
 set(HAVE_SYS_SOCKIO_H 0)
 set(HAVE_SYS_TYPES_H 1)
 set(HAVE_SYS_UN_H 0)
@@ -177,6 +183,7 @@ set(HAVE_TERMIO_H 0)
 set(HAVE_TIME_T_UNSIGNED 0)
 set(HAVE_UTIME 1)
 set(HAVE_UTIMES 0)
+set(HAVE_WRITEV 0)
 set(HAVE__SETMODE 1)
 set(STDC_HEADERS 1)
 
@@ -398,6 +398,9 @@ typedef enum {
   /* network has changed, adjust caches/connection reuse */
   CURLOPT(CURLMOPT_NETWORK_CHANGED, CURLOPTTYPE_LONG, 17),
 
+  /* curl_multi_perform() only runs transfers that are ready */
+  CURLOPT(CURLMOPT_PERFORM_READY, CURLOPTTYPE_LONG, 18),
+
   CURLMOPT_LASTENTRY /* the last unused */
 } CURLMoption;
 
@@ -1,34 +1,30 @@
 #ifndef CURL_CAPTURE_H
 #define CURL_CAPTURE_H
 
-#include <stdlib.h>
-#include <string.h>
+#include <stddef.h>
 
 struct CaptureBuffer {
     char *data;
     size_t size;
     size_t capacity;
+    int is_static; /* data is the caller's array, never realloc() it */
 };
 
-static inline void capture_init(struct CaptureBuffer *cap, char *staticbuf, size_t capsize) {
-    cap->data = staticbuf;
-    cap->size = 0;
-    cap->capacity = capsize;
-    if(staticbuf && capsize > 0)
-        cap->data[0] = '\0';
-}
-
-static inline void capture_append(struct CaptureBuffer *cap, const char *msg, size_t len) {
-    if(cap->size + len + 1 > cap->capacity) {
-        size_t newcap = (cap->size + len + 1) * 2;
-        char *newbuf = (char*)realloc(cap->data, newcap);
-        if(!newbuf) return;
-        cap->data = newbuf;
-        cap->capacity = newcap;
-    }
-    memcpy(cap->data + cap->size, msg, len);
-    cap->size += len;
-    cap->data[cap->size] = '\0';
-}
-
-#endif // CURL_CAPTURE_H
\ No newline at end of file
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 'staticbuf' may be the caller's array of 'capsize' bytes, or NULL */
+void capture_init(struct CaptureBuffer *cap, char *staticbuf, size_t capsize);
+
+/* returns 0 on success, -1 when out of memory */
+int capture_append(struct CaptureBuffer *cap, const char *msg, size_t len);
+
+/* frees the data unless it is the caller's array */
+void capture_free(struct CaptureBuffer *cap);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif // CURL_CAPTURE_H
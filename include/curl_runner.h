@@ -1,12 +1,17 @@
 #ifndef CURL_RUNNER_H
 #define CURL_RUNNER_H
 
-#include <string>
-#include <vector>
+#include <stdio.h>
+
+#include <curl/curl.h>
 
 #include "curl_capture.h"
 
 #ifdef __cplusplus
+#include <string>
+#include <utility>
+#include <vector>
+
 extern "C" {
 #endif
 
@@ -15,30 +20,367 @@ int curl_main(int argc, char *argv[]);
 void set_stdout_capture_buffer(struct CaptureBuffer *buffer);
 void set_stderr_capture_buffer(struct CaptureBuffer *buffer);
 
+/*
+ * A runner context initializes libcurl once and is then used for any number
+ * of curl_runner_exec() calls. A context may be shared by several threads:
+ * every call gets its own tool state and capture buffers, so calls made from
+ * different threads run concurrently. Where the compiler has no thread-local
+ * storage, the calls on a context take turns instead, and threads must then
+ * share one context. A build without thread support must be called from one
+ * thread at a time.
+ */
+typedef struct curl_runner_ctx curl_runner_ctx;
+
+curl_runner_ctx *curl_runner_init(void);
+void curl_runner_cleanup(curl_runner_ctx *ctx);
+
+/*
+ * Between calls a context keeps transfer state warm in a few pools: open
+ * connections, the DNS cache and TLS sessions, so that repeated calls to the
+ * same hosts reuse connections. A call takes a pool for itself, calls running
+ * at the same time use different pools. Cookies and HSTS entries are only
+ * carried over from one call to the next when asked for.
+ */
+typedef enum {
+  CURLRUNNEROPT_KEEP = 1,          /* long, CURLRUNNER_KEEP_* bits of what to
+                                      carry over besides connections and DNS,
+                                      default CURLRUNNER_KEEP_DEFAULT */
+  CURLRUNNEROPT_MAXPOOLS,          /* long, idle pools kept, default 4. 0 makes
+                                      every call start cold */
+  CURLRUNNEROPT_POOL_IDLE_TIMEOUT, /* long, seconds an unused pool is kept,
+                                      default 300 */
+  CURLRUNNEROPT_MAXCONNECTS,       /* long, idle connections a pool keeps,
+                                      default 0 for libcurl's default */
+  CURLRUNNEROPT_MAXAGE_CONN,       /* long, seconds an idle connection stays
+                                      usable, default 118 */
+  CURLRUNNEROPT_DNS_CACHE_TIMEOUT  /* long, seconds, -1 = forever, default 60 */
+} CURLRUNNERoption;
+
+#define CURLRUNNER_KEEP_SSL_SESSION (1L << 0)
+#define CURLRUNNER_KEEP_COOKIE      (1L << 1)
+#define CURLRUNNER_KEEP_HSTS        (1L << 2)
+#define CURLRUNNER_KEEP_ALL         (CURLRUNNER_KEEP_SSL_SESSION | \
+                                     CURLRUNNER_KEEP_COOKIE | \
+                                     CURLRUNNER_KEEP_HSTS)
+#define CURLRUNNER_KEEP_DEFAULT     CURLRUNNER_KEEP_SSL_SESSION
+
+/*
+ * Set an option on a context. Returns a CURLcode.
+ */
+int curl_runner_setopt(curl_runner_ctx *ctx, CURLRUNNERoption option,
+                       long value);
+
+/*
+ * A sink takes one output stream of a run in chunks, handed over straight
+ * from the buffer the tool has them in. It returns the number of bytes it
+ * took care of; anything else than 'len' fails the transfer.
+ */
+typedef size_t (*curl_runner_sink)(const char *ptr, size_t len, void *userp);
+
+/*
+ * The outcome of one transfer, straight from curl_easy_getinfo(). Strings
+ * and arrays are only valid during the callback that gets the record.
+ */
+struct curl_runner_header {
+  const char *name;
+  const char *value;
+};
+
+struct curl_runner_result {
+  long index;                     /* transfer number in the run, from 0 */
+  const char *url;                /* as given */
+  const char *effective_url;      /* after redirects */
+  int exit_code;                  /* the CURLcode the transfer ended with */
+  long response_code;
+  long http_version;              /* CURL_HTTP_VERSION_* */
+  const char *remote_ip;
+  long remote_port;
+  const char *content_type;
+  long num_connects;
+  long num_redirects;
+  curl_off_t size_download;
+  curl_off_t size_upload;
+  curl_off_t size_header;
+  curl_off_t size_request;
+  curl_off_t speed_download;      /* bytes per second */
+  curl_off_t speed_upload;
+  /* microseconds from the start of the transfer */
+  curl_off_t time_namelookup;
+  curl_off_t time_connect;
+  curl_off_t time_appconnect;
+  curl_off_t time_pretransfer;
+  curl_off_t time_starttransfer;
+  curl_off_t time_redirect;
+  curl_off_t time_total;
+  /* headers of the last response, with CURLRUNNER_RESULT_HEADERS */
+  const struct curl_runner_header *headers;
+  size_t num_headers;
+  /* data of this transfer meant for stdout, with CURLRUNNER_RESULT_BODY */
+  const char *body;
+  size_t body_len;
+};
+
+/*
+ * Called once for every finished transfer, after retries.
+ */
+typedef void (*curl_runner_result_cb)(const struct curl_runner_result *res,
+                                      void *userp);
+
+#define CURLRUNNER_RESULT_HEADERS (1L << 0)
+#define CURLRUNNER_RESULT_BODY    (1L << 1) /* collected instead of going to
+                                               the body sink or stdout */
+
+/*
+ * The sinks of a run, any of them may be NULL.
+ *
+ * 'body' gets the received data the tool would write to stdout, instead of
+ * stdout. Output the command line sends to files is still written to the
+ * files, and --write-out, --help and --version text still goes to stdout.
+ * 'header' gets every response header line as received, in addition to
+ * what --include or --dump-header do with them.
+ * 'err' gets the messages the tool would write to stderr, instead of stderr:
+ * warnings, errors and notes. Verbose and progress output stay on stderr.
+ * 'result' gets a record of every transfer, with the CURLRUNNER_RESULT_*
+ * extras in 'result_flags'.
+ */
+struct curl_runner_io {
+  curl_runner_sink body;
+  void *body_userp;
+  curl_runner_sink header;
+  void *header_userp;
+  curl_runner_sink err;
+  void *err_userp;
+  curl_runner_result_cb result;
+  void *result_userp;
+  long result_flags;
+};
+
+/*
+ * Run the curl tool with the given arguments, argv[0] being the program
+ * name, delivering its output to the sinks in 'io', which may be NULL.
+ * Returns the curl exit code.
+ */
+int curl_runner_exec_io(curl_runner_ctx *ctx, int argc, char *argv[],
+                        const struct curl_runner_io *io);
+
+/*
+ * Same as curl_runner_exec_io() with the stdout and stderr output copied to
+ * 'out' and 'err', both may be NULL.
+ */
+int curl_runner_exec(curl_runner_ctx *ctx, int argc, char *argv[],
+                     struct CaptureBuffer *out, struct CaptureBuffer *err);
+
+/*
+ * A plan is a command line parsed once, with .curlrc, -K files and data read
+ * from files, that can then be run any number of times, also from several
+ * threads at once. Messages while parsing go to the 'err' sink of 'io',
+ * which may be NULL. Returns a CURLcode and sets *planp on success. A plan
+ * must be freed before its context is cleaned up.
+ */
+typedef struct curl_runner_plan curl_runner_plan;
+
+int curl_runner_compile(curl_runner_ctx *ctx, int argc, char *argv[],
+                        const struct curl_runner_io *io,
+                        curl_runner_plan **planp);
+
+struct curl_runner_var {
+  const char *name;
+  const char *value;
+};
+
+/*
+ * What one run of a plan changes from the command line, all of it optional.
+ * It applies to the first operation, the part before any --next.
+ * Variables are expanded while parsing, so a run setting any has the command
+ * line parsed again.
+ */
+struct curl_runner_overrides {
+  const char *url;                /* instead of the first URL */
+  const char *const *headers;     /* "Name: value", after the -H ones */
+  size_t num_headers;
+  const char *body;               /* instead of the -d data, POSTs it */
+  size_t body_len;
+  const struct curl_runner_var *vars; /* win over --variable */
+  size_t num_vars;
+};
+
+/*
+ * Run a plan with the overrides in 'ov' and the sinks in 'io', both may be
+ * NULL. Returns the curl exit code.
+ */
+int curl_runner_plan_exec(curl_runner_plan *plan,
+                          const struct curl_runner_overrides *ov,
+                          const struct curl_runner_io *io);
+void curl_runner_plan_free(curl_runner_plan *plan);
+
+/*
+ * Sink collecting into a CaptureBuffer, pass the buffer as userp.
+ */
+size_t curl_runner_capture_sink(const char *ptr, size_t len, void *userp);
+
+/*
+ * Sink collecting into a list of chunks, so that large output is never
+ * copied into one contiguous buffer. Pass a zeroed struct
+ * curl_runner_chunks as userp, optionally with 'chunk_size' set, and free
+ * the chunks with curl_runner_chunks_free() when done.
+ */
+struct curl_runner_chunk {
+  struct curl_runner_chunk *next;
+  size_t len;                     /* bytes used in data[] */
+  size_t size;                    /* bytes allocated for data[] */
+  char data[1];
+};
+
+struct curl_runner_chunks {
+  struct curl_runner_chunk *head;
+  struct curl_runner_chunk *tail;
+  size_t chunk_size;              /* bytes per chunk, 0 for 64 KiB */
+  size_t total;                   /* bytes collected */
+};
+
+size_t curl_runner_chunks_sink(const char *ptr, size_t len, void *userp);
+void curl_runner_chunks_free(struct curl_runner_chunks *chunks);
+
+/*
+ * Sink writing to a file that can then be mapped into memory, so that the
+ * output can be used in place without being held in memory during the run.
+ * Set 'fp' to a FILE opened for both writing and reading, for example with
+ * tmpfile(), and pass the struct as userp. curl_runner_mapfile_map() returns
+ * the collected output or NULL, curl_runner_mapfile_unmap() releases it.
+ * Closing 'fp' is up to the caller.
+ */
+struct curl_runner_mapfile {
+  FILE *fp;
+  void *map;
+  size_t maplen;
+  int mapped;                     /* map is a mapping, not a copy */
+};
+
+size_t curl_runner_mapfile_sink(const char *ptr, size_t len, void *userp);
+const char *curl_runner_mapfile_map(struct curl_runner_mapfile *mf,
+                                    size_t *lenp);
+void curl_runner_mapfile_unmap(struct curl_runner_mapfile *mf);
+
 #ifdef __cplusplus
 } /* extern "C" */
-#endif
 
-#define RUNNER_OUT_BUFFER_SIZE 1024 * 64
-#define RUNNER_ERR_BUFFER_SIZE 1024 * 16
+struct CurlTransfer {
+    long index;
+    std::string url;
+    std::string effective_url;
+    int exit_code;
+    long response_code;
+    long http_version;
+    std::string remote_ip;
+    long remote_port;
+    std::string content_type;
+    long num_connects;
+    long num_redirects;
+    curl_off_t size_download;
+    curl_off_t size_upload;
+    curl_off_t size_header;
+    curl_off_t size_request;
+    curl_off_t speed_download;
+    curl_off_t speed_upload;
+    curl_off_t time_namelookup;
+    curl_off_t time_connect;
+    curl_off_t time_appconnect;
+    curl_off_t time_pretransfer;
+    curl_off_t time_starttransfer;
+    curl_off_t time_redirect;
+    curl_off_t time_total;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
 
 struct CurlResult {
     int exit_code;
     std::string stdout_str;
     std::string stderr_str;
+    std::vector<CurlTransfer> transfers;
 };
 
-struct CurlResult curl_run(const std::vector<std::string> &args) {
+inline size_t curl_run_string_sink(const char *ptr, size_t len, void *userp) {
+    try {
+        static_cast<std::string *>(userp)->append(ptr, len);
+    }
+    catch (...) {
+        return 0; /* never let an exception unwind through C code */
+    }
+    return len;
+}
 
-    static struct CaptureBuffer outbuf;
-    static char out_static[RUNNER_OUT_BUFFER_SIZE];
-    capture_init(&outbuf, out_static, sizeof(out_static));
-    set_stdout_capture_buffer(&outbuf);
+inline void curl_run_result_cb(const struct curl_runner_result *res,
+                               void *userp) {
+    auto *transfers = static_cast<std::vector<CurlTransfer> *>(userp);
+    try {
+        CurlTransfer t;
+        t.index = res->index;
+        t.url = res->url ? res->url : "";
+        t.effective_url = res->effective_url ? res->effective_url : "";
+        t.exit_code = res->exit_code;
+        t.response_code = res->response_code;
+        t.http_version = res->http_version;
+        t.remote_ip = res->remote_ip ? res->remote_ip : "";
+        t.remote_port = res->remote_port;
+        t.content_type = res->content_type ? res->content_type : "";
+        t.num_connects = res->num_connects;
+        t.num_redirects = res->num_redirects;
+        t.size_download = res->size_download;
+        t.size_upload = res->size_upload;
+        t.size_header = res->size_header;
+        t.size_request = res->size_request;
+        t.speed_download = res->speed_download;
+        t.speed_upload = res->speed_upload;
+        t.time_namelookup = res->time_namelookup;
+        t.time_connect = res->time_connect;
+        t.time_appconnect = res->time_appconnect;
+        t.time_pretransfer = res->time_pretransfer;
+        t.time_starttransfer = res->time_starttransfer;
+        t.time_redirect = res->time_redirect;
+        t.time_total = res->time_total;
+        t.headers.reserve(res->num_headers);
+        for (size_t i = 0; i < res->num_headers; i++)
+            t.headers.emplace_back(res->headers[i].name,
+                                   res->headers[i].value);
+        if (res->body)
+            t.body.assign(res->body, res->body_len);
+        transfers->push_back(std::move(t));
+    }
+    catch (...) {
+        /* never let an exception unwind through C code */
+    }
+}
+
+/*
+ * The sinks collecting a run into 'result'.
+ */
+inline struct curl_runner_io curl_run_io(struct CurlResult &result,
+                                         long result_flags) {
+
+    /* output goes straight into the strings, no intermediate buffer */
+    struct curl_runner_io io = {};
+    io.body = curl_run_string_sink;
+    io.body_userp = &result.stdout_str;
+    io.err = curl_run_string_sink;
+    io.err_userp = &result.stderr_str;
+    io.result = curl_run_result_cb;
+    io.result_userp = &result.transfers;
+    io.result_flags = result_flags;
+    return io;
+}
 
-    static struct CaptureBuffer errbuf;
-    static char err_static[RUNNER_ERR_BUFFER_SIZE];
-    capture_init(&errbuf, err_static, sizeof(err_static));
-    set_stderr_capture_buffer(&errbuf);
+/*
+ * Run the tool and collect its output and a record of every transfer.
+ * 'result_flags' takes CURLRUNNER_RESULT_* bits for headers and bodies per
+ * transfer.
+ */
+inline struct CurlResult curl_run(curl_runner_ctx *ctx,
+                                  const std::vector<std::string> &args,
+                                  long result_flags = 0) {
+
+    CurlResult result;
+    struct curl_runner_io io = curl_run_io(result, result_flags);
 
     std::vector<char*> argv;
     argv.reserve(args.size() + 2);
@@ -47,14 +389,45 @@ struct CurlResult curl_run(const std::vector<std::string> &args) {
         argv.push_back(const_cast<char*>(s.c_str()));
     argv.push_back(nullptr);
 
-    int code = curl_main(static_cast<int>(argv.size() - 1), argv.data());
+    result.exit_code = curl_runner_exec_io(ctx,
+                                           static_cast<int>(argv.size() - 1),
+                                           argv.data(), &io);
+    return result;
+}
+
+/*
+ * Run a compiled plan, collecting the same as curl_run().
+ */
+inline struct CurlResult curl_run(curl_runner_plan *plan,
+                                  const struct curl_runner_overrides *ov =
+                                      nullptr,
+                                  long result_flags = 0) {
 
     CurlResult result;
-    result.exit_code = code;
-    result.stdout_str = std::string(outbuf.data);
-    result.stderr_str = std::string(errbuf.data);
-    
+    struct curl_runner_io io = curl_run_io(result, result_flags);
+    result.exit_code = curl_runner_plan_exec(plan, ov, &io);
     return result;
 }
 
-#endif /* CURL_RUNNER_H */
\ No newline at end of file
+/*
+ * Run with a context shared by the whole process, created on first use.
+ */
+inline struct CurlResult curl_run(const std::vector<std::string> &args,
+                                  long result_flags = 0) {
+
+    static struct DefaultRunner {
+        curl_runner_ctx *ctx;
+        DefaultRunner() : ctx(curl_runner_init()) {}
+        ~DefaultRunner() { curl_runner_cleanup(ctx); }
+    } runner;
+
+    if (!runner.ctx) {
+        CurlResult result;
+        result.exit_code = 2; /* CURLE_FAILED_INIT */
+        return result;
+    }
+    return curl_run(runner.ctx, args, result_flags);
+}
+#endif /* __cplusplus */
+
+#endif /* CURL_RUNNER_H */
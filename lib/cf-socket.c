@@ -60,6 +60,9 @@
 /* Required for __DragonFly_version */
 #include <sys/param.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include "urldata.h"
 #include "bufq.h"
@@ -1520,6 +1523,59 @@ static CURLcode cf_socket_send(struct Curl_cfilter *cf, struct Curl_easy *data,
   return result;
 }
 
+CURLcode Curl_cf_socket_send_file(struct Curl_cfilter *cf,
+                                  struct Curl_easy *data,
+                                  int fd, curl_off_t offset, size_t len,
+                                  size_t *pnwritten)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+  struct cf_socket_ctx *ctx = cf->ctx;
+  off_t off = (off_t)offset;
+  ssize_t nwritten;
+  CURLcode result = CURLE_OK;
+
+  *pnwritten = 0;
+  if(((cf->cft != &Curl_cft_tcp) && (cf->cft != &Curl_cft_unix)) ||
+     cf->conn->bits.tcp_fastopen || (off != offset))
+    return CURLE_NOT_BUILT_IN;
+  if(!len)
+    return CURLE_OK;
+
+  nwritten = sendfile(ctx->sock, fd, &off, len);
+  if(nwritten < 0) {
+    int sockerr = SOCKERRNO;
+
+    if((SOCKEWOULDBLOCK == sockerr) || (EAGAIN == sockerr) ||
+       (SOCKEINTR == sockerr))
+      result = CURLE_AGAIN;
+    else if((SOCKEINVAL == sockerr) || (ENOSYS == sockerr))
+      /* the file cannot be sent like this, it has to be read */
+      result = CURLE_NOT_BUILT_IN;
+    else {
+      char buffer[STRERROR_LEN];
+      failf(data, "Send failure: %s",
+            Curl_strerror(sockerr, buffer, sizeof(buffer)));
+      data->state.os_errno = sockerr;
+      result = CURLE_SEND_ERROR;
+    }
+  }
+  else
+    *pnwritten = (size_t)nwritten;
+
+  CURL_TRC_CF(data, cf, "sendfile(len=%zu) -> %d, %zu",
+              len, result, *pnwritten);
+  return result;
+#else
+  (void)cf;
+  (void)data;
+  (void)fd;
+  (void)offset;
+  (void)len;
+  *pnwritten = 0;
+  return CURLE_NOT_BUILT_IN;
+#endif
+}
+
 static CURLcode cf_socket_recv(struct Curl_cfilter *cf, struct Curl_easy *data,
                                char *buf, size_t len, size_t *pnread)
 {
@@ -159,6 +159,19 @@ CURLcode Curl_cf_socket_peek(struct Curl_cfilter *cf,
                              const struct Curl_sockaddr_ex **paddr,
                              struct ip_quadruple *pip);
 
+/**
+ * Send `len` bytes of the file `fd` from `offset` on, without copying them
+ * to user space. Only the TCP and UNIX socket filters can do this. With
+ * `len` 0, this only checks that the filter can.
+ * @return CURLE_NOT_BUILT_IN if the filter or the file does not allow it,
+ *         CURLE_AGAIN if the socket is blocked. CURLE_OK with `*pnwritten`
+ *         0 when the file has no data at `offset`.
+ */
+CURLcode Curl_cf_socket_send_file(struct Curl_cfilter *cf,
+                                  struct Curl_easy *data,
+                                  int fd, curl_off_t offset, size_t len,
+                                  size_t *pnwritten);
+
 extern struct Curl_cftype Curl_cft_tcp;
 extern struct Curl_cftype Curl_cft_udp;
 extern struct Curl_cftype Curl_cft_unix;
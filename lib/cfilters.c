@@ -28,6 +28,7 @@
 #include "strerror.h"
 #include "cfilters.h"
 #include "connect.h"
+#include "cf-socket.h"
 #include "url.h"
 #include "sendf.h"
 #include "sockaddr.h" /* required for Curl_sockaddr_storage */
@@ -1146,3 +1147,25 @@ CURLcode Curl_conn_send(struct Curl_easy *data, int sockindex,
   *pnwritten = 0;
   return CURLE_FAILED_INIT;
 }
+
+CURLcode Curl_conn_send_file(struct Curl_easy *data, int sockindex,
+                             int fd, curl_off_t offset, size_t len,
+                             size_t *pnwritten)
+{
+  struct Curl_cfilter *cf;
+
+  DEBUGASSERT(data);
+  DEBUGASSERT(data->conn);
+  *pnwritten = 0;
+  if(!CONN_SOCK_IDX_VALID(sockindex) ||
+     (data->conn->send[sockindex] != Curl_cf_send))
+    return CURLE_NOT_BUILT_IN;
+  /* filters that pass sends on unchanged do not matter, the one below
+   * them has to be the socket */
+  cf = data->conn->cfilter[sockindex];
+  while(cf && cf->connected && (cf->cft->do_send == Curl_cf_def_send))
+    cf = cf->next;
+  if(!cf || !cf->connected)
+    return CURLE_NOT_BUILT_IN;
+  return Curl_cf_socket_send_file(cf, data, fd, offset, len, pnwritten);
+}
@@ -632,6 +632,17 @@ CURLcode Curl_conn_send(struct Curl_easy *data, int sockindex,
                         const void *buf, size_t blen, bool eos,
                         size_t *pnwritten);
 
+/*
+ * Send `len` bytes of file `fd` from `offset` on the connection, letting
+ * the system copy them. Only possible when no filter changes the data on
+ * its way to the socket. With `len` 0, only checks that.
+ * Will return CURLE_NOT_BUILT_IN iff not possible, the data has to be sent
+ * with Curl_conn_send() then, and CURLE_AGAIN iff blocked on sending.
+ */
+CURLcode Curl_conn_send_file(struct Curl_easy *data, int sockindex,
+                             int fd, curl_off_t offset, size_t len,
+                             size_t *pnwritten);
+
 
 /**
  * Types and macros used to keep the current easy handle in filter calls,
@@ -43,6 +43,7 @@
 #include "connect.h"
 #include "select.h"
 #include "curlx/strparse.h"
+#include "uint-hash.h"
 #include "uint-table.h"
 
 /* The last 3 #include files should be in this order */
@@ -75,9 +76,17 @@
   } while(0)
 
 
+/* The connections of a bundle with the same reuse key. */
+struct cpool_bucket {
+  struct cpool_bucket *next;
+  struct Curl_llist conns;
+  unsigned int key;
+};
+
 /* A list of connections to the same destination. */
 struct cpool_bundle {
   struct Curl_llist conns; /* connections in the bundle */
+  struct cpool_bucket *buckets; /* the connections by reuse key */
   size_t dest_len; /* total length of destination, including NUL */
   char *dest[1]; /* destination of bundle, allocated to keep dest_len bytes */
 };
@@ -105,28 +114,86 @@ static struct cpool_bundle *cpool_bundle_create(const char *dest)
 static void cpool_bundle_destroy(struct cpool_bundle *bundle)
 {
   DEBUGASSERT(!Curl_llist_count(&bundle->conns));
+  DEBUGASSERT(!bundle->buckets);
   free(bundle);
 }
 
+static struct cpool_bucket *cpool_bundle_bucket(struct cpool_bundle *bundle,
+                                                unsigned int key)
+{
+  struct cpool_bucket *bucket;
+  for(bucket = bundle->buckets; bucket; bucket = bucket->next) {
+    if(bucket->key == key)
+      break;
+  }
+  return bucket;
+}
+
 /* Add a connection to a bundle */
-static void cpool_bundle_add(struct cpool_bundle *bundle,
+static bool cpool_bundle_add(struct cpool_bundle *bundle,
                              struct connectdata *conn)
 {
+  struct cpool_bucket *bucket = cpool_bundle_bucket(bundle, conn->reuse_key);
+  if(!bucket) {
+    bucket = calloc(1, sizeof(*bucket));
+    if(!bucket)
+      return FALSE;
+    Curl_llist_init(&bucket->conns, NULL);
+    bucket->key = conn->reuse_key;
+    bucket->next = bundle->buckets;
+    bundle->buckets = bucket;
+  }
   DEBUGASSERT(!Curl_node_llist(&conn->cpool_node));
   Curl_llist_append(&bundle->conns, conn, &conn->cpool_node);
+  Curl_llist_append(&bucket->conns, conn, &conn->cpool_key_node);
   conn->bits.in_cpool = TRUE;
+  return TRUE;
 }
 
 /* Remove a connection from a bundle */
 static void cpool_bundle_remove(struct cpool_bundle *bundle,
                                 struct connectdata *conn)
 {
-  (void)bundle;
+  struct cpool_bucket **bp = &bundle->buckets;
+  struct Curl_llist *list = Curl_node_llist(&conn->cpool_key_node);
+
   DEBUGASSERT(Curl_node_llist(&conn->cpool_node) == &bundle->conns);
   Curl_node_remove(&conn->cpool_node);
+  Curl_node_remove(&conn->cpool_key_node);
+  while(*bp) {
+    struct cpool_bucket *bucket = *bp;
+    if(&bucket->conns == list) {
+      if(!Curl_llist_count(&bucket->conns)) {
+        *bp = bucket->next;
+        free(bucket);
+      }
+      break;
+    }
+    bp = &bucket->next;
+  }
   conn->bits.in_cpool = FALSE;
 }
 
+/* The pooled connections by id and the idle ones in the order they became
+   idle. Kept out of struct cpool, which is part of every multi handle. */
+struct cpool_index {
+  struct uint_hash conn_ids;
+  struct Curl_llist idle; /* least recently used first */
+};
+
+static struct cpool_index *cpool_index_get(struct cpool *cpool)
+{
+  if(!cpool->idx) {
+    cpool->idx = malloc(sizeof(*cpool->idx));
+    if(!cpool->idx)
+      return NULL;
+    Curl_uint_hash_init(&cpool->idx->conn_ids,
+                        (unsigned int)cpool->dest2bundle.slots, NULL);
+    Curl_llist_init(&cpool->idx->idle, NULL);
+  }
+  return cpool->idx;
+}
+
 static void cpool_bundle_free_entry(void *freethis)
 {
   cpool_bundle_destroy((struct cpool_bundle *)freethis);
@@ -139,6 +206,7 @@ void Curl_cpool_init(struct cpool *cpool,
 {
   Curl_hash_init(&cpool->dest2bundle, size, Curl_hash_str,
                  curlx_str_key_compare, cpool_bundle_free_entry);
+  cpool->idx = NULL;
 
   DEBUGASSERT(idata);
 
@@ -184,8 +252,8 @@ static void cpool_remove_bundle(struct cpool *cpool,
 }
 
 
-static void cpool_remove_conn(struct cpool *cpool,
-                              struct connectdata *conn)
+UNITTEST void cpool_remove_conn(struct cpool *cpool,
+                                struct connectdata *conn)
 {
   struct Curl_llist *list = Curl_node_llist(&conn->cpool_node);
   DEBUGASSERT(cpool);
@@ -193,9 +261,15 @@ static void cpool_remove_conn(struct cpool *cpool,
     /* The connection is certainly in the pool, but where? */
     struct cpool_bundle *bundle = cpool_find_bundle(cpool, conn);
     if(bundle && (list == &bundle->conns)) {
+      unsigned int key = (unsigned int)conn->connection_id;
       cpool_bundle_remove(bundle, conn);
       if(!Curl_llist_count(&bundle->conns))
         cpool_remove_bundle(cpool, bundle);
+      if(cpool->idx &&
+         (Curl_uint_hash_get(&cpool->idx->conn_ids, key) == conn))
+        Curl_uint_hash_remove(&cpool->idx->conn_ids, key);
+      if(Curl_node_llist(&conn->cpool_idle_node))
+        Curl_node_remove(&conn->cpool_idle_node);
       conn->bits.in_cpool = FALSE;
       cpool->num_conn--;
     }
@@ -228,6 +302,10 @@ void Curl_cpool_destroy(struct cpool *cpool)
     CPOOL_UNLOCK(cpool, cpool->idata);
     sigpipe_restore(&pipe_st);
     Curl_hash_destroy(&cpool->dest2bundle);
+    if(cpool->idx) {
+      Curl_uint_hash_destroy(&cpool->idx->conn_ids);
+      Curl_safefree(cpool->idx);
+    }
   }
 }
 
@@ -312,39 +390,24 @@ cpool_bundle_get_oldest_idle(struct cpool_bundle *bundle)
   return oldest_idle;
 }
 
+/* The least recently used idle connection. The idle list has the
+   connections in the order they became idle, the ones used again since are
+   taken out of it on the way. */
 static struct connectdata *cpool_get_oldest_idle(struct cpool *cpool)
 {
-  struct Curl_hash_iterator iter;
-  struct Curl_llist_node *curr;
-  struct Curl_hash_element *he;
-  struct connectdata *oldest_idle = NULL;
-  struct cpool_bundle *bundle;
-  struct curltime now;
-  timediff_t highscore =- 1;
-  timediff_t score;
+  struct Curl_llist_node *curr =
+    cpool->idx ? Curl_llist_head(&cpool->idx->idle) : NULL;
 
-  now = curlx_now();
-  Curl_hash_start_iterate(&cpool->dest2bundle, &iter);
-
-  for(he = Curl_hash_next_element(&iter); he;
-      he = Curl_hash_next_element(&iter)) {
-    struct connectdata *conn;
-    bundle = he->ptr;
-
-    for(curr = Curl_llist_head(&bundle->conns); curr;
-        curr = Curl_node_next(curr)) {
-      conn = Curl_node_elem(curr);
-      if(CONN_INUSE(conn) || conn->bits.close || conn->connect_only)
-        continue;
-      /* Set higher score for the age passed since the connection was used */
-      score = curlx_timediff(now, conn->lastused);
-      if(score > highscore) {
-        highscore = score;
-        oldest_idle = conn;
-      }
-    }
+  while(curr) {
+    struct connectdata *conn = Curl_node_elem(curr);
+    curr = Curl_node_next(curr);
+    if(CONN_INUSE(conn))
+      /* back in the list when it is idle again */
+      Curl_node_remove(&conn->cpool_idle_node);
+    else if(!conn->bits.close && !conn->connect_only)
+      return conn;
   }
-  return oldest_idle;
+  return NULL;
 }
 
 
@@ -455,6 +518,10 @@ CURLcode Curl_cpool_add(struct Curl_easy *data,
     return CURLE_FAILED_INIT;
 
   CPOOL_LOCK(cpool, data);
+  if(!cpool_index_get(cpool)) {
+    result = CURLE_OUT_OF_MEMORY;
+    goto out;
+  }
   bundle = cpool_find_bundle(cpool, conn);
   if(!bundle) {
     bundle = cpool_add_bundle(cpool, conn);
@@ -464,9 +531,20 @@ CURLcode Curl_cpool_add(struct Curl_easy *data,
     }
   }
 
-  cpool_bundle_add(bundle, conn);
+  if(!cpool_bundle_add(bundle, conn)) {
+    if(!Curl_llist_count(&bundle->conns))
+      cpool_remove_bundle(cpool, bundle);
+    result = CURLE_OUT_OF_MEMORY;
+    goto out;
+  }
   conn->connection_id = cpool->next_connection_id++;
   cpool->num_conn++;
+  /* an id already in the index after the ids wrapped the key around keeps
+     its place, the connection is found with a scan instead */
+  if(!Curl_uint_hash_get(&cpool->idx->conn_ids,
+                         (unsigned int)conn->connection_id))
+    (void)Curl_uint_hash_set(&cpool->idx->conn_ids,
+                             (unsigned int)conn->connection_id, conn);
   CURL_TRC_M(data, "[CPOOL] added connection %" FMT_OFF_T ". "
              "The cache now contains %zu members",
              conn->connection_id, cpool->num_conn);
@@ -539,12 +617,18 @@ bool Curl_cpool_conn_now_idle(struct Curl_easy *data,
   bool kept = TRUE;
 
   conn->lastused = curlx_now(); /* it was used up until now */
-  if(cpool && maxconnects) {
+  if(cpool) {
     /* may be called form a callback already under lock */
     bool do_lock = !CPOOL_IS_LOCKED(cpool);
     if(do_lock)
       CPOOL_LOCK(cpool, data);
-    if(cpool->num_conn > maxconnects) {
+    if(conn->bits.in_cpool) {
+      /* the most recently used idle connection now */
+      if(Curl_node_llist(&conn->cpool_idle_node))
+        Curl_node_remove(&conn->cpool_idle_node);
+      Curl_llist_append(&cpool->idx->idle, conn, &conn->cpool_idle_node);
+    }
+    if(maxconnects && (cpool->num_conn > maxconnects)) {
       infof(data, "Connection pool is full, closing the oldest of %zu/%u",
             cpool->num_conn, maxconnects);
 
@@ -563,6 +647,7 @@ bool Curl_cpool_conn_now_idle(struct Curl_easy *data,
 
 bool Curl_cpool_find(struct Curl_easy *data,
                      const char *destination,
+                     unsigned int reuse_key,
                      Curl_cpool_conn_match_cb *conn_cb,
                      Curl_cpool_done_match_cb *done_cb,
                      void *userdata)
@@ -581,7 +666,9 @@ bool Curl_cpool_find(struct Curl_easy *data,
                           CURL_UNCONST(destination),
                           strlen(destination) + 1);
   if(bundle) {
-    struct Curl_llist_node *curr = Curl_llist_head(&bundle->conns);
+    struct cpool_bucket *bucket = cpool_bundle_bucket(bundle, reuse_key);
+    struct Curl_llist_node *curr =
+      bucket ? Curl_llist_head(&bucket->conns) : NULL;
     while(curr) {
       struct connectdata *conn = Curl_node_elem(curr);
       /* Get next node now. callback might discard current */
@@ -786,53 +873,56 @@ static int cpool_find_conn(struct Curl_easy *data,
   return 0;
 }
 
-struct connectdata *Curl_cpool_get_conn(struct Curl_easy *data,
-                                        curl_off_t conn_id)
+/* The pooled connection with the given id, from the index. Only when not all
+   connections made it into the index is the pool scanned for it. */
+static struct connectdata *cpool_get_by_id(struct Curl_easy *data,
+                                           struct cpool *cpool,
+                                           curl_off_t conn_id)
 {
-  struct cpool *cpool = cpool_get_instance(data);
   struct cpool_find_ctx fctx;
 
-  if(!cpool)
+  if(conn_id < 0)
     return NULL;
-  fctx.id = conn_id;
+  if(!cpool->idx)
+    return NULL; /* no connection was ever added */
+  fctx.conn = Curl_uint_hash_get(&cpool->idx->conn_ids,
+                                 (unsigned int)conn_id);
+  if(fctx.conn && (fctx.conn->connection_id == conn_id))
+    return fctx.conn;
   fctx.conn = NULL;
-  CPOOL_LOCK(cpool, data);
-  cpool_foreach(data, cpool, &fctx, cpool_find_conn);
-  CPOOL_UNLOCK(cpool, data);
+  if(Curl_uint_hash_count(&cpool->idx->conn_ids) != cpool->num_conn) {
+    fctx.id = conn_id;
+    cpool_foreach(data, cpool, &fctx, cpool_find_conn);
+  }
   return fctx.conn;
 }
 
-struct cpool_do_conn_ctx {
-  curl_off_t id;
-  Curl_cpool_conn_do_cb *cb;
-  void *cbdata;
-};
-
-static int cpool_do_conn(struct Curl_easy *data,
-                         struct connectdata *conn, void *param)
+struct connectdata *Curl_cpool_get_conn(struct Curl_easy *data,
+                                        curl_off_t conn_id)
 {
-  struct cpool_do_conn_ctx *dctx = param;
-  (void)data;
-  if(conn->connection_id == dctx->id) {
-    dctx->cb(conn, data, dctx->cbdata);
-    return 1;
-  }
-  return 0;
+  struct cpool *cpool = cpool_get_instance(data);
+  struct connectdata *conn;
+
+  if(!cpool)
+    return NULL;
+  CPOOL_LOCK(cpool, data);
+  conn = cpool_get_by_id(data, cpool, conn_id);
+  CPOOL_UNLOCK(cpool, data);
+  return conn;
 }
 
 void Curl_cpool_do_by_id(struct Curl_easy *data, curl_off_t conn_id,
                          Curl_cpool_conn_do_cb *cb, void *cbdata)
 {
   struct cpool *cpool = cpool_get_instance(data);
-  struct cpool_do_conn_ctx dctx;
+  struct connectdata *conn;
 
   if(!cpool)
     return;
-  dctx.id = conn_id;
-  dctx.cb = cb;
-  dctx.cbdata = cbdata;
   CPOOL_LOCK(cpool, data);
-  cpool_foreach(data, cpool, &dctx, cpool_do_conn);
+  conn = cpool_get_by_id(data, cpool, conn_id);
+  if(conn)
+    cb(conn, data, cbdata);
   CPOOL_UNLOCK(cpool, data);
 }
 
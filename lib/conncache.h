@@ -29,6 +29,7 @@
 #include "curlx/timeval.h"
 
 struct connectdata;
+struct cpool_index;
 struct Curl_easy;
 struct curl_pollfds;
 struct Curl_waitfds;
@@ -51,6 +52,8 @@ void Curl_conn_terminate(struct Curl_easy *data,
 struct cpool {
    /* the pooled connections, bundled per destination */
   struct Curl_hash dest2bundle;
+  /* by id and in idle order, allocated with the first connection */
+  struct cpool_index *idx;
   size_t num_conn;
   curl_off_t next_connection_id;
   curl_off_t next_easy_id;
@@ -103,17 +106,19 @@ typedef bool Curl_cpool_conn_match_cb(struct connectdata *conn,
 typedef bool Curl_cpool_done_match_cb(bool result, void *userdata);
 
 /**
- * Find a connection in the pool matching `destination`.
+ * Find a connection in the pool matching `destination` and `reuse_key`.
  * All callbacks are invoked while the pool's lock is held.
  * @param data        current transfer
  * @param destination match against `conn->destination` in pool
+ * @param reuse_key   match against `conn->reuse_key` in pool
  * @param conn_cb     must be present, called for each connection in the
- *                    bundle until it returns TRUE
+ *                    bundle with the key until it returns TRUE
  * @return combined result of last conn_db and result_cb or FALSE if no
                       connections were present.
  */
 bool Curl_cpool_find(struct Curl_easy *data,
                      const char *destination,
+                     unsigned int reuse_key,
                      Curl_cpool_conn_match_cb *conn_cb,
                      Curl_cpool_done_match_cb *done_cb,
                      void *userdata);
@@ -166,5 +171,9 @@ void Curl_cpool_do_locked(struct Curl_easy *data,
 /* Close all unused connections, prevent reuse of existing ones. */
 void Curl_cpool_nw_changed(struct Curl_easy *data);
 
+#ifdef UNITTESTS
+UNITTEST void cpool_remove_conn(struct cpool *cpool,
+                                struct connectdata *conn);
+#endif
 
 #endif /* HEADER_CURL_CONNCACHE_H */
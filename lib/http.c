@@ -4764,22 +4764,22 @@ static void http_exp100_continue(struct Curl_easy *data,
   }
 }
 
-static CURLcode cr_exp100_read(struct Curl_easy *data,
+/* Sets `*ppass` when the upload data may go on, otherwise the reader
+ * gives nothing. */
+static CURLcode cr_exp100_wait(struct Curl_easy *data,
                                struct Curl_creader *reader,
-                               char *buf, size_t blen,
-                               size_t *nread, bool *eos)
+                               bool *ppass)
 {
   struct cr_exp100_ctx *ctx = reader->ctx;
   timediff_t ms;
 
+  *ppass = FALSE;
   switch(ctx->state) {
   case EXP100_SENDING_REQUEST:
     if(!Curl_req_sendbuf_empty(data)) {
       /* The initial request data has not been fully sent yet. Do
        * not start the timer yet. */
       DEBUGF(infof(data, "cr_exp100_read, request not full sent yet"));
-      *nread = 0;
-      *eos = FALSE;
       return CURLE_OK;
     }
     /* We are now waiting for a reply from the server or
@@ -4791,13 +4791,9 @@ static CURLcode cr_exp100_read(struct Curl_easy *data,
     Curl_expire(data, data->set.expect_100_timeout, EXPIRE_100_TIMEOUT);
     data->req.keepon &= ~KEEP_SEND;
     data->req.keepon |= KEEP_SEND_TIMED;
-    *nread = 0;
-    *eos = FALSE;
     return CURLE_OK;
   case EXP100_FAILED:
     DEBUGF(infof(data, "cr_exp100_read, expectation failed, error"));
-    *nread = 0;
-    *eos = FALSE;
     return CURLE_READ_ERROR;
   case EXP100_AWAITING_CONTINUE:
     ms = curlx_timediff(curlx_now(), ctx->start);
@@ -4805,8 +4801,6 @@ static CURLcode cr_exp100_read(struct Curl_easy *data,
       DEBUGF(infof(data, "cr_exp100_read, AWAITING_CONTINUE, not expired"));
       data->req.keepon &= ~KEEP_SEND;
       data->req.keepon |= KEEP_SEND_TIMED;
-      *nread = 0;
-      *eos = FALSE;
       return CURLE_OK;
     }
     /* we have waited long enough, continue anyway */
@@ -4815,10 +4809,42 @@ static CURLcode cr_exp100_read(struct Curl_easy *data,
     FALLTHROUGH();
   default:
     DEBUGF(infof(data, "cr_exp100_read, pass through"));
-    return Curl_creader_read(data, reader->next, buf, blen, nread, eos);
+    *ppass = TRUE;
+    return CURLE_OK;
   }
 }
 
+static CURLcode cr_exp100_read(struct Curl_easy *data,
+                               struct Curl_creader *reader,
+                               char *buf, size_t blen,
+                               size_t *nread, bool *eos)
+{
+  bool pass;
+  CURLcode result = cr_exp100_wait(data, reader, &pass);
+
+  *nread = 0;
+  *eos = FALSE;
+  if(result || !pass)
+    return result;
+  return Curl_creader_read(data, reader->next, buf, blen, nread, eos);
+}
+
+static CURLcode cr_exp100_send_file(struct Curl_easy *data,
+                                    struct Curl_creader *reader,
+                                    int sockindex, size_t blen,
+                                    size_t *pnwritten, bool *eos)
+{
+  bool pass;
+  CURLcode result = cr_exp100_wait(data, reader, &pass);
+
+  *pnwritten = 0;
+  *eos = FALSE;
+  if(result || !pass)
+    return result;
+  return Curl_creader_send_file(data, reader->next, sockindex, blen,
+                                pnwritten, eos);
+}
+
 static void cr_exp100_done(struct Curl_easy *data,
                            struct Curl_creader *reader, int premature)
 {
@@ -4840,6 +4866,7 @@ static const struct Curl_crtype cr_exp100 = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   cr_exp100_done,
+  cr_exp100_send_file,
   sizeof(struct cr_exp100_ctx)
 };
 
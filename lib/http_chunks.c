@@ -660,6 +660,7 @@ const struct Curl_crtype Curl_httpchunk_encoder = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct chunked_reader)
 };
 
@@ -2189,6 +2189,7 @@ static const struct Curl_crtype cr_mime = {
   cr_mime_unpause,
   cr_mime_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct cr_mime_ctx)
 };
 
@@ -99,13 +99,12 @@
 
 static void move_pending_to_connect(struct Curl_multi *multi,
                                     struct Curl_easy *data);
-static CURLMcode add_next_timeout(struct curltime now,
-                                  struct Curl_multi *multi,
-                                  struct Curl_easy *d);
 static CURLMcode multi_timeout(struct Curl_multi *multi,
                                struct curltime *expire_time,
                                long *timeout_ms);
 static void process_pending_handles(struct Curl_multi *multi);
+static CURLMcode multi_perform_ready(struct Curl_multi *multi,
+                                     int *running_handles);
 static void multi_xfer_bufs_free(struct Curl_multi *multi);
 #ifdef DEBUGBUILD
 static void multi_xfer_tbl_dump(struct Curl_multi *multi);
@@ -253,13 +252,16 @@ struct Curl_multi *Curl_multi_handle(unsigned int xfer_table_size,
      Curl_uint_tbl_resize(&multi->xfers, xfer_table_size))
     goto error;
 
+  multi->timers = Curl_twheel_create(curlx_now());
+  if(!multi->timers)
+    goto error;
+
   multi->admin = curl_easy_init();
   if(!multi->admin)
     goto error;
   /* Initialize admin handle to operate inside this multi */
   multi->admin->multi = multi;
   multi->admin->state.internal = TRUE;
-  Curl_llist_init(&multi->admin->state.timeoutlist, NULL);
 #ifdef DEBUGBUILD
   if(getenv("CURL_DEBUG"))
     multi->admin->set.verbose = TRUE;
@@ -311,6 +313,7 @@ error:
   Curl_uint_bset_destroy(&multi->pending);
   Curl_uint_bset_destroy(&multi->msgsent);
   Curl_uint_tbl_destroy(&multi->xfers);
+  Curl_twheel_destroy(multi->timers);
 
   free(multi);
   return NULL;
@@ -447,9 +450,6 @@ CURLMcode curl_multi_add_handle(CURLM *m, CURL *d)
   if(multi_xfers_add(multi, data))
     return CURLM_OUT_OF_MEMORY;
 
-  /* Initialize timeout list for this handle */
-  Curl_llist_init(&data->state.timeoutlist, NULL);
-
   /*
    * No failure allowed in this function beyond this point. No modification of
    * easy nor multi handle allowed before this except for potential multi's
@@ -490,6 +490,7 @@ CURLMcode curl_multi_add_handle(CURLM *m, CURL *d)
    * a timeout callback invocation. */
   rc = Curl_update_timer(multi);
   if(rc) {
+    Curl_expire_clear(data);
     data->multi = NULL; /* not anymore */
     Curl_uint_tbl_remove(&multi->xfers, data->mid);
     data->mid = UINT_MAX;
@@ -775,9 +776,9 @@ CURLMcode curl_multi_remove_handle(CURLM *m, CURL *d)
     (void)multi_done(data, data->result, premature);
   }
 
-  /* The timer must be shut down before data->multi is set to NULL, else the
-     timenode will remain in the splay tree after curl_easy_cleanup is
-     called. Do it after multi_done() in case that sets another time! */
+  /* The timers must be shut down before data->multi is set to NULL, else
+     they remain in the timer wheel after curl_easy_cleanup is called. Do it
+     after multi_done() in case that sets another time! */
   removed_timer = Curl_expire_clear(data);
 
   /* If in `msgsent`, it was deducted from `multi->xfers_alive` already. */
@@ -991,6 +992,18 @@ static CURLcode mstate_perform_pollset(struct Curl_easy *data,
   }
 }
 
+/* the number of timers the transfer has set */
+static unsigned int multi_xfer_timers(struct Curl_easy *data)
+{
+  unsigned int n = 0;
+  int i;
+  for(i = 0; i < EXPIRE_LAST; i++) {
+    if(Curl_twnode_queued(&data->state.expires[i].tw))
+      n++;
+  }
+  return n;
+}
+
 /* Initializes `poll_set` with the current socket poll actions needed
  * for transfer `data`. */
 CURLMcode Curl_multi_pollset(struct Curl_easy *data,
@@ -1105,37 +1118,37 @@ CURLMcode Curl_multi_pollset(struct Curl_easy *data,
 
   switch(ps->n) {
     case 0:
-      CURL_TRC_M(data, "%s pollset[], timeouts=%zu, paused %d/%d (r/w)",
-                 caller, Curl_llist_count(&data->state.timeoutlist),
+      CURL_TRC_M(data, "%s pollset[], timeouts=%u, paused %d/%d (r/w)",
+                 caller, multi_xfer_timers(data),
                  Curl_xfer_send_is_paused(data),
                  Curl_xfer_recv_is_paused(data));
       break;
     case 1:
-      CURL_TRC_M(data, "%s pollset[fd=%" FMT_SOCKET_T " %s%s], timeouts=%zu",
+      CURL_TRC_M(data, "%s pollset[fd=%" FMT_SOCKET_T " %s%s], timeouts=%u",
                  caller, ps->sockets[0],
                  (ps->actions[0] & CURL_POLL_IN) ? "IN" : "",
                  (ps->actions[0] & CURL_POLL_OUT) ? "OUT" : "",
-                 Curl_llist_count(&data->state.timeoutlist));
+                 multi_xfer_timers(data));
       break;
     case 2:
       CURL_TRC_M(data, "%s pollset[fd=%" FMT_SOCKET_T " %s%s, "
-                 "fd=%" FMT_SOCKET_T " %s%s], timeouts=%zu",
+                 "fd=%" FMT_SOCKET_T " %s%s], timeouts=%u",
                  caller, ps->sockets[0],
                  (ps->actions[0] & CURL_POLL_IN) ? "IN" : "",
                  (ps->actions[0] & CURL_POLL_OUT) ? "OUT" : "",
                  ps->sockets[1],
                  (ps->actions[1] & CURL_POLL_IN) ? "IN" : "",
                  (ps->actions[1] & CURL_POLL_OUT) ? "OUT" : "",
-                 Curl_llist_count(&data->state.timeoutlist));
+                 multi_xfer_timers(data));
       break;
     default:
-      CURL_TRC_M(data, "%s pollset[fds=%u], timeouts=%zu",
-                 caller, ps->n, Curl_llist_count(&data->state.timeoutlist));
+      CURL_TRC_M(data, "%s pollset[fds=%u], timeouts=%u",
+                 caller, ps->n, multi_xfer_timers(data));
       break;
   }
   if(expect_sockets && !ps->n && data->multi &&
      !Curl_uint_bset_contains(&data->multi->dirty, data->mid) &&
-     !Curl_llist_count(&data->state.timeoutlist) &&
+     !multi_xfer_timers(data) &&
      !Curl_cwriter_is_paused(data) && !Curl_creader_is_paused(data) &&
      Curl_conn_is_ip_connected(data, FIRSTSOCKET)) {
     /* We expected sockets for POLL monitoring, but none are set.
@@ -1276,6 +1289,15 @@ static void reset_socket_fdwrite(curl_socket_t s)
 }
 #endif
 
+/* With CURLMOPT_PERFORM_READY, the transfers on a socket with activity are
+   among the ones the next curl_multi_perform() runs */
+static void multi_wait_ready(struct Curl_multi *multi, curl_socket_t s)
+{
+  bool run_cpool;
+  if(multi->perform_ready)
+    Curl_multi_ev_dirty_xfers(multi, s, &run_cpool);
+}
+
 #define NUM_POLLS_ON_STACK 10
 
 static CURLMcode multi_wait(struct Curl_multi *multi,
@@ -1297,6 +1319,7 @@ static CURLMcode multi_wait(struct Curl_multi *multi,
   struct Curl_easy *data = NULL;
   CURLMcode result = CURLM_OK;
   unsigned int mid;
+  curl_socket_t epfd;
 
 #ifdef USE_WINSOCK
   WSANETWORKEVENTS wsa_events;
@@ -1318,8 +1341,17 @@ static CURLMcode multi_wait(struct Curl_multi *multi,
   Curl_pollset_init(&ps);
   Curl_pollfds_init(&cpfds, a_few_on_stack, NUM_POLLS_ON_STACK);
 
-  /* Add the curl handles to our pollfds first */
-  if(Curl_uint_bset_first(&multi->process, &mid)) {
+  /* When the sockets of all transfers are in an epoll set, poll that.
+   * Otherwise add the curl handles to our pollfds first */
+  epfd = Curl_multi_ev_epoll_fd(multi);
+  if(epfd != CURL_SOCKET_BAD) {
+    data = multi->admin;
+    if(Curl_pollfds_add_sock(&cpfds, epfd, POLLIN)) {
+      result = CURLM_OUT_OF_MEMORY;
+      goto out;
+    }
+  }
+  else if(Curl_uint_bset_first(&multi->process, &mid)) {
     do {
       data = Curl_multi_get_easy(multi, mid);
       if(!data) {
@@ -1422,6 +1454,18 @@ static CURLMcode multi_wait(struct Curl_multi *multi,
 
     if(pollrc > 0) {
       retcode = pollrc;
+      /* count the sockets with events in the epoll set, not the set */
+      if(epfd != CURL_SOCKET_BAD) {
+        if(cpfds.pfds[0].revents & POLLIN)
+          retcode += (int)Curl_multi_ev_epoll_ready(multi,
+                                                    multi->perform_ready) - 1;
+      }
+      else if(multi->perform_ready) {
+        for(i = 0; i < curl_nfds; i++) {
+          if(cpfds.pfds[i].revents)
+            multi_wait_ready(multi, cpfds.pfds[i].fd);
+        }
+      }
 #ifdef USE_WINSOCK
     }
     else { /* now wait... if not ready during the pre-check (pollrc == 0) */
@@ -1474,6 +1518,8 @@ static CURLMcode multi_wait(struct Curl_multi *multi,
         if(WSAEnumNetworkEvents(cpfds.pfds[i].fd, NULL, &wsa_events) == 0) {
           if(ret && !pollrc && wsa_events.lNetworkEvents)
             retcode++;
+          if(wsa_events.lNetworkEvents)
+            multi_wait_ready(multi, cpfds.pfds[i].fd);
         }
         WSAEventSelect(cpfds.pfds[i].fd, multi->wsa_event, 0);
       }
@@ -2738,10 +2784,23 @@ statemachine_end:
 }
 
 
+/* a PENDING transfer's timer expired */
+static void multi_pending_timeout(struct Curl_multi *multi,
+                                  struct Curl_easy *data,
+                                  struct curltime *now)
+{
+  bool stream_unused;
+  CURLcode result_unused;
+  if(multi_handle_timeout(data, now, &stream_unused, &result_unused)) {
+    infof(data, "PENDING handle timeout");
+    move_pending_to_connect(multi, data);
+  }
+}
+
 CURLMcode curl_multi_perform(CURLM *m, int *running_handles)
 {
   CURLMcode returncode = CURLM_OK;
-  struct Curl_tree *t = NULL;
+  struct Curl_twnode *t;
   struct curltime now = curlx_now();
   struct Curl_multi *multi = m;
   unsigned int mid;
@@ -2753,6 +2812,9 @@ CURLMcode curl_multi_perform(CURLM *m, int *running_handles)
   if(multi->in_callback)
     return CURLM_RECURSIVE_API_CALL;
 
+  if(multi->perform_ready)
+    return multi_perform_ready(multi, running_handles);
+
   sigpipe_init(&pipe_st);
   if(Curl_uint_bset_first(&multi->process, &mid)) {
     CURL_TRC_M(multi->admin, "multi_perform(running=%u)",
@@ -2772,6 +2834,12 @@ CURLMcode curl_multi_perform(CURLM *m, int *running_handles)
         result = multi_runsingle(multi, &now, data);
         if(result)
           returncode = result;
+        /* keep the epoll set of curl_multi_wait() up to date */
+        if(Curl_multi_ev_epoll_on(multi)) {
+          result = Curl_multi_ev_assess_xfer(multi, data);
+          if(result && !returncode)
+            returncode = result;
+        }
       }
     }
     while(Curl_uint_bset_next(&multi->process, mid, &mid));
@@ -2785,31 +2853,21 @@ CURLMcode curl_multi_perform(CURLM *m, int *running_handles)
     process_pending_handles(m);
 
   /*
-   * Simply remove all expired timers from the splay since handles are dealt
+   * Simply remove all expired timers from the wheel since handles are dealt
    * with unconditionally by this function and curl_multi_timeout() requires
-   * that already passed/handled expire times are removed from the splay.
+   * that already passed/handled expire times are removed from the wheel.
    *
    * It is important that the 'now' value is set at the entry of this function
    * and not for the current time as it may have ticked a little while since
    * then and then we risk this loop to remove timers that actually have not
    * been handled!
    */
-  do {
-    multi->timetree = Curl_splaygetbest(now, multi->timetree, &t);
-    if(t) {
-      /* the removed may have another timeout in queue */
-      struct Curl_easy *data = Curl_splayget(t);
-      (void)add_next_timeout(now, multi, data);
-      if(data->mstate == MSTATE_PENDING) {
-        bool stream_unused;
-        CURLcode result_unused;
-        if(multi_handle_timeout(data, &now, &stream_unused, &result_unused)) {
-          infof(data, "PENDING handle timeout");
-          move_pending_to_connect(multi, data);
-        }
-      }
-    }
-  } while(t);
+  for(t = Curl_twheel_expire(multi->timers, now); t;
+      t = Curl_twnode_enext(t)) {
+    struct Curl_easy *data = Curl_twnode_get(t);
+    if(data->mstate == MSTATE_PENDING)
+      multi_pending_timeout(multi, data, &now);
+  }
 
   if(running_handles) {
     unsigned int running = Curl_multi_xfers_running(multi);
@@ -2854,6 +2912,8 @@ CURLMcode curl_multi_cleanup(CURLM *m)
           /* if DONE was never called for this handle */
           (void)multi_done(data, CURLE_OK, TRUE);
 
+        /* the timers go away with the multi */
+        Curl_expire_clear(data);
         data->multi = NULL; /* clear the association */
         Curl_uint_tbl_remove(&multi->xfers, mid);
         data->mid = UINT_MAX;
@@ -2872,6 +2932,7 @@ CURLMcode curl_multi_cleanup(CURLM *m)
     Curl_cshutdn_destroy(&multi->cshutdn, multi->admin);
     if(multi->admin) {
       CURL_TRC_M(multi->admin, "multi_cleanup, closing admin handle, done");
+      Curl_expire_clear(multi->admin);
       multi->admin->multi = NULL;
       Curl_uint_tbl_remove(&multi->xfers, multi->admin->mid);
       Curl_close(&multi->admin);
@@ -2910,6 +2971,7 @@ CURLMcode curl_multi_cleanup(CURLM *m)
     Curl_uint_bset_destroy(&multi->pending);
     Curl_uint_bset_destroy(&multi->msgsent);
     Curl_uint_tbl_destroy(&multi->xfers);
+    Curl_twheel_destroy(multi->timers);
     free(multi);
 
     return CURLM_OK;
@@ -2967,93 +3029,29 @@ void Curl_multi_will_close(struct Curl_easy *data, curl_socket_t s)
   }
 }
 
-/*
- * add_next_timeout()
- *
- * Each Curl_easy has a list of timeouts. The add_next_timeout() is called
- * when it has just been removed from the splay tree because the timeout has
- * expired. This function is then to advance in the list to pick the next
- * timeout to use (skip the already expired ones) and add this node back to
- * the splay tree again.
- *
- * The splay tree only has each sessionhandle as a single node and the nearest
- * timeout is used to sort it on.
- */
-static CURLMcode add_next_timeout(struct curltime now,
-                                  struct Curl_multi *multi,
-                                  struct Curl_easy *d)
-{
-  struct curltime *tv = &d->state.expiretime;
-  struct Curl_llist *list = &d->state.timeoutlist;
-  struct Curl_llist_node *e;
-
-  /* move over the timeout list for this specific handle and remove all
-     timeouts that are now passed tense and store the next pending
-     timeout in *tv */
-  for(e = Curl_llist_head(list); e;) {
-    struct Curl_llist_node *n = Curl_node_next(e);
-    struct time_node *node = Curl_node_elem(e);
-    timediff_t diff = curlx_timediff_us(node->time, now);
-    if(diff <= 0)
-      /* remove outdated entry */
-      Curl_node_remove(e);
-    else
-      /* the list is sorted so get out on the first mismatch */
-      break;
-    e = n;
-  }
-  e = Curl_llist_head(list);
-  if(!e) {
-    /* clear the expire times within the handles that we remove from the
-       splay tree */
-    tv->tv_sec = 0;
-    tv->tv_usec = 0;
-  }
-  else {
-    struct time_node *node = Curl_node_elem(e);
-    /* copy the first entry to 'tv' */
-    memcpy(tv, &node->time, sizeof(*tv));
-
-    /* Insert this node again into the splay. Keep the timer in the list in
-       case we need to recompute future timers. */
-    multi->timetree = Curl_splayinsert(*tv, multi->timetree,
-                                       &d->state.timenode);
-  }
-  return CURLM_OK;
-}
-
 struct multi_run_ctx {
   struct Curl_multi *multi;
   struct curltime now;
   size_t run_xfers;
   SIGPIPE_MEMBER(pipe_st);
   bool run_cpool;
+  bool pending; /* handle timeouts of PENDING transfers */
 };
 
 static void multi_mark_expired_as_dirty(struct multi_run_ctx *mrc)
 {
   struct Curl_multi *multi = mrc->multi;
-  struct Curl_easy *data = NULL;
-  struct Curl_tree *t = NULL;
-
-  /*
-   * The loop following here will go on as long as there are expire-times left
-   * to process (compared to mrc->now) in the splay and 'data' will be
-   * re-assigned for every expired handle we deal with.
-   */
-  while(1) {
-    /* Check if there is one (more) expired timer to deal with! This function
-       extracts a matching node if there is one */
-    multi->timetree = Curl_splaygetbest(mrc->now, multi->timetree, &t);
-    if(!t)
-      return;
-
-    data = Curl_splayget(t); /* assign this for next loop */
-    if(!data)
-      continue;
-
-    (void)add_next_timeout(mrc->now, multi, data);
-    Curl_multi_mark_dirty(data);
+  struct Curl_twnode *t;
+
+  /* all timers expired by mrc->now come off the wheel at once, a transfer
+     with several of them is marked for each */
+  for(t = Curl_twheel_expire(multi->timers, mrc->now); t;
+      t = Curl_twnode_enext(t)) {
+    struct Curl_easy *data = Curl_twnode_get(t);
+    if(mrc->pending && (data->mstate == MSTATE_PENDING))
+      multi_pending_timeout(multi, data, &mrc->now);
+    else
+      Curl_multi_mark_dirty(data);
   }
 }
 
@@ -3104,6 +3102,43 @@ out:
   return result;
 }
 
+/* curl_multi_perform() with CURLMOPT_PERFORM_READY: run the transfers
+ * that are dirty, e.g. curl_multi_wait() saw activity on their sockets,
+ * or have a timer expired */
+static CURLMcode multi_perform_ready(struct Curl_multi *multi,
+                                     int *running_handles)
+{
+  CURLMcode result;
+  struct multi_run_ctx mrc;
+
+  memset(&mrc, 0, sizeof(mrc));
+  mrc.multi = multi;
+  mrc.now = curlx_now();
+  mrc.pending = TRUE;
+  sigpipe_init(&mrc.pipe_st);
+
+  CURL_TRC_M(multi->admin, "multi_perform(running=%u, ready)",
+             Curl_multi_xfers_running(multi));
+  multi_mark_expired_as_dirty(&mrc);
+  result = multi_run_dirty(&mrc);
+
+  sigpipe_apply(multi->admin, &mrc.pipe_st);
+  Curl_cshutdn_perform(&multi->cshutdn, multi->admin, CURL_SOCKET_TIMEOUT);
+  sigpipe_restore(&mrc.pipe_st);
+
+  if(multi_ischanged(multi, TRUE))
+    process_pending_handles(multi);
+
+  if(running_handles) {
+    unsigned int running = Curl_multi_xfers_running(multi);
+    *running_handles = (running < INT_MAX) ? (int)running : INT_MAX;
+  }
+
+  if(CURLM_OK >= result)
+    result = Curl_update_timer(multi);
+  return result;
+}
+
 static CURLMcode multi_socket(struct Curl_multi *multi,
                               bool checkall,
                               curl_socket_t s,
@@ -3201,6 +3236,8 @@ CURLMcode curl_multi_setopt(CURLM *m,
   switch(option) {
   case CURLMOPT_SOCKETFUNCTION:
     multi->socket_cb = va_arg(param, curl_socket_callback);
+    if(multi->socket_cb)
+      Curl_multi_ev_epoll_stop(multi);
     break;
   case CURLMOPT_SOCKETDATA:
     multi->socket_userp = va_arg(param, void *);
@@ -3250,6 +3287,12 @@ CURLMcode curl_multi_setopt(CURLM *m,
       multi->max_concurrent_streams = (unsigned int)streams;
     }
     break;
+  case CURLMOPT_PERFORM_READY:
+    multi->perform_ready = va_arg(param, long) ? 1 : 0;
+    if(multi->perform_ready)
+      /* start tracking the sockets of the transfers */
+      res = Curl_multi_ev_assess_xfer_bset(multi, &multi->process);
+    break;
   case CURLMOPT_NETWORK_CHANGED: {
     long val = va_arg(param, long);
     if(val & CURLMNWC_CLEAR_DNS) {
@@ -3335,31 +3378,22 @@ static CURLMcode multi_timeout(struct Curl_multi *multi,
     *timeout_ms = 0;
     return CURLM_OK;
   }
-  else if(multi->timetree) {
-    /* we have a tree of expire times */
+  else if(Curl_twheel_count(multi->timers)) {
+    /* we have timers set, the earliest one is what counts */
+    struct Curl_twnode *first = Curl_twheel_first(multi->timers);
     struct curltime now = curlx_now();
 
-    /* splay the lowest to the bottom */
-    multi->timetree = Curl_splay(tv_zero, multi->timetree);
-    /* this will not return NULL from a non-empty tree, but some compilers
-     * are not convinced of that. Analyzers are hard. */
-    *expire_time = multi->timetree ? multi->timetree->key : tv_zero;
-
-    /* 'multi->timetree' will be non-NULL here but the compilers sometimes
-       yell at us if we assume so */
-    if(multi->timetree &&
-       curlx_timediff_us(multi->timetree->key, now) > 0) {
+    *expire_time = first->time;
+    if(curlx_timediff_us(first->time, now) > 0) {
       /* some time left before expiration */
-      timediff_t diff = curlx_timediff_ceil(multi->timetree->key, now);
+      timediff_t diff = curlx_timediff_ceil(first->time, now);
       /* this should be safe even on 32-bit archs, as we do not use that
          overly long timeouts */
       *timeout_ms = (long)diff;
     }
     else {
-      if(multi->timetree) {
-        struct Curl_easy *data = Curl_splayget(multi->timetree);
-        CURL_TRC_M(data, "multi_timeout() says this has expired");
-      }
+      struct Curl_easy *data = Curl_twnode_get(first);
+      CURL_TRC_M(data, "multi_timeout() says this has expired");
       /* 0 means immediately */
       *timeout_ms = 0;
     }
@@ -3462,75 +3496,12 @@ CURLMcode Curl_update_timer(struct Curl_multi *multi)
   return CURLM_OK;
 }
 
-/*
- * multi_deltimeout()
- *
- * Remove a given timestamp from the list of timeouts.
- */
-static void
-multi_deltimeout(struct Curl_easy *data, expire_id eid)
-{
-  struct Curl_llist_node *e;
-  struct Curl_llist *timeoutlist = &data->state.timeoutlist;
-  /* find and remove the specific node from the list */
-  for(e = Curl_llist_head(timeoutlist); e; e = Curl_node_next(e)) {
-    struct time_node *n = Curl_node_elem(e);
-    if(n->eid == eid) {
-      Curl_node_remove(e);
-      return;
-    }
-  }
-}
-
-/*
- * multi_addtimeout()
- *
- * Add a timestamp to the list of timeouts. Keep the list sorted so that head
- * of list is always the timeout nearest in time.
- *
- */
-static CURLMcode
-multi_addtimeout(struct Curl_easy *data,
-                 struct curltime *stamp,
-                 expire_id eid)
-{
-  struct Curl_llist_node *e;
-  struct time_node *node;
-  struct Curl_llist_node *prev = NULL;
-  size_t n;
-  struct Curl_llist *timeoutlist = &data->state.timeoutlist;
-
-  node = &data->state.expires[eid];
-
-  /* copy the timestamp and id */
-  memcpy(&node->time, stamp, sizeof(*stamp));
-  node->eid = eid; /* also marks it as in use */
-
-  n = Curl_llist_count(timeoutlist);
-  if(n) {
-    /* find the correct spot in the list */
-    for(e = Curl_llist_head(timeoutlist); e; e = Curl_node_next(e)) {
-      struct time_node *check = Curl_node_elem(e);
-      timediff_t diff = curlx_timediff(check->time, node->time);
-      if(diff > 0)
-        break;
-      prev = e;
-    }
-
-  }
-  /* else
-     this is the first timeout on the list */
-
-  Curl_llist_insert_next(timeoutlist, prev, node, &node->list);
-  return CURLM_OK;
-}
-
 void Curl_expire_ex(struct Curl_easy *data,
                     const struct curltime *nowp,
                     timediff_t milli, expire_id id)
 {
   struct Curl_multi *multi = data->multi;
-  struct curltime *curr_expire = &data->state.expiretime;
+  struct time_node *node;
   struct curltime set;
 
   /* this is only interesting while there is still an associated multi struct
@@ -3549,40 +3520,10 @@ void Curl_expire_ex(struct Curl_easy *data,
     set.tv_usec -= 1000000;
   }
 
-  /* Remove any timer with the same id just in case. */
-  multi_deltimeout(data, id);
-
-  /* Add it to the timer list. It must stay in the list until it has expired
-     in case we need to recompute the minimum timer later. */
-  multi_addtimeout(data, &set, id);
-
-  if(curr_expire->tv_sec || curr_expire->tv_usec) {
-    /* This means that the struct is added as a node in the splay tree.
-       Compare if the new time is earlier, and only remove-old/add-new if it
-       is. */
-    timediff_t diff = curlx_timediff(set, *curr_expire);
-    int rc;
-
-    if(diff > 0) {
-      /* The current splay tree entry is sooner than this new expiry time.
-         We do not need to update our splay tree entry. */
-      return;
-    }
-
-    /* Since this is an updated time, we must remove the previous entry from
-       the splay tree first and then re-add the new value */
-    rc = Curl_splayremove(multi->timetree, &data->state.timenode,
-                          &multi->timetree);
-    if(rc)
-      infof(data, "Internal error removing splay node = %d", rc);
-  }
-
-  /* Indicate that we are in the splay tree and insert the new timer expiry
-     value since it is our local minimum. */
-  *curr_expire = set;
-  Curl_splayset(&data->state.timenode, data);
-  multi->timetree = Curl_splayinsert(*curr_expire, multi->timetree,
-                                     &data->state.timenode);
+  /* Put it into the wheel, this replaces a timer with the same id. */
+  node = &data->state.expires[id];
+  node->eid = id;
+  Curl_twheel_add(multi->timers, &node->tw, set, data);
   if(data->id >= 0)
     CURL_TRC_M(data, "set expire[%d] in %" FMT_TIMEDIFF_T "ns",
                id, curlx_timediff_us(set, *nowp));
@@ -3614,7 +3555,8 @@ void Curl_expire(struct Curl_easy *data, timediff_t milli, expire_id id)
 void Curl_expire_done(struct Curl_easy *data, expire_id id)
 {
   /* remove the timer, if there */
-  multi_deltimeout(data, id);
+  if(data->multi)
+    Curl_twheel_remove(data->multi->timers, &data->state.expires[id].tw);
 }
 
 /*
@@ -3625,33 +3567,24 @@ void Curl_expire_done(struct Curl_easy *data, expire_id id)
 bool Curl_expire_clear(struct Curl_easy *data)
 {
   struct Curl_multi *multi = data->multi;
-  struct curltime *nowp = &data->state.expiretime;
+  bool cleared = FALSE;
+  int i;
 
   /* this is only interesting while there is still an associated multi struct
      remaining! */
   if(!multi)
     return FALSE;
 
-  if(nowp->tv_sec || nowp->tv_usec) {
-    /* Since this is an cleared time, we must remove the previous entry from
-       the splay tree */
-    struct Curl_llist *list = &data->state.timeoutlist;
-    int rc;
-
-    rc = Curl_splayremove(multi->timetree, &data->state.timenode,
-                          &multi->timetree);
-    if(rc)
-      infof(data, "Internal error clearing splay node = %d", rc);
-
-    /* clear the timeout list too */
-    Curl_llist_destroy(list, NULL);
-
-    CURL_TRC_M(data, "Expire cleared");
-    nowp->tv_sec = 0;
-    nowp->tv_usec = 0;
-    return TRUE;
+  for(i = 0; i < EXPIRE_LAST; i++) {
+    struct Curl_twnode *node = &data->state.expires[i].tw;
+    if(Curl_twnode_queued(node)) {
+      Curl_twheel_remove(multi->timers, node);
+      cleared = TRUE;
+    }
   }
-  return FALSE;
+  if(cleared)
+    CURL_TRC_M(data, "Expire cleared");
+  return cleared;
 }
 
 CURLMcode curl_multi_assign(CURLM *m, curl_socket_t s,
@@ -38,8 +38,13 @@
 #include "uint-spbset.h"
 #include "uint-table.h"
 #include "curlx/warnless.h"
+#include "curlx/strparse.h"
 #include "multihandle.h"
 #include "socks.h"
+
+#ifdef USE_MULTI_EV_EPOLL
+#include <sys/epoll.h>
+#endif
 /* The last 3 #include files should be in this order */
 #include "curl_printf.h"
 #include "curl_memory.h"
@@ -64,6 +69,7 @@ struct mev_sh_entry {
                          * libcurl application to watch out for */
   unsigned int readers; /* this many transfers want to read */
   unsigned int writers; /* this many transfers want to write */
+  unsigned int ep_action; /* CURL_POLL_IN/CURL_POLL_OUT in the epoll set */
   BIT(announced);       /* this socket has been passed to the socket
                            callback at least once */
 };
@@ -193,6 +199,264 @@ static bool mev_sh_entry_conn_remove(struct mev_sh_entry *e,
   return FALSE;
 }
 
+#ifdef USE_MULTI_EV_EPOLL
+
+#define MEV_EPOLL_MAXEVENTS 64
+
+/* The epoll set while it is in use. It is kept as meta data of the admin
+ * handle, so that multi handles not polling an epoll set do not carry it. */
+struct mev_epoll {
+  int fd;
+  unsigned int n;  /* sockets in the set */
+  struct epoll_event *events; /* for all of them to be ready at once */
+  unsigned int events_len;
+#ifdef DEBUGBUILD
+  curl_off_t fail_ctl; /* make the n-th epoll_ctl() change fail */
+#endif
+};
+
+static void mev_epoll_dtor(void *key, size_t klen, void *entry)
+{
+  struct mev_epoll *ep = entry;
+  (void)key;
+  (void)klen;
+  close(ep->fd);
+  free(ep->events);
+  free(ep);
+}
+
+static struct mev_epoll *mev_epoll_get(struct Curl_multi *multi)
+{
+  return multi->admin ?
+    Curl_meta_get(multi->admin, CURL_META_MEV_EPOLL) : NULL;
+}
+
+static bool mev_epoll_on(struct Curl_multi *multi)
+{
+  return !!mev_epoll_get(multi);
+}
+
+static void mev_epoll_close(struct Curl_multi *multi)
+{
+  struct Curl_hash_iterator iter;
+  struct Curl_hash_element *he;
+
+  if(!mev_epoll_on(multi))
+    return;
+  Curl_meta_remove(multi->admin, CURL_META_MEV_EPOLL);
+  Curl_hash_start_iterate(&multi->ev.sh_entries, &iter);
+  for(he = Curl_hash_next_element(&iter); he;
+      he = Curl_hash_next_element(&iter)) {
+    struct mev_sh_entry *entry = he->ptr;
+    entry->ep_action = 0;
+  }
+}
+
+/* Change what the epoll set monitors on socket `s` from `entry->ep_action`
+ * to `action`. Stop using the set when that fails, curl_multi_wait() then
+ * goes back to polling each socket. */
+static void mev_epoll_update(struct Curl_multi *multi,
+                             struct Curl_easy *data,
+                             struct mev_sh_entry *entry,
+                             curl_socket_t s, unsigned int action)
+{
+  struct mev_epoll *ep = mev_epoll_get(multi);
+  struct epoll_event ev;
+  int op;
+  int rc;
+
+  if(!ep || (entry->ep_action == action))
+    return;
+
+  if(!action) {
+    /* fails when the socket has been closed already, that is fine */
+    (void)epoll_ctl(ep->fd, EPOLL_CTL_DEL, s, NULL);
+    entry->ep_action = 0;
+    ep->n--;
+    return;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  if(action & CURL_POLL_IN)
+    ev.events |= EPOLLIN;
+  if(action & CURL_POLL_OUT)
+    ev.events |= EPOLLOUT;
+  ev.data.fd = s;
+  op = entry->ep_action ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  rc = epoll_ctl(ep->fd, op, s, &ev);
+#ifdef DEBUGBUILD
+  if(!rc && ep->fail_ctl && !--ep->fail_ctl) {
+    rc = -1;
+    SET_SOCKERRNO(SOCKEINVAL);
+  }
+#endif
+  if(rc) {
+    /* the socket was closed and its number reused without us knowing */
+    if(((errno != EEXIST) && (errno != ENOENT)) ||
+       epoll_ctl(ep->fd, (op == EPOLL_CTL_ADD) ?
+                 EPOLL_CTL_MOD : EPOLL_CTL_ADD, s, &ev)) {
+      CURL_TRC_M(data, "ev epoll fd=%" FMT_SOCKET_T " failed, errno %d, "
+                 "no longer using epoll", s, errno);
+      mev_epoll_close(multi);
+      multi->epoll_failed = TRUE;
+      return;
+    }
+  }
+  if(!entry->ep_action)
+    ep->n++;
+  entry->ep_action = action;
+}
+
+curl_socket_t Curl_multi_ev_epoll_fd(struct Curl_multi *multi)
+{
+  struct mev_epoll *ep;
+
+  if(multi->socket_cb || multi->epoll_failed || !multi->admin)
+    return CURL_SOCKET_BAD;
+
+  ep = mev_epoll_get(multi);
+  if(!ep) {
+    struct Curl_hash_iterator iter;
+    struct Curl_hash_element *he;
+
+    ep = calloc(1, sizeof(*ep));
+    if(!ep)
+      return CURL_SOCKET_BAD;
+    ep->fd = epoll_create1(EPOLL_CLOEXEC);
+    if(ep->fd == -1) {
+      free(ep);
+      return CURL_SOCKET_BAD;
+    }
+#ifdef DEBUGBUILD
+    {
+      const char *p = getenv("CURL_DBG_EPOLL_FAIL");
+      if(p)
+        (void)curlx_str_number(&p, &ep->fail_ctl, CURL_OFF_T_MAX);
+    }
+#endif
+    /* frees `ep` on failure */
+    if(Curl_meta_set(multi->admin, CURL_META_MEV_EPOLL, ep, mev_epoll_dtor))
+      return CURL_SOCKET_BAD;
+    /* sockets known from a socket callback set before */
+    Curl_hash_start_iterate(&multi->ev.sh_entries, &iter);
+    for(he = Curl_hash_next_element(&iter); he && mev_epoll_on(multi);
+        he = Curl_hash_next_element(&iter)) {
+      struct mev_sh_entry *entry = he->ptr;
+      curl_socket_t s = *(curl_socket_t *)he->key;
+      mev_epoll_update(multi, multi->admin, entry, s,
+                       (entry->writers ? CURL_POLL_OUT : 0) |
+                       (entry->readers ? CURL_POLL_IN : 0));
+    }
+    if(mev_epoll_on(multi) &&
+       Curl_multi_ev_assess_xfer_bset(multi, &multi->process))
+      mev_epoll_close(multi);
+    ep = mev_epoll_get(multi);
+    if(!ep)
+      return CURL_SOCKET_BAD;
+    CURL_TRC_M(multi->admin, "ev epoll set created with %u sockets", ep->n);
+  }
+  return ep->n ? ep->fd : CURL_SOCKET_BAD;
+}
+
+bool Curl_multi_ev_epoll_on(struct Curl_multi *multi)
+{
+  return mev_epoll_on(multi);
+}
+
+unsigned int Curl_multi_ev_epoll_ready(struct Curl_multi *multi, bool dirty)
+{
+  struct mev_epoll *ep = mev_epoll_get(multi);
+  struct epoll_event few[MEV_EPOLL_MAXEVENTS];
+  struct epoll_event *events = few;
+  unsigned int max = MEV_EPOLL_MAXEVENTS;
+  int i, n;
+
+  if(!ep)
+    return 0;
+
+  if(dirty && (ep->n > max)) {
+    /* marking needs all sockets with events in one go, another
+     * epoll_wait() may return the same ones again */
+    if(ep->events_len < ep->n) {
+      unsigned int len = ep->n * 2;
+      struct epoll_event *p = realloc(ep->events, len * sizeof(*p));
+      if(p) {
+        ep->events = p;
+        ep->events_len = len;
+      }
+    }
+    if(ep->events_len >= ep->n) {
+      events = ep->events;
+      max = ep->events_len;
+    }
+    else {
+      /* out of memory, run them all */
+      unsigned int mid;
+      if(Curl_uint_bset_first(&multi->process, &mid)) {
+        do {
+          struct Curl_easy *data = Curl_multi_get_easy(multi, mid);
+          if(data)
+            Curl_multi_mark_dirty(data);
+        }
+        while(Curl_uint_bset_next(&multi->process, mid, &mid));
+      }
+      dirty = FALSE;
+    }
+  }
+
+  n = epoll_wait(ep->fd, events, (int)max, 0);
+  if(n <= 0)
+    return 0;
+  for(i = 0; dirty && (i < n); i++) {
+    bool run_cpool;
+    Curl_multi_ev_dirty_xfers(multi, events[i].data.fd, &run_cpool);
+  }
+  return (unsigned int)n;
+}
+
+void Curl_multi_ev_epoll_stop(struct Curl_multi *multi)
+{
+  mev_epoll_close(multi);
+}
+
+#else /* USE_MULTI_EV_EPOLL */
+
+#define mev_epoll_on(x)                   FALSE
+#define mev_epoll_update(a, b, c, d, e)   Curl_nop_stmt
+
+curl_socket_t Curl_multi_ev_epoll_fd(struct Curl_multi *multi)
+{
+  (void)multi;
+  return CURL_SOCKET_BAD;
+}
+
+bool Curl_multi_ev_epoll_on(struct Curl_multi *multi)
+{
+  (void)multi;
+  return FALSE;
+}
+
+unsigned int Curl_multi_ev_epoll_ready(struct Curl_multi *multi, bool dirty)
+{
+  (void)multi;
+  (void)dirty;
+  return 0;
+}
+
+void Curl_multi_ev_epoll_stop(struct Curl_multi *multi)
+{
+  (void)multi;
+}
+
+#endif /* !USE_MULTI_EV_EPOLL */
+
+/* The book-keeping of sockets is done for the socket callback, the epoll
+ * set and for CURLMOPT_PERFORM_READY */
+static bool mev_tracking(struct Curl_multi *multi)
+{
+  return multi->socket_cb || multi->perform_ready || mev_epoll_on(multi);
+}
+
 /* Purge any information about socket `s`.
  * Let the socket callback know as well when necessary */
 static CURLMcode mev_forget_socket(struct Curl_multi *multi,
@@ -206,6 +470,8 @@ static CURLMcode mev_forget_socket(struct Curl_multi *multi,
   if(!entry) /* we never knew or already forgot about this socket */
     return CURLM_OK;
 
+  mev_epoll_update(multi, data, entry, s, 0);
+
   /* We managed this socket before, tell the socket callback to forget it. */
   if(entry->announced && multi->socket_cb) {
     CURL_TRC_M(data, "ev %s, call(fd=%" FMT_SOCKET_T ", ev=REMOVE)",
@@ -234,9 +500,9 @@ static CURLMcode mev_sh_entry_update(struct Curl_multi *multi,
 {
   int rc, comboaction;
 
-  /* we should only be called when the callback exists */
-  DEBUGASSERT(multi->socket_cb);
-  if(!multi->socket_cb)
+  /* we should only be called when sockets are tracked */
+  DEBUGASSERT(mev_tracking(multi));
+  if(!mev_tracking(multi))
     return CURLM_OK;
 
   /* Transfer `data` goes from `last_action` to `cur_action` on socket `s`
@@ -275,6 +541,9 @@ static CURLMcode mev_sh_entry_update(struct Curl_multi *multi,
 
   comboaction = (entry->writers ? CURL_POLL_OUT : 0) |
                 (entry->readers ? CURL_POLL_IN : 0);
+  mev_epoll_update(multi, data, entry, s, (unsigned int)comboaction);
+  if(!multi->socket_cb)
+    return CURLM_OK;
   if(((int)entry->action == comboaction)) /* nothing for socket changed */
     return CURLM_OK;
 
@@ -497,7 +766,9 @@ static CURLMcode mev_assess(struct Curl_multi *multi,
   struct easy_pollset ps, *last_ps;
   CURLMcode res = CURLM_OK;
 
-  if(!multi || !multi->socket_cb)
+  /* without a socket callback only the sockets of transfers are tracked,
+   * connections shutting down are polled by curl_multi_wait() separately */
+  if(!multi || !mev_tracking(multi) || (conn && !multi->socket_cb))
     return CURLM_OK;
 
   Curl_pollset_init(&ps);
@@ -552,7 +823,7 @@ CURLMcode Curl_multi_ev_assess_xfer_bset(struct Curl_multi *multi,
   unsigned int mid;
   CURLMcode result = CURLM_OK;
 
-  if(multi && multi->socket_cb && Curl_uint_bset_first(set, &mid)) {
+  if(multi && mev_tracking(multi) && Curl_uint_bset_first(set, &mid)) {
     do {
       struct Curl_easy *data = Curl_multi_get_easy(multi, mid);
       if(data)
@@ -646,5 +917,6 @@ void Curl_multi_ev_init(struct Curl_multi *multi, size_t hashsize)
 
 void Curl_multi_ev_cleanup(struct Curl_multi *multi)
 {
+  Curl_multi_ev_epoll_stop(multi);
   Curl_hash_destroy(&multi->ev.sh_entries);
 }
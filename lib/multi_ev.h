@@ -33,6 +33,12 @@ struct uint_bset;
 
 /* meta key for event pollset at easy handle or connection */
 #define CURL_META_MEV_POLLSET   "meta:mev:ps"
+/* meta key for the epoll set at the multi's admin handle */
+#define CURL_META_MEV_EPOLL     "meta:mev:epoll"
+
+#if defined(HAVE_SYS_EPOLL_H) && !defined(USE_WINSOCK)
+#define USE_MULTI_EV_EPOLL
+#endif
 
 struct curl_multi_ev {
   struct Curl_hash sh_entries;
@@ -61,6 +67,25 @@ CURLMcode Curl_multi_ev_assess_conn(struct Curl_multi *multi,
                                     struct Curl_easy *data,
                                     struct connectdata *conn);
 
+/* Get the epoll set holding the sockets all transfers want monitored, for
+ * curl_multi_wait() to poll instead of each socket. It is created on first
+ * use and then kept up to date on each assessment of a transfer.
+ * Returns CURL_SOCKET_BAD when there is no such set, e.g. when the
+ * application has a socket callback, the set has no sockets or updating
+ * it failed before. */
+curl_socket_t Curl_multi_ev_epoll_fd(struct Curl_multi *multi);
+
+/* TRUE when the epoll set is in use */
+bool Curl_multi_ev_epoll_on(struct Curl_multi *multi);
+
+/* The number of sockets in the epoll set with events. With `dirty`, mark
+ * the transfers on these sockets as dirty. */
+unsigned int Curl_multi_ev_epoll_ready(struct Curl_multi *multi, bool dirty);
+
+/* No longer use the epoll set, e.g. the application sets a socket
+ * callback */
+void Curl_multi_ev_epoll_stop(struct Curl_multi *multi);
+
 /* Mark all transfers tied to the given socket as dirty */
 void Curl_multi_ev_dirty_xfers(struct Curl_multi *multi,
                                curl_socket_t s,
@@ -32,6 +32,7 @@
 #include "multi_ev.h"
 #include "psl.h"
 #include "socketpair.h"
+#include "timewheel.h"
 #include "uint-bset.h"
 #include "uint-spbset.h"
 #include "uint-table.h"
@@ -118,9 +119,8 @@ struct Curl_multi {
   struct PslCache psl;
 #endif
 
-  /* timetree points to the splay-tree of time nodes to figure out expire
-     times of all currently set timers */
-  struct Curl_tree *timetree;
+  /* the timers set by all transfers */
+  struct Curl_twheel *timers;
 
   /* buffer used for transfer data, lazy initialized */
   char *xfer_buf; /* the actual buffer */
@@ -178,6 +178,8 @@ struct Curl_multi {
   BIT(multiplexing);           /* multiplexing wanted */
   BIT(recheckstate);           /* see Curl_multi_connchanged */
   BIT(in_callback);            /* true while executing a callback */
+  BIT(perform_ready);          /* CURLMOPT_PERFORM_READY */
+  BIT(epoll_failed);           /* the epoll set broke, poll each socket */
 #ifdef USE_OPENSSL
   BIT(ssl_seeded);
 #endif
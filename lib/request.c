@@ -431,12 +431,53 @@ bool Curl_req_done_sending(struct Curl_easy *data)
   return data->req.upload_done && !Curl_req_want_send(data);
 }
 
+/* Send body bytes straight from the client's file, without them passing
+ * through the send buffer. CURLE_NOT_BUILT_IN when that is not possible,
+ * they are read into the buffer then. */
+static CURLcode req_send_file(struct Curl_easy *data)
+{
+  CURLcode result;
+  size_t blen = SIZE_MAX, nwritten;
+  bool eos = FALSE;
+
+  if(data->req.upload_aborted || data->req.eos_read ||
+     Curl_xfer_send_is_paused(data))
+    return CURLE_NOT_BUILT_IN;
+
+  if(!Curl_bufq_is_empty(&data->req.sendbuf) || Curl_xfer_needs_flush(data))
+    /* only check, the file is sent once what is before it is out */
+    blen = 0;
+  else if(data->set.max_send_speed &&
+          (data->set.max_send_speed < (curl_off_t)blen))
+    /* Make sure this does not send more than what the max send speed
+       says */
+    blen = (size_t)data->set.max_send_speed;
+
+  result = Curl_client_send_file(data, data->conn->send_idx, blen,
+                                 &nwritten, &eos);
+  if(!result) {
+    if(eos)
+      data->req.eos_read = TRUE;
+    if(nwritten) {
+      data->info.request_size += nwritten;
+      data->req.writebytecount += nwritten;
+      Curl_pgrsSetUploadCounter(data, data->req.writebytecount);
+    }
+  }
+  return result;
+}
+
 CURLcode Curl_req_send_more(struct Curl_easy *data)
 {
   CURLcode result;
 
+  result = req_send_file(data);
+  if(result && (result != CURLE_NOT_BUILT_IN) && (result != CURLE_AGAIN))
+    return result;
+
   /* Fill our send buffer if more from client can be read. */
-  if(!data->req.upload_aborted &&
+  if((result == CURLE_NOT_BUILT_IN) &&
+     !data->req.upload_aborted &&
      !data->req.eos_read &&
      !Curl_xfer_send_is_paused(data) &&
      !Curl_bufq_is_full(&data->req.sendbuf)) {
@@ -543,6 +543,19 @@ CURLcode Curl_creader_read(struct Curl_easy *data,
   return reader->crt->do_read(data, reader, buf, blen, nread, eos);
 }
 
+CURLcode Curl_creader_send_file(struct Curl_easy *data,
+                                struct Curl_creader *reader,
+                                int sockindex, size_t blen,
+                                size_t *pnwritten, bool *eos)
+{
+  *pnwritten = 0;
+  *eos = FALSE;
+  if(!reader)
+    return CURLE_NOT_BUILT_IN;
+  return reader->crt->send_file(data, reader, sockindex, blen,
+                                pnwritten, eos);
+}
+
 CURLcode Curl_creader_def_init(struct Curl_easy *data,
                                struct Curl_creader *reader)
 {
@@ -630,17 +643,36 @@ void Curl_creader_def_done(struct Curl_easy *data,
   (void)premature;
 }
 
+CURLcode Curl_creader_def_send_file(struct Curl_easy *data,
+                                    struct Curl_creader *reader,
+                                    int sockindex, size_t blen,
+                                    size_t *pnwritten, bool *eos)
+{
+  (void)data;
+  (void)reader;
+  (void)sockindex;
+  (void)blen;
+  *pnwritten = 0;
+  *eos = FALSE;
+  return CURLE_NOT_BUILT_IN;
+}
+
 struct cr_in_ctx {
   struct Curl_creader super;
   curl_read_callback read_cb;
   void *cb_user_data;
   curl_off_t total_len;
   curl_off_t read_len;
+  curl_off_t file_offset; /* of the next byte when sending the file */
   CURLcode error_result;
+  int fd;                 /* of the FILE given to fread() */
   BIT(seen_eos);
   BIT(errored);
   BIT(has_used_cb);
   BIT(is_paused);
+  BIT(file_started);      /* sending the file, 'fd' and 'file_offset' set */
+  BIT(file_sent);         /* some of it has been sent */
+  BIT(no_send_file);      /* the file cannot be sent, read it */
 };
 
 static CURLcode cr_in_init(struct Curl_easy *data, struct Curl_creader *reader)
@@ -842,6 +874,10 @@ static CURLcode cr_in_rewind(struct Curl_easy *data,
 {
   struct cr_in_ctx *ctx = reader->ctx;
 
+  /* the stream position is where the file is sent from next time */
+  ctx->file_started = FALSE;
+  ctx->file_sent = FALSE;
+
   /* If we never invoked the callback, there is noting to rewind */
   if(!ctx->has_used_cb)
     return CURLE_OK;
@@ -908,6 +944,108 @@ static bool cr_in_is_paused(struct Curl_easy *data,
   return ctx->is_paused;
 }
 
+#ifdef HAVE_SYS_SENDFILE_H
+/* show the bytes sent from the file like they are shown when read */
+static void cr_in_trace_file(struct Curl_easy *data, struct cr_in_ctx *ctx,
+                             curl_off_t offset, size_t len)
+{
+  char scratch[4*1024];
+
+  while(len) {
+    ssize_t n = pread(ctx->fd, scratch, CURLMIN(len, sizeof(scratch)),
+                      (off_t)offset);
+    if(n <= 0)
+      break;
+    Curl_debug(data, CURLINFO_DATA_OUT, scratch, (size_t)n);
+    offset += n;
+    len -= (size_t)n;
+  }
+}
+#endif
+
+/* When the application leaves reading to fread() from a FILE, libcurl
+ * knows the file and can have the system send it. */
+static CURLcode cr_in_send_file(struct Curl_easy *data,
+                                struct Curl_creader *reader,
+                                int sockindex, size_t blen,
+                                size_t *pnwritten, bool *peos)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+  struct cr_in_ctx *ctx = reader->ctx;
+  CURLcode result;
+  curl_off_t remain;
+
+  *pnwritten = 0;
+  *peos = FALSE;
+  if(ctx->no_send_file || ctx->errored || ctx->seen_eos ||
+     (ctx->total_len <= 0) || !ctx->cb_user_data ||
+     (ctx->read_cb != (curl_read_callback)fread))
+    return CURLE_NOT_BUILT_IN;
+
+  if(!ctx->file_started) {
+    /* the file is sent from where the stream is, after what has been read
+       through it already */
+    FILE *in = ctx->cb_user_data;
+    off_t pos = -1;
+    ctx->fd = fileno(in);
+    if(ctx->fd >= 0)
+      pos = ftello(in);
+    if(pos < 0) {
+      ctx->no_send_file = TRUE;
+      return CURLE_NOT_BUILT_IN;
+    }
+    ctx->file_offset = pos;
+    ctx->file_started = TRUE;
+  }
+
+  remain = ctx->total_len - ctx->read_len;
+  if(blen > SSIZE_T_MAX)
+    blen = SSIZE_T_MAX;
+  if(remain < (curl_off_t)blen)
+    blen = (size_t)remain;
+  result = Curl_conn_send_file(data, sockindex, ctx->fd, ctx->file_offset,
+                               blen, pnwritten);
+  if(!blen && !result)
+    return CURLE_OK;
+  if(result == CURLE_NOT_BUILT_IN) {
+    ctx->no_send_file = TRUE;
+    if(ctx->file_sent) {
+      /* the stream is not where the sending stopped */
+      failf(data, "could not continue sending the upload file");
+      ctx->errored = TRUE;
+      ctx->error_result = result = CURLE_SEND_ERROR;
+    }
+  }
+  else if(!result) {
+    if(!*pnwritten) {
+      failf(data, "client file EOF fail, "
+            "only %"FMT_OFF_T"/%"FMT_OFF_T " of needed bytes read",
+            ctx->read_len, ctx->total_len);
+      ctx->errored = TRUE;
+      ctx->error_result = result = CURLE_READ_ERROR;
+    }
+    else {
+      if(data->set.verbose && data->set.fdebug)
+        cr_in_trace_file(data, ctx, ctx->file_offset, *pnwritten);
+      ctx->has_used_cb = TRUE;
+      ctx->file_sent = TRUE;
+      ctx->file_offset += *pnwritten;
+      ctx->read_len += *pnwritten;
+      ctx->seen_eos = (ctx->read_len >= ctx->total_len);
+      *peos = ctx->seen_eos;
+    }
+  }
+  CURL_TRC_READ(data, "cr_in_send_file(len=%zu, total=%"FMT_OFF_T
+                ", read=%"FMT_OFF_T") -> %d, nwritten=%zu, eos=%d",
+                blen, ctx->total_len, ctx->read_len, result,
+                *pnwritten, *peos);
+  return result;
+#else
+  return Curl_creader_def_send_file(data, reader, sockindex, blen,
+                                    pnwritten, peos);
+#endif
+}
+
 static const struct Curl_crtype cr_in = {
   "cr-in",
   cr_in_init,
@@ -920,6 +1058,7 @@ static const struct Curl_crtype cr_in = {
   cr_in_unpause,
   cr_in_is_paused,
   Curl_creader_def_done,
+  cr_in_send_file,
   sizeof(struct cr_in_ctx)
 };
 
@@ -1081,6 +1220,7 @@ static const struct Curl_crtype cr_lc = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct cr_lc_ctx)
 };
 
@@ -1207,6 +1347,29 @@ CURLcode Curl_client_read(struct Curl_easy *data, char *buf, size_t blen,
   return result;
 }
 
+CURLcode Curl_client_send_file(struct Curl_easy *data, int sockindex,
+                               size_t blen, size_t *pnwritten, bool *eos)
+{
+  CURLcode result;
+
+  DEBUGASSERT(pnwritten);
+  DEBUGASSERT(eos);
+
+  if(!data->req.reader_stack) {
+    result = Curl_creader_set_fread(data, data->state.infilesize);
+    if(result)
+      return result;
+    DEBUGASSERT(data->req.reader_stack);
+  }
+
+  result = Curl_creader_send_file(data, data->req.reader_stack, sockindex,
+                                  blen, pnwritten, eos);
+  if(result != CURLE_NOT_BUILT_IN)
+    CURL_TRC_READ(data, "client_send_file(len=%zu) -> %d, nwritten=%zu, "
+                  "eos=%d", blen, result, *pnwritten, *eos);
+  return result;
+}
+
 bool Curl_creader_needs_rewind(struct Curl_easy *data)
 {
   struct Curl_creader *reader = data->req.reader_stack;
@@ -1255,6 +1418,7 @@ static const struct Curl_crtype cr_null = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct Curl_creader)
 };
 
@@ -1364,6 +1528,7 @@ static const struct Curl_crtype cr_buf = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct cr_buf_ctx)
 };
 
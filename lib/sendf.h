@@ -220,6 +220,9 @@ struct Curl_crtype {
   bool (*is_paused)(struct Curl_easy *data, struct Curl_creader *reader);
   void (*done)(struct Curl_easy *data,
                struct Curl_creader *reader, int premature);
+  CURLcode (*send_file)(struct Curl_easy *data, struct Curl_creader *reader,
+                        int sockindex, size_t blen,
+                        size_t *pnwritten, bool *eos);
   size_t creader_size;  /* sizeof() allocated struct Curl_creader */
 };
 
@@ -272,6 +275,12 @@ bool Curl_creader_def_is_paused(struct Curl_easy *data,
                                 struct Curl_creader *reader);
 void Curl_creader_def_done(struct Curl_easy *data,
                            struct Curl_creader *reader, int premature);
+/* Readers that change the data cannot let the file be sent as it is,
+ * this returns CURLE_NOT_BUILT_IN. */
+CURLcode Curl_creader_def_send_file(struct Curl_easy *data,
+                                    struct Curl_creader *reader,
+                                    int sockindex, size_t blen,
+                                    size_t *pnwritten, bool *eos);
 
 /**
  * Convenience method for calling `reader->do_read()` that
@@ -281,6 +290,15 @@ CURLcode Curl_creader_read(struct Curl_easy *data,
                            struct Curl_creader *reader,
                            char *buf, size_t blen, size_t *nread, bool *eos);
 
+/**
+ * Convenience method for calling `reader->send_file()` that
+ * checks for NULL reader.
+ */
+CURLcode Curl_creader_send_file(struct Curl_easy *data,
+                                struct Curl_creader *reader,
+                                int sockindex, size_t blen,
+                                size_t *pnwritten, bool *eos);
+
 /**
  * Create a new creader instance with given type and phase. Is not
  * inserted into the writer chain by this call.
@@ -324,6 +342,23 @@ CURLcode Curl_creader_set(struct Curl_easy *data, struct Curl_creader *r);
 CURLcode Curl_client_read(struct Curl_easy *data, char *buf, size_t blen,
                           size_t *nread, bool *eos) WARN_UNUSED_RESULT;
 
+/**
+ * Send at most `blen` bytes of the client's data on the connection at
+ * `sockindex` without reading them, when the data comes from a file and
+ * the installed readers pass it on unchanged.
+ * @param data      the transfer to send client bytes for
+ * @param sockindex the connection socket to send on
+ * @param blen      the amount to send at most, 0 only checks if the
+ *                  readers and the connection allow sending the file
+ * @param pnwritten on return the number of bytes sent
+ * @param eos       TRUE iff bytes sent are the end of data from client
+ * @return CURLE_OK on successful send (even 0 length)
+ *         CURLE_NOT_BUILT_IN if not possible, the data has to be read
+ *         CURLE_AGAIN if the connection is blocked
+ */
+CURLcode Curl_client_send_file(struct Curl_easy *data, int sockindex,
+                               size_t blen, size_t *pnwritten, bool *eos);
+
 /**
  * TRUE iff client reader needs rewing before it can be used for
  * a retry request.
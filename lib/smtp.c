@@ -2073,6 +2073,7 @@ static const struct Curl_crtype cr_eob = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct cr_eob_ctx)
 };
 
@@ -0,0 +1,265 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+
+#include "curl_setup.h"
+
+#include "curlx/timeval.h"
+#include "timewheel.h"
+#include "uint-bset.h"
+
+/* The last 3 #include files should be in this order */
+#include "curl_printf.h"
+#include "curl_memory.h"
+#include "memdebug.h"
+
+/*
+ * A timer with tick T is queued on the lowest level L where T and the
+ * current tick only differ in the digit of L, in the slot of that digit.
+ * The slot of the current tick on a level above 0 is always empty: when the
+ * wheel gets to a slot there, its timers move down. So all timers on a
+ * level expire before the ones on the level above, and on a level the slots
+ * are in the order of their ticks.
+ */
+#define TW_MASK        (CURL_TW_SLOTS - 1)
+#define TW_SHIFT(l)    ((l) * CURL_TW_BITS)
+#define TW_SPAN        TW_SHIFT(CURL_TW_LEVELS)
+#define TW_DIGIT(t, l) ((unsigned int)(((t) >> TW_SHIFT(l)) & TW_MASK))
+#define TW_BIT(s)      (((curl_uint64_t)1) << (s))
+/* the bits for slot 's' and the ones after it */
+#define TW_FROM(s)     (~(TW_BIT(s) - 1))
+
+struct Curl_twheel *Curl_twheel_create(struct curltime origin)
+{
+  struct Curl_twheel *w = calloc(1, sizeof(*w));
+  if(w) {
+    w->origin = origin;
+    w->first_known = TRUE;
+  }
+  return w;
+}
+
+void Curl_twheel_destroy(struct Curl_twheel *w)
+{
+  free(w);
+}
+
+static curl_uint64_t tw_tick(struct Curl_twheel *w, struct curltime t)
+{
+  timediff_t us = curlx_timediff_us(t, w->origin);
+  return (us > 0) ? (curl_uint64_t)us / 1000 : 0;
+}
+
+static struct Curl_twnode **tw_head(struct Curl_twheel *w,
+                                    unsigned int level, unsigned int slot)
+{
+  return (level < CURL_TW_LEVELS) ? &w->slots[level][slot] : &w->later;
+}
+
+static void tw_link(struct Curl_twheel *w, struct Curl_twnode *node)
+{
+  curl_uint64_t tick = tw_tick(w, node->time);
+  curl_uint64_t diff;
+  struct Curl_twnode **head;
+  unsigned int level = 0;
+
+  if(tick < w->now)
+    /* overdue, expires with the current tick */
+    tick = w->now;
+  diff = tick ^ w->now;
+  if(diff >> TW_SPAN) {
+    level = CURL_TW_LEVELS;
+    node->slot = 0;
+  }
+  else {
+    while(diff >> TW_SHIFT(level + 1))
+      level++;
+    node->slot = (unsigned char)TW_DIGIT(tick, level);
+    w->used[level] |= TW_BIT(node->slot);
+  }
+  node->level = (unsigned char)level;
+  head = tw_head(w, level, node->slot);
+  node->next = *head;
+  if(node->next)
+    node->next->pprev = &node->next;
+  node->pprev = head;
+  *head = node;
+}
+
+static void tw_unlink(struct Curl_twheel *w, struct Curl_twnode *node)
+{
+  *node->pprev = node->next;
+  if(node->next)
+    node->next->pprev = node->pprev;
+  else if((node->level < CURL_TW_LEVELS) &&
+          !w->slots[node->level][node->slot])
+    w->used[node->level] &= ~TW_BIT(node->slot);
+  node->next = NULL;
+  node->pprev = NULL;
+}
+
+void Curl_twheel_add(struct Curl_twheel *w, struct Curl_twnode *node,
+                     struct curltime time, void *payload)
+{
+  Curl_twheel_remove(w, node);
+  node->time = time;
+  node->ptr = payload;
+  tw_link(w, node);
+  w->count++;
+  if(w->first_known &&
+     (!w->first || (curlx_timediff_us(time, w->first->time) < 0)))
+    w->first = node;
+}
+
+void Curl_twheel_remove(struct Curl_twheel *w, struct Curl_twnode *node)
+{
+  if(!node->pprev)
+    return;
+  tw_unlink(w, node);
+  w->count--;
+  if(w->first == node) {
+    w->first = NULL;
+    w->first_known = !w->count;
+  }
+}
+
+/* the earliest timer in a slot */
+static struct Curl_twnode *tw_earliest(struct Curl_twnode *node)
+{
+  struct Curl_twnode *best = node;
+  for(; node; node = node->next) {
+    if(curlx_timediff_us(node->time, best->time) < 0)
+      best = node;
+  }
+  return best;
+}
+
+struct Curl_twnode *Curl_twheel_first(struct Curl_twheel *w)
+{
+  unsigned int level;
+
+  if(w->first_known)
+    return w->first;
+  w->first = NULL;
+  for(level = 0; level < CURL_TW_LEVELS; level++) {
+    curl_uint64_t bits = w->used[level] & TW_FROM(TW_DIGIT(w->now, level));
+    if(bits) {
+      w->first = tw_earliest(w->slots[level][CURL_CTZ64(bits)]);
+      break;
+    }
+  }
+  if(!w->first)
+    w->first = tw_earliest(w->later);
+  w->first_known = TRUE;
+  return w->first;
+}
+
+/* queue the timers of a slot again, for the current tick */
+static void tw_cascade(struct Curl_twheel *w,
+                       unsigned int level, unsigned int slot)
+{
+  struct Curl_twnode **head = tw_head(w, level, slot);
+  struct Curl_twnode *node = *head;
+
+  *head = NULL;
+  if(level < CURL_TW_LEVELS)
+    w->used[level] &= ~TW_BIT(slot);
+  while(node) {
+    struct Curl_twnode *next = node->next;
+    tw_link(w, node);
+    node = next;
+  }
+}
+
+/* move the current tick on to the next one where a slot has timers, or to
+   'target' if that comes first */
+static void tw_step(struct Curl_twheel *w, curl_uint64_t target)
+{
+  curl_uint64_t tick = target;
+  unsigned int level;
+
+  for(level = 0; level < CURL_TW_LEVELS; level++) {
+    /* the slots after the current one */
+    curl_uint64_t bits = w->used[level] &
+      TW_FROM(TW_DIGIT(w->now, level)) & ~TW_BIT(TW_DIGIT(w->now, level));
+    if(bits) {
+      unsigned int shift = TW_SHIFT(level + 1);
+      tick = ((w->now >> shift) << shift) |
+        ((curl_uint64_t)CURL_CTZ64(bits) << TW_SHIFT(level));
+      break;
+    }
+  }
+  if((level == CURL_TW_LEVELS) && w->later)
+    /* the start of the next round of the top level */
+    tick = ((w->now >> TW_SPAN) + 1) << TW_SPAN;
+  if(tick > target)
+    tick = target;
+  w->now = tick;
+
+  /* the slots we got to on the levels above move down, top one first as
+     its timers may move into the slot below */
+  for(level = CURL_TW_LEVELS; level > 0; level--) {
+    if(tick & (TW_BIT(TW_SHIFT(level)) - 1))
+      continue;
+    if(level == CURL_TW_LEVELS) {
+      if(w->later)
+        tw_cascade(w, level, 0);
+    }
+    else if(w->used[level] & TW_BIT(TW_DIGIT(tick, level)))
+      tw_cascade(w, level, TW_DIGIT(tick, level));
+  }
+}
+
+struct Curl_twnode *Curl_twheel_expire(struct Curl_twheel *w,
+                                       struct curltime now)
+{
+  struct Curl_twnode *expired = NULL;
+  struct Curl_twnode **tail = &expired;
+  curl_uint64_t target = tw_tick(w, now);
+
+  while(w->count) {
+    struct Curl_twnode *node = w->slots[0][TW_DIGIT(w->now, 0)];
+    while(node) {
+      struct Curl_twnode *next = node->next;
+      if(curlx_timediff_us(node->time, now) <= 0) {
+        tw_unlink(w, node);
+        w->count--;
+        *tail = node;
+        tail = &node->enext;
+      }
+      node = next;
+    }
+    if(w->now >= target)
+      break;
+    tw_step(w, target);
+  }
+  if(w->now < target)
+    /* nothing queued */
+    w->now = target;
+  *tail = NULL;
+  if(expired) {
+    w->first = NULL;
+    w->first_known = !w->count;
+  }
+  return expired;
+}
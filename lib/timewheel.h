@@ -0,0 +1,89 @@
+#ifndef HEADER_CURL_TIMEWHEEL_H
+#define HEADER_CURL_TIMEWHEEL_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "curl_setup.h"
+#include "curlx/timeval.h"
+
+/*
+ * A hierarchical timer wheel. Time is counted in millisecond ticks from the
+ * origin the wheel is initialized with. Level 0 has a slot for each of the
+ * next 64 ticks, each level above has slots 64 times as wide. Timers are
+ * added and removed in constant time and move down a level when the wheel
+ * gets to their slot. Timers beyond the top level wait in a list of their
+ * own.
+ */
+#define CURL_TW_BITS   6
+#define CURL_TW_SLOTS  (1 << CURL_TW_BITS)
+#define CURL_TW_LEVELS 6 /* 2^36 ticks, about 795 days */
+
+struct Curl_twnode {
+  struct Curl_twnode *next;   /* in the slot */
+  struct Curl_twnode **pprev; /* pointing to us, NULL when not queued */
+  struct Curl_twnode *enext;  /* in the list of expired timers */
+  struct curltime time;       /* when it expires */
+  void *ptr;                  /* data the wheel does not care about */
+  unsigned char level;        /* where it is queued */
+  unsigned char slot;
+};
+
+struct Curl_twheel {
+  struct Curl_twnode *slots[CURL_TW_LEVELS][CURL_TW_SLOTS];
+  curl_uint64_t used[CURL_TW_LEVELS]; /* a bit for each slot with timers */
+  struct Curl_twnode *later;  /* beyond the top level */
+  struct Curl_twnode *first;  /* the earliest timer, when known */
+  struct curltime origin;     /* tick 0 */
+  curl_uint64_t now;          /* the current tick */
+  size_t count;               /* timers queued */
+  BIT(first_known);
+};
+
+/* an empty wheel counting ticks from 'origin', NULL when out of memory */
+struct Curl_twheel *Curl_twheel_create(struct curltime origin);
+
+/* free the wheel, the timers still in it are left alone */
+void Curl_twheel_destroy(struct Curl_twheel *w);
+
+/* queue the timer to expire at 'time'. One that is queued already moves. */
+void Curl_twheel_add(struct Curl_twheel *w, struct Curl_twnode *node,
+                     struct curltime time, void *payload);
+
+/* take the timer off the wheel, if queued */
+void Curl_twheel_remove(struct Curl_twheel *w, struct Curl_twnode *node);
+
+/* the timer expiring first, NULL when there is none */
+struct Curl_twnode *Curl_twheel_first(struct Curl_twheel *w);
+
+/* take all timers expiring at or before 'now' off the wheel. They are
+ * returned as a list to walk with Curl_twnode_enext(), which stays intact
+ * when timers in it are queued again while walking it. */
+struct Curl_twnode *Curl_twheel_expire(struct Curl_twheel *w,
+                                       struct curltime now);
+
+#define Curl_twheel_count(w)    ((w)->count)
+#define Curl_twnode_queued(n)   (!!(n)->pprev)
+#define Curl_twnode_enext(n)    ((n)->enext)
+#define Curl_twnode_get(n)      ((n)->ptr)
+
+#endif /* HEADER_CURL_TIMEWHEEL_H */
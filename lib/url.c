@@ -684,6 +684,63 @@ socks_proxy_info_matches(const struct proxy_info *data,
 #define socks_proxy_info_matches(x,y) FALSE
 #endif
 
+/* Mix a string into a reuse key, lowercased for names compared without
+   case */
+static unsigned int reuse_key_str(unsigned int h, const char *s, bool nocase)
+{
+  if(!s)
+    return (h * 33) ^ 0x100; /* not the same as "" */
+  for(; *s; s++)
+    h = (h * 33) ^ (unsigned char)(nocase ? Curl_raw_tolower(*s) : *s);
+  return (h * 33) ^ 0x101;
+}
+
+static unsigned int reuse_key_num(unsigned int h, unsigned int n)
+{
+  return (h * 33) ^ n;
+}
+
+/*
+ * The reuse key of a connection is a hash of what url_match_conn() wants to
+ * be the same in a connection and the transfer reusing it, whatever the
+ * transfer asks for: the connect-to use, the unix domain socket, the proxies
+ * and the GSS delegation. Connections are found in the pool by it, so the
+ * ones that cannot match are not even looked at.
+ */
+UNITTEST unsigned int url_reuse_key(const struct connectdata *conn)
+{
+  unsigned int h = 5381;
+
+  h = reuse_key_num(h, conn->bits.conn_to_host);
+  h = reuse_key_num(h, conn->bits.conn_to_port);
+#ifdef USE_UNIX_SOCKETS
+  h = reuse_key_str(h, conn->unix_domain_socket, FALSE);
+  if(conn->unix_domain_socket)
+    h = reuse_key_num(h, conn->bits.abstract_unix_socket);
+#endif
+#ifndef CURL_DISABLE_PROXY
+  h = reuse_key_num(h, conn->bits.httpproxy);
+  h = reuse_key_num(h, conn->bits.socksproxy);
+  if(conn->bits.socksproxy) {
+    h = reuse_key_num(h, (unsigned int)conn->socks_proxy.proxytype);
+    h = reuse_key_num(h, (unsigned int)conn->socks_proxy.port);
+    h = reuse_key_str(h, conn->socks_proxy.host.name, TRUE);
+    h = reuse_key_str(h, conn->socks_proxy.user, FALSE);
+    h = reuse_key_str(h, conn->socks_proxy.passwd, FALSE);
+  }
+  if(conn->bits.httpproxy) {
+    h = reuse_key_num(h, conn->bits.tunnel_proxy);
+    h = reuse_key_num(h, (unsigned int)conn->http_proxy.proxytype);
+    h = reuse_key_num(h, (unsigned int)conn->http_proxy.port);
+    h = reuse_key_str(h, conn->http_proxy.host.name, TRUE);
+  }
+#endif
+#ifdef HAVE_GSSAPI
+  h = reuse_key_num(h, conn->gssapi_delegation);
+#endif
+  return h;
+}
+
 /* A connection has to have been idle for less than 'conn_max_idle_ms'
    (the success rate is just too low after this), or created less than
    'conn_max_age_ms' ago, to be subject for reuse. */
@@ -1373,7 +1430,7 @@ ConnectionExists(struct Curl_easy *data,
 
   /* Find a connection in the pool that matches what "data + needle"
    * requires. If a suitable candidate is found, it is attached to "data". */
-  result = Curl_cpool_find(data, needle->destination,
+  result = Curl_cpool_find(data, needle->destination, needle->reuse_key,
                            url_match_conn, url_match_result, &match);
 
   /* wait_pipe is TRUE if we encounter a bundle that is undecided. There
@@ -3648,6 +3705,10 @@ static CURLcode create_conn(struct Curl_easy *data,
 
   Curl_cpool_prune_dead(data);
 
+  /* what a connection in the pool has to have the same to be reused, and
+     what this one is found by once it is in there */
+  conn->reuse_key = url_reuse_key(conn);
+
   /*************************************************************
    * Check the current list of connections to see if we can
    * reuse an already existing one or if we have to create a
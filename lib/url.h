@@ -121,4 +121,8 @@ CURLcode Curl_data_priority_add_child(struct Curl_easy *parent,
 #define Curl_data_priority_add_child(x, y, z) CURLE_NOT_BUILT_IN
 #endif
 
+#ifdef UNITTESTS
+UNITTEST unsigned int url_reuse_key(const struct connectdata *conn);
+#endif
+
 #endif /* HEADER_CURL_URL_H */
@@ -152,7 +152,7 @@ typedef unsigned int curl_prot_t;
 #include "http_chunks.h" /* for the structs and enum stuff */
 #include "hostip.h"
 #include "hash.h"
-#include "splay.h"
+#include "timewheel.h"
 #include "curlx/dynbuf.h"
 #include "dynhds.h"
 #include "request.h"
@@ -633,6 +633,8 @@ struct proxy_info {
  */
 struct connectdata {
   struct Curl_llist_node cpool_node; /* conncache lists */
+  struct Curl_llist_node cpool_idle_node; /* conncache idle list */
+  struct Curl_llist_node cpool_key_node; /* conncache reuse key lists */
   struct Curl_llist_node cshutdn_node; /* cshutdn list */
 
   curl_closesocket_callback fclosesocket; /* function closing the socket(s) */
@@ -649,6 +651,8 @@ struct connectdata {
   curl_off_t connection_id; /* Contains a unique number to make it easier to
                                track the connections in the log output */
   char *destination; /* string carrying normalized hostname+port+scope */
+  unsigned int reuse_key; /* hash of what a reusing transfer must have the
+                             same, connections are found by it */
 
   /* `meta_hash` is a general key-value store for implementations
    * with the lifetime of the connection.
@@ -970,8 +974,7 @@ typedef enum {
  * One instance for each timeout an easy handle can set.
  */
 struct time_node {
-  struct Curl_llist_node list;
-  struct curltime time;
+  struct Curl_twnode tw; /* in the multi's timer wheel while set */
   expire_id eid;
 };
 
@@ -1044,9 +1047,6 @@ struct UrlState {
 
   BIT(provider_loaded);
 #endif /* USE_OPENSSL */
-  struct curltime expiretime; /* set this with Curl_expire() only */
-  struct Curl_tree timenode; /* for the splay stuff */
-  struct Curl_llist timeoutlist; /* list of pending timeouts */
   struct time_node expires[EXPIRE_LAST]; /* nodes for each expire type */
 
   /* a place to store the most recently set (S)FTP entrypath */
@@ -994,6 +994,7 @@ static const struct Curl_crtype ws_cr_encode = {
   Curl_creader_def_unpause,
   Curl_creader_def_is_paused,
   Curl_creader_def_done,
+  Curl_creader_def_send_file,
   sizeof(struct cr_ws_ctx)
 };
 
@@ -41,7 +41,7 @@
 #define BUFFER_SIZE 102400L
 
 /* When doing serial transfers, we use a single fixed error area */
-static char global_errorbuffer[CURL_ERROR_SIZE];
+static TOOL_THREAD_LOCAL char global_errorbuffer[CURL_ERROR_SIZE];
 
 #ifdef IP_TOS
 static int get_address_family(curl_socket_t sockfd)
@@ -110,8 +110,8 @@ static int sockopt_callback(void *clientp, curl_socket_t curlfd,
 /* return current SSL backend name, chop off multissl */
 static char *ssl_backend(void)
 {
-  static char ssl_ver[80] = "no ssl";
-  static bool already = FALSE;
+  static TOOL_THREAD_LOCAL char ssl_ver[80] = "no ssl";
+  static TOOL_THREAD_LOCAL bool already = FALSE;
   if(!already) { /* if there is no existing version */
     const char *v = curl_version_info(CURLVERSION_NOW)->ssl_version;
     if(v)
@@ -665,11 +665,12 @@ static CURLcode ftp_setopts(struct OperationConfig *config, CURL *curl)
   return CURLE_OK;
 }
 
-static void gen_trace_setopts(struct OperationConfig *config, CURL *curl)
+static void gen_trace_setopts(struct OperationConfig *config,
+                              struct per_transfer *per, CURL *curl)
 {
   if(global->tracetype != TRACE_NONE) {
     my_setopt(curl, CURLOPT_DEBUGFUNCTION, tool_debug_cb);
-    my_setopt(curl, CURLOPT_DEBUGDATA, config);
+    my_setopt(curl, CURLOPT_DEBUGDATA, per);
     my_setopt_long(curl, CURLOPT_VERBOSE, 1L);
   }
 }
@@ -697,7 +698,7 @@ static void gen_cb_setopts(struct OperationConfig *config,
   my_setopt(curl, CURLOPT_SEEKFUNCTION, tool_seek_cb);
 
   if((global->progressmode == CURL_PROGRESS_BAR) &&
-     !global->noprogress && !global->silent) {
+     !per->noprogress && !global->silent) {
     /* we want the alternative style, then we have to implement it
        ourselves! */
     my_setopt(curl, CURLOPT_XFERINFOFUNCTION, tool_progress_cb);
@@ -813,12 +814,36 @@ CURLcode config2setopts(struct OperationConfig *config,
      slow cleanups. Crappy ones might need to skip this.
      Note: avoid having this setopt added to the --libcurl source
      output. */
-  result = curl_easy_setopt(curl, CURLOPT_QUICK_EXIT, 1L);
-  if(result)
-    return result;
+  if(!global->embedded) {
+    result = curl_easy_setopt(curl, CURLOPT_QUICK_EXIT, 1L);
+    if(result)
+      return result;
+  }
 #endif
 
-  gen_trace_setopts(config, curl);
+  if(global->embedded) {
+    /* other threads of the host process may run transfers at the same time,
+       so libcurl must leave the signal handlers alone */
+    result = curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    if(result)
+      return result;
+  }
+
+  if(global->runshare) {
+    /* the share outlives this run, keep what it caches in check */
+    const struct RunnerShare *rs = global->runshare;
+    if(rs->maxconnects)
+      result = curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, rs->maxconnects);
+    if(!result)
+      result = curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, rs->maxage_conn);
+    if(!result)
+      result = curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT,
+                                rs->dns_cache_timeout);
+    if(result)
+      return result;
+  }
+
+  gen_trace_setopts(config, per, curl);
 
   {
 #ifdef DEBUGBUILD
@@ -840,7 +865,7 @@ CURLcode config2setopts(struct OperationConfig *config,
 
   my_setopt_str(curl, CURLOPT_URL, per->url);
   my_setopt_long(curl, CURLOPT_NOPROGRESS,
-                 global->noprogress || global->silent);
+                 per->noprogress || global->silent);
   /* call after the line above. It may override CURLOPT_NOPROGRESS */
   gen_cb_setopts(config, per, curl);
 
@@ -0,0 +1,953 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+#ifdef HAVE_FCNTL_H
+/* for open() */
+#include <fcntl.h>
+#endif
+
+#include "tool_cfgable.h"
+#include "tool_msgs.h"
+#include "tool_cb_wrt.h"
+#include "tool_cache.h"
+#include "tool_dirhie.h"
+#include "tool_operate.h"
+#include "tool_paramhlp.h"
+
+#include "memdebug.h" /* keep this as LAST include */
+
+#ifdef _WIN32
+#define OPENMODE S_IREAD | S_IWRITE
+#else
+#define OPENMODE S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH
+#endif
+
+#define CACHE_MAGIC "curl cache 1"
+#define CACHE_HEX 65            /* a SHA-256 in hex and a null byte */
+#define CACHE_VARIANTS 8        /* stored variants of a URL at most */
+#define CACHE_INDEX_MAX (1024*1024)
+#define CACHE_CHUNK (16*1024)   /* written to the output at a time */
+
+/*
+ * SHA-256, naming the bodies by their content. A weaker hash would let a
+ * server make one URL's body show up for another.
+ */
+static const unsigned int sha_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA_M 0xffffffff
+#define SHA_ROTR(x, n) ((((x) >> (n)) | ((x) << (32 - (n)))) & SHA_M)
+
+UNITTEST void tool_sha256_init(struct tool_sha256 *s)
+{
+  static const unsigned int h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(s->h, h0, sizeof(h0));
+  s->len = 0;
+}
+
+static void sha256_block(struct tool_sha256 *s, const unsigned char *p)
+{
+  unsigned int w[64];
+  unsigned int v[8];
+  int i;
+
+  for(i = 0; i < 16; i++)
+    w[i] = ((unsigned int)p[i * 4] << 24) |
+      ((unsigned int)p[i * 4 + 1] << 16) |
+      ((unsigned int)p[i * 4 + 2] << 8) | p[i * 4 + 3];
+  for(i = 16; i < 64; i++) {
+    unsigned int s0 = SHA_ROTR(w[i - 15], 7) ^ SHA_ROTR(w[i - 15], 18) ^
+      (w[i - 15] >> 3);
+    unsigned int s1 = SHA_ROTR(w[i - 2], 17) ^ SHA_ROTR(w[i - 2], 19) ^
+      (w[i - 2] >> 10);
+    w[i] = (w[i - 16] + s0 + w[i - 7] + s1) & SHA_M;
+  }
+  memcpy(v, s->h, sizeof(v));
+  for(i = 0; i < 64; i++) {
+    unsigned int e = v[4];
+    unsigned int a = v[0];
+    unsigned int t1 = (v[7] +
+                       (SHA_ROTR(e, 6) ^ SHA_ROTR(e, 11) ^ SHA_ROTR(e, 25)) +
+                       ((e & v[5]) ^ (~e & v[6])) + sha_k[i] + w[i]) & SHA_M;
+    unsigned int t2 = ((SHA_ROTR(a, 2) ^ SHA_ROTR(a, 13) ^ SHA_ROTR(a, 22)) +
+                       ((a & v[1]) ^ (a & v[2]) ^ (v[1] & v[2]))) & SHA_M;
+    v[7] = v[6];
+    v[6] = v[5];
+    v[5] = v[4];
+    v[4] = (v[3] + t1) & SHA_M;
+    v[3] = v[2];
+    v[2] = v[1];
+    v[1] = v[0];
+    v[0] = (t1 + t2) & SHA_M;
+  }
+  for(i = 0; i < 8; i++)
+    s->h[i] = (s->h[i] + v[i]) & SHA_M;
+}
+
+UNITTEST void tool_sha256_update(struct tool_sha256 *s, const void *data,
+                                 size_t len)
+{
+  const unsigned char *p = data;
+  size_t fill = (size_t)(s->len & 63);
+
+  s->len += len;
+  if(fill) {
+    size_t n = CURLMIN(len, 64 - fill);
+    memcpy(&s->buf[fill], p, n);
+    p += n;
+    len -= n;
+    if(fill + n < 64)
+      return;
+    sha256_block(s, s->buf);
+  }
+  for(; len >= 64; p += 64, len -= 64)
+    sha256_block(s, p);
+  if(len)
+    memcpy(s->buf, p, len);
+}
+
+/* end it and write the hash as CACHE_HEX bytes of lowercase hex */
+UNITTEST void tool_sha256_hex(struct tool_sha256 *s, char *hex)
+{
+  static const char digits[] = "0123456789abcdef";
+  unsigned char pad[72];
+  curl_off_t bits = s->len * 8;
+  size_t fill = (size_t)(s->len & 63);
+  size_t padlen = (fill < 56) ? (56 - fill) : (120 - fill);
+  int i;
+
+  memset(pad, 0, sizeof(pad));
+  pad[0] = 0x80;
+  for(i = 0; i < 8; i++)
+    pad[padlen + i] = (unsigned char)((bits >> (56 - i * 8)) & 0xff);
+  tool_sha256_update(s, pad, padlen + 8);
+  for(i = 0; i < 32; i++) {
+    unsigned int b = (s->h[i / 4] >> (24 - (i % 4) * 8)) & 0xff;
+    hex[i * 2] = digits[b >> 4];
+    hex[i * 2 + 1] = digits[b & 0xf];
+  }
+  hex[64] = 0;
+}
+
+/* a stored variant of a URL */
+struct cache_entry {
+  curl_off_t stored;          /* when the response was made, by its age */
+  curl_off_t lifetime;        /* seconds it is fresh from then */
+  curl_off_t swr;             /* seconds after that it may still be used */
+  curl_off_t size;
+  char body[CACHE_HEX];
+  char *etag;
+  char *lastmod;
+};
+
+struct cache_xfer {
+  const char *dir;
+  char key[CACHE_HEX];        /* of the URL */
+  char *vary;                 /* the stored Vary names, NULL if none */
+  struct cache_entry e;       /* the stored variant, if 'found' */
+  struct curl_slist *headers; /* config->headers and the validators */
+  struct tool_sha256 sha;     /* of the body being stored */
+  FILE *tmp;                  /* and where it is kept meanwhile */
+  char *tmpname;
+  BIT(found);
+  BIT(revalidate);            /* the request wants a validated copy */
+  BIT(served);                /* the output has the stored copy */
+  BIT(serving);
+  BIT(checked);               /* this attempt's response has been checked */
+};
+
+/* the Cache-Control directives used */
+struct cache_control {
+  curl_off_t max_age;         /* -1 when not there */
+  curl_off_t s_maxage;
+  curl_off_t swr;
+  BIT(no_store);
+  BIT(private_only);          /* private, not for a shared cache */
+  BIT(no_cache);
+  BIT(must_revalidate);
+};
+
+static void cc_parse(const char *p, struct cache_control *cc)
+{
+  while(*p) {
+    const char *name;
+    size_t nlen;
+    curl_off_t num = -1;
+
+    while((*p == ',') || ISBLANK(*p))
+      p++;
+    name = p;
+    while(*p && (*p != ',') && (*p != '=') && !ISBLANK(*p))
+      p++;
+    nlen = p - name;
+    while(ISBLANK(*p))
+      p++;
+    if(*p == '=') {
+      p++;
+      while(ISBLANK(*p))
+        p++;
+      if(*p == '\"')
+        p++;
+      if(curlx_str_number(&p, &num, CURL_OFF_T_MAX))
+        num = -1;
+    }
+    while(*p && (*p != ','))
+      p++;
+
+    if((nlen == 7) && curl_strnequal(name, "max-age", 7))
+      cc->max_age = num;
+    else if((nlen == 8) && curl_strnequal(name, "s-maxage", 8))
+      cc->s_maxage = num;
+    else if((nlen == 22) && curl_strnequal(name, "stale-while-revalidate", 22))
+      cc->swr = num;
+    else if((nlen == 8) && curl_strnequal(name, "no-store", 8))
+      cc->no_store = TRUE;
+    else if((nlen == 7) && curl_strnequal(name, "private", 7))
+      cc->private_only = TRUE;
+    else if((nlen == 8) && curl_strnequal(name, "no-cache", 8))
+      cc->no_cache = TRUE;
+    else if(((nlen == 15) && curl_strnequal(name, "must-revalidate", 15)) ||
+            ((nlen == 16) && curl_strnequal(name, "proxy-revalidate", 16)))
+      cc->must_revalidate = TRUE;
+  }
+}
+
+static void cc_init(struct cache_control *cc)
+{
+  memset(cc, 0, sizeof(*cc));
+  cc->max_age = cc->s_maxage = cc->swr = -1;
+}
+
+/* the value of a request header set with --header, NULL if none */
+static const char *req_header(struct OperationConfig *config,
+                              const char *name, size_t nlen, size_t *lenp)
+{
+  struct curl_slist *h;
+  for(h = config->headers; h; h = h->next) {
+    if(curl_strnequal(h->data, name, nlen) && (h->data[nlen] == ':')) {
+      const char *v = &h->data[nlen + 1];
+      size_t len;
+      while(ISBLANK(*v))
+        v++;
+      len = strlen(v);
+      while(len && ISBLANK(v[len - 1]))
+        len--;
+      *lenp = len;
+      return v;
+    }
+  }
+  return NULL;
+}
+
+/* the request headers that make it one the cache cannot answer */
+static const char *const cache_nothanks[] = {
+  "Authorization", "Cookie", "If-Match", "If-Modified-Since", "If-None-Match",
+  "If-Range", "If-Unmodified-Since", "Range", NULL
+};
+
+/* the variant the request asks for: a hash of the values it sends for the
+   names in 'vary' */
+static void variant_key(struct OperationConfig *config, const char *vary,
+                        char *hex)
+{
+  struct tool_sha256 s;
+  tool_sha256_init(&s);
+  while(*vary) {
+    const char *name = vary;
+    size_t nlen = strcspn(vary, ",");
+    const char *value;
+    size_t vlen = 0;
+
+    vary += nlen;
+    if(*vary)
+      vary++;
+    value = req_header(config, name, nlen, &vlen);
+    if(!value) {
+      /* what curl sends by itself */
+      if((nlen == 10) && !strncmp(name, "user-agent", 10))
+        value = config->useragent;
+      else if((nlen == 7) && !strncmp(name, "referer", 7))
+        value = config->referer;
+      else if((nlen == 6) && !strncmp(name, "accept", 6))
+        value = "*/*";
+      else if((nlen == 15) && !strncmp(name, "accept-encoding", 15))
+        value = config->encoding ? "compressed" : NULL;
+      vlen = value ? strlen(value) : 0;
+    }
+    tool_sha256_update(&s, name, nlen);
+    tool_sha256_update(&s, ":", 1);
+    if(value)
+      tool_sha256_update(&s, value, vlen);
+    tool_sha256_update(&s, "\n", 1);
+  }
+  tool_sha256_hex(&s, hex);
+}
+
+/* the response's Vary names, lowercase and comma separated. NULL if the
+   response cannot be stored. */
+static char *resp_vary(CURL *curl)
+{
+  struct dynbuf d;
+  struct curl_header *h;
+  size_t i;
+  size_t amount = 1;
+
+  curlx_dyn_init(&d, 4096);
+  for(i = 0; i < amount; i++) {
+    const char *p;
+    if(curl_easy_header(curl, "Vary", i, CURLH_HEADER, -1, &h))
+      break;
+    amount = h->amount;
+    for(p = h->value; *p;) {
+      const char *name;
+      size_t nlen;
+      while((*p == ',') || ISBLANK(*p))
+        p++;
+      name = p;
+      while(*p && (*p != ',') && !ISBLANK(*p))
+        p++;
+      nlen = p - name;
+      while(*p && (*p != ','))
+        p++;
+      if((nlen == 1) && (*name == '*')) {
+        /* not any stored response can be used */
+        curlx_dyn_free(&d);
+        return NULL;
+      }
+      if(nlen) {
+        size_t at = curlx_dyn_len(&d);
+        char *n;
+        if((at && curlx_dyn_addn(&d, ",", 1)) ||
+           curlx_dyn_addn(&d, name, nlen))
+          return NULL;
+        for(n = curlx_dyn_ptr(&d) + at; *n; n++)
+          if((*n >= 'A') && (*n <= 'Z'))
+            *n = (char)(*n + ('a' - 'A'));
+      }
+    }
+  }
+  if(!curlx_dyn_len(&d))
+    return strdup("");
+  return curlx_dyn_ptr(&d);
+}
+
+static char *cache_path(const char *dir, const char *what, const char *hex)
+{
+  return aprintf("%s/%s/%.2s/%s", dir, what, hex, hex);
+}
+
+static void entry_clear(struct cache_entry *e)
+{
+  tool_safefree(e->etag);
+  tool_safefree(e->lastmod);
+  memset(e, 0, sizeof(*e));
+}
+
+/* a header value kept in a line of the index */
+static bool value_ok(const char *v)
+{
+  return !v[strcspn(v, "\t\r\n")];
+}
+
+/* update the stored variant with what the response says, as RFC 9111
+   section 4.3.4 has it for a 304. FALSE if it is not to be stored. */
+static bool entry_update(CURL *curl, struct cache_entry *e)
+{
+  struct cache_control cc;
+  struct curl_header *h;
+  curl_off_t now = (curl_off_t)time(NULL);
+  curl_off_t date = now;
+  curl_off_t age = 0;
+  curl_off_t apparent;
+  size_t i;
+  size_t amount = 1;
+
+  cc_init(&cc);
+  for(i = 0; i < amount; i++) {
+    if(curl_easy_header(curl, "Cache-Control", i, CURLH_HEADER, -1, &h))
+      break;
+    amount = h->amount;
+    cc_parse(h->value, &cc);
+  }
+  /* the cache is shared, it keeps nothing made for one user */
+  if(cc.no_store || cc.private_only ||
+     !curl_easy_header(curl, "Set-Cookie", 0, CURLH_HEADER, -1, &h))
+    return FALSE;
+  if(cc.s_maxage >= 0) {
+    /* made for shared caches, and as with proxy-revalidate */
+    cc.max_age = cc.s_maxage;
+    cc.must_revalidate = TRUE;
+  }
+
+  if(!curl_easy_header(curl, "Date", 0, CURLH_HEADER, -1, &h)) {
+    time_t t = curl_getdate(h->value, NULL);
+    if(t != -1)
+      date = (curl_off_t)t;
+  }
+  if(!curl_easy_header(curl, "Age", 0, CURLH_HEADER, -1, &h)) {
+    const char *p = h->value;
+    if(curlx_str_number(&p, &age, CURL_OFF_T_MAX))
+      age = 0;
+  }
+  /* the corrected age, the response is made about now */
+  apparent = (now > date) ? (now - date) : 0;
+  e->stored = now - CURLMAX(apparent, age);
+
+  if(cc.max_age >= 0)
+    e->lifetime = cc.max_age;
+  else if(!curl_easy_header(curl, "Expires", 0, CURLH_HEADER, -1, &h)) {
+    /* an Expires date that does not parse is in the past */
+    time_t t = curl_getdate(h->value, NULL);
+    e->lifetime = ((t != -1) && ((curl_off_t)t > date)) ?
+      ((curl_off_t)t - date) : 0;
+  }
+  if(cc.swr >= 0)
+    e->swr = cc.swr;
+  if(cc.no_cache)
+    e->lifetime = 0;
+  if(cc.no_cache || cc.must_revalidate)
+    e->swr = 0;
+
+  if(!curl_easy_header(curl, "ETag", 0, CURLH_HEADER, -1, &h)) {
+    if(!value_ok(h->value))
+      return FALSE;
+    free(e->etag);
+    e->etag = strdup(h->value);
+    if(!e->etag)
+      return FALSE;
+  }
+  if(!curl_easy_header(curl, "Last-Modified", 0, CURLH_HEADER, -1, &h)) {
+    if(!value_ok(h->value))
+      return FALSE;
+    free(e->lastmod);
+    e->lastmod = strdup(h->value);
+    if(!e->lastmod)
+      return FALSE;
+  }
+  /* a copy that can neither be used nor validated is no use */
+  return e->etag || e->lastmod || e->lifetime || e->swr;
+}
+
+/* cut off the next line of the buffer, NULL at its end */
+static char *next_line(char **bufp)
+{
+  char *line = *bufp;
+  char *nl;
+  if(!*line)
+    return NULL;
+  nl = strchr(line, '\n');
+  if(nl) {
+    *nl = 0;
+    *bufp = nl + 1;
+  }
+  else
+    *bufp = line + strlen(line);
+  return line;
+}
+
+static bool get_num(const char *str, curl_off_t *num)
+{
+  return !curlx_str_number(&str, num, CURL_OFF_T_MAX) && !*str;
+}
+
+/* a variant line: key, stored, lifetime, swr, size, body, etag, lastmod
+   separated by tabs */
+#define VARIANT_FIELDS 8
+
+static bool variant_parse(char *line, struct cache_entry *e)
+{
+  char *f[VARIANT_FIELDS];
+  int i;
+  for(i = 0; i < VARIANT_FIELDS; i++) {
+    char *tab = strchr(line, '\t');
+    f[i] = line;
+    if(i == VARIANT_FIELDS - 1)
+      break;
+    if(!tab)
+      return FALSE;
+    *tab = 0;
+    line = tab + 1;
+  }
+  if(!get_num(f[1], &e->stored) || !get_num(f[2], &e->lifetime) ||
+     !get_num(f[3], &e->swr) || !get_num(f[4], &e->size) ||
+     (strlen(f[5]) != CACHE_HEX - 1))
+    return FALSE;
+  strcpy(e->body, f[5]);
+  if(*f[6]) {
+    e->etag = strdup(f[6]);
+    if(!e->etag)
+      return FALSE;
+  }
+  if(*f[7]) {
+    e->lastmod = strdup(f[7]);
+    if(!e->lastmod)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* the index of the URL, NULL if there is none */
+static char *index_read(struct cache_xfer *c)
+{
+  char *buf = NULL;
+  size_t size = 0;
+  char *name = cache_path(c->dir, "index", c->key);
+  FILE *f = name ? fopen(name, "rb") : NULL;
+  free(name);
+  if(!f)
+    return NULL;
+  if(file2memory(&buf, &size, f))
+    buf = NULL;
+  fclose(f);
+  return buf;
+}
+
+/* find the stored variant of the request */
+static void index_load(struct cache_xfer *c, struct OperationConfig *config,
+                       const char *url)
+{
+  char vkey[CACHE_HEX];
+  char *buf = index_read(c);
+  char *p = buf;
+  char *line;
+
+  if(!buf)
+    return;
+  line = next_line(&p);
+  if(!line || strcmp(line, CACHE_MAGIC))
+    goto out;
+  line = next_line(&p);
+  if(!line || strcmp(line, url))
+    goto out;
+  line = next_line(&p);
+  if(!line)
+    goto out;
+  c->vary = strdup(line);
+  if(!c->vary)
+    goto out;
+  variant_key(config, c->vary, vkey);
+  for(line = next_line(&p); line; line = next_line(&p)) {
+    if(!strncmp(line, vkey, CACHE_HEX - 1) && (line[CACHE_HEX - 1] == '\t')) {
+      c->found = variant_parse(line, &c->e);
+      if(!c->found)
+        entry_clear(&c->e);
+      break;
+    }
+  }
+out:
+  free(buf);
+}
+
+#ifdef _WIN32
+#define cache_rename(o, n) !MoveFileExA(o, n, MOVEFILE_REPLACE_EXISTING)
+#else
+#define cache_rename(o, n) rename(o, n)
+#endif
+
+/* open a new file in tmp/ */
+static FILE *tmp_open(struct cache_xfer *c, char **namep)
+{
+  struct curltime now = curlx_now();
+  int i;
+
+  bool mkdirs = FALSE;
+
+  for(i = 0; i < 100; i++) {
+    int fd;
+    int err;
+    char *name = aprintf("%s/tmp/%lx.%lx.%p.%d", c->dir, (long)now.tv_sec,
+                         (long)now.tv_usec, (void *)c, i);
+    if(!name)
+      return NULL;
+    do {
+      fd = open(name, O_CREAT | O_WRONLY | O_EXCL | CURL_O_BINARY, OPENMODE);
+      /* !checksrc! disable ERRNOVAR 1 */
+      err = (fd == -1) ? errno : 0;
+    } while(err == EINTR);
+    if((err == ENOENT) && !mkdirs) {
+      /* the first one in a new directory */
+      mkdirs = TRUE;
+      if(!create_dir_hierarchy(name)) {
+        free(name);
+        i--;
+        continue;
+      }
+    }
+    if(fd != -1) {
+      FILE *f = fdopen(fd, "wb");
+      if(!f) {
+        close(fd);
+        unlink(name);
+        free(name);
+        return NULL;
+      }
+      *namep = name;
+      return f;
+    }
+    free(name);
+    if(err != EEXIST)
+      break;
+  }
+  return NULL;
+}
+
+/* move a file of tmp/ into place */
+static bool tmp_move(const char *tmpname, const char *name)
+{
+  if(!cache_rename(tmpname, name))
+    return TRUE;
+  if(!create_dir_hierarchy(name) && !cache_rename(tmpname, name))
+    return TRUE;
+  unlink(tmpname);
+  return FALSE;
+}
+
+/* write the index with the variant, keeping the other ones stored for the
+   same Vary names */
+static void index_write(struct cache_xfer *c, struct OperationConfig *config,
+                        const char *url, const char *vary,
+                        const struct cache_entry *e)
+{
+  struct dynbuf d;
+  char vkey[CACHE_HEX];
+  char *old = index_read(c);
+  char *name = NULL;
+  char *tmpname = NULL;
+  FILE *f = NULL;
+  bool ok = FALSE;
+
+  variant_key(config, vary, vkey);
+  curlx_dyn_init(&d, CACHE_INDEX_MAX);
+  if(curlx_dyn_addf(&d, "%s\n%s\n%s\n", CACHE_MAGIC, url, vary) ||
+     curlx_dyn_addf(&d, "%s\t%" CURL_FORMAT_CURL_OFF_T
+                    "\t%" CURL_FORMAT_CURL_OFF_T
+                    "\t%" CURL_FORMAT_CURL_OFF_T
+                    "\t%" CURL_FORMAT_CURL_OFF_T "\t%s\t%s\t%s\n",
+                    vkey, e->stored, e->lifetime, e->swr, e->size, e->body,
+                    e->etag ? e->etag : "", e->lastmod ? e->lastmod : ""))
+    goto out;
+  if(old) {
+    char *p = old;
+    char *line = next_line(&p);
+    if(line && !strcmp(line, CACHE_MAGIC) &&
+       (line = next_line(&p)) != NULL && !strcmp(line, url) &&
+       (line = next_line(&p)) != NULL && !strcmp(line, vary)) {
+      int variants = 1;
+      while((variants < CACHE_VARIANTS) &&
+            (line = next_line(&p)) != NULL) {
+        if(!strncmp(line, vkey, CACHE_HEX - 1))
+          continue;
+        if(curlx_dyn_addf(&d, "%s\n", line))
+          goto out;
+        variants++;
+      }
+    }
+  }
+
+  name = cache_path(c->dir, "index", c->key);
+  if(name)
+    f = tmp_open(c, &tmpname);
+  if(f) {
+    bool written = (fwrite(curlx_dyn_ptr(&d), 1, curlx_dyn_len(&d), f) ==
+                    curlx_dyn_len(&d));
+    if(fclose(f) || !written)
+      unlink(tmpname);
+    else
+      ok = tmp_move(tmpname, name);
+  }
+out:
+  if(!ok)
+    warnf("Failed updating the cache for %s", url);
+  curlx_dyn_free(&d);
+  free(old);
+  free(name);
+  free(tmpname);
+}
+
+/* write the stored body to the output */
+static CURLcode cache_serve(struct per_transfer *per)
+{
+  struct cache_xfer *c = per->cache;
+  CURLcode result = CURLE_OK;
+  char *name = cache_path(c->dir, "data", c->e.body);
+  FILE *f = name ? fopen(name, "rb") : NULL;
+  char *buf = malloc(CACHE_CHUNK);
+
+  free(name);
+  if(!f || !buf) {
+    result = f ? CURLE_OUT_OF_MEMORY : CURLE_READ_ERROR;
+    goto out;
+  }
+  c->serving = TRUE;
+  for(;;) {
+    size_t n = fread(buf, 1, CACHE_CHUNK, f);
+    if(!n)
+      break;
+    if(tool_write_cb(buf, 1, n, per) != n) {
+      result = CURLE_WRITE_ERROR;
+      break;
+    }
+  }
+  if(!result && ferror(f))
+    result = CURLE_READ_ERROR;
+  c->serving = FALSE;
+out:
+  if(f)
+    fclose(f);
+  free(buf);
+  if(result)
+    errorf("Failed using the cached copy of %s", per->url);
+  return result;
+}
+
+/* the stored body is there, as big as the index says */
+static bool body_ok(struct cache_xfer *c)
+{
+  struct_stat st;
+  char *name = cache_path(c->dir, "data", c->e.body);
+  bool ok = name && !stat(name, &st) && (st.st_size == c->e.size);
+  free(name);
+  return ok;
+}
+
+static CURLcode add_header(struct curl_slist **listp, const char *fmt,
+                           const char *value)
+{
+  struct curl_slist *nlist;
+  char *h = aprintf(fmt, value);
+  if(!h)
+    return CURLE_OUT_OF_MEMORY;
+  nlist = curl_slist_append(*listp, h);
+  free(h);
+  if(!nlist)
+    return CURLE_OUT_OF_MEMORY;
+  *listp = nlist;
+  return CURLE_OK;
+}
+
+CURLcode cache_setup(struct OperationConfig *config, struct per_transfer *per,
+                     bool *done)
+{
+  struct cache_xfer *c;
+  struct cache_control cc;
+  struct tool_sha256 s;
+  struct curl_slist *item;
+  const char *value;
+  size_t vlen;
+  curl_off_t age;
+  int i;
+
+  *done = FALSE;
+  for(i = 0; cache_nothanks[i]; i++)
+    if(req_header(config, cache_nothanks[i], strlen(cache_nothanks[i]),
+                  &vlen))
+      return CURLE_OK;
+  cc_init(&cc);
+  value = req_header(config, "Cache-Control", 13, &vlen);
+  if(value)
+    cc_parse(value, &cc);
+  if(cc.no_store || strchr(per->url, '\n'))
+    return CURLE_OK;
+
+  c = calloc(1, sizeof(*c));
+  if(!c)
+    return CURLE_OUT_OF_MEMORY;
+  per->cache = c;
+  c->dir = config->cache_dir;
+  c->revalidate = cc.no_cache || !cc.max_age;
+  tool_sha256_init(&s);
+  tool_sha256_update(&s, per->url, strlen(per->url));
+  tool_sha256_hex(&s, c->key);
+
+  index_load(c, config, per->url);
+  if(!c->found)
+    return CURLE_OK;
+  if(!body_ok(c)) {
+    c->found = FALSE;
+    return CURLE_OK;
+  }
+
+  age = (curl_off_t)time(NULL) - c->e.stored;
+  if(!c->revalidate && (age < c->e.lifetime)) {
+    *done = TRUE;
+    return cache_serve(per);
+  }
+  if(!c->e.etag && !c->e.lastmod) {
+    /* cannot be validated, get a new one */
+    c->found = FALSE;
+    return CURLE_OK;
+  }
+
+  for(item = config->headers; item; item = item->next) {
+    struct curl_slist *nlist = curl_slist_append(c->headers, item->data);
+    if(!nlist)
+      return CURLE_OUT_OF_MEMORY;
+    c->headers = nlist;
+  }
+  if((c->e.etag && add_header(&c->headers, "If-None-Match: %s", c->e.etag)) ||
+     (c->e.lastmod &&
+      add_header(&c->headers, "If-Modified-Since: %s", c->e.lastmod)))
+    return CURLE_OUT_OF_MEMORY;
+  (void)curl_easy_setopt(per->curl, CURLOPT_HTTPHEADER, c->headers);
+
+  if(!c->revalidate && (age < c->e.lifetime + c->e.swr)) {
+    /* stale-while-revalidate: use it now, the response only updates the
+       cache */
+    CURLcode result = cache_serve(per);
+    if(result)
+      return result;
+    c->served = TRUE;
+  }
+  return CURLE_OK;
+}
+
+/* drop what the attempt kept */
+static void tmp_drop(struct cache_xfer *c)
+{
+  if(c->tmp) {
+    fclose(c->tmp);
+    c->tmp = NULL;
+    unlink(c->tmpname);
+  }
+  tool_safefree(c->tmpname);
+}
+
+bool cache_write(struct per_transfer *per, const char *buf, size_t len)
+{
+  struct cache_xfer *c = per->cache;
+
+  if(c->serving)
+    return FALSE;
+  if(!c->checked) {
+    /* a response to keep: a 200 to the request, all of it */
+    long code = 0;
+    long redirects = 0;
+    c->checked = TRUE;
+    curl_easy_getinfo(per->curl, CURLINFO_RESPONSE_CODE, &code);
+    curl_easy_getinfo(per->curl, CURLINFO_REDIRECT_COUNT, &redirects);
+    if((code == 200) && !redirects && !per->resumed) {
+      c->tmp = tmp_open(c, &c->tmpname);
+      tool_sha256_init(&c->sha);
+    }
+  }
+  if(c->tmp) {
+    if(fwrite(buf, 1, len, c->tmp) == len)
+      tool_sha256_update(&c->sha, buf, len);
+    else
+      tmp_drop(c);
+  }
+  return c->served;
+}
+
+/* keep the body written to tmp/ */
+static void cache_store(struct per_transfer *per)
+{
+  struct cache_xfer *c = per->cache;
+  struct cache_entry e;
+  char *vary = resp_vary(per->curl);
+  char *name = NULL;
+  bool ok = FALSE;
+
+  memset(&e, 0, sizeof(e));
+  if(!vary || !entry_update(per->curl, &e))
+    goto out;
+  e.size = c->sha.len;
+  tool_sha256_hex(&c->sha, e.body);
+  name = cache_path(c->dir, "data", e.body);
+  if(!name)
+    goto out;
+  ok = !fclose(c->tmp);
+  c->tmp = NULL;
+  if(ok) {
+    struct_stat st;
+    if(!stat(name, &st) && (st.st_size == e.size))
+      /* the same content is stored already, for this URL or another */
+      unlink(c->tmpname);
+    else
+      ok = tmp_move(c->tmpname, name);
+  }
+  else
+    unlink(c->tmpname);
+  if(ok)
+    index_write(c, per->config, per->url, vary, &e);
+out:
+  free(vary);
+  free(name);
+  entry_clear(&e);
+}
+
+CURLcode cache_done(struct per_transfer *per, CURLcode result)
+{
+  struct cache_xfer *c = per->cache;
+  long code = 0;
+
+  curl_easy_getinfo(per->curl, CURLINFO_RESPONSE_CODE, &code);
+  if(!result && (code == 304) && c->found) {
+    if(!c->served) {
+      result = cache_serve(per);
+      c->served = !result;
+    }
+    if(c->served && entry_update(per->curl, &c->e))
+      index_write(c, per->config, per->url, c->vary, &c->e);
+  }
+  else if(!result && (code == 200) && c->tmp)
+    cache_store(per);
+  tmp_drop(c);
+  c->checked = FALSE;
+
+  if(result && c->served) {
+    /* the output has a copy to live with */
+    notef("Using the stale cached copy of %s", per->url);
+    result = CURLE_OK;
+  }
+  return result;
+}
+
+void cache_free(struct per_transfer *per)
+{
+  struct cache_xfer *c = per->cache;
+  if(c) {
+    tmp_drop(c);
+    entry_clear(&c->e);
+    free(c->vary);
+    curl_slist_free_all(c->headers);
+    free(c);
+    per->cache = NULL;
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef HEADER_CURL_TOOL_CACHE_H
+#define HEADER_CURL_TOOL_CACHE_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+/*
+ * --cache-dir: a private HTTP cache shared by all transfers using the same
+ * directory, in the spirit of RFC 9111. The directory has
+ *
+ *   index/xx/<sha256 of the URL>   the URL, its Vary names and one line for
+ *                                  each stored variant
+ *   data/xx/<sha256 of the body>   the bodies, one file for each content
+ *   tmp/                           files being written
+ *
+ * where xx are the first two digits of the name. Files are written in tmp/
+ * and renamed into place, so several curl processes can use the same one.
+ */
+
+struct OperationConfig;
+struct per_transfer;
+struct cache_xfer;
+
+/* SHA-256, the names of the files are hashes */
+struct tool_sha256 {
+  unsigned int h[8];
+  unsigned char buf[64];
+  curl_off_t len;             /* bytes hashed */
+};
+
+/* look up the transfer's URL. A fresh stored copy is written to the output
+   and *done is set, the transfer needs no request. Otherwise the request
+   gets the validators of a stored copy, and a stale one still allowed by
+   stale-while-revalidate is written to the output right away. */
+CURLcode cache_setup(struct OperationConfig *config, struct per_transfer *per,
+                     bool *done);
+
+/* the write callback got data, keep it when it is to be stored. TRUE when
+   the output already has the stored copy and does not want it. */
+bool cache_write(struct per_transfer *per, const char *buf, size_t len);
+
+/* the attempt has ended: write the stored copy to the output on a 304 and
+   store a new one on a 200 */
+CURLcode cache_done(struct per_transfer *per, CURLcode result);
+
+void cache_free(struct per_transfer *per);
+
+#ifdef UNITTESTS
+UNITTEST void tool_sha256_init(struct tool_sha256 *s);
+UNITTEST void tool_sha256_update(struct tool_sha256 *s, const void *data,
+                                 size_t len);
+/* end it and write the hash as 64 lowercase hex digits and a null byte */
+UNITTEST void tool_sha256_hex(struct tool_sha256 *s, char *hex);
+#endif
+
+#endif /* HEADER_CURL_TOOL_CACHE_H */
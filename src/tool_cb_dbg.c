@@ -26,22 +26,23 @@
 #include "tool_cfgable.h"
 #include "tool_msgs.h"
 #include "tool_cb_dbg.h"
+#include "tool_operate.h"
+#include "tool_trace.h"
 #include "tool_util.h"
 
 #include "memdebug.h" /* keep this as LAST include */
 
 static void dump(const char *timebuf, const char *idsbuf, const char *text,
                  FILE *stream, const unsigned char *ptr, size_t size,
-                 trace tracetype, curl_infotype infotype);
+                 size_t len, trace tracetype, curl_infotype infotype);
 
 /*
  * Return the formatted HH:MM:SS for the tv_sec given.
- * NOT thread safe.
  */
 static const char *hms_for_sec(time_t tv_sec)
 {
-  static time_t cached_tv_sec;
-  static char hms_buf[12];
+  static TOOL_THREAD_LOCAL time_t cached_tv_sec;
+  static TOOL_THREAD_LOCAL char hms_buf[12];
 
   if(tv_sec != cached_tv_sec) {
     /* !checksrc! disable BANNEDFUNC 1 */
@@ -73,15 +74,75 @@ static void log_line_start(FILE *log, const char *timebuf,
 #define TRC_IDS_FORMAT_IDS_2  "[%" CURL_FORMAT_CURL_OFF_T "-%" \
                                    CURL_FORMAT_CURL_OFF_T "] "
 /*
-** callback for CURLOPT_DEBUGFUNCTION
-*/
-int tool_debug_cb(CURL *handle, curl_infotype type,
-                  char *data, size_t size,
-                  void *userdata)
+ * Open the trace output unless already done. Called from the debug callback,
+ * and before transfers start in more than one thread.
+ */
+void tool_trace_open(void)
+{
+  if(!global->trace_stream) {
+    /* open for append */
+    if(!strcmp("-", global->trace_dump))
+      global->trace_stream = stdout;
+    else if(!strcmp("%", global->trace_dump))
+      /* Ok, this is somewhat hackish but we do it undocumented for now */
+      global->trace_stream = tool_stderr;
+    else {
+      global->trace_stream = fopen(global->trace_dump,
+                                   (global->tracetype == TRACE_RAW) ?
+                                   "wb" : FOPEN_WRITETEXT);
+      global->trace_fopened = TRUE;
+    }
+    if(global->trace_stream && (global->tracetype == TRACE_RAW))
+      fputs(TRACE_RAW_MAGIC, global->trace_stream);
+  }
+}
+
+/*
+ * Get the trace going before transfers start in more than one thread: open
+ * the output and start the writer thread of --trace-async.
+ */
+void tool_trace_start(void)
+{
+  tool_trace_open();
+#ifdef USE_TRACE_RING
+  if(global->trace_async && !global->trace_ring && !trace_ring_start()) {
+    warnf("--trace-async could not start its thread, tracing directly");
+    global->trace_async = FALSE;
+  }
+#endif
+}
+
+/*
+ * Write what is queued and close the trace output.
+ */
+void tool_trace_close(void)
+{
+#ifdef USE_TRACE_RING
+  trace_ring_stop();
+#endif
+  if(global->trace_fopened && global->trace_stream)
+    fclose(global->trace_stream);
+  global->trace_stream = NULL;
+  global->trace_fopened = FALSE;
+}
+
+void tool_trace_flush(void)
+{
+  fflush(global->trace_stream ? global->trace_stream : tool_stderr);
+}
+
+/*
+ * Write a trace event, from the debug callback or the writer thread of
+ * --trace-async. 'data' has ev->len bytes.
+ */
+void tool_trace_write(const struct trace_event *ev,
+                      const unsigned char *ptr)
 {
   FILE *output = tool_stderr;
+  const char *data = (const char *)ptr;
+  curl_infotype type = (curl_infotype)ev->type;
+  size_t size = ev->len;
   const char *text;
-  struct timeval tv;
   char timebuf[20];
   /* largest signed 64-bit is: 9,223,372,036,854,775,807
    * max length in decimal: 1 + (6*3) = 19
@@ -89,57 +150,52 @@ int tool_debug_cb(CURL *handle, curl_infotype type,
    * negative xfer-id are not printed, negative conn-ids use TRC_IDS_FORMAT_1
    */
   char idsbuf[60];
-  curl_off_t xfer_id, conn_id;
 
-  (void)handle; /* not used */
-  (void)userdata;
+  tool_trace_open();
 
-  if(global->tracetime) {
-    tv = tvrealnow();
-    msnprintf(timebuf, sizeof(timebuf), "%s.%06ld ",
-              hms_for_sec(tv.tv_sec), (long)tv.tv_usec);
+  if(global->trace_stream)
+    output = global->trace_stream;
+
+  if(!output) {
+    warnf("Failed to create/open output");
+    return;
   }
+
+  if(global->tracetype == TRACE_RAW) {
+    unsigned char hdr[TRACE_RAW_HDR];
+    trace_raw_header(hdr, ev);
+    (void)fwrite(hdr, sizeof(hdr), 1, output);
+    if(ev->len)
+      (void)fwrite(ptr, ev->len, 1, output);
+    return;
+  }
+
+  if(global->tracetime)
+    msnprintf(timebuf, sizeof(timebuf), "%s.%06ld ",
+              hms_for_sec(ev->tv.tv_sec), (long)ev->tv.tv_usec);
   else
     timebuf[0] = 0;
 
-  if(handle && global->traceids &&
-     !curl_easy_getinfo(handle, CURLINFO_XFER_ID, &xfer_id) && xfer_id >= 0) {
-    if(!curl_easy_getinfo(handle, CURLINFO_CONN_ID, &conn_id) &&
-        conn_id >= 0) {
+  if(global->traceids && (ev->xfer_id >= 0)) {
+    if(ev->conn_id >= 0) {
       msnprintf(idsbuf, sizeof(idsbuf), TRC_IDS_FORMAT_IDS_2,
-                xfer_id, conn_id);
+                ev->xfer_id, ev->conn_id);
     }
     else {
-      msnprintf(idsbuf, sizeof(idsbuf), TRC_IDS_FORMAT_IDS_1, xfer_id);
+      msnprintf(idsbuf, sizeof(idsbuf), TRC_IDS_FORMAT_IDS_1, ev->xfer_id);
     }
   }
   else
     idsbuf[0] = 0;
 
-  if(!global->trace_stream) {
-    /* open for append */
-    if(!strcmp("-", global->trace_dump))
-      global->trace_stream = stdout;
-    else if(!strcmp("%", global->trace_dump))
-      /* Ok, this is somewhat hackish but we do it undocumented for now */
-      global->trace_stream = tool_stderr;
-    else {
-      global->trace_stream = fopen(global->trace_dump, FOPEN_WRITETEXT);
-      global->trace_fopened = TRUE;
-    }
-  }
-
-  if(global->trace_stream)
-    output = global->trace_stream;
-
-  if(!output) {
-    warnf("Failed to create/open output");
-    return 0;
+  if(ev->type == TRACE_DROPPED) {
+    fprintf(output, "%s[%zu trace events dropped]\n", timebuf, ev->size);
+    return;
   }
 
   if(global->tracetype == TRACE_PLAIN) {
-    static bool newl = FALSE;
-    static bool traced_data = FALSE;
+    static TOOL_THREAD_LOCAL bool newl = FALSE;
+    static TOOL_THREAD_LOCAL bool traced_data = FALSE;
 
     switch(type) {
     case CURLINFO_HEADER_OUT:
@@ -180,11 +236,11 @@ int tool_debug_cb(CURL *handle, curl_infotype type,
            to stderr or stdout, we do not display the alert about the data not
            being shown as the data _is_ shown then just not via this
            function */
-        if(!global->isatty ||
+        if(!ev->tty ||
            ((output != tool_stderr) && (output != stdout))) {
           if(!newl)
             log_line_start(output, timebuf, idsbuf, type);
-          fprintf(output, "[%zu bytes data]\n", size);
+          fprintf(output, "[%zu bytes data]\n", ev->size);
           newl = FALSE;
           traced_data = TRUE;
         }
@@ -196,7 +252,7 @@ int tool_debug_cb(CURL *handle, curl_infotype type,
       break;
     }
 
-    return 0;
+    return;
   }
 
   switch(type) {
@@ -204,7 +260,7 @@ int tool_debug_cb(CURL *handle, curl_infotype type,
     fprintf(output, "%s%s== Info: %.*s", timebuf, idsbuf, (int)size, data);
     FALLTHROUGH();
   default: /* in case a new one is introduced to shock us */
-    return 0;
+    return;
 
   case CURLINFO_HEADER_OUT:
     text = "=> Send header";
@@ -226,15 +282,89 @@ int tool_debug_cb(CURL *handle, curl_infotype type,
     break;
   }
 
-  dump(timebuf, idsbuf, text, output, (unsigned char *) data, size,
+  dump(timebuf, idsbuf, text, output, ptr, ev->size, ev->len,
        global->tracetype, type);
+}
+
+static int debug_cb(CURL *handle, curl_infotype type,
+                    char *data, size_t size,
+                    void *userdata)
+{
+  struct per_transfer *per = userdata;
+  struct trace_event ev;
+  bool raw = (global->tracetype == TRACE_RAW);
+
+  memset(&ev, 0, sizeof(ev));
+  ev.type = (int)type;
+  ev.tty = per && per->isatty;
+  ev.size = ev.len = size;
+  ev.xfer_id = ev.conn_id = -1;
+
+  if(global->tracetime || raw)
+    ev.tv = tvrealnow();
+
+  if(handle && (global->traceids || raw)) {
+    if(curl_easy_getinfo(handle, CURLINFO_XFER_ID, &ev.xfer_id) ||
+       (ev.xfer_id < 0))
+      ev.xfer_id = -1;
+    else if(curl_easy_getinfo(handle, CURLINFO_CONN_ID, &ev.conn_id))
+      ev.conn_id = -1;
+  }
+
+#ifdef USE_TRACE_RING
+  if(global->trace_async && !global->trace_ring)
+    tool_trace_start();
+  if(global->trace_ring) {
+    switch(type) {
+    case CURLINFO_DATA_OUT:
+    case CURLINFO_DATA_IN:
+    case CURLINFO_SSL_DATA_IN:
+    case CURLINFO_SSL_DATA_OUT:
+      if(global->tracetype == TRACE_PLAIN) {
+        /* only the size is shown */
+        ev.len = 0;
+        break;
+      }
+      FALLTHROUGH();
+    default:
+      if(ev.len > TRACE_CAP)
+        ev.len = TRACE_CAP;
+      break;
+    }
+    trace_ring_put(&ev, (unsigned char *)data);
+    return 0;
+  }
+#endif
+  tool_trace_write(&ev, (unsigned char *)data);
   return 0;
 }
 
+/*
+** callback for CURLOPT_DEBUGFUNCTION
+*/
+int tool_debug_cb(CURL *handle, curl_infotype type,
+                  char *data, size_t size,
+                  void *userdata)
+{
+  int rc;
+#ifdef USE_PARALLEL_THREADS
+  /* one trace line at a time from the --parallel-threads workers */
+  if(global->iolock)
+    Curl_mutex_acquire(global->iolock);
+#endif
+  rc = debug_cb(handle, type, data, size, userdata);
+#ifdef USE_PARALLEL_THREADS
+  if(global->iolock)
+    Curl_mutex_release(global->iolock);
+#endif
+  return rc;
+}
+
 static void dump(const char *timebuf, const char *idsbuf, const char *text,
                  FILE *stream, const unsigned char *ptr, size_t size,
-                 trace tracetype, curl_infotype infotype)
+                 size_t len, trace tracetype, curl_infotype infotype)
 {
+  size_t total = size;
   size_t i;
   size_t c;
 
@@ -247,6 +377,8 @@ static void dump(const char *timebuf, const char *idsbuf, const char *text,
   fprintf(stream, "%s%s%s, %zu bytes (0x%zx)\n", timebuf, idsbuf,
           text, size, size);
 
+  /* with --trace-async only the first TRACE_CAP bytes are kept */
+  size = len;
   for(i = 0; i < size; i += width) {
 
     fprintf(stream, "%04zx: ", i);
@@ -281,5 +413,9 @@ static void dump(const char *timebuf, const char *idsbuf, const char *text,
     }
     fputc('\n', stream); /* newline */
   }
-  fflush(stream);
+  if(size < total)
+    fprintf(stream, "[%zu bytes not kept]\n", total - size);
+  if(!global->trace_ring)
+    /* the writer thread flushes when it has nothing to do */
+    fflush(stream);
 }
@@ -33,4 +33,13 @@ int tool_debug_cb(CURL *handle, curl_infotype type,
                   char *data, size_t size,
                   void *userdata);
 
+struct trace_event;
+
+void tool_trace_open(void);
+void tool_trace_start(void);
+void tool_trace_close(void);
+void tool_trace_flush(void);
+void tool_trace_write(const struct trace_event *ev,
+                      const unsigned char *ptr);
+
 #endif /* HEADER_CURL_TOOL_CB_DBG_H */
@@ -110,6 +110,11 @@ size_t tool_header_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
     memset(outs->utf8seq, 0, sizeof(outs->utf8seq));
 #endif
 
+  if(global->io.header &&
+     (tool_sink_call(global->io.header, global->io.header_userp,
+                     ptr, cb) != cb))
+    return CURL_WRITEFUNC_ERROR;
+
   /*
    * Write header data when curl option --dump-header (-D) is given.
    */
@@ -285,7 +290,10 @@ size_t tool_header_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
     if(!outs->stream && !tool_create_output_file(outs, per->config))
       return CURL_WRITEFUNC_ERROR;
 
-    if(global->isatty &&
+    if(tool_outs_to_sink(outs))
+      return tool_sink_write(per, ptr, cb);
+
+    if(per->isatty &&
 #ifdef _WIN32
        tool_term_has_bold &&
 #endif
@@ -107,6 +107,14 @@ size_t tool_read_cb(char *buffer, size_t sz, size_t nmemb, void *userdata)
           " is only supported on desktop Windows", per->infd);
 #endif
   }
+#ifdef USE_IO_URING
+  else if(per->uring && uring_input_ok(per)) {
+    size_t n = uring_read(per, buffer, sz*nmemb);
+    if((n == CURL_READFUNC_PAUSE) || (n == CURL_READFUNC_ABORT))
+      return n;
+    rc = (ssize_t)n;
+  }
+#endif
   else {
     rc = read(per->infd, buffer, sz*nmemb);
     if(rc < 0) {
@@ -144,7 +152,7 @@ int tool_readbusy_cb(void *clientp,
 {
   struct per_transfer *per = clientp;
   struct OperationConfig *config = per->config;
-  static curl_off_t ulprev;
+  static TOOL_THREAD_LOCAL curl_off_t ulprev;
 
   (void)dltotal;  /* unused */
   (void)dlnow;  /* unused */
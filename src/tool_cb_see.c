@@ -40,6 +40,13 @@ int tool_seek_cb(void *userdata, curl_off_t offset, int whence)
 {
   struct per_transfer *per = userdata;
 
+#ifdef HAVE_SYS_SENDFILE_H
+  if(per->infile)
+    /* libcurl reads the file through the stream */
+    return fseeko(per->infile, (off_t)offset, whence) ?
+      CURL_SEEKFUNC_CANTSEEK : CURL_SEEKFUNC_OK;
+#endif
+
 #if (SIZEOF_CURL_OFF_T > SIZEOF_OFF_T) && !defined(USE_WIN32_LARGE_FILES)
 
 /* OUR_MAX_SEEK_L has 'long' data type, OUR_MAX_SEEK_O has 'curl_off_t,
@@ -74,6 +81,10 @@ int tool_seek_cb(void *userdata, curl_off_t offset, int whence)
         return CURL_SEEKFUNC_FAIL;
       left -= step;
     }
+#ifdef USE_IO_URING
+    if(per->uring)
+      uring_seek(per);
+#endif
     return CURL_SEEKFUNC_OK;
   }
 #endif
@@ -88,5 +99,9 @@ int tool_seek_cb(void *userdata, curl_off_t offset, int whence)
        libcurl know that it may try other means if it wants to. */
     return CURL_SEEKFUNC_CANTSEEK;
 
+#ifdef USE_IO_URING
+  if(per->uring)
+    uring_seek(per);
+#endif
   return CURL_SEEKFUNC_OK;
 }
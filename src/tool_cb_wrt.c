@@ -27,13 +27,16 @@
 /* for open() */
 #include <fcntl.h>
 #endif
+#ifdef HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 
 #include "tool_cfgable.h"
+#include "tool_cache.h"
 #include "tool_msgs.h"
 #include "tool_cb_wrt.h"
 #include "tool_operate.h"
-
-#include "curl_capture.h"
+#include "tool_paramhlp.h"
 
 #include "memdebug.h" /* keep this as LAST include */
 
@@ -43,12 +46,6 @@
 #define OPENMODE S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH
 #endif
 
-static struct CaptureBuffer *capture_out = NULL;
-
-void set_stdout_capture_buffer(struct CaptureBuffer *buffer) {
-  capture_out = buffer;
-}
-
 /* create/open a local file for writing, return TRUE on success */
 bool tool_create_output_file(struct OutStruct *outs,
                              struct OperationConfig *config)
@@ -59,9 +56,12 @@ bool tool_create_output_file(struct OutStruct *outs,
   DEBUGASSERT(config);
   DEBUGASSERT(fname && *fname);
 
-  if(config->file_clobber_mode == CLOBBER_ALWAYS ||
-     (config->file_clobber_mode == CLOBBER_DEFAULT &&
-      !outs->is_cd_filename)) {
+  if(outs->segment)
+    /* a part of --segments, the file is there in its full size already */
+    file = fopen(fname, "r+b");
+  else if(config->file_clobber_mode == CLOBBER_ALWAYS ||
+          (config->file_clobber_mode == CLOBBER_DEFAULT &&
+           !outs->is_cd_filename)) {
     /* open file for writing */
     file = fopen(fname, "wb");
   }
@@ -114,7 +114,8 @@ bool tool_create_output_file(struct OutStruct *outs,
   outs->fopened = TRUE;
   outs->stream = file;
   outs->bytes = 0;
-  outs->init = 0;
+  if(!outs->segment)
+    outs->init = 0;
   return TRUE;
 }
 
@@ -244,6 +245,351 @@ static size_t win_console(intptr_t fhnd, struct OutStruct *outs,
 }
 #endif
 
+/* TRUE if the response has the range of the file the part of a --segments
+   download asked for */
+static bool segment_range(struct per_transfer *per)
+{
+  struct OutStruct *outs = &per->outs;
+  struct curl_header *h;
+  const char *p;
+  curl_off_t first;
+  curl_off_t last;
+  curl_off_t size;
+
+  /* Content-Range: bytes FIRST-LAST/SIZE */
+  if(curl_easy_header(per->curl, "Content-Range", 0, CURLH_HEADER, -1, &h) ||
+     !curl_strnequal(h->value, "bytes ", 6))
+    return FALSE;
+  p = &h->value[6];
+  if(curlx_str_number(&p, &first, CURL_OFF_T_MAX) ||
+     curlx_str_single(&p, '-') ||
+     curlx_str_number(&p, &last, CURL_OFF_T_MAX) ||
+     curlx_str_single(&p, '/') ||
+     curlx_str_number(&p, &size, CURL_OFF_T_MAX))
+    return FALSE;
+  return (first == outs->init) && (last == outs->init + outs->seglen - 1) &&
+    (size == per->segs->size);
+}
+
+/* TRUE if the response has the header as the HEAD request of the --segments
+   download got it, or both do not have it */
+static bool segment_same(CURL *curl, const char *name, const char *value)
+{
+  struct curl_header *h;
+  if(curl_easy_header(curl, name, 0, CURLH_HEADER, -1, &h))
+    return !value;
+  return value && !strcmp(h->value, value);
+}
+
+/* write a part of a --segments download at its place in the file */
+static size_t segment_write(struct per_transfer *per, const char *buffer,
+                            size_t bytes)
+{
+  struct OutStruct *outs = &per->outs;
+
+  if(!outs->bytes) {
+    long code = 0;
+    curl_easy_getinfo(per->curl, CURLINFO_RESPONSE_CODE, &code);
+    if((code != 206) || !segment_range(per)) {
+      warnf("The server did not send the requested range");
+      return CURL_WRITEFUNC_ERROR;
+    }
+    if(!segment_same(per->curl, "ETag", per->segs->etag) ||
+       !segment_same(per->curl, "Last-Modified", per->segs->lastmod)) {
+      warnf("The file changed on the server during the download");
+      return CURL_WRITEFUNC_ERROR;
+    }
+  }
+  if((curl_off_t)bytes > outs->seglen - outs->bytes) {
+    warnf("The server sent more than the requested range");
+    return CURL_WRITEFUNC_ERROR;
+  }
+#ifdef HAVE_PWRITE
+  {
+    curl_off_t offset = outs->init + outs->bytes;
+    size_t left = bytes;
+    while(left) {
+      ssize_t rc = pwrite(fileno(outs->stream), buffer, left, (off_t)offset);
+      if(rc < 0) {
+        /* !checksrc! disable ERRNOVAR 1 */
+        if(errno == EINTR)
+          continue;
+        return 0;
+      }
+      buffer += rc;
+      left -= (size_t)rc;
+      offset += rc;
+    }
+  }
+  return bytes;
+#else
+  /* the stream is positioned at the start of each attempt */
+  if(!outs->bytes && tool_fseek(outs->stream, outs->init, SEEK_SET))
+    return 0;
+  return fwrite(buffer, 1, bytes, outs->stream);
+#endif
+}
+
+#ifdef USE_OUTPUT_BUFFER
+
+#define OUTPUT_ALIGN 4096 /* O_DIRECT wants buffers, sizes and offsets
+                             aligned to this */
+#define OUTPUT_DIRECT_SIZE (1024*1024) /* --output-sync direct default */
+
+/* go on without O_DIRECT */
+static void direct_off(struct OutStruct *outs)
+{
+#ifdef O_DIRECT
+  int fd = fileno(outs->stream);
+  int flags = fcntl(fd, F_GETFL);
+  if(flags != -1)
+    (void)fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+  outs->direct = FALSE;
+}
+
+/* write all of 'a' and then all of 'b' to the file, in one system call
+   when it takes them, return TRUE on success */
+static bool outs_write(struct OutStruct *outs, char *a, size_t alen,
+                       char *b, size_t blen)
+{
+  int fd = fileno(outs->stream);
+  while(alen || blen) {
+    ssize_t rc;
+#ifdef HAVE_WRITEV
+    if(alen && blen) {
+      struct iovec iov[2];
+      iov[0].iov_base = a;
+      iov[0].iov_len = alen;
+      iov[1].iov_base = b;
+      iov[1].iov_len = blen;
+      rc = writev(fd, iov, 2);
+    }
+    else
+#endif
+    if(alen)
+      rc = write(fd, a, alen);
+    else
+      rc = write(fd, b, blen);
+    if(rc < 0) {
+      /* !checksrc! disable ERRNOVAR 2 */
+      if(errno == EINTR)
+        continue;
+      if(outs->direct && (errno == EINVAL)) {
+        /* the file system does not take it after all */
+        direct_off(outs);
+        continue;
+      }
+      return FALSE;
+    }
+    if((size_t)rc >= alen) {
+      b += (size_t)rc - alen;
+      blen -= (size_t)rc - alen;
+      alen = 0;
+    }
+    else {
+      a += rc;
+      alen -= (size_t)rc;
+    }
+  }
+  return TRUE;
+}
+
+/* get the buffer for the first write to the file, allocate the file when
+   the size is known and turn on O_DIRECT if asked to */
+static bool outs_buffer_init(struct per_transfer *per)
+{
+  struct OutStruct *outs = &per->outs;
+  struct OperationConfig *config = per->config;
+  int fd = fileno(outs->stream);
+  size_t size = (size_t)config->output_buffer;
+  size_t skew;
+  struct_stat st;
+  int flags = fcntl(fd, F_GETFL);
+  bool plain;
+
+  if(!size)
+    size = OUTPUT_DIRECT_SIZE;
+  size = (size + OUTPUT_ALIGN - 1) & ~(size_t)(OUTPUT_ALIGN - 1);
+  outs->wmem = malloc(size + OUTPUT_ALIGN);
+  if(!outs->wmem)
+    return FALSE;
+  skew = (size_t)((uintptr_t)outs->wmem % OUTPUT_ALIGN);
+  outs->wbuf = outs->wmem + (skew ? OUTPUT_ALIGN - skew : 0);
+  outs->wsize = size;
+  outs->wlen = 0;
+
+  /* only a regular file written from its start, not appended to */
+  plain = !outs->init && (flags != -1) && !(flags & O_APPEND) &&
+    !fstat(fd, &st) && S_ISREG(st.st_mode);
+#ifdef HAVE_POSIX_FALLOCATE
+  if(plain) {
+    curl_off_t size_dl = -1;
+    curl_easy_getinfo(per->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                      &size_dl);
+    /* sequential extents and no surprise when the disk is full */
+    if((size_dl > 0) && !posix_fallocate(fd, 0, (off_t)size_dl))
+      outs->prealloc = size_dl;
+  }
+#endif
+#ifdef O_DIRECT
+  if(plain && (config->output_sync == OUTPUT_SYNC_DIRECT) &&
+     !fcntl(fd, F_SETFL, flags | O_DIRECT))
+    outs->direct = TRUE;
+#endif
+  return TRUE;
+}
+
+/* keep the data in the --output-buffer and write it when it is full */
+static size_t buffered_write(struct per_transfer *per, char *buffer,
+                             size_t bytes)
+{
+  struct OutStruct *outs = &per->outs;
+  size_t total = bytes;
+
+  if(!outs->wmem && !outs_buffer_init(per))
+    return 0;
+
+  if(!outs->direct) {
+    if(outs->wlen + bytes <= outs->wsize) {
+      memcpy(&outs->wbuf[outs->wlen], buffer, bytes);
+      outs->wlen += bytes;
+    }
+    else {
+      /* what is held and what came, together */
+      if(!outs_write(outs, outs->wbuf, outs->wlen, buffer, bytes))
+        return 0;
+      outs->wlen = 0;
+    }
+    return total;
+  }
+
+  /* O_DIRECT writes full buffers only */
+  while(bytes) {
+    size_t n = CURLMIN(bytes, outs->wsize - outs->wlen);
+    memcpy(&outs->wbuf[outs->wlen], buffer, n);
+    outs->wlen += n;
+    buffer += n;
+    bytes -= n;
+    if(outs->wlen == outs->wsize) {
+      if(!outs_write(outs, outs->wbuf, outs->wlen, NULL, 0))
+        return 0;
+      outs->wlen = 0;
+    }
+  }
+  return total;
+}
+
+bool tool_outs_flush(struct OutStruct *outs)
+{
+  if(!outs->wlen)
+    return TRUE;
+  if(outs->direct) {
+    size_t aligned = outs->wlen & ~(size_t)(OUTPUT_ALIGN - 1);
+    if(aligned && !outs_write(outs, outs->wbuf, aligned, NULL, 0))
+      return FALSE;
+    /* the rest is not a full block, which O_DIRECT cannot write */
+    direct_off(outs);
+    memmove(outs->wbuf, &outs->wbuf[aligned], outs->wlen - aligned);
+    outs->wlen -= aligned;
+  }
+  if(!outs_write(outs, outs->wbuf, outs->wlen, NULL, 0))
+    return FALSE;
+  outs->wlen = 0;
+  return TRUE;
+}
+
+bool tool_outs_finish(struct OutStruct *outs, struct OperationConfig *config)
+{
+  bool ok = TRUE;
+  int fd = fileno(outs->stream);
+
+  if(outs->wmem) {
+    ok = tool_outs_flush(outs);
+    /* the file was allocated for more than it got */
+    if(ok && (outs->prealloc > outs->init + outs->bytes) &&
+       ftruncate(fd, (off_t)(outs->init + outs->bytes)))
+      ok = FALSE;
+    tool_safefree(outs->wmem);
+    outs->wbuf = NULL;
+    outs->wlen = outs->wsize = 0;
+    outs->prealloc = 0;
+  }
+  if(ok && (config->output_sync != OUTPUT_SYNC_NONE)) {
+    if(fflush(outs->stream))
+      ok = FALSE;
+    /* !checksrc! disable ERRNOVAR 2 */
+#ifdef HAVE_FDATASYNC
+    else if(fdatasync(fd) && (errno != EINVAL))
+#else
+    else if(fsync(fd) && (errno != EINVAL))
+#endif
+      /* EINVAL is a file that cannot be synced, like a pipe */
+      ok = FALSE;
+  }
+  return ok;
+}
+
+#else /* USE_OUTPUT_BUFFER */
+
+bool tool_outs_flush(struct OutStruct *outs)
+{
+  (void)outs;
+  return TRUE;
+}
+
+bool tool_outs_finish(struct OutStruct *outs, struct OperationConfig *config)
+{
+  (void)outs;
+  (void)config;
+  return TRUE;
+}
+
+#endif /* !USE_OUTPUT_BUFFER */
+
+size_t tool_sink_write(struct per_transfer *per, const char *ptr, size_t len)
+{
+  if(tool_body_per_result())
+    return capture_append(&per->body, ptr, len) ? 0 : len;
+  return tool_sink_call(global->io.body, global->io.body_userp, ptr, len);
+}
+
+void tool_remove_output(const char *filename)
+{
+  struct_stat st;
+  if(!stat(filename, &st) &&
+     S_ISREG(st.st_mode)) {
+    if(!unlink(filename))
+      notef("Removed output file: %s", filename);
+    else
+      warnf("Failed removing: %s", filename);
+  }
+  else
+    warnf("Skipping removal; not a regular file: %s", filename);
+}
+
+CURLcode tool_outs_close(struct OutStruct *outs,
+                         struct OperationConfig *config, CURLcode result)
+{
+  if(outs->fopened && outs->stream) {
+    int rc;
+    if(!tool_outs_finish(outs, config) && !result) {
+      result = CURLE_WRITE_ERROR;
+      errorf("curl: (%d) Failed writing body", result);
+    }
+    rc = fclose(outs->stream);
+    if(!result && rc) {
+      /* something went wrong in the writing process */
+      result = CURLE_WRITE_ERROR;
+      errorf("curl: (%d) Failed writing body", result);
+    }
+    if(result && config->rm_partial && !outs->segment)
+      /* the last part of a --segments download removes the file */
+      tool_remove_output(outs->filename);
+  }
+  return result;
+}
+
 /*
 ** callback for CURLOPT_WRITEFUNCTION
 */
@@ -255,18 +601,19 @@ size_t tool_write_cb(char *buffer, size_t sz, size_t nmemb, void *userdata)
   struct OutStruct *outs = &per->outs;
   struct OperationConfig *config = per->config;
   size_t bytes = sz * nmemb;
-  bool is_tty = global->isatty;
+  bool is_tty = per->isatty;
 #if defined(_WIN32) && !defined(UNDER_CE)
   CONSOLE_SCREEN_BUFFER_INFO console_info;
   intptr_t fhnd;
 #endif
 
-  /* CaptureBuffer Hack */
-  if(capture_out) capture_append(capture_out, buffer, bytes);
-
   if(outs->out_null)
     return bytes;
 
+  if(per->cache && cache_write(per, buffer, bytes))
+    /* the output has the stored copy */
+    return bytes;
+
 #ifdef DEBUGBUILD
   {
     char *tty = curl_getenv("CURL_ISATTY");
@@ -322,7 +669,8 @@ size_t tool_write_cb(char *buffer, size_t sz, size_t nmemb, void *userdata)
   if(!outs->stream && !tool_create_output_file(outs, per->config))
     return CURL_WRITEFUNC_ERROR;
 
-  if(is_tty && (outs->bytes < 2000) && !config->terminal_binary_ok) {
+  if(is_tty && !tool_outs_to_sink(outs) && (outs->bytes < 2000) &&
+     !config->terminal_binary_ok) {
     /* binary output to terminal? */
     if(memchr(buffer, 0, bytes)) {
       warnf("Binary output can mess up your terminal. "
@@ -333,23 +681,39 @@ size_t tool_write_cb(char *buffer, size_t sz, size_t nmemb, void *userdata)
     }
   }
 
+  if(outs->segment)
+    rc = segment_write(per, buffer, bytes);
+  else if(tool_outs_to_sink(outs))
+    rc = tool_sink_write(per, buffer, bytes);
+#ifdef USE_IO_URING
+  else if(per->uring && uring_output_ok(per))
+    rc = uring_write(per, buffer, bytes);
+#endif
+#ifdef USE_OUTPUT_BUFFER
+  else if(outs->fopened && (config->output_buffer ||
+                            (config->output_sync == OUTPUT_SYNC_DIRECT)) &&
+          !config->show_headers && !config->nobuffer)
+    rc = buffered_write(per, buffer, bytes);
+#endif
+  else {
 #if defined(_WIN32) && !defined(UNDER_CE)
-  fhnd = _get_osfhandle(fileno(outs->stream));
-  /* if Windows console then UTF-8 must be converted to UTF-16 */
-  if(isatty(fileno(outs->stream)) &&
-     GetConsoleScreenBufferInfo((HANDLE)fhnd, &console_info)) {
-    size_t retval = win_console(fhnd, outs, buffer, bytes, &rc);
-    if(retval)
-      return retval;
-  }
-  else
+    fhnd = _get_osfhandle(fileno(outs->stream));
+    /* if Windows console then UTF-8 must be converted to UTF-16 */
+    if(isatty(fileno(outs->stream)) &&
+       GetConsoleScreenBufferInfo((HANDLE)fhnd, &console_info)) {
+      size_t retval = win_console(fhnd, outs, buffer, bytes, &rc);
+      if(retval)
+        return retval;
+    }
+    else
 #endif
-  {
-    if(per->hdrcbdata.headlist) {
-      if(tool_write_headers(&per->hdrcbdata, outs->stream))
-        return CURL_WRITEFUNC_ERROR;
+    {
+      if(per->hdrcbdata.headlist) {
+        if(tool_write_headers(&per->hdrcbdata, outs->stream))
+          return CURL_WRITEFUNC_ERROR;
+      }
+      rc = fwrite(buffer, sz, nmemb, outs->stream);
     }
-    rc = fwrite(buffer, sz, nmemb, outs->stream);
   }
 
   if(bytes == rc)
@@ -31,8 +31,37 @@
 
 size_t tool_write_cb(char *buffer, size_t sz, size_t nmemb, void *userdata);
 
+/* TRUE when the caller of curl_runner takes what goes to stdout, either in
+   the body sink or in the result record of the transfer */
+#define tool_body_per_result() \
+  (global->io.result && (global->io.result_flags & CURLRUNNER_RESULT_BODY))
+#define tool_outs_to_sink(outs) \
+  ((global->io.body || tool_body_per_result()) && \
+   ((outs)->stream == stdout))
+
+struct per_transfer;
+
+/* deliver stdout data to the caller, when tool_outs_to_sink() */
+size_t tool_sink_write(struct per_transfer *per, const char *ptr, size_t len);
+
 /* create a local file for writing, return TRUE on success */
 bool tool_create_output_file(struct OutStruct *outs,
                              struct OperationConfig *config);
 
+/* write what the --output-buffer holds to the file, TRUE on success */
+bool tool_outs_flush(struct OutStruct *outs);
+
+/* done writing the file: flush, give back what was allocated but not used
+   and sync it as --output-sync says, TRUE on success */
+bool tool_outs_finish(struct OutStruct *outs, struct OperationConfig *config);
+
+/* remove the output file, for --remove-on-error */
+void tool_remove_output(const char *filename);
+
+/* done with the output: finish and close the file, removing it on an error
+   with --remove-on-error unless it is a part of a --segments download. The
+   transfer's result is returned, or an error if the closing fails. */
+CURLcode tool_outs_close(struct OutStruct *outs,
+                         struct OperationConfig *config, CURLcode result);
+
 #endif /* HEADER_CURL_TOOL_CB_WRT_H */
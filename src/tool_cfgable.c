@@ -24,6 +24,7 @@
 #include "tool_setup.h"
 
 #include "tool_cfgable.h"
+#include "tool_cb_dbg.h"
 #include "tool_formparse.h"
 #include "tool_paramhlp.h"
 #include "tool_main.h"
@@ -31,7 +32,8 @@
 #include "memdebug.h" /* keep this as LAST include */
 
 static struct GlobalConfig globalconf;
-struct GlobalConfig *global;
+static struct curl_runner_io main_io;
+TOOL_THREAD_LOCAL struct GlobalConfig *global;
 
 struct OperationConfig *config_alloc(void)
 {
@@ -57,10 +59,20 @@ struct OperationConfig *config_alloc(void)
   return config;
 }
 
-static void free_config_fields(struct OperationConfig *config)
+static void getout_free(struct getout *urlnode)
 {
-  struct getout *urlnode;
+  while(urlnode) {
+    struct getout *next = urlnode->next;
+    tool_safefree(urlnode->url);
+    tool_safefree(urlnode->outfile);
+    tool_safefree(urlnode->infile);
+    tool_safefree(urlnode);
+    urlnode = next;
+  }
+}
 
+static void free_config_fields(struct OperationConfig *config)
+{
   tool_safefree(config->useragent);
   tool_safefree(config->altsvc);
   tool_safefree(config->hsts);
@@ -105,15 +117,7 @@ static void free_config_fields(struct OperationConfig *config)
   tool_safefree(config->proto_str);
   tool_safefree(config->proto_redir_str);
 
-  urlnode = config->url_list;
-  while(urlnode) {
-    struct getout *next = urlnode->next;
-    tool_safefree(urlnode->url);
-    tool_safefree(urlnode->outfile);
-    tool_safefree(urlnode->infile);
-    tool_safefree(urlnode);
-    urlnode = next;
-  }
+  getout_free(config->url_list);
   config->url_list = NULL;
   config->url_last = NULL;
   config->url_get = NULL;
@@ -152,6 +156,7 @@ static void free_config_fields(struct OperationConfig *config)
   tool_safefree(config->engine);
   tool_safefree(config->etag_save_file);
   tool_safefree(config->etag_compare_file);
+  tool_safefree(config->cache_dir);
   tool_safefree(config->ssl_ec_curves);
   tool_safefree(config->request_target);
   tool_safefree(config->customrequest);
@@ -207,6 +212,197 @@ void config_free(struct OperationConfig *config)
   }
 }
 
+/* The fields a run may have set in its copy of a plan's config, the rest
+   belongs to the plan */
+static void free_clone_fields(struct OperationConfig *config)
+{
+  const struct OperationConfig *tmpl = config->tmpl;
+
+  getout_free(config->url_list);
+  config->url_list = NULL;
+  if(curlx_dyn_ptr(&config->postdata) != curlx_dyn_ptr(&tmpl->postdata))
+    curlx_dyn_free(&config->postdata);
+  curl_slist_free_all(config->headers);
+  curl_mime_free(config->mimepost);
+  if(config->cacert != tmpl->cacert)
+    tool_safefree(config->cacert);
+  if(config->capath != tmpl->capath)
+    tool_safefree(config->capath);
+  if(config->cert_type != tmpl->cert_type)
+    tool_safefree(config->cert_type);
+  if(config->key_type != tmpl->key_type)
+    tool_safefree(config->key_type);
+  if(config->proxy_cert_type != tmpl->proxy_cert_type)
+    tool_safefree(config->proxy_cert_type);
+  if(config->proxy_key_type != tmpl->proxy_key_type)
+    tool_safefree(config->proxy_key_type);
+}
+
+static void clone_free(struct OperationConfig *config)
+{
+  while(config) {
+    struct OperationConfig *prev = config->prev;
+
+    free_clone_fields(config);
+    free(config);
+
+    config = prev;
+  }
+}
+
+/* A copy of the URL list of a plan. Transfers take the upload file names
+   off the nodes as they go. */
+static struct getout *getout_dup(const struct getout *node)
+{
+  struct getout *first = NULL;
+  struct getout **nextp = &first;
+
+  for(; node; node = node->next) {
+    struct getout *copy = malloc(sizeof(*copy));
+    if(!copy)
+      break;
+    *copy = *node;
+    copy->next = NULL;
+    copy->url = node->url ? strdup(node->url) : NULL;
+    copy->outfile = node->outfile ? strdup(node->outfile) : NULL;
+    copy->infile = node->infile ? strdup(node->infile) : NULL;
+    *nextp = copy;
+    nextp = &copy->next;
+    if((node->url && !copy->url) || (node->outfile && !copy->outfile) ||
+       (node->infile && !copy->infile))
+      break;
+  }
+  if(node) {
+    getout_free(first);
+    return NULL;
+  }
+  return first;
+}
+
+/* A copy of the parsed config of a plan for one run to work on. Fields a
+   transfer changes in place are copied: the headers since etag_compare()
+   appends to them and the URL list. */
+static struct OperationConfig *clone_alloc(const struct OperationConfig *tmpl)
+{
+  struct OperationConfig *config = malloc(sizeof(*config));
+  struct curl_slist *item;
+
+  if(!config)
+    return NULL;
+  *config = *tmpl;
+  config->tmpl = tmpl;
+  config->prev = config->next = NULL;
+  config->headers = NULL;
+  config->mimepost = NULL;
+  config->url_list = getout_dup(tmpl->url_list);
+  config->url_last = config->url_get = config->url_out = NULL;
+  if(tmpl->url_list && !config->url_list) {
+    free(config);
+    return NULL;
+  }
+  for(item = tmpl->headers; item; item = item->next) {
+    struct curl_slist *headers = curl_slist_append(config->headers,
+                                                   item->data);
+    if(!headers) {
+      curl_slist_free_all(config->headers);
+      getout_free(config->url_list);
+      free(config);
+      return NULL;
+    }
+    config->headers = headers;
+  }
+  return config;
+}
+
+CURLcode globalconf_clone(struct GlobalConfig *config,
+                          const struct GlobalConfig *tmpl)
+{
+  const struct OperationConfig *op;
+
+  *config = *tmpl;
+  global = config;
+
+  /* nothing of a previous run */
+  memset(&config->state, 0, sizeof(config->state));
+  memset(&config->progress, 0, sizeof(config->progress));
+  memset(&config->io, 0, sizeof(config->io));
+  config->transfers = config->transfersl = NULL;
+  config->ready = config->readyl = NULL;
+  config->nready = 0;
+  config->runshare = NULL;
+  config->dedupe = NULL;
+#ifdef USE_PARALLEL_THREADS
+  config->iolock = NULL;
+  config->proglock = NULL;
+#endif
+  config->trace_stream = NULL;
+  config->trace_ring = NULL;
+  config->trace_fopened = FALSE;
+  config->knownhosts = NULL;
+  config->variables = NULL;
+  config->templates = NULL;
+  config->all_added = 0;
+  config->num_transfers = 0;
+#if defined(_WIN32) && !defined(UNDER_CE)
+  memset(&config->term, 0, sizeof(config->term));
+#endif
+
+  config->first = config->last = config->current = NULL;
+  for(op = tmpl->first; op; op = op->next) {
+    struct OperationConfig *copy = clone_alloc(op);
+    if(!copy) {
+      clone_free(config->last);
+      config->first = config->last = NULL;
+      errorf("out of memory");
+      return CURLE_OUT_OF_MEMORY;
+    }
+    copy->prev = config->last;
+    if(config->last)
+      config->last->next = copy;
+    else
+      config->first = copy;
+    config->last = copy;
+  }
+  return CURLE_OK;
+}
+
+void globalconf_clone_teardown(void)
+{
+  tool_trace_close();
+#if defined(_WIN32) && !defined(UNDER_CE)
+  free(global->term.buf);
+#endif
+
+  clone_free(global->last);
+  global->first = NULL;
+  global->last = NULL;
+}
+
+/*
+ * Initialise the given global config with default values and an initial
+ * operate config, and make it the one used by the calling thread. This does
+ * not touch the libcurl global state.
+ */
+CURLcode globalconf_setup(struct GlobalConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  global = config;
+
+  /* Initialise the global config */
+  global->showerror = FALSE;          /* show errors when silent */
+  global->styled_output = TRUE;       /* enable detection */
+  global->parallel_max = PARALLEL_DEFAULT;
+  global->parallel_threads = 1;
+
+  /* Allocate the initial operate config */
+  global->first = global->last = config_alloc();
+  if(!global->first) {
+    errorf("error initializing curl");
+    return CURLE_FAILED_INIT;
+  }
+  return CURLE_OK;
+}
+
 /*
  * This is the main global constructor for the app. Call this before
  * _any_ libcurl usage. If this fails, *NO* libcurl functions may be
@@ -214,22 +410,17 @@ void config_free(struct OperationConfig *config)
  */
 CURLcode globalconf_init(void)
 {
-  CURLcode result = CURLE_OK;
-  global = &globalconf;
+  CURLcode result;
 
 #ifdef __DJGPP__
   /* stop stat() wasting time */
   _djstat_flags |= _STAT_INODE | _STAT_EXEC_MAGIC | _STAT_DIRSIZE;
 #endif
 
-  /* Initialise the global config */
-  global->showerror = FALSE;          /* show errors when silent */
-  global->styled_output = TRUE;       /* enable detection */
-  global->parallel_max = PARALLEL_DEFAULT;
+  result = globalconf_setup(&globalconf);
+  if(!result) {
+    global->io = main_io;
 
-  /* Allocate the initial operate config */
-  global->first = global->last = config_alloc();
-  if(global->first) {
     /* Perform the libcurl initialization */
     result = curl_global_init(CURL_GLOBAL_DEFAULT);
     if(!result) {
@@ -246,22 +437,15 @@ CURLcode globalconf_init(void)
       free(global->first);
     }
   }
-  else {
-    errorf("error initializing curl");
-    result = CURLE_FAILED_INIT;
-  }
 
   return result;
 }
 
 static void free_globalconfig(void)
 {
+  tool_trace_close();
   tool_safefree(global->trace_dump);
 
-  if(global->trace_fopened && global->trace_stream)
-    fclose(global->trace_stream);
-  global->trace_stream = NULL;
-
   tool_safefree(global->libcurl);
 #if defined(_WIN32) && !defined(UNDER_CE)
   free(global->term.buf);
@@ -269,14 +453,11 @@ static void free_globalconfig(void)
 }
 
 /*
- * This is the main global destructor for the app. Call this after _all_
- * libcurl usage is done.
+ * Free everything the global config of the calling thread holds. The
+ * counterpart to globalconf_setup().
  */
-void globalconf_free(void)
+void globalconf_teardown(void)
 {
-  /* Cleanup the easy handle */
-  /* Main cleanup */
-  curl_global_cleanup();
   free_globalconfig();
 
   /* Free the OperationConfig structures */
@@ -284,3 +465,50 @@ void globalconf_free(void)
   global->first = NULL;
   global->last = NULL;
 }
+
+/*
+ * This is the main global destructor for the app. Call this after _all_
+ * libcurl usage is done.
+ */
+void globalconf_free(void)
+{
+  /* Main cleanup */
+  curl_global_cleanup();
+  globalconf_teardown();
+}
+
+/*
+ * Hands output to one of the caller's sinks, one call at a time when
+ * --parallel-threads workers write too.
+ */
+size_t tool_sink_call(curl_runner_sink sink, void *userp,
+                      const char *ptr, size_t len)
+{
+  size_t n;
+#ifdef USE_PARALLEL_THREADS
+  if(global->iolock)
+    Curl_mutex_acquire(global->iolock);
+#endif
+  n = sink(ptr, len, userp);
+#ifdef USE_PARALLEL_THREADS
+  if(global->iolock)
+    Curl_mutex_release(global->iolock);
+#endif
+  return n;
+}
+
+/*
+ * Capture buffers for the curl_main() entry point. They receive what would
+ * otherwise be written to the output and error streams.
+ */
+void set_stdout_capture_buffer(struct CaptureBuffer *buffer)
+{
+  main_io.body = buffer ? curl_runner_capture_sink : NULL;
+  main_io.body_userp = buffer;
+}
+
+void set_stderr_capture_buffer(struct CaptureBuffer *buffer)
+{
+  main_io.err = buffer ? curl_runner_capture_sink : NULL;
+  main_io.err_userp = buffer;
+}
@@ -28,8 +28,15 @@
 #include "tool_setup.h"
 #include "tool_sdecls.h"
 #include "tool_urlglob.h"
+#include "tool_progress.h"
 #include "var.h"
 
+#include "curl_runner.h"
+
+#ifdef USE_PARALLEL_THREADS
+#include "curl_threads.h"
+#endif
+
 /* the type we use for storing a single boolean bit */
 #ifndef BIT
 #ifdef _MSC_VER
@@ -62,7 +69,7 @@
 #define tool_safefree(ptr)                      \
   do { free((ptr)); (ptr) = NULL;} while(0)
 
-extern struct GlobalConfig *global;
+extern TOOL_THREAD_LOCAL struct GlobalConfig *global;
 
 struct State {
   struct getout *urlnode;
@@ -74,6 +81,10 @@ struct State {
   curl_off_t upidx;     /* index for upload glob */
   curl_off_t urlnum;    /* how many iterations this URL has with ranges etc */
   curl_off_t urlidx;    /* index for globbed URLs */
+  FILE *urlfile;        /* --url @file being read */
+  struct dynbuf urlline; /* its current URL */
+  curl_off_t urlfilenum; /* URLs read from it so far */
+  curl_off_t urlnumoff; /* URLs URL files had beyond their own node */
 };
 
 struct OperationConfig {
@@ -92,6 +103,7 @@ struct OperationConfig {
   char *referer;
   char *query;
   curl_off_t max_filesize;
+  curl_off_t output_buffer; /* --output-buffer, 0 = stdio buffering */
   char *output_dir;
   char *headerfile;
   char *ftpport;
@@ -155,6 +167,7 @@ struct OperationConfig {
   char *engine;
   char *etag_save_file;
   char *etag_compare_file;
+  char *cache_dir;
   char *customrequest;
   char *ssl_ec_curves;
   char *ssl_signature_algorithms;
@@ -186,6 +199,9 @@ struct OperationConfig {
   char *ech;                      /* Config set by --ech keywords */
   char *ech_config;               /* Config set by "--ech esl:" option */
   char *ech_public;               /* Config set by "--ech pn:" option */
+  const struct OperationConfig *tmpl; /* set in the copy of a curl_runner
+                                         plan's config a run works on, the
+                                         plan owns the fields */
   struct OperationConfig *prev;
   struct OperationConfig *next;   /* Always last in the struct */
   curl_off_t condtime;
@@ -211,6 +227,7 @@ struct OperationConfig {
   long req_retry;           /* number of retries */
   long retry_delay_ms;      /* delay between retries (in milliseconds) */
   long retry_maxtime_ms;    /* maximum time to keep retrying */
+  long segments;            /* --segments, parts to download at once */
 
   unsigned long mime_options; /* Mime option flags. */
   long tftp_blksize;        /* TFTP BLKSIZE option */
@@ -235,10 +252,19 @@ struct OperationConfig {
     CLOBBER_NEVER, /* If the file exists, always fail */
     CLOBBER_ALWAYS /* If the file exists, always overwrite it */
   } file_clobber_mode;
+  enum {
+    OUTPUT_SYNC_NONE,  /* leave it to the system */
+    OUTPUT_SYNC_DATA,  /* fdatasync() the file when done */
+    OUTPUT_SYNC_DIRECT /* write with O_DIRECT, then fdatasync() */
+  } output_sync;
   unsigned char upload_flags; /* Bitmask for --upload-flags */
   unsigned short porttouse;
   unsigned char ssl_version;     /* 0 - 4, 0 being default */
   unsigned char ssl_version_max; /* 0 - 4, 0 being default */
+  /* not bits, the transfer callbacks set these in --parallel-threads worker
+     threads */
+  bool readbusy;            /* set when reading input returns EAGAIN */
+  bool synthetic_error;     /* if TRUE, this is tool-internal error */
   BIT(remote_name_all);   /* --remote-name-all */
   BIT(remote_time);
   BIT(cookiesession);       /* new session? */
@@ -270,7 +296,6 @@ struct OperationConfig {
   BIT(crlf);
   BIT(http09_allowed);
   BIT(nobuffer);
-  BIT(readbusy);            /* set when reading input returns EAGAIN */
   BIT(globoff);
   BIT(use_httpget);
   BIT(insecure_ok);         /* set TRUE to allow insecure SSL connects */
@@ -329,7 +354,6 @@ struct OperationConfig {
   BIT(path_as_is);
   BIT(suppress_connect_headers);  /* suppress proxy CONNECT response headers
                                      from user callbacks */
-  BIT(synthetic_error);           /* if TRUE, this is tool-internal error */
   BIT(ssh_compression);           /* enable/disable SSH compression */
   BIT(haproxy_protocol);          /* whether to send HAProxy protocol v1 */
   BIT(disallow_username_in_url);  /* disallow usernames in URLs */
@@ -337,6 +361,7 @@ struct OperationConfig {
   BIT(rm_partial);                /* on error, remove partially written output
                                      files */
   BIT(skip_existing);
+  BIT(dedupe);             /* --dedupe */
 };
 
 #if defined(_WIN32) && !defined(UNDER_CE)
@@ -346,15 +371,40 @@ struct termout {
 };
 #endif
 
+/* Connection reuse state a curl_runner context lends to one run */
+struct RunnerShare {
+  CURLSH *share;                  /* kept alive between runs */
+  long maxconnects;               /* idle connections to keep, 0 = default */
+  long maxage_conn;               /* max idle seconds of a connection */
+  long dns_cache_timeout;         /* seconds, -1 = forever */
+};
+
 struct GlobalConfig {
   struct State state;             /* for create_transfer() */
+  struct per_transfer *transfers; /* first node */
+  struct per_transfer *transfersl; /* last node */
+  struct per_transfer *ready;     /* parallel transfers not added yet, */
+  struct per_transfer *readyl;    /* linked with rnext and rprev */
+  long nready;                    /* number of transfers in 'ready' */
+  struct ProgressMeter progress;  /* for the parallel progress meter */
+  struct curl_runner_io io;        /* caller's sinks when embedded */
+  struct RunnerShare *runshare;   /* persistent share, NULL for a fresh one */
+  struct dedupe *dedupe;          /* --dedupe transfers of the run, or NULL */
+#ifdef USE_PARALLEL_THREADS
+  curl_mutex_t *iolock;           /* one sink call at a time while worker
+                                     threads run transfers */
+  curl_mutex_t *proglock;         /* for the sums of global->progress while
+                                     worker threads run transfers */
+#endif
   char *trace_dump;               /* file to dump the network trace to */
   FILE *trace_stream;
+  struct trace_ring *trace_ring;  /* --trace-async writer thread, or NULL */
   char *libcurl;                  /* Output libcurl code to this filename */
   char *ssl_sessions;             /* file to load/save SSL session tickets */
   char *knownhosts;               /* known host path, if set. curl_free()
                                      this */
-  struct tool_var *variables;
+  struct tool_vars *variables;    /* --variable, by name */
+  struct var_tmpls *templates;    /* lines compiled for expansion */
   struct OperationConfig *first;
   struct OperationConfig *current;
   struct OperationConfig *last;
@@ -363,31 +413,51 @@ struct GlobalConfig {
 #endif
   timediff_t ms_per_transfer;     /* start next transfer after (at least) this
                                      many milliseconds */
+  timediff_t host_ms_per_transfer; /* the same for each host, with
+                                      --parallel */
+  long all_added;                 /* number of easy handles currently added */
+  long num_transfers;             /* number of transfers created so far */
+  int outnum;                     /* number of URLs given so far */
+  int progress_fd;                /* --progress-fd, 0 = none */
   trace tracetype;
   int progressmode;               /* CURL_PROGRESS_BAR / CURL_PROGRESS_STATS */
   unsigned short parallel_host; /* MAX_PARALLEL_HOST is the maximum */
   unsigned short parallel_max; /* MAX_PARALLEL is the maximum */
+  unsigned short parallel_threads; /* MAX_PARALLEL_THREADS is the maximum */
   unsigned char verbosity;        /* How verbose we should be */
 #ifdef DEBUGBUILD
   BIT(test_duphandle);
   BIT(test_event_based);
 #endif
+  BIT(embedded);                  /* run by curl_runner, the process lives on
+                                     after the transfers are done */
   BIT(parallel);
   BIT(parallel_connect);
+  BIT(parallel_adaptive);         /* back off hosts that reply 429/503 */
+  BIT(io_uring);                  /* --io-uring for the file I/O */
   BIT(fail_early);                /* exit on first transfer error */
   BIT(styled_output);             /* enable fancy output style detection */
   BIT(trace_fopened);
+  BIT(trace_async);               /* format and write the trace in a thread */
   BIT(tracetime);                 /* include timestamp? */
   BIT(traceids);                  /* include xfer-/conn-id? */
   BIT(showerror);                 /* show errors when silent */
   BIT(silent);                    /* do not show messages, --silent given */
   BIT(noprogress);                /* do not show progress bar */
-  BIT(isatty);                    /* Updated internally if output is a tty */
+  BIT(stdin_used);                /* an option has stdin to read */
+  BIT(stdin_urls);                /* --url @- reads URLs from stdin */
 };
 
 struct OperationConfig *config_alloc(void);
 void config_free(struct OperationConfig *config);
 CURLcode globalconf_init(void);
 void globalconf_free(void);
+CURLcode globalconf_setup(struct GlobalConfig *config);
+void globalconf_teardown(void);
+size_t tool_sink_call(curl_runner_sink sink, void *userp,
+                      const char *ptr, size_t len);
+CURLcode globalconf_clone(struct GlobalConfig *config,
+                          const struct GlobalConfig *tmpl);
+void globalconf_clone_teardown(void);
 
 #endif /* HEADER_CURL_TOOL_CFGABLE_H */
@@ -0,0 +1,426 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+#ifdef HAVE_FCNTL_H
+/* for open() */
+#include <fcntl.h>
+#endif
+
+#if defined(__linux__) && defined(HAVE_SYS_IOCTL_H)
+#include <sys/ioctl.h>
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+
+#include "tool_cfgable.h"
+#include "tool_cb_wrt.h"
+#include "tool_dedupe.h"
+#include "tool_msgs.h"
+#include "tool_operate.h"
+#include "tool_runner.h"
+#include "tool_writeout.h"
+
+#include "memdebug.h" /* keep this as LAST include */
+
+#ifdef _WIN32
+#define OPENMODE S_IREAD | S_IWRITE
+#else
+#define OPENMODE S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH
+#endif
+
+#define DEDUPE_SLOTS 64        /* initial hash table size */
+#define DEDUPE_KEEP 64         /* done requests kept for later duplicates */
+#define DEDUPE_CHUNK (16*1024) /* written to an output at a time */
+
+/*
+ * A request: the method, headers and body come from the config, so the
+ * config and the URL tell two apart. The first transfer asking for it makes
+ * it, the ones after get its output. Once done, the easy handle is kept for
+ * the --write-out of the ones still to come, for the DEDUPE_KEEP most recent
+ * requests. A duplicate of a request dropped from there makes it again.
+ */
+struct dupe {
+  struct dupe *next;            /* in the hash chain */
+  struct dupe *knext;           /* in the kept list, oldest first */
+  struct dupe *kprev;
+  struct OperationConfig *config;
+  char *url;
+  struct per_transfer *first;   /* making the request, NULL once done */
+  struct per_transfer *waiters; /* duplicates waiting for it */
+  struct per_transfer *waitersl;
+  CURL *curl;                   /* the first one's handle, once done */
+  char *filename;               /* its output file */
+  char *body;                   /* or the body it captured */
+  size_t len;
+  CURLcode result;
+  BIT(performed);               /* the request was made, not skipped */
+};
+
+struct dedupe {
+  struct dupe **table;
+  size_t size;                  /* slots in the table */
+  size_t count;                 /* requests in the table */
+  struct dupe *kept;            /* done ones, oldest first */
+  struct dupe *keptl;
+  size_t nkept;
+};
+
+static size_t url_hash(const char *url)
+{
+  size_t h = 5381;
+  for(; *url; url++)
+    h = (h * 33) ^ (unsigned char)*url;
+  return h;
+}
+
+/* double the table when it gets crowded, keep going with the old one if
+   that fails */
+static void dedupe_grow(struct dedupe *dd)
+{
+  size_t size = dd->size ? dd->size * 2 : DEDUPE_SLOTS;
+  struct dupe **table = calloc(size, sizeof(*table));
+  size_t i;
+  if(!table)
+    return;
+  for(i = 0; i < dd->size; i++) {
+    struct dupe *d = dd->table[i];
+    while(d) {
+      struct dupe *next = d->next;
+      size_t slot = url_hash(d->url) & (size - 1);
+      d->next = table[slot];
+      table[slot] = d;
+      d = next;
+    }
+  }
+  free(dd->table);
+  dd->table = table;
+  dd->size = size;
+}
+
+static void dupe_free(struct dupe *d)
+{
+  if(d->curl)
+    curl_easy_cleanup(d->curl);
+  free(d->url);
+  free(d->filename);
+  free(d->body);
+  free(d);
+}
+
+/* take it out of the table and the kept list and free it */
+static void dupe_drop(struct dedupe *dd, struct dupe *d)
+{
+  struct dupe **dp = &dd->table[url_hash(d->url) & (dd->size - 1)];
+  struct per_transfer *w;
+
+  while(*dp != d)
+    dp = &(*dp)->next;
+  *dp = d->next;
+  dd->count--;
+  if(d->curl) {
+    if(d->kprev)
+      d->kprev->knext = d->knext;
+    else
+      dd->kept = d->knext;
+    if(d->knext)
+      d->knext->kprev = d->kprev;
+    else
+      dd->keptl = d->kprev;
+    dd->nkept--;
+  }
+  for(w = d->waiters; w; w = w->dnext)
+    /* the request was never done, they end without output */
+    w->dupe = NULL;
+  dupe_free(d);
+}
+
+/* give the duplicate's output file the same content without copying it: a
+   reflink where the file system has them, else a hard link */
+static bool dupe_link(const char *from, const char *to)
+{
+#ifdef _WIN32
+  (void)from;
+  (void)to;
+  return FALSE;
+#else
+#if defined(__linux__) && defined(HAVE_SYS_IOCTL_H)
+  int in = open(from, O_RDONLY | CURL_O_BINARY);
+  if(in != -1) {
+    int out = open(to, O_CREAT | O_WRONLY | O_TRUNC | CURL_O_BINARY,
+                   OPENMODE);
+    bool ok = FALSE;
+    if(out != -1) {
+      ok = !ioctl(out, FICLONE, in);
+      close(out);
+    }
+    close(in);
+    if(ok)
+      return TRUE;
+  }
+#endif
+  (void)unlink(to);
+  return !link(from, to);
+#endif
+}
+
+/* write the output of the request to the duplicate's output */
+static CURLcode dupe_output(struct dupe *d, struct per_transfer *per)
+{
+  struct OutStruct *outs = &per->outs;
+  struct OperationConfig *config = per->config;
+  CURLcode result = CURLE_OK;
+  FILE *in = NULL;
+  char *buf = NULL;
+
+  if(outs->out_null)
+    return CURLE_OK;
+  if(d->filename && outs->filename) {
+    if(!strcmp(d->filename, outs->filename) ||
+       dupe_link(d->filename, outs->filename))
+      return CURLE_OK;
+  }
+
+  if(d->filename) {
+    in = fopen(d->filename, "rb");
+    buf = malloc(DEDUPE_CHUNK);
+    if(!in || !buf) {
+      result = in ? CURLE_OUT_OF_MEMORY : CURLE_READ_ERROR;
+      if(!in)
+        errorf("Failed to open %s", d->filename);
+    }
+    while(!result) {
+      size_t n = fread(buf, 1, DEDUPE_CHUNK, in);
+      if(!n) {
+        if(ferror(in))
+          result = CURLE_READ_ERROR;
+        break;
+      }
+      if(tool_write_cb(buf, 1, n, per) != n)
+        result = CURLE_WRITE_ERROR;
+    }
+    if(in)
+      fclose(in);
+    free(buf);
+  }
+  else {
+    size_t done = 0;
+    while(!result && (done < d->len)) {
+      size_t n = CURLMIN(d->len - done, DEDUPE_CHUNK);
+      if(tool_write_cb(d->body + done, 1, n, per) != n)
+        result = CURLE_WRITE_ERROR;
+      done += n;
+    }
+  }
+
+  /* an empty body still makes the output file */
+  if(!result && !outs->stream && !tool_create_output_file(outs, config))
+    result = CURLE_WRITE_ERROR;
+  return tool_outs_close(outs, config, result);
+}
+
+/* the duplicate gets the output of the request and the --write-out and
+   result record of it */
+static void dupe_complete(struct dupe *d, struct per_transfer *per)
+{
+  struct OperationConfig *config = per->config;
+  CURLcode result = d->result;
+  CURL *own = per->curl;
+  bool skip = per->skip;
+
+  per->dupe = NULL;
+  if(!result)
+    result = dupe_output(d, per);
+  per->curl = d->curl;
+  per->skip = !d->performed;
+  if(config->writeout)
+    ourWriteOut(config, per, result);
+  if(global->io.result)
+    runner_report(per, result);
+  per->curl = own;
+  per->skip = skip;
+  per->deduped = TRUE;
+}
+
+/* the first one of a request: its output can be given to others */
+static bool first_ok(struct per_transfer *per)
+{
+  struct OutStruct *outs = &per->outs;
+  if(outs->filename)
+    return !outs->is_cd_filename;
+  return tool_body_per_result() && (outs->stream == stdout);
+}
+
+CURLcode dedupe_add(struct per_transfer *per, bool *dup)
+{
+  struct dedupe *dd = global->dedupe;
+  struct dupe *d;
+  size_t slot;
+
+  *dup = FALSE;
+  if(!dd) {
+    dd = calloc(1, sizeof(*dd));
+    if(!dd)
+      return CURLE_OUT_OF_MEMORY;
+    global->dedupe = dd;
+  }
+  if(dd->count >= dd->size)
+    dedupe_grow(dd);
+  if(!dd->size)
+    return CURLE_OUT_OF_MEMORY;
+
+  slot = url_hash(per->url) & (dd->size - 1);
+  for(d = dd->table[slot]; d; d = d->next) {
+    if((d->config == per->config) && !strcmp(d->url, per->url))
+      break;
+  }
+  if(d) {
+    *dup = TRUE;
+    if(d->first) {
+      /* made now, wait for it */
+      per->dupe = d;
+      per->dnext = NULL;
+      if(d->waitersl)
+        d->waitersl->dnext = per;
+      else
+        d->waiters = per;
+      d->waitersl = per;
+    }
+    else
+      dupe_complete(d, per);
+    return CURLE_OK;
+  }
+
+  if(!first_ok(per))
+    return CURLE_OK;
+  d = calloc(1, sizeof(*d));
+  if(!d)
+    return CURLE_OUT_OF_MEMORY;
+  d->url = strdup(per->url);
+  if(!d->url) {
+    free(d);
+    return CURLE_OUT_OF_MEMORY;
+  }
+  d->config = per->config;
+  d->first = per;
+  d->next = dd->table[slot];
+  dd->table[slot] = d;
+  dd->count++;
+  per->dupe = d;
+  return CURLE_OK;
+}
+
+bool dedupe_done(struct per_transfer *per, CURLcode result)
+{
+  struct dedupe *dd = global->dedupe;
+  struct dupe *d = per->dupe;
+  struct per_transfer *w;
+
+  if(!d || (d->first != per))
+    return FALSE;
+  d->first = NULL;
+  per->dupe = NULL;
+  d->curl = per->curl;
+  d->result = result;
+  d->performed = !per->skip;
+  if(!result) {
+    if(per->outs.filename) {
+      d->filename = strdup(per->outs.filename);
+      if(!d->filename)
+        d->result = CURLE_OUT_OF_MEMORY;
+    }
+    else if(per->body.size) {
+      d->body = malloc(per->body.size);
+      if(d->body) {
+        memcpy(d->body, per->body.data, per->body.size);
+        d->len = per->body.size;
+      }
+      else
+        d->result = CURLE_OUT_OF_MEMORY;
+    }
+  }
+
+  while(d->waiters) {
+    w = d->waiters;
+    d->waiters = w->dnext;
+    w->dnext = NULL;
+    dupe_complete(d, w);
+  }
+  d->waitersl = NULL;
+
+  d->kprev = dd->keptl;
+  if(dd->keptl)
+    dd->keptl->knext = d;
+  else
+    dd->kept = d;
+  dd->keptl = d;
+  dd->nkept++;
+  if(dd->nkept > DEDUPE_KEEP)
+    dupe_drop(dd, dd->kept);
+  return TRUE;
+}
+
+void dedupe_forget(struct per_transfer *per)
+{
+  struct dupe *d = per->dupe;
+  if(!d)
+    return;
+  per->dupe = NULL;
+  if(d->first == per)
+    /* ended without being done */
+    dupe_drop(global->dedupe, d);
+  else {
+    struct per_transfer **wp = &d->waiters;
+    d->waitersl = NULL;
+    while(*wp) {
+      if(*wp == per)
+        *wp = per->dnext;
+      else {
+        d->waitersl = *wp;
+        wp = &(*wp)->dnext;
+      }
+    }
+    per->dnext = NULL;
+  }
+}
+
+void dedupe_cleanup(void)
+{
+  struct dedupe *dd = global->dedupe;
+  size_t i;
+  if(!dd)
+    return;
+  for(i = 0; i < dd->size; i++) {
+    struct dupe *d = dd->table[i];
+    while(d) {
+      struct dupe *next = d->next;
+      dupe_free(d);
+      d = next;
+    }
+  }
+  free(dd->table);
+  free(dd);
+  global->dedupe = NULL;
+}
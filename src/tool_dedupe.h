@@ -0,0 +1,47 @@
+#ifndef HEADER_CURL_TOOL_DEDUPE_H
+#define HEADER_CURL_TOOL_DEDUPE_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+struct per_transfer;
+
+/* --dedupe: a transfer asking for the same URL with the same options as an
+   earlier one makes no request of its own. It gets the output of the earlier
+   one, right away if that is done or else when it is. Sets *dup for such a
+   transfer. */
+CURLcode dedupe_add(struct per_transfer *per, bool *dup);
+
+/* the transfer has ended, hand its output to the duplicates waiting for it.
+   TRUE when the easy handle is kept for their --write-out and the caller
+   must not clean it up. */
+bool dedupe_done(struct per_transfer *per, CURLcode result);
+
+/* the transfer goes away */
+void dedupe_forget(struct per_transfer *per);
+
+/* the run is over */
+void dedupe_cleanup(void);
+
+#endif /* HEADER_CURL_TOOL_DEDUPE_H */
@@ -35,13 +35,14 @@
 
 /* global variable definitions, for easy-interface source code generation */
 
-struct slist_wc *easysrc_decl; /* Variable declarations */
-struct slist_wc *easysrc_data; /* Build slists, forms etc. */
-struct slist_wc *easysrc_code; /* Setopt calls */
-struct slist_wc *easysrc_toohard; /* Unconvertible setopt */
-struct slist_wc *easysrc_clean;  /* Clean up allocated data */
-int easysrc_mime_count;
-int easysrc_slist_count;
+TOOL_THREAD_LOCAL struct slist_wc *easysrc_decl; /* Variable declarations */
+TOOL_THREAD_LOCAL struct slist_wc *easysrc_data; /* Build slists, forms etc. */
+TOOL_THREAD_LOCAL struct slist_wc *easysrc_code; /* Setopt calls */
+TOOL_THREAD_LOCAL struct slist_wc *easysrc_toohard; /* Unconvertible setopt */
+/* Clean up allocated data */
+TOOL_THREAD_LOCAL struct slist_wc *easysrc_clean;
+TOOL_THREAD_LOCAL int easysrc_mime_count;
+TOOL_THREAD_LOCAL int easysrc_slist_count;
 
 static const char *const srchead[]={
   "/********* Sample code generated by the curl command line tool **********",
@@ -28,14 +28,21 @@
 
 /* global variable declarations, for easy-interface source code generation */
 
-extern struct slist_wc *easysrc_decl; /* Variable declarations */
-extern struct slist_wc *easysrc_data; /* Build slists, forms etc. */
-extern struct slist_wc *easysrc_code; /* Setopt calls etc. */
-extern struct slist_wc *easysrc_toohard; /* Unconvertible setopt */
-extern struct slist_wc *easysrc_clean;  /* Clean up (reverse order) */
-
-extern int easysrc_mime_count;  /* Number of curl_mime variables */
-extern int easysrc_slist_count; /* Number of curl_slist variables */
+/* Variable declarations */
+extern TOOL_THREAD_LOCAL struct slist_wc *easysrc_decl;
+/* Build slists, forms etc. */
+extern TOOL_THREAD_LOCAL struct slist_wc *easysrc_data;
+/* Setopt calls etc. */
+extern TOOL_THREAD_LOCAL struct slist_wc *easysrc_code;
+/* Unconvertible setopt */
+extern TOOL_THREAD_LOCAL struct slist_wc *easysrc_toohard;
+/* Clean up (reverse order) */
+extern TOOL_THREAD_LOCAL struct slist_wc *easysrc_clean;
+
+/* Number of curl_mime variables */
+extern TOOL_THREAD_LOCAL int easysrc_mime_count;
+/* Number of curl_slist variables */
+extern TOOL_THREAD_LOCAL int easysrc_slist_count;
 
 extern CURLcode easysrc_init(void);
 extern CURLcode easysrc_add(struct slist_wc **plist, const char *bupf);
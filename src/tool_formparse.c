@@ -130,6 +130,10 @@ static struct tool_mime *tool_mime_new_filedata(struct tool_mime *parent,
     curl_off_t origin;
     struct_stat sbuf;
 
+    if(stdin_claim(FALSE)) {
+      *errcode = CURLE_BAD_FUNCTION_ARGUMENT;
+      return NULL;
+    }
     CURLX_SET_BINMODE(stdin);
     origin = ftell(stdin);
     /* If stdin is a regular file, do not buffer data but read it
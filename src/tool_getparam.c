@@ -35,6 +35,8 @@
 #include "tool_parsecfg.h"
 #include "tool_main.h"
 #include "tool_stderr.h"
+#include "tool_trace.h"
+#include "tool_uring.h"
 #include "tool_help.h"
 #include "var.h"
 
@@ -93,6 +95,7 @@ static const struct LongShort aliases[]= {
   {"buffer",                     ARG_BOOL|ARG_NO, 'N', C_BUFFER},
   {"ca-native",                  ARG_BOOL|ARG_TLS, ' ', C_CA_NATIVE},
   {"cacert",                     ARG_FILE|ARG_TLS, ' ', C_CACERT},
+  {"cache-dir",                  ARG_FILE, ' ', C_CACHE_DIR},
   {"capath",                     ARG_FILE|ARG_TLS, ' ', C_CAPATH},
   {"cert",                       ARG_FILE|ARG_TLS|ARG_CLEAR, 'E', C_CERT},
   {"cert-status",                ARG_BOOL|ARG_TLS, ' ', C_CERT_STATUS},
@@ -117,6 +120,7 @@ static const struct LongShort aliases[]= {
   {"data-binary",                ARG_STRG, ' ', C_DATA_BINARY},
   {"data-raw",                   ARG_STRG, ' ', C_DATA_RAW},
   {"data-urlencode",             ARG_STRG, ' ', C_DATA_URLENCODE},
+  {"dedupe",                     ARG_BOOL, ' ', C_DEDUPE},
   {"delegation",                 ARG_STRG, ' ', C_DELEGATION},
   {"digest",                     ARG_BOOL, ' ', C_DIGEST},
   {"disable",                    ARG_BOOL, 'q', C_DISABLE},
@@ -183,6 +187,7 @@ static const struct LongShort aliases[]= {
   {"include",                    ARG_BOOL, ' ', C_INCLUDE},
   {"insecure",                   ARG_BOOL, 'k', C_INSECURE},
   {"interface",                  ARG_STRG, ' ', C_INTERFACE},
+  {"io-uring",                   ARG_BOOL, ' ', C_IO_URING},
   {"ip-tos",                     ARG_STRG, ' ', C_IP_TOS},
 #ifndef CURL_DISABLE_IPFS
   {"ipfs-gateway",               ARG_STRG, ' ', C_IPFS_GATEWAY},
@@ -227,11 +232,16 @@ static const struct LongShort aliases[]= {
   {"oauth2-bearer",              ARG_STRG|ARG_CLEAR, ' ', C_OAUTH2_BEARER},
   {"out-null",                   ARG_BOOL, ' ', C_OUT_NULL},
   {"output",                     ARG_FILE, 'o', C_OUTPUT},
+  {"output-buffer",              ARG_STRG, ' ', C_OUTPUT_BUFFER},
   {"output-dir",                 ARG_STRG, ' ', C_OUTPUT_DIR},
+  {"output-sync",                ARG_STRG, ' ', C_OUTPUT_SYNC},
   {"parallel",                   ARG_BOOL, 'Z', C_PARALLEL},
+  {"parallel-adaptive",          ARG_BOOL, ' ', C_PARALLEL_ADAPTIVE},
+  {"parallel-host-rate",         ARG_STRG, ' ', C_PARALLEL_HOST_RATE},
   {"parallel-immediate",         ARG_BOOL, ' ', C_PARALLEL_IMMEDIATE},
   {"parallel-max",               ARG_STRG, ' ', C_PARALLEL_MAX},
   {"parallel-max-host",          ARG_STRG, ' ', C_PARALLEL_HOST},
+  {"parallel-threads",           ARG_STRG, ' ', C_PARALLEL_THREADS},
   {"pass",                       ARG_STRG|ARG_CLEAR, ' ', C_PASS},
   {"path-as-is",                 ARG_BOOL, ' ', C_PATH_AS_IS},
   {"pinnedpubkey",               ARG_STRG|ARG_TLS, ' ', C_PINNEDPUBKEY},
@@ -240,6 +250,7 @@ static const struct LongShort aliases[]= {
   {"post303",                    ARG_BOOL, ' ', C_POST303},
   {"preproxy",                   ARG_STRG, ' ', C_PREPROXY},
   {"progress-bar",               ARG_BOOL, '#', C_PROGRESS_BAR},
+  {"progress-fd",                ARG_STRG, ' ', C_PROGRESS_FD},
   {"progress-meter",             ARG_BOOL|ARG_NO, ' ', C_PROGRESS_METER},
   {"proto",                      ARG_STRG, ' ', C_PROTO},
   {"proto-default",              ARG_STRG, ' ', C_PROTO_DEFAULT},
@@ -299,6 +310,7 @@ static const struct LongShort aliases[]= {
   {"retry-max-time",             ARG_STRG, ' ', C_RETRY_MAX_TIME},
   {"sasl-authzid",               ARG_STRG, ' ', C_SASL_AUTHZID},
   {"sasl-ir",                    ARG_BOOL, ' ', C_SASL_IR},
+  {"segments",                   ARG_STRG, ' ', C_SEGMENTS},
   {"service-name",               ARG_STRG, ' ', C_SERVICE_NAME},
   {"sessionid",                  ARG_BOOL|ARG_NO, ' ', C_SESSIONID},
   {"show-error",                 ARG_BOOL, 'S', C_SHOW_ERROR},
@@ -355,8 +367,10 @@ static const struct LongShort aliases[]= {
   {"tr-encoding",                ARG_BOOL, ' ', C_TR_ENCODING},
   {"trace",                      ARG_FILE, ' ', C_TRACE},
   {"trace-ascii",                ARG_FILE, ' ', C_TRACE_ASCII},
+  {"trace-async",                ARG_BOOL, ' ', C_TRACE_ASYNC},
   {"trace-config",               ARG_STRG, ' ', C_TRACE_CONFIG},
   {"trace-ids",                  ARG_BOOL, ' ', C_TRACE_IDS},
+  {"trace-raw",                  ARG_FILE, ' ', C_TRACE_RAW},
   {"trace-time",                 ARG_BOOL, ' ', C_TRACE_TIME},
   {"unix-socket",                ARG_FILE, ' ', C_UNIX_SOCKET},
   {"upload-file",                ARG_FILE, 'T', C_UPLOAD_FILE},
@@ -623,6 +637,9 @@ static ParameterError data_urlencode(const char *nextarg,
     FILE *file;
     /* a '@' letter, it means that a filename or - (stdin) follows */
     if(!strcmp("-", p)) {
+      err = stdin_claim(FALSE);
+      if(err)
+        return err;
       file = stdin;
       CURLX_SET_BINMODE(stdin);
     }
@@ -774,8 +791,9 @@ static int findarg(const void *a, const void *b)
 
 const struct LongShort *findshortopt(char letter)
 {
-  static const struct LongShort *singles[128 - ' ']; /* ASCII => pointer */
-  static bool singles_done = FALSE;
+  /* ASCII => pointer */
+  static TOOL_THREAD_LOCAL const struct LongShort *singles[128 - ' '];
+  static TOOL_THREAD_LOCAL bool singles_done = FALSE;
   if((letter >= 127) || (letter <= ' '))
     return NULL;
 
@@ -894,6 +912,9 @@ static ParameterError set_data(cmdline_t cmd,
     nextarg++; /* pass the @ */
 
     if(!strcmp("-", nextarg)) {
+      err = stdin_claim(FALSE);
+      if(err)
+        return err;
       file = stdin;
       if(cmd == C_DATA_BINARY) /* forced data-binary */
         CURLX_SET_BINMODE(stdin);
@@ -954,9 +975,10 @@ static ParameterError set_data(cmdline_t cmd,
   return err;
 }
 
-static ParameterError set_rate(const char *nextarg)
+static ParameterError set_rate(const char *nextarg, const char *option,
+                               timediff_t *ms_per_transfer)
 {
-  /* --rate */
+  /* --rate and --parallel-host-rate */
   /* support a few different suffixes, extract the suffix first, then
      get the number and convert to per hour.
      /s == per second
@@ -1002,14 +1024,14 @@ static ParameterError set_rate(const char *nextarg)
       numerator = 24*60*60*1000;
       break;
     default:
-      errorf("unsupported --rate unit");
+      errorf("unsupported --%s unit", option);
       err = PARAM_BAD_USE;
       break;
     }
 
     if((LONG_MAX / numerator) < numunits) {
       /* overflow, too large number */
-      errorf("too large --rate unit");
+      errorf("too large --%s unit", option);
       err = PARAM_NUMBER_TOO_LARGE;
     }
     /* this typecast is okay based on the check above */
@@ -1021,7 +1043,7 @@ static ParameterError set_rate(const char *nextarg)
   else if(denominator > numerator)
     err = PARAM_NUMBER_TOO_LARGE;
   else
-    global->ms_per_transfer = numerator/denominator;
+    *ms_per_transfer = numerator/denominator;
 
   return err;
 }
@@ -1035,6 +1057,164 @@ const struct LongShort *findlongopt(const char *opt)
                  sizeof(aliases[0]), findarg);
 }
 
+/* the nodes after one added or removed keep the URL numbers in order */
+static void url_renumber(struct getout *node, curl_off_t diff)
+{
+  for(; node; node = node->next)
+    node->num += diff;
+}
+
+static void url_drop(struct OperationConfig *config, struct getout *node)
+{
+  struct getout *prev = NULL;
+  struct getout **nodep = &config->url_list;
+
+  while(*nodep != node) {
+    prev = *nodep;
+    nodep = &prev->next;
+  }
+  *nodep = node->next;
+  if(config->url_last == node)
+    config->url_last = prev;
+  if(config->url_get == node)
+    config->url_get = NULL;
+  if(config->url_out == node)
+    config->url_out = NULL;
+  if(config->url_ul == node)
+    config->url_ul = NULL;
+  url_renumber(node->next, -1);
+  global->outnum--;
+  config->num_urls--;
+  tool_safefree(node->url);
+  tool_safefree(node->outfile);
+  tool_safefree(node->infile);
+  free(node);
+}
+
+/*
+ * A --url @file node is read as the transfers are created, but an output or
+ * upload option given for it goes with its next URL. That URL is read now
+ * into the node, the rest of the file goes on in a new node after it.
+ *
+ * Sets 'gone' when there is no URL left. A node with options of its own
+ * then gives them to the next URL given, otherwise it is dropped.
+ */
+static ParameterError url_file_split(struct OperationConfig *config,
+                                     struct getout *node, bool *gone)
+{
+  bool fromstdin = !strcmp("-", node->url);
+  FILE *file = fromstdin ? stdin : fopen(node->url, FOPEN_READTEXT);
+  struct getout *rest;
+  struct dynbuf line;
+  bool error = FALSE;
+  bool got = FALSE;
+  curl_off_t i;
+
+  *gone = FALSE;
+  if(!file) {
+    errorf("Failed to open %s", node->url);
+    return PARAM_READ_ERROR;
+  }
+  curlx_dyn_init(&line, 8092);
+  /* stdin goes on where it was, a file is read again from the start */
+  for(i = 0; i <= node->fileskip; i++) {
+    got = my_get_line(file, &line, &error);
+    if(!got)
+      break;
+  }
+  if(!fromstdin)
+    fclose(file);
+  if(error) {
+    curlx_dyn_free(&line);
+    return PARAM_READ_ERROR;
+  }
+  if(!got) {
+    curlx_dyn_free(&line);
+    *gone = TRUE;
+    if(node->outset || node->uploadset) {
+      tool_safefree(node->url);
+      node->urlset = node->fromfile = FALSE;
+      config->url_get = NULL;
+      config->num_urls--;
+    }
+    else
+      url_drop(config, node);
+    return PARAM_OK;
+  }
+
+  rest = calloc(1, sizeof(*rest));
+  if(!rest) {
+    curlx_dyn_free(&line);
+    return PARAM_NO_MEM;
+  }
+  rest->url = node->url;
+  node->url = strdup(curlx_dyn_ptr(&line));
+  curlx_dyn_free(&line);
+  if(!node->url) {
+    node->url = rest->url;
+    free(rest);
+    return PARAM_NO_MEM;
+  }
+  rest->urlset = rest->fromfile = TRUE;
+  rest->useremote = rest->noglob = TRUE;
+  rest->fileskip = fromstdin ? 0 : node->fileskip + 1;
+  rest->num = node->num + 1;
+  rest->next = node->next;
+  node->next = rest;
+  node->fromfile = FALSE;
+  node->fileskip = 0;
+  if(config->url_last == node)
+    config->url_last = rest;
+  url_renumber(rest->next, 1);
+  global->outnum++;
+  config->num_urls++;
+  return PARAM_OK;
+}
+
+/* the node the next output option, or upload option when 'upload' is set,
+   goes to: the first one not having one */
+static ParameterError option_node(struct OperationConfig *config,
+                                  bool upload, struct getout **nodep)
+{
+  struct getout **cursor = upload ? &config->url_ul : &config->url_out;
+
+  for(;;) {
+    struct getout *url;
+    ParameterError err;
+    bool gone;
+
+    if(!*cursor)
+      *cursor = config->url_list;
+    /* there is a node here, if it already is filled-in continue to find
+       an "empty" node */
+    while(*cursor && (upload ? (*cursor)->uploadset : (*cursor)->outset))
+      *cursor = (*cursor)->next;
+
+    /* now there might or might not be an available node to fill in! */
+
+    if(*cursor)
+      /* existing node */
+      url = *cursor;
+    else
+      /* there was no free node, create one! */
+      *cursor = url = new_getout(config);
+
+    if(!url)
+      return PARAM_NO_MEM;
+    if(!url->fromfile) {
+      *nodep = url;
+      return PARAM_OK;
+    }
+    err = url_file_split(config, url, &gone);
+    if(err)
+      return err;
+    if(!gone) {
+      *nodep = url;
+      return PARAM_OK;
+    }
+  }
+}
+
 static ParameterError add_url(struct OperationConfig *config,
                               const char *thisurl,
                               bool remote_noglob)
@@ -1083,33 +1263,31 @@ static ParameterError parse_url(struct OperationConfig *config,
 {
   /* nextarg is never NULL here */
   if(nextarg[0] == '@') {
-    /* read URLs from a file, treat all as -O */
-    struct dynbuf line;
-    ParameterError err = PARAM_OK;
-    bool error = FALSE;
-    bool fromstdin = !strcmp("-", &nextarg[1]);
-    FILE *f;
-
-    if(fromstdin)
-      f = stdin;
-    else
-      f = fopen(&nextarg[1], FOPEN_READTEXT);
-    if(f) {
-      curlx_dyn_init(&line, 8092);
-      while(my_get_line(f, &line, &error)) {
-        const char *ptr = curlx_dyn_ptr(&line);
-        err = add_url(config, ptr, TRUE);
-        if(err)
-          break;
-      }
-      if(!fromstdin)
-        fclose(f);
-      curlx_dyn_free(&line);
-      if(error || err)
-        return PARAM_READ_ERROR;
-      return PARAM_OK;
+    /* read URLs from a file, treat all as -O. The file is read as the
+       transfers are created, so only check that it is there. */
+    struct getout *node;
+    ParameterError err;
+    bool gone;
+    if(strcmp("-", &nextarg[1])) {
+      FILE *f = fopen(&nextarg[1], FOPEN_READTEXT);
+      if(!f)
+        return PARAM_READ_ERROR; /* file not found */
+      fclose(f);
+    }
+    else {
+      err = stdin_claim(TRUE);
+      if(err)
+        return err;
     }
-    return PARAM_READ_ERROR; /* file not found */
+    err = add_url(config, &nextarg[1], TRUE);
+    if(err)
+      return err;
+    node = config->url_get;
+    node->fromfile = TRUE;
+    if(node->outset || node->uploadset)
+      /* options given before it go with its first URL */
+      err = url_file_split(config, node, &gone);
+    return err;
   }
   return add_url(config, nextarg, FALSE);
 }
@@ -1202,6 +1380,9 @@ static ParameterError parse_ech(struct OperationConfig *config,
 
       nextarg += 5;        /* skip over 'ecl:@' */
       if(!strcmp("-", nextarg)) {
+        err = stdin_claim(FALSE);
+        if(err)
+          return err;
         file = stdin;
       }
       else {
@@ -1241,7 +1422,13 @@ static ParameterError parse_header(struct OperationConfig *config,
   if(nextarg[0] == '@') {
     /* read many headers from a file or stdin */
     bool use_stdin = !strcmp(&nextarg[1], "-");
-    FILE *file = use_stdin ? stdin : fopen(&nextarg[1], FOPEN_READTEXT);
+    FILE *file;
+    if(use_stdin) {
+      err = stdin_claim(FALSE);
+      if(err)
+        return err;
+    }
+    file = use_stdin ? stdin : fopen(&nextarg[1], FOPEN_READTEXT);
     if(!file) {
       errorf("Failed to open %s", &nextarg[1]);
       err = PARAM_READ_ERROR;
@@ -1277,31 +1464,13 @@ static ParameterError parse_header(struct OperationConfig *config,
 static ParameterError parse_output(struct OperationConfig *config,
                                    const char *nextarg)
 {
-  ParameterError err = PARAM_OK;
+  ParameterError err;
   struct getout *url;
 
   /* output file */
-  if(!config->url_out)
-    config->url_out = config->url_list;
-  if(config->url_out) {
-    /* there is a node here, if it already is filled-in continue to find
-       an "empty" node */
-    while(config->url_out && config->url_out->outset)
-      config->url_out = config->url_out->next;
-  }
-
-  /* now there might or might not be an available node to fill in! */
-
-  if(config->url_out)
-    /* existing node */
-    url = config->url_out;
-  else {
-    /* there was no free node, create one! */
-    config->url_out = url = new_getout(config);
-  }
-
-  if(!url)
-    return PARAM_NO_MEM;
+  err = option_node(config, FALSE, &url);
+  if(err)
+    return err;
 
   /* fill in the outfile */
   if(nextarg)
@@ -1324,27 +1493,9 @@ static ParameterError parse_remote_name(struct OperationConfig *config,
     return err; /* nothing to do */
 
   /* output file */
-  if(!config->url_out)
-    config->url_out = config->url_list;
-  if(config->url_out) {
-    /* there is a node here, if it already is filled-in continue to find
-       an "empty" node */
-    while(config->url_out && config->url_out->outset)
-      config->url_out = config->url_out->next;
-  }
-
-  /* now there might or might not be an available node to fill in! */
-
-  if(config->url_out)
-    /* existing node */
-    url = config->url_out;
-  else {
-    /* there was no free node, create one! */
-    config->url_out = url = new_getout(config);
-  }
-
-  if(!url)
-    return PARAM_NO_MEM;
+  err = option_node(config, FALSE, &url);
+  if(err)
+    return err;
 
   url->outfile = NULL; /* leave it */
   url->useremote = toggle;
@@ -1427,27 +1578,15 @@ static ParameterError parse_upload_file(struct OperationConfig *config,
   ParameterError err = PARAM_OK;
   struct getout *url;
 
-  /* we are uploading */
-  if(!config->url_ul)
-    config->url_ul = config->url_list;
-  if(config->url_ul) {
-    /* there is a node here, if it already is filled-in continue to find
-       an "empty" node */
-    while(config->url_ul && config->url_ul->uploadset)
-      config->url_ul = config->url_ul->next;
+  /* we are uploading, "-" and "." read stdin */
+  if(!strcmp(nextarg, "-") || !strcmp(nextarg, ".")) {
+    err = stdin_claim(FALSE);
+    if(err)
+      return err;
   }
-
-  /* now there might or might not be an available node to fill in! */
-
-  if(config->url_ul)
-    /* existing node */
-    url = config->url_ul;
-  else
-    /* there was no free node, create one! */
-    config->url_ul = url = new_getout(config);
-
-  if(!url)
-    return PARAM_NO_MEM;
+  err = option_node(config, TRUE, &url);
+  if(err)
+    return err;
 
   url->uploadset = TRUE; /* mark -T used */
   if(!*nextarg)
@@ -1459,7 +1598,7 @@ static ParameterError parse_upload_file(struct OperationConfig *config,
   return err;
 }
 
-static size_t verbose_nopts;
+static TOOL_THREAD_LOCAL size_t verbose_nopts;
 
 static ParameterError parse_verbose(bool toggle)
 {
@@ -1530,6 +1669,9 @@ static ParameterError parse_writeout(struct OperationConfig *config,
     const char *fname;
     nextarg++; /* pass the @ */
     if(!strcmp("-", nextarg)) {
+      err = stdin_claim(FALSE);
+      if(err)
+        return err;
       fname = "<stdin>";
       file = stdin;
     }
@@ -1953,6 +2095,14 @@ static ParameterError opt_bool(struct OperationConfig *config,
   case C_TRACE_IDS: /* --trace-ids */
     global->traceids = toggle;
     break;
+  case C_TRACE_ASYNC: /* --trace-async */
+#ifndef USE_TRACE_RING
+    if(toggle)
+      warnf("--trace-async needs thread support, tracing directly");
+#else
+    global->trace_async = toggle;
+#endif
+    break;
   case C_PROGRESS_METER: /* --progress-meter */
     global->noprogress = !toggle;
     break;
@@ -2125,6 +2275,9 @@ static ParameterError opt_bool(struct OperationConfig *config,
   case C_SKIP_EXISTING: /* --skip-existing */
     config->skip_existing = toggle;
     break;
+  case C_DEDUPE: /* --dedupe */
+    config->dedupe = toggle;
+    break;
   case C_SHOW_ERROR: /* --show-error */
     global->showerror = toggle;
     break;
@@ -2138,6 +2291,16 @@ static ParameterError opt_bool(struct OperationConfig *config,
   case C_PARALLEL: /* --parallel */
     global->parallel = toggle;
     break;
+  case C_PARALLEL_ADAPTIVE: /* --parallel-adaptive */
+    global->parallel_adaptive = toggle;
+    break;
+  case C_IO_URING: /* --io-uring */
+#ifndef USE_IO_URING
+    if(toggle)
+      warnf("--io-uring is not supported in this build");
+#endif
+    global->io_uring = toggle;
+    break;
   case C_PARALLEL_IMMEDIATE:   /* --parallel-immediate */
     global->parallel_connect = toggle;
     break;
@@ -2243,6 +2406,14 @@ static ParameterError opt_filestring(struct OperationConfig *config,
       global->tracetype = TRACE_ASCII;
     }
     break;
+  case C_TRACE_RAW: /* --trace-raw */
+    err = getstr(&global->trace_dump, nextarg, DENY_BLANK);
+    if(!err) {
+      if(global->tracetype && (global->tracetype != TRACE_RAW))
+        warnf("--trace-raw overrides an earlier trace/verbose option");
+      global->tracetype = TRACE_RAW;
+    }
+    break;
   case C_LIMIT_RATE: /* --limit-rate */
     err = GetSizeParameter(nextarg, "rate", &value);
     if(!err) {
@@ -2251,7 +2422,7 @@ static ParameterError opt_filestring(struct OperationConfig *config,
     }
     break;
   case C_RATE:
-    err = set_rate(nextarg);
+    err = set_rate(nextarg, "rate", &global->ms_per_transfer);
     break;
   case C_CREATE_FILE_MODE: /* --create-file-mode */
     err = oct2nummax(&config->create_file_mode, nextarg, 0777);
@@ -2340,6 +2511,31 @@ static ParameterError opt_filestring(struct OperationConfig *config,
   case C_RETRY_MAX_TIME: /* --retry-max-time */
     err = secs2ms(&config->retry_maxtime_ms, nextarg);
     break;
+  case C_OUTPUT_BUFFER: /* --output-buffer */
+    err = GetSizeParameter(nextarg, "output-buffer", &value);
+    if(!err) {
+#ifndef USE_OUTPUT_BUFFER
+      warnf("--output-buffer is not supported on this platform");
+#endif
+      config->output_buffer = (value > MAX_OUTPUT_BUFFER) ?
+        MAX_OUTPUT_BUFFER : value;
+    }
+    break;
+  case C_OUTPUT_SYNC: /* --output-sync */
+    if(curl_strequal("none", nextarg))
+      config->output_sync = OUTPUT_SYNC_NONE;
+    else if(curl_strequal("data", nextarg))
+      config->output_sync = OUTPUT_SYNC_DATA;
+    else if(curl_strequal("direct", nextarg))
+      config->output_sync = OUTPUT_SYNC_DIRECT;
+    else
+      err = PARAM_BAD_USE;
+    break;
+  case C_SEGMENTS: /* --segments */
+    err = str2unum(&config->segments, nextarg);
+    if(!err && (config->segments > MAX_SEGMENTS))
+      config->segments = MAX_SEGMENTS;
+    break;
   case C_FTP_ACCOUNT: /* --ftp-account */
     err = getstr(&config->ftp_account, nextarg, DENY_BLANK);
     break;
@@ -2710,6 +2906,9 @@ static ParameterError opt_filestring(struct OperationConfig *config,
   case C_OUTPUT_DIR: /* --output-dir */
     err = getstr(&config->output_dir, nextarg, DENY_BLANK);
     break;
+  case C_CACHE_DIR: /* --cache-dir */
+    err = getstr(&config->cache_dir, nextarg, DENY_BLANK);
+    break;
   case C_OUTPUT: /* --output */
     err = parse_output(config, nextarg);
     break;
@@ -2786,6 +2985,10 @@ static ParameterError opt_filestring(struct OperationConfig *config,
       global->parallel_host = (unsigned short)val;
     break;
     break;
+  case C_PARALLEL_HOST_RATE: /* --parallel-host-rate */
+    err = set_rate(nextarg, "parallel-host-rate",
+                   &global->host_ms_per_transfer);
+    break;
   case C_PARALLEL_MAX:  /* --parallel-max */
     err = str2unum(&val, nextarg);
     if(err)
@@ -2797,6 +3000,31 @@ static ParameterError opt_filestring(struct OperationConfig *config,
     else
       global->parallel_max = (unsigned short)val;
     break;
+  case C_PARALLEL_THREADS: /* --parallel-threads */
+    err = str2unum(&val, nextarg);
+    if(err)
+      break;
+#ifndef USE_PARALLEL_THREADS
+    if(val > 1)
+      warnf("--parallel-threads needs thread support, using one thread");
+    val = 1;
+#endif
+    if(val > MAX_PARALLEL_THREADS)
+      global->parallel_threads = MAX_PARALLEL_THREADS;
+    else if(val < 1)
+      global->parallel_threads = 1;
+    else
+      global->parallel_threads = (unsigned short)val;
+    break;
+  case C_PROGRESS_FD: /* --progress-fd */
+    err = str2unum(&val, nextarg);
+    if(err)
+      break;
+    if(val > INT_MAX)
+      err = PARAM_NUMBER_TOO_LARGE;
+    else
+      global->progress_fd = (int)val;
+    break;
   case C_TIME_COND: /* --time-cond */
     err = parse_time_cond(config, nextarg);
     break;
@@ -39,6 +39,7 @@ typedef enum {
   C_BUFFER,
   C_CA_NATIVE,
   C_CACERT,
+  C_CACHE_DIR,
   C_CAPATH,
   C_CERT,
   C_CERT_STATUS,
@@ -63,6 +64,7 @@ typedef enum {
   C_DATA_BINARY,
   C_DATA_RAW,
   C_DATA_URLENCODE,
+  C_DEDUPE,
   C_DELEGATION,
   C_DIGEST,
   C_DISABLE,
@@ -129,6 +131,7 @@ typedef enum {
   C_INCLUDE,
   C_INSECURE,
   C_INTERFACE,
+  C_IO_URING,
   C_IPFS_GATEWAY,
   C_IPV4,
   C_IPV6,
@@ -170,11 +173,16 @@ typedef enum {
   C_OAUTH2_BEARER,
   C_OUT_NULL,
   C_OUTPUT,
+  C_OUTPUT_BUFFER,
   C_OUTPUT_DIR,
+  C_OUTPUT_SYNC,
   C_PARALLEL,
+  C_PARALLEL_ADAPTIVE,
   C_PARALLEL_HOST,
+  C_PARALLEL_HOST_RATE,
   C_PARALLEL_IMMEDIATE,
   C_PARALLEL_MAX,
+  C_PARALLEL_THREADS,
   C_PASS,
   C_PATH_AS_IS,
   C_PINNEDPUBKEY,
@@ -183,6 +191,7 @@ typedef enum {
   C_POST303,
   C_PREPROXY,
   C_PROGRESS_BAR,
+  C_PROGRESS_FD,
   C_PROGRESS_METER,
   C_PROTO,
   C_PROTO_DEFAULT,
@@ -240,6 +249,7 @@ typedef enum {
   C_RETRY_MAX_TIME,
   C_SASL_AUTHZID,
   C_SASL_IR,
+  C_SEGMENTS,
   C_SERVICE_NAME,
   C_SESSIONID,
   C_SHOW_ERROR,
@@ -291,8 +301,10 @@ typedef enum {
   C_TR_ENCODING,
   C_TRACE,
   C_TRACE_ASCII,
+  C_TRACE_ASYNC,
   C_TRACE_CONFIG,
   C_TRACE_IDS,
+  C_TRACE_RAW,
   C_TRACE_TIME,
   C_IP_TOS,
   C_UNIX_SOCKET,
@@ -57,6 +57,9 @@ const struct helptxt helptext[] = {
   {"    --cacert <file>",
    "CA certificate to verify peer against",
    CURLHELP_TLS},
+  {"    --cache-dir <dir>",
+   "Keep and revalidate HTTP responses in dir",
+   CURLHELP_HTTP | CURLHELP_CURL},
   {"    --capath <dir>",
    "CA directory to verify peer against",
    CURLHELP_TLS},
@@ -126,6 +129,9 @@ const struct helptxt helptext[] = {
   {"    --data-urlencode <data>",
    "HTTP POST data URL encoded",
    CURLHELP_HTTP | CURLHELP_POST | CURLHELP_UPLOAD},
+  {"    --dedupe",
+   "Make one request for duplicate URLs",
+   CURLHELP_CURL | CURLHELP_OUTPUT},
   {"    --delegation <LEVEL>",
    "GSS-API delegation permission",
    CURLHELP_AUTH},
@@ -311,6 +317,9 @@ const struct helptxt helptext[] = {
   {"    --interface <name>",
    "Use network interface",
    CURLHELP_CONNECTION},
+  {"    --io-uring",
+   "Queue file reads and writes to io_uring",
+   CURLHELP_OUTPUT | CURLHELP_CURL | CURLHELP_GLOBAL},
   {"    --ip-tos <string>",
    "Set IP Type of Service or Traffic Class",
    CURLHELP_CONNECTION},
@@ -451,12 +460,24 @@ const struct helptxt helptext[] = {
   {"-o, --output <file>",
    "Write to file instead of stdout",
    CURLHELP_IMPORTANT | CURLHELP_OUTPUT},
+  {"    --output-buffer <size>",
+   "Write files in chunks of this size",
+   CURLHELP_OUTPUT},
   {"    --output-dir <dir>",
    "Directory to save files in",
    CURLHELP_OUTPUT},
+  {"    --output-sync <mode>",
+   "Flush files to disk: none, data or direct",
+   CURLHELP_OUTPUT},
   {"-Z, --parallel",
    "Perform transfers in parallel",
    CURLHELP_CONNECTION | CURLHELP_CURL | CURLHELP_GLOBAL},
+  {"    --parallel-adaptive",
+   "Back off hosts that ask for it",
+   CURLHELP_CONNECTION | CURLHELP_CURL | CURLHELP_GLOBAL},
+  {"    --parallel-host-rate <max request rate>",
+   "Request rate for each host in parallel transfers",
+   CURLHELP_CONNECTION | CURLHELP_CURL | CURLHELP_GLOBAL},
   {"    --parallel-immediate",
    "Do not wait for multiplexing",
    CURLHELP_CONNECTION | CURLHELP_CURL | CURLHELP_GLOBAL},
@@ -466,6 +487,9 @@ const struct helptxt helptext[] = {
   {"    --parallel-max-host <num>",
    "Maximum connections to a single host",
    CURLHELP_CONNECTION | CURLHELP_CURL | CURLHELP_GLOBAL},
+  {"    --parallel-threads <num>",
+   "Threads to run parallel transfers in",
+   CURLHELP_CONNECTION | CURLHELP_CURL | CURLHELP_GLOBAL},
   {"    --pass <phrase>",
    "Passphrase for the private key",
    CURLHELP_SSH | CURLHELP_TLS | CURLHELP_AUTH},
@@ -490,6 +514,9 @@ const struct helptxt helptext[] = {
   {"-#, --progress-bar",
    "Display transfer progress as a bar",
    CURLHELP_VERBOSE | CURLHELP_GLOBAL},
+  {"    --progress-fd <fd>",
+   "Write parallel progress as JSON lines to fd",
+   CURLHELP_VERBOSE | CURLHELP_CURL | CURLHELP_GLOBAL},
   {"    --proto <protocols>",
    "Enable/disable PROTOCOLS",
    CURLHELP_CONNECTION | CURLHELP_CURL},
@@ -605,7 +632,7 @@ const struct helptxt helptext[] = {
    "Retrieve only the bytes within RANGE",
    CURLHELP_HTTP | CURLHELP_FTP | CURLHELP_SFTP | CURLHELP_FILE},
   {"    --rate <max request rate>",
-   "Request rate for serial transfers",
+   "Request rate for transfers",
    CURLHELP_CONNECTION | CURLHELP_GLOBAL},
   {"    --raw",
    "Do HTTP raw; no transfer decoding",
@@ -659,6 +686,9 @@ const struct helptxt helptext[] = {
   {"    --sasl-ir",
    "Initial response in SASL authentication",
    CURLHELP_AUTH},
+  {"    --segments <num>",
+   "Download a file in this many parts at once",
+   CURLHELP_HTTP | CURLHELP_OUTPUT},
   {"    --service-name <name>",
    "SPNEGO service name",
    CURLHELP_AUTH},
@@ -805,12 +835,18 @@ const struct helptxt helptext[] = {
   {"    --trace-ascii <file>",
    "Like --trace, but without hex output",
    CURLHELP_VERBOSE | CURLHELP_GLOBAL},
+  {"    --trace-async",
+   "Write the trace from a thread of its own",
+   CURLHELP_VERBOSE | CURLHELP_GLOBAL},
   {"    --trace-config <string>",
    "Details to log in trace/verbose output",
    CURLHELP_VERBOSE | CURLHELP_GLOBAL},
   {"    --trace-ids",
    "Transfer + connection ids in verbose output",
    CURLHELP_VERBOSE | CURLHELP_GLOBAL},
+  {"    --trace-raw <file>",
+   "Write the trace events in binary to FILE",
+   CURLHELP_VERBOSE | CURLHELP_GLOBAL},
   {"    --trace-time",
    "Add time stamps to trace/verbose output",
    CURLHELP_VERBOSE | CURLHELP_GLOBAL},
@@ -211,6 +211,12 @@ int main(int argc, char *argv[])
   /* Initialize memory tracking */
   memory_tracking_init();
 
+#ifdef HAVE_SETLOCALE
+  /* Override locale for number parsing (only) */
+  setlocale(LC_ALL, "");
+  setlocale(LC_NUMERIC, "C");
+#endif
+
   /* Initialize the curl library - do not call any libcurl functions before
      this point */
   result = globalconf_init();
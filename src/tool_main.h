@@ -33,7 +33,19 @@
 #define MAX_PARALLEL 65535
 #define PARALLEL_DEFAULT 50
 
+#define MAX_PARALLEL_THREADS 256
+
 #define MAX_PARALLEL_HOST 65535
 #define PARALLEL_HOST_DEFAULT 0 /* means not used */
 
+#define MAX_SEGMENTS 64
+#define SEGMENT_MIN (64*1024) /* no --segments part gets smaller */
+
+#define MAX_OUTPUT_BUFFER (256*1024*1024)
+
+#if defined(_UNICODE) && !defined(UNDER_CE)
+int convert_argv_to_wargv(int argc, char *argv[], wchar_t ***wargv_out);
+void free_wargv(int argc, wchar_t **wargv);
+#endif
+
 #endif /* HEADER_CURL_TOOL_MAIN_H */
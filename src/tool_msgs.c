@@ -28,18 +28,27 @@
 #include "tool_cb_prg.h"
 #include "terminal.h"
 
-#include "curl_capture.h"
-
 #include "memdebug.h" /* keep this as LAST include */
 
 #define WARN_PREFIX "Warning: "
 #define NOTE_PREFIX "Note: "
 #define ERROR_PREFIX "curl: "
 
-static struct CaptureBuffer *capture_err = NULL;
+static void verrprintf(const char *fmt, va_list ap) CURL_PRINTF(1, 0);
 
-void set_stderr_capture_buffer(struct CaptureBuffer *buffer) {
-  capture_err = buffer;
+/* Write to stderr, or to the caller's sink when embedded */
+static void verrprintf(const char *fmt, va_list ap)
+{
+  if(global->io.err) {
+    char *msg = vaprintf(fmt, ap);
+    if(msg) {
+      (void)tool_sink_call(global->io.err, global->io.err_userp,
+                           msg, strlen(msg));
+      curl_free(msg);
+    }
+  }
+  else
+    vfprintf(tool_stderr, fmt, ap);
 }
 
 static void voutf(const char *prefix,
@@ -62,8 +71,16 @@ static void voutf(const char *prefix,
       return;
     len = strlen(print_buffer);
 
-    /* CaptureBuffer Hack */
-    if(capture_err) capture_append(capture_err, print_buffer, len);
+    if(global->io.err) {
+      /* the sink gets the message unwrapped, in a single chunk */
+      char *msg = aprintf("%s%s\n", prefix, print_buffer);
+      if(msg) {
+        (void)tool_sink_call(global->io.err, global->io.err_userp,
+                           msg, strlen(msg));
+        curl_free(msg);
+      }
+      len = 0;
+    }
 
     ptr = print_buffer;
     while(len > 0) {
@@ -128,18 +145,21 @@ void helpf(const char *fmt, ...)
 {
   if(fmt) {
     va_list ap;
+    char *msg;
     va_start(ap, fmt);
     DEBUGASSERT(!strchr(fmt, '\n'));
-    fputs("curl: ", tool_stderr); /* prefix it */
-    vfprintf(tool_stderr, fmt, ap);
+    msg = vaprintf(fmt, ap);
     va_end(ap);
-    fputs("\n", tool_stderr); /* newline it */
+    if(msg) {
+      errprintf("curl: %s\n", msg); /* prefix and newline it */
+      curl_free(msg);
+    }
   }
-  fprintf(tool_stderr, "curl: try 'curl --help' "
+  errprintf("curl: try 'curl --help' "
 #ifdef USE_MANUAL
-          "or 'curl --manual' "
+            "or 'curl --manual' "
 #endif
-          "for more information\n");
+            "for more information\n");
 }
 
 /*
@@ -155,3 +175,14 @@ void errorf(const char *fmt, ...)
     va_end(ap);
   }
 }
+
+/*
+ * Emit a formatted message on the error stream as is.
+ */
+void errprintf(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  verrprintf(fmt, ap);
+  va_end(ap);
+}
@@ -34,5 +34,7 @@ void helpf(const char *fmt, ...)
   CURL_PRINTF(1, 2);
 void errorf(const char *fmt, ...)
   CURL_PRINTF(1, 2);
+void errprintf(const char *fmt, ...)
+  CURL_PRINTF(1, 2);
 
 #endif /* HEADER_CURL_TOOL_MSGS_H */
@@ -27,10 +27,6 @@
 #  include <fcntl.h>
 #endif
 
-#ifdef HAVE_LOCALE_H
-#  include <locale.h>
-#endif
-
 #ifdef HAVE_SYS_SELECT_H
 #  include <sys/select.h>
 #elif defined(HAVE_UNISTD_H)
@@ -49,12 +45,25 @@
 #  include <netinet/in.h>
 #endif
 
+#ifdef USE_PARALLEL_THREADS
+#  ifdef USE_THREADS_POSIX
+#    include <pthread.h>
+#  elif !defined(CURL_WINDOWS_UWP) && !defined(UNDER_CE)
+#    include <process.h>
+#  endif
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #ifdef HAVE_UV_H
 /* this is for libuv-enabled debug builds only */
 #include <uv.h>
 #endif
 
 #include "tool_cfgable.h"
+#include "tool_cache.h"
 #include "tool_cb_dbg.h"
 #include "tool_cb_hdr.h"
 #include "tool_cb_prg.h"
@@ -62,6 +71,7 @@
 #include "tool_cb_see.h"
 #include "tool_cb_soc.h"
 #include "tool_cb_wrt.h"
+#include "tool_dedupe.h"
 #include "tool_dirhie.h"
 #include "tool_doswin.h"
 #include "tool_easysrc.h"
@@ -86,6 +96,8 @@
 #include "tool_help.h"
 #include "tool_hugehelp.h"
 #include "tool_progress.h"
+#include "tool_ratelimit.h"
+#include "tool_runner.h"
 #include "tool_ipfs.h"
 #include "config2setopts.h"
 
@@ -200,8 +212,65 @@ static curl_off_t VmsSpecialSize(const char *name,
 }
 #endif /* __VMS */
 
-struct per_transfer *transfers; /* first node */
-static struct per_transfer *transfersl; /* last node */
+/* The ready queue has the parallel transfers that wait to get added, in the
+   order they are to be added. */
+static void ready_append(struct per_transfer *per)
+{
+  DEBUGASSERT(!per->queued);
+  per->rnext = NULL;
+  per->rprev = global->readyl;
+  if(global->readyl)
+    global->readyl->rnext = per;
+  else
+    global->ready = per;
+  global->readyl = per;
+  global->nready++;
+  per->queued = TRUE;
+}
+
+/* for a retry, it goes before the ones never started but after the retries
+   queued with an earlier or the same startat */
+static void ready_retry(struct per_transfer *per)
+{
+  struct per_transfer *prev = NULL;
+  struct per_transfer *next = global->ready;
+
+  DEBUGASSERT(!per->queued);
+  while(next && next->retry && (next->startat <= per->startat)) {
+    prev = next;
+    next = next->rnext;
+  }
+  per->rprev = prev;
+  per->rnext = next;
+  if(prev)
+    prev->rnext = per;
+  else
+    global->ready = per;
+  if(next)
+    next->rprev = per;
+  else
+    global->readyl = per;
+  global->nready++;
+  per->queued = TRUE;
+  per->retry = TRUE;
+}
+
+static void ready_remove(struct per_transfer *per)
+{
+  DEBUGASSERT(per->queued);
+  if(per->rprev)
+    per->rprev->rnext = per->rnext;
+  else
+    global->ready = per->rnext;
+  if(per->rnext)
+    per->rnext->rprev = per->rprev;
+  else
+    global->readyl = per->rprev;
+  per->rnext = per->rprev = NULL;
+  global->nready--;
+  per->queued = FALSE;
+  per->retry = FALSE;
+}
 
 /* add_per_transfer creates a new 'per_transfer' node in the linked
    list of transfers */
@@ -211,17 +280,21 @@ static CURLcode add_per_transfer(struct per_transfer **per)
   p = calloc(1, sizeof(struct per_transfer));
   if(!p)
     return CURLE_OUT_OF_MEMORY;
-  if(!transfers)
+  if(!global->transfers)
     /* first entry */
-    transfersl = transfers = p;
+    global->transfersl = global->transfers = p;
   else {
     /* make the last node point to the new node */
-    transfersl->next = p;
+    global->transfersl->next = p;
     /* make the new node point back to the formerly last node */
-    p->prev = transfersl;
+    p->prev = global->transfersl;
     /* move the last node pointer to the new entry */
-    transfersl = p;
+    global->transfersl = p;
   }
+  p->num = global->num_transfers++;
+  progress_add(p);
+  if(global->parallel)
+    ready_append(p);
   *per = p;
 
   return CURLE_OK;
@@ -233,8 +306,8 @@ static struct per_transfer *del_per_transfer(struct per_transfer *per)
 {
   struct per_transfer *n;
   struct per_transfer *p;
-  DEBUGASSERT(transfers);
-  DEBUGASSERT(transfersl);
+  DEBUGASSERT(global->transfers);
+  DEBUGASSERT(global->transfersl);
   DEBUGASSERT(per);
 
   n = per->next;
@@ -243,12 +316,22 @@ static struct per_transfer *del_per_transfer(struct per_transfer *per)
   if(p)
     p->next = n;
   else
-    transfers = n;
+    global->transfers = n;
 
   if(n)
     n->prev = p;
   else
-    transfersl = p;
+    global->transfersl = p;
+
+  if(per->queued)
+    ready_remove(per);
+  progress_remove(per);
+
+  capture_free(&per->body);
+  curl_slist_free_all(per->resumeheaders);
+  cache_free(per);
+  dedupe_forget(per);
+  free(per->outs.wmem);
 
   free(per);
 
@@ -324,12 +407,74 @@ static CURLcode pre_transfer(struct per_transfer *per)
 
     if(uploadfilesize != -1)
       my_setopt_offt(per->curl, CURLOPT_INFILESIZE_LARGE, uploadfilesize);
+
+#ifdef HAVE_SYS_SENDFILE_H
+    /* With the default read function on a FILE, libcurl has the system send
+       a plain file straight from the page cache when the connection allows
+       it. The read callback adds nothing for a file of a known size. */
+    if((uploadfilesize != -1) && !global->libcurl && !global->io_uring) {
+      per->infile = fdopen(per->infd, "rb");
+      if(per->infile) {
+        (void)curl_easy_setopt(per->curl, CURLOPT_READFUNCTION, NULL);
+        (void)curl_easy_setopt(per->curl, CURLOPT_READDATA, per->infile);
+      }
+    }
+#endif
   }
   per->uploadfilesize = uploadfilesize;
   per->start = curlx_now();
   return result;
 }
 
+static void url_file_close(struct State *state)
+{
+  if(state->urlfile) {
+    if(state->urlfile != stdin)
+      fclose(state->urlfile);
+    state->urlfile = NULL;
+    state->urlfilenum = 0;
+    curlx_dyn_free(&state->urlline);
+  }
+}
+
+/* Get the next URL from a --url @file into state->urlline. Reading one line
+   at a time keeps the memory use flat no matter how many URLs there are. */
+static CURLcode url_file_next(struct State *state, struct getout *u,
+                              bool *eof)
+{
+  bool error = FALSE;
+  *eof = FALSE;
+  if(!state->urlfile) {
+    curl_off_t skip = u->fileskip;
+    if(!strcmp("-", u->url))
+      state->urlfile = stdin;
+    else {
+      state->urlfile = fopen(u->url, FOPEN_READTEXT);
+      if(!state->urlfile) {
+        errorf("cannot read URLs from %s", u->url);
+        return CURLE_READ_ERROR;
+      }
+    }
+    curlx_dyn_init(&state->urlline, 8092);
+    /* the URLs the options were split off for have nodes of their own */
+    for(; skip > 0; skip--) {
+      if(!my_get_line(state->urlfile, &state->urlline, &error))
+        break;
+    }
+  }
+  if(error || !my_get_line(state->urlfile, &state->urlline, &error)) {
+    /* the URLs after this node are numbered after the ones in the file */
+    state->urlnumoff += state->urlfilenum - 1;
+    url_file_close(state);
+    if(error)
+      return CURLE_READ_ERROR;
+    *eof = TRUE;
+  }
+  else
+    state->urlfilenum++;
+  return CURLE_OK;
+}
+
 void single_transfer_cleanup(void)
 {
   struct State *state = &global->state;
@@ -338,6 +483,92 @@ void single_transfer_cleanup(void)
   tool_safefree(state->uploadfile);
   /* Free list of globbed upload files */
   glob_cleanup(&state->inglob);
+  url_file_close(state);
+}
+
+/* Make the next attempt of a failed download ask only for the part that is
+   missing, when the server does ranges and sent a validator. With If-Range,
+   the server sends all of it again if it has changed. */
+static bool retry_resume(struct OperationConfig *config,
+                         struct per_transfer *per)
+{
+  struct OutStruct *outs = &per->outs;
+  struct curl_header *h;
+  struct curl_slist *list = NULL;
+  struct curl_slist *item;
+  char *ifrange = NULL;
+  long code = 0;
+
+  if(config->range || config->show_headers || config->encoding ||
+     config->tr_encoding || per->uploadfile || !outs->s_isreg ||
+     !outs->fopened)
+    return FALSE;
+
+  curl_easy_getinfo(per->curl, CURLINFO_RESPONSE_CODE, &code);
+  if(code == 200) {
+    if(curl_easy_header(per->curl, "Accept-Ranges", 0, CURLH_HEADER, -1,
+                        &h) || !curl_strequal(h->value, "bytes"))
+      return FALSE;
+  }
+  else if(code != 206)
+    return FALSE;
+
+  /* a weak ETag cannot be used in If-Range */
+  if(!curl_easy_header(per->curl, "ETag", 0, CURLH_HEADER, -1, &h) &&
+     strncmp(h->value, "W/", 2))
+    ifrange = aprintf("If-Range: %s", h->value);
+  else if(!curl_easy_header(per->curl, "Last-Modified", 0, CURLH_HEADER, -1,
+                            &h))
+    ifrange = aprintf("If-Range: %s", h->value);
+  if(!ifrange)
+    return FALSE;
+
+  for(item = config->headers; item; item = item->next) {
+    struct curl_slist *nlist = curl_slist_append(list, item->data);
+    if(!nlist)
+      break;
+    list = nlist;
+  }
+  if(!item) {
+    struct curl_slist *nlist = curl_slist_append(list, ifrange);
+    if(nlist)
+      list = nlist;
+    else
+      item = config->headers; /* failed */
+  }
+  free(ifrange);
+  if(item) {
+    curl_slist_free_all(list);
+    return FALSE;
+  }
+
+  if(!tool_outs_flush(outs) || fflush(outs->stream)) {
+    curl_slist_free_all(list);
+    return FALSE;
+  }
+  curl_slist_free_all(per->resumeheaders);
+  per->resumeheaders = list;
+  (void)curl_easy_setopt(per->curl, CURLOPT_HTTPHEADER, list);
+  (void)curl_easy_setopt(per->curl, CURLOPT_RESUME_FROM_LARGE,
+                         outs->init + outs->bytes);
+  per->resumed = TRUE;
+  notef("Resuming at %" CURL_FORMAT_CURL_OFF_T " bytes",
+        outs->init + outs->bytes);
+  return TRUE;
+}
+
+/* The next attempt gets all of it again */
+static void retry_restart(struct per_transfer *per)
+{
+  if(per->resumed) {
+    (void)curl_easy_setopt(per->curl, CURLOPT_HTTPHEADER,
+                           per->config->headers);
+    (void)curl_easy_setopt(per->curl, CURLOPT_RESUME_FROM_LARGE,
+                           per->outs.init);
+    curl_slist_free_all(per->resumeheaders);
+    per->resumeheaders = NULL;
+    per->resumed = FALSE;
+  }
 }
 
 static CURLcode retrycheck(struct OperationConfig *config,
@@ -355,10 +586,15 @@ static CURLcode retrycheck(struct OperationConfig *config,
     RETRY_CONNREFUSED,
     RETRY_HTTP,
     RETRY_FTP,
+    RETRY_CHANGED,
     RETRY_LAST /* not used */
   } retry = RETRY_NO;
   long response = 0;
-  if((CURLE_OPERATION_TIMEDOUT == result) ||
+  if(per->resumed && (CURLE_RANGE_ERROR == result))
+    /* If-Range did not match, the resource changed since the attempt this
+       one continued */
+    retry = RETRY_CHANGED;
+  else if((CURLE_OPERATION_TIMEDOUT == result) ||
      (CURLE_COULDNT_RESOLVE_HOST == result) ||
      (CURLE_COULDNT_RESOLVE_PROXY == result) ||
      (CURLE_FTP_ACCEPT_TIMEOUT == result))
@@ -434,10 +670,11 @@ static CURLcode retrycheck(struct OperationConfig *config,
       ": timeout",
       ": connection refused",
       ": HTTP error",
-      ": FTP error"
+      ": FTP error",
+      ": resource changed"
     };
 
-    sleeptime = per->retry_sleep;
+    sleeptime = (RETRY_CHANGED == retry) ? 0 : per->retry_sleep;
     if(RETRY_HTTP == retry) {
       curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after);
       if(retry_after) {
@@ -479,7 +716,14 @@ static CURLcode retrycheck(struct OperationConfig *config,
         per->retry_sleep = RETRY_SLEEP_MAX;
     }
 
-    if(outs->bytes && outs->filename && outs->stream) {
+    if(outs->segment)
+      /* a part of --segments writes its range again from the start */
+      outs->bytes = 0;
+    else if(outs->bytes && outs->filename && outs->stream &&
+            (RETRY_HTTP != retry) && (RETRY_CHANGED != retry) &&
+            retry_resume(config, per))
+      ; /* the next attempt continues where this one stopped */
+    else if(outs->bytes && outs->filename && outs->stream) {
 #ifndef __MINGW32CE__
       struct_stat fileinfo;
 
@@ -493,7 +737,10 @@ static CURLcode retrycheck(struct OperationConfig *config,
       {
         int rc;
         /* We have written data to an output file, we truncate file */
+        outs->wlen = 0; /* and the --output-buffer is thrown away */
+        outs->prealloc = 0;
         fflush(outs->stream);
+        retry_restart(per);
         notef("Throwing away %"  CURL_FORMAT_CURL_OFF_T " bytes",
               outs->bytes);
         /* truncate file at the position where we started appending */
@@ -530,6 +777,233 @@ static CURLcode retrycheck(struct OperationConfig *config,
   return result;
 }
 
+static size_t segment_discard(char *ptr, size_t size, size_t nmemb,
+                              void *userdata)
+{
+  (void)ptr;
+  (void)userdata;
+  return size * nmemb;
+}
+
+/* --segments: the transfer is first a HEAD request asking for all of the
+   file as a range, to find out its size. The download is split up when that
+   is done, in segment_split(). */
+static CURLcode segment_setup(CURLSH *share, struct per_transfer *per)
+{
+  per->segs = calloc(1, sizeof(struct segments));
+  if(!per->segs)
+    return CURLE_OUT_OF_MEMORY;
+  per->segs->share = share;
+  per->segs->refs = 1;
+  per->segprobe = TRUE;
+  (void)curl_easy_setopt(per->curl, CURLOPT_NOBODY, 1L);
+  (void)curl_easy_setopt(per->curl, CURLOPT_RANGE, "0-");
+  (void)curl_easy_setopt(per->curl, CURLOPT_NOPROGRESS, 1L);
+  (void)curl_easy_setopt(per->curl, CURLOPT_HEADERFUNCTION, segment_discard);
+  (void)curl_easy_setopt(per->curl, CURLOPT_WRITEFUNCTION, segment_discard);
+  return CURLE_OK;
+}
+
+/* The size of the resource to download in segments, or -1 if the server
+   cannot send it in parts, from the response to the HEAD request */
+static curl_off_t segment_size(CURL *curl, long code)
+{
+  curl_off_t size = -1;
+  struct curl_header *h;
+
+  if(code == 206) {
+    /* Content-Range: bytes 0-N/SIZE */
+    if(!curl_easy_header(curl, "Content-Range", 0, CURLH_HEADER, -1, &h)) {
+      const char *p = strchr(h->value, '/');
+      curl_off_t num;
+      if(p) {
+        p++;
+        if(!curlx_str_number(&p, &num, CURL_OFF_T_MAX))
+          size = num;
+      }
+    }
+    else
+      curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+  }
+  else if((code == 200) &&
+          !curl_easy_header(curl, "Accept-Ranges", 0, CURLH_HEADER, -1,
+                            &h) &&
+          curl_strequal(h->value, "bytes"))
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+
+  return size;
+}
+
+/* store a copy of the header from the response to the HEAD request, the
+   parts check that they get the same */
+static CURLcode segment_header(CURL *curl, const char *name, char **valuep)
+{
+  struct curl_header *h;
+  if(!curl_easy_header(curl, name, 0, CURLH_HEADER, -1, &h)) {
+    *valuep = strdup(h->value);
+    if(!*valuep)
+      return CURLE_OUT_OF_MEMORY;
+  }
+  return CURLE_OK;
+}
+
+/* forget a part of a --segments download that does not get started */
+static void segment_drop(struct per_transfer *seg)
+{
+  seg->segs->refs--;
+  curl_easy_cleanup(seg->curl);
+  free(seg->url);
+  free(seg->outfile);
+  (void)del_per_transfer(seg);
+}
+
+/* another part of the download of 'first', a transfer of its own */
+static CURLcode segment_add(struct per_transfer *first,
+                            struct per_transfer **segp)
+{
+  struct OperationConfig *config = first->config;
+  struct per_transfer *seg;
+  CURLcode result;
+  CURL *curl = curl_easy_init();
+  if(!curl)
+    return CURLE_OUT_OF_MEMORY;
+  result = add_per_transfer(&seg);
+  if(result) {
+    curl_easy_cleanup(curl);
+    return result;
+  }
+  seg->config = config;
+  seg->curl = curl;
+  seg->segs = first->segs;
+  seg->segs->refs++;
+  seg->urlnum = first->urlnum;
+  seg->noprogress = first->noprogress;
+  seg->isatty = first->isatty;
+  seg->infd = STDIN_FILENO;
+  seg->heads.stream = stdout;
+  seg->etag_save.stream = stdout;
+  seg->url = strdup(first->url);
+  seg->outfile = strdup(first->outs.filename);
+  if(!seg->url || !seg->outfile)
+    result = CURLE_OUT_OF_MEMORY;
+  else {
+    seg->outs.filename = seg->outfile;
+    seg->outs.s_isreg = TRUE;
+    seg->hdrcbdata.outs = &seg->outs;
+    seg->hdrcbdata.heads = &seg->heads;
+    seg->hdrcbdata.etag_save = &seg->etag_save;
+    seg->hdrcbdata.config = config;
+    result = config2setopts(config, seg, curl, first->segs->share);
+  }
+  if(result) {
+    segment_drop(seg);
+    return result;
+  }
+
+  seg->retry_sleep_default = config->retry_delay_ms;
+  seg->retry_remaining = config->req_retry;
+  seg->retry_sleep = seg->retry_sleep_default; /* ms */
+  seg->retrystart = curlx_now();
+  *segp = seg;
+  return CURLE_OK;
+}
+
+/* The HEAD request of --segments is done: split the download into ranges
+   that are transfers of their own, all writing to their own part of the same
+   output file. The transfer itself is done again, for the first range or for
+   all of the file when it cannot be split. 'retryp' is left FALSE when the
+   transfer ends here. */
+static CURLcode segment_split(struct per_transfer *per, CURLcode result,
+                              bool *retryp)
+{
+  struct OperationConfig *config = per->config;
+  struct segments *segs = per->segs;
+  struct OutStruct *outs = &per->outs;
+  curl_off_t parts = config->segments;
+  curl_off_t partlen;
+  curl_off_t start = 0;
+  curl_off_t i;
+  long code = 0;
+
+  per->segprobe = FALSE;
+  (void)curl_easy_setopt(per->curl, CURLOPT_NOBODY, 0L);
+  (void)curl_easy_setopt(per->curl, CURLOPT_RANGE, NULL);
+  (void)curl_easy_setopt(per->curl, CURLOPT_NOPROGRESS,
+                         (long)(per->noprogress || global->silent));
+  (void)curl_easy_setopt(per->curl, CURLOPT_HEADERFUNCTION, tool_header_cb);
+  (void)curl_easy_setopt(per->curl, CURLOPT_WRITEFUNCTION, tool_write_cb);
+  if(!result)
+    curl_easy_getinfo(per->curl, CURLINFO_RESPONSE_CODE, &code);
+  if(!code)
+    /* no response, the transfer ends with what went wrong */
+    return result;
+
+  segs->size = segment_size(per->curl, code);
+  if(segs->size > 0 && (parts > segs->size / SEGMENT_MIN))
+    parts = segs->size / SEGMENT_MIN;
+  if((segs->size <= 0) || (parts < 2)) {
+    notef("downloading %s in one piece", per->url);
+    *retryp = TRUE;
+    return CURLE_OK;
+  }
+
+  if(segment_header(per->curl, "ETag", &segs->etag) ||
+     segment_header(per->curl, "Last-Modified", &segs->lastmod))
+    return CURLE_OUT_OF_MEMORY;
+
+  /* the file gets its full size first, the segments then write into it */
+  if(!tool_create_output_file(outs, config))
+    return CURLE_WRITE_ERROR;
+#if defined(HAVE_FTRUNCATE) && !defined(__DJGPP__) && !defined(__AMIGA__) && \
+  !defined(__MINGW32CE__)
+  if(ftruncate(fileno(outs->stream), segs->size))
+    warnf("Failed to set the size of %s", outs->filename);
+#endif
+
+  partlen = segs->size / parts;
+  for(i = 0; i < parts; i++) {
+    char range[64];
+    struct per_transfer *seg = per;
+    curl_off_t len = (i == parts - 1) ? segs->size - start : partlen;
+    if(i) {
+      result = segment_add(per, &seg);
+      if(result) {
+        /* none of the parts get started, the new ones are last in the list */
+        while(global->transfersl != per)
+          segment_drop(global->transfersl);
+        return result;
+      }
+    }
+    seg->outs.segment = TRUE;
+    seg->outs.init = start;
+    seg->outs.seglen = len;
+    msnprintf(range, sizeof(range), "%" CURL_FORMAT_CURL_OFF_T "-%"
+              CURL_FORMAT_CURL_OFF_T, start, start + len - 1);
+    (void)curl_easy_setopt(seg->curl, CURLOPT_RANGE, range);
+    start += len;
+  }
+  *retryp = TRUE;
+  return CURLE_OK;
+}
+
+/* a part of a --segments download is done for good. The last one removes the
+   file with --remove-on-error when any of them failed, the others might still
+   be writing to it before that. */
+static void segment_done(struct per_transfer *per, CURLcode result)
+{
+  struct segments *segs = per->segs;
+  if(result && per->outs.segment)
+    segs->failed = TRUE;
+  if(!--segs->refs) {
+    if(segs->failed && per->config->rm_partial)
+      tool_remove_output(per->outs.filename);
+    free(segs->etag);
+    free(segs->lastmod);
+    free(segs);
+  }
+  per->segs = NULL;
+}
+
 /*
  * Call this after a transfer has completed.
  */
@@ -549,6 +1023,19 @@ static CURLcode post_per_transfer(struct per_transfer *per,
   if(!curl || !config)
     return result;
 
+  if(per->segprobe) {
+    result = segment_split(per, result, retryp);
+    if(*retryp)
+      return CURLE_OK;
+  }
+
+  if(per->infile) {
+    fclose(per->infile);
+    per->infile = NULL;
+    per->infdopen = FALSE;
+    per->infd = STDIN_FILENO;
+  }
+
   if(per->uploadfile) {
     if(!strcmp(per->uploadfile, ".") && per->infd > 0) {
 #if defined(_WIN32) && !defined(CURL_WINDOWS_UWP) && !defined(UNDER_CE)
@@ -569,6 +1056,9 @@ static CURLcode post_per_transfer(struct per_transfer *per,
   if(per->skip)
     goto skip;
 
+  if(per->cache)
+    result = cache_done(per, result);
+
 #ifdef __VMS
   if(is_vms_shell()) {
     /* VMS DCL shell behavior */
@@ -580,10 +1070,10 @@ static CURLcode post_per_transfer(struct per_transfer *per,
     if(!config->synthetic_error && result &&
        (!global->silent || global->showerror)) {
       const char *msg = per->errorbuffer;
-      fprintf(tool_stderr, "curl: (%d) %s\n", result,
-              (msg && msg[0]) ? msg : curl_easy_strerror(result));
+      errprintf("curl: (%d) %s\n", result,
+                (msg && msg[0]) ? msg : curl_easy_strerror(result));
       if(result == CURLE_PEER_FAILED_VERIFICATION)
-        fputs(CURL_CA_CERT_ERRORMSG, tool_stderr);
+        errprintf("%s", CURL_CA_CERT_ERRORMSG);
     }
     else if(config->failwithbody) {
       /* if HTTP response >= 400, return error */
@@ -591,9 +1081,8 @@ static CURLcode post_per_transfer(struct per_transfer *per,
       curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
       if(code >= 400) {
         if(!global->silent || global->showerror)
-          fprintf(tool_stderr,
-                  "curl: (%d) The requested URL returned error: %ld\n",
-                  CURLE_HTTP_RETURNED_ERROR, code);
+          errprintf("curl: (%d) The requested URL returned error: %ld\n",
+                    CURLE_HTTP_RETURNED_ERROR, code);
         result = CURLE_HTTP_RETURNED_ERROR;
       }
     }
@@ -640,8 +1129,10 @@ static CURLcode post_per_transfer(struct per_transfer *per,
       (curlx_timediff(curlx_now(), per->retrystart) <
        config->retry_maxtime_ms)) ) {
     result = retrycheck(config, per, result, retryp, delay);
-    if(!result && *retryp)
+    if(!result && *retryp) {
+      per->body.size = 0; /* the record gets the last attempt only */
       return CURLE_OK; /* retry! */
+    }
   }
 
   if((global->progressmode == CURL_PROGRESS_BAR) &&
@@ -650,28 +1141,9 @@ static CURLcode post_per_transfer(struct per_transfer *per,
        newline here */
     fputs("\n", per->progressbar.out);
 
-  /* Close the outs file */
-  if(outs->fopened && outs->stream) {
-    rc = fclose(outs->stream);
-    if(!result && rc) {
-      /* something went wrong in the writing process */
-      result = CURLE_WRITE_ERROR;
-      errorf("curl: (%d) Failed writing body", result);
-    }
-    if(result && config->rm_partial) {
-      struct_stat st;
-      if(!stat(outs->filename, &st) &&
-         S_ISREG(st.st_mode)) {
-        if(!unlink(outs->filename))
-          notef("Removed output file: %s", outs->filename);
-        else
-          warnf("Failed removing: %s", outs->filename);
-      }
-      else
-        warnf("Skipping removal; not a regular file: %s",
-              outs->filename);
-    }
-  }
+  result = tool_outs_close(outs, config, result);
+  if(per->segs)
+    segment_done(per, result);
 
   /* File time can only be set _after_ the file has been closed */
   if(!result && config->remote_time && outs->s_isreg && outs->filename) {
@@ -681,10 +1153,14 @@ static CURLcode post_per_transfer(struct per_transfer *per,
     setfiletime(filetime, outs->filename);
   }
 skip:
-  /* Write the --write-out data before cleanup but after result is final */
-  if(config->writeout)
+  /* Write the --write-out data before cleanup but after result is final.
+     A --dedupe duplicate got them with the request made for it. */
+  if(config->writeout && !per->deduped)
     ourWriteOut(config, per, result);
 
+  if(global->io.result && !per->deduped)
+    runner_report(per, result);
+
   /* Close function-local opened file descriptors */
   if(per->heads.fopened && per->heads.stream)
     fclose(per->heads.stream);
@@ -698,6 +1174,8 @@ skip:
   if(per->etag_save.alloc_filename)
     tool_safefree(per->etag_save.filename);
 
+  if(per->dupe && dedupe_done(per, result))
+    per->curl = NULL; /* kept for the --write-out of the duplicates */
   curl_easy_cleanup(per->curl);
   if(outs->alloc_filename)
     free(outs->filename);
@@ -1071,13 +1549,79 @@ static void check_stdin_upload(struct OperationConfig *config,
   }
 }
 
+static bool http_url(const char *url)
+{
+  bool http = FALSE;
+  CURLU *u = curl_url();
+  if(u) {
+    char *scheme = NULL;
+    if(!curl_url_set(u, CURLUPART_URL, url,
+                     CURLU_GUESS_SCHEME | CURLU_NON_SUPPORT_SCHEME) &&
+       !curl_url_get(u, CURLUPART_SCHEME, &scheme, 0)) {
+      const char *proto = proto_token(scheme);
+      http = (proto == proto_http) || (proto == proto_https);
+    }
+    curl_free(scheme);
+    curl_url_cleanup(u);
+  }
+  return http;
+}
+
+/* --segments works for plain HTTP downloads to a file */
+static bool segments_ok(struct OperationConfig *config,
+                        struct per_transfer *per)
+{
+  if(!per->outs.filename || per->outs.stream || per->outs.out_null ||
+     per->skip || per->cache || per->uploadfile || config->range ||
+     config->resume_from ||
+     config->show_headers || config->content_disposition ||
+     config->headerfile || config->etag_save_file || config->encoding ||
+     config->tr_encoding || config->customrequest || config->no_body ||
+     ((config->httpreq != TOOL_HTTPREQ_UNSPEC) &&
+      (config->httpreq != TOOL_HTTPREQ_GET)) || global->libcurl)
+    return FALSE;
+
+  return http_url(per->url);
+}
+
+/* --dedupe works for transfers without an upload and with an output the
+   duplicates can get a copy of */
+static bool dedupe_ok(struct OperationConfig *config,
+                      struct per_transfer *per)
+{
+  return !per->skip && !per->uploadfile && !config->mimepost &&
+    !config->resume_from && !config->resume_from_current &&
+    !config->ftp_append && !config->content_disposition &&
+    !config->headerfile && !config->etag_save_file &&
+    (config->file_clobber_mode != CLOBBER_NEVER) &&
+    (config->segments <= 1) && !global->libcurl;
+}
+
+/* --cache-dir works for plain HTTP GETs without credentials */
+static bool cache_ok(struct OperationConfig *config,
+                     struct per_transfer *per)
+{
+  if(per->outs.out_null || per->skip || per->uploadfile || config->range ||
+     config->resume_from || config->resume_from_current ||
+     config->show_headers || config->content_disposition ||
+     config->etag_save_file || config->etag_compare_file ||
+     config->customrequest || config->no_body || config->userpwd ||
+     config->oauth_bearer || config->aws_sigv4 || config->netrc_opt ||
+     config->cookies || config->cookiefiles || config->cookiejar ||
+     config->cert ||
+     ((config->httpreq != TOOL_HTTPREQ_UNSPEC) &&
+      (config->httpreq != TOOL_HTTPREQ_GET)) || global->libcurl)
+    return FALSE;
+
+  return http_url(per->url);
+}
+
 /* create the next (singular) transfer */
 static CURLcode single_transfer(struct OperationConfig *config,
                                 CURLSH *share, bool *added, bool *skipped)
 {
   CURLcode result = CURLE_OK;
-  bool orig_noprogress = global->noprogress;
-  bool orig_isatty = global->isatty;
+  bool binary_ok;
   struct State *state = &global->state;
   char *httpgetfields = state->httpgetfields;
 
@@ -1149,7 +1693,19 @@ static CURLcode single_transfer(struct OperationConfig *config,
     }
 
     if(!state->urlnum) {
-      if(!config->globoff && !u->noglob) {
+      if(u->fromfile) {
+        bool eof;
+        result = url_file_next(state, u, &eof);
+        if(result)
+          return result;
+        if(eof) {
+          /* move on to the next node */
+          state->upidx = state->upnum;
+          continue;
+        }
+        state->urlnum = 1;
+      }
+      else if(!config->globoff && !u->noglob) {
         /* Unless explicitly shut off, we expand '{...}' and '[...]'
            expressions and return total number of URLs in pattern set */
         result = glob_url(&state->urlglob, u->url, &state->urlnum, err);
@@ -1201,7 +1757,9 @@ static CURLcode single_transfer(struct OperationConfig *config,
     }
     per->config = config;
     per->curl = curl;
-    per->urlnum = u->num;
+    per->urlnum = u->num + state->urlnumoff;
+    if(u->fromfile)
+      per->urlnum += state->urlfilenum - 1;
 
     /* default headers output stream is stdout */
     heads = &per->heads;
@@ -1227,7 +1785,8 @@ static CURLcode single_transfer(struct OperationConfig *config,
     if(glob_inuse(&state->urlglob))
       result = glob_next_url(&per->url, &state->urlglob);
     else if(!state->urlidx) {
-      per->url = strdup(u->url);
+      per->url = strdup(u->fromfile ? curlx_dyn_ptr(&state->urlline) :
+                        u->url);
       if(!per->url)
         result = CURLE_OUT_OF_MEMORY;
     }
@@ -1271,16 +1830,16 @@ static CURLcode single_transfer(struct OperationConfig *config,
     }
 
     if(output_expected(per->url, per->uploadfile) && outs->stream &&
-       isatty(fileno(outs->stream)))
+       !tool_outs_to_sink(outs) && isatty(fileno(outs->stream)))
       /* we send the output to a tty, therefore we switch off the progress
          meter */
-      per->noprogress = global->noprogress = global->isatty = TRUE;
-    else {
-      /* progress meter is per download, so restore config
-         values */
-      per->noprogress = global->noprogress = orig_noprogress;
-      global->isatty = orig_isatty;
-    }
+      per->noprogress = per->isatty = TRUE;
+    else
+      /* progress meter is per download, so use the config value */
+      per->noprogress = global->noprogress;
+    /* kept per transfer, --parallel-threads workers run the callbacks. The
+       parallel meter goes by the transfer set up last. */
+    global->progress.noprogress = per->noprogress;
 
     if(httpgetfields || config->query) {
       result = append2query(config, per,
@@ -1297,8 +1856,9 @@ static CURLcode single_transfer(struct OperationConfig *config,
     }
 
     /* explicitly passed to stdout means okaying binary gunk */
-    config->terminal_binary_ok =
-      (per->outfile && !strcmp(per->outfile, "-"));
+    binary_ok = (per->outfile && !strcmp(per->outfile, "-"));
+    if(config->terminal_binary_ok != binary_ok)
+      config->terminal_binary_ok = binary_ok;
 
     hdrcbdata->honor_cd_filename =
       (config->content_disposition && u->useremote);
@@ -1317,13 +1877,47 @@ static CURLcode single_transfer(struct OperationConfig *config,
     per->retry_sleep = per->retry_sleep_default; /* ms */
     per->retrystart = curlx_now();
 
+    if(config->dedupe && dedupe_ok(config, per)) {
+      bool dup;
+      result = dedupe_add(per, &dup);
+      if(result)
+        return result;
+      if(dup) {
+        /* another transfer makes the request */
+        per->skip = TRUE;
+        *skipped = TRUE;
+      }
+    }
+
+    if(config->cache_dir && cache_ok(config, per)) {
+      bool done;
+      result = cache_setup(config, per, &done);
+      if(!result && done) {
+        /* fresh in the cache, there is no request to make */
+        result = tool_outs_close(outs, config, result);
+        per->skip = TRUE;
+        *skipped = TRUE;
+      }
+      if(result)
+        return result;
+    }
+
+    if((config->segments > 1) && segments_ok(config, per)) {
+      result = segment_setup(share, per);
+      if(result)
+        return result;
+    }
+
     state->urlidx++;
     /* Here's looping around each globbed URL */
     if(state->urlidx >= state->urlnum) {
       state->urlidx = state->urlnum = 0;
       glob_cleanup(&state->urlglob);
-      state->upidx++;
-      tool_safefree(state->uploadfile); /* clear it to get the next */
+      if(!u->fromfile) {
+        /* a URL file stays until its end */
+        state->upidx++;
+        tool_safefree(state->uploadfile); /* clear it to get the next */
+      }
     }
     *added = TRUE;
     break;
@@ -1331,62 +1925,491 @@ static CURLcode single_transfer(struct OperationConfig *config,
   return result;
 }
 
-static long all_added; /* number of easy handles currently added */
-
 /*
  * add_parallel_transfers() sets 'morep' to TRUE if there are more transfers
  * to add even after this call returns. sets 'addedp' to TRUE if one or more
  * transfers were added.
  */
-static CURLcode add_parallel_transfers(CURLM *multi, CURLSH *share,
-                                       bool *morep, bool *addedp)
-{
-  struct per_transfer *per;
-  CURLcode result = CURLE_OK;
+struct parastate {
+  CURLM *multi;
+  CURLSH *share;
   CURLMcode mcode;
-  bool sleeping = FALSE;
-  char *errorbuf;
-  curl_off_t nxfers;
+  CURLcode result;
+  int still_running;
+  struct curltime start;
+  bool more_transfers;
+  bool added_transfers;
+  /* wrapitup is set TRUE after a critical error occurs to end all transfers */
+  bool wrapitup;
+  /* wrapitup_processed is set TRUE after the per transfer abort flag is set */
+  bool wrapitup_processed;
+  time_t tick;
+  struct per_transfer **delayed;  /* retries waiting for their startat, a
+                                     min-heap */
+  size_t ndelayed;
+  size_t adelayed;                /* allocated entries */
+  struct ratelimit rl;            /* --rate, --parallel-host-rate and
+                                     --parallel-adaptive */
+  struct curltime rate_at;        /* a waiting transfer may start then */
+  bool rate_wait;                 /* rate_at is set */
+#ifdef USE_IO_URING
+  struct uring uring;
+  struct uring *ring;             /* --io-uring, or NULL */
+  struct per_transfer *draining;  /* ended, waiting for their writes */
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+  int epfd;                       /* event-driven loop, or -1 */
+  struct curltime timer_at;       /* when libcurl wants its timeout call */
+  bool timer_set;
+#endif
+#ifdef USE_PARALLEL_THREADS
+  struct parworker *workers;      /* --parallel-threads minus one */
+  unsigned int nworkers;
+  long assigned;                  /* transfers in this thread's multi */
+  curl_mutex_t iolock;            /* for global->iolock */
+  curl_mutex_t proglock;          /* for global->proglock */
+#endif
+};
 
-  *addedp = FALSE;
-  *morep = FALSE;
-  mcode = curl_multi_get_offt(multi, CURLMINFO_XFERS_CURRENT, &nxfers);
-  if(mcode) {
-    DEBUGASSERT(0);
-    return CURLE_UNKNOWN_OPTION;
+#ifdef USE_PARALLEL_THREADS
+
+#ifdef USE_THREADS_POSIX
+#define WORKER_RETURN_T void *
+#define WORKER_CALL
+#elif defined(CURL_WINDOWS_UWP) || defined(UNDER_CE)
+#define WORKER_RETURN_T DWORD
+#define WORKER_CALL WINAPI
+#else
+#define WORKER_RETURN_T unsigned int
+#define WORKER_CALL __stdcall
+#endif
+
+/* A thread running its share of the transfers of --parallel-threads in a
+   multi handle of its own. The main thread creates the transfers, hands them
+   over and gets them back when done, so all but the transfer itself stays in
+   the main thread: retries, --write-out and the progress meter. */
+struct parworker {
+  curl_mutex_t lock;              /* for the fields up to 'multi' */
+  struct per_transfer *inbox;     /* to add, linked with qnext */
+  struct per_transfer *inboxl;
+  struct per_transfer *outbox;    /* ended, with qresult */
+  struct per_transfer *outboxl;
+  curl_off_t xfers_added;         /* its multi counters */
+  curl_off_t xfers_running;
+  CURLMcode mcode;                /* a multi problem ended the thread */
+  bool quit;
+  bool abort;                     /* abort all its transfers */
+  /* set by the main thread before the thread starts */
+  CURLM *multi;
+  CURLM *wakeup;                  /* the main thread's multi */
+  struct GlobalConfig *global;
+  FILE *errstream;
+#ifdef USE_THREADS_POSIX
+  pthread_t thread;
+#else
+  HANDLE thread;
+#endif
+  long assigned;                  /* main thread only, transfers it runs */
+};
+
+/* Queue a transfer that ended, with the lock held */
+static void worker_ended(struct parworker *w, struct per_transfer *per,
+                         CURLcode result)
+{
+  per->qresult = result;
+  per->qnext = NULL;
+  if(w->outboxl)
+    w->outboxl->qnext = per;
+  else
+    w->outbox = per;
+  w->outboxl = per;
+}
+
+static void worker_abort_all(struct parworker *w)
+{
+  CURL **handles = curl_multi_get_handles(w->multi);
+  if(handles) {
+    size_t i;
+    for(i = 0; handles[i]; i++) {
+      struct per_transfer *per;
+      curl_easy_getinfo(handles[i], CURLINFO_PRIVATE, (void *)&per);
+      per->abort = TRUE;
+    }
+    curl_free(handles);
   }
+}
 
-  if(nxfers < (curl_off_t)(global->parallel_max*2)) {
-    bool skipped = FALSE;
-    do {
-      result = create_transfer(share, addedp, &skipped);
-      if(result)
-        return result;
-    } while(skipped);
+/* Take the transfers still running out of the multi handle, the main thread
+   cleans them up */
+static void worker_remove_all(struct parworker *w)
+{
+  CURL **handles = curl_multi_get_handles(w->multi);
+  if(handles) {
+    size_t i;
+    for(i = 0; handles[i]; i++)
+      curl_multi_remove_handle(w->multi, handles[i]);
+    curl_free(handles);
   }
-  for(per = transfers; per && (all_added < global->parallel_max);
-      per = per->next) {
-    if(per->added || per->skip)
-      /* already added or to be skipped */
-      continue;
-    if(per->startat && (time(NULL) < per->startat)) {
-      /* this is still delaying */
-      sleeping = TRUE;
-      continue;
+}
+
+static WORKER_RETURN_T WORKER_CALL parallel_worker(void *arg)
+{
+  struct parworker *w = arg;
+  bool aborting = FALSE;
+
+  /* the transfer callbacks use the tool state of the run */
+  global = w->global;
+  tool_stderr = w->errstream;
+
+  for(;;) {
+    struct per_transfer *add;
+    struct per_transfer *ended = NULL;
+    struct per_transfer *endedl = NULL;
+    struct per_transfer *per;
+    CURLMsg *msg;
+    CURLMcode mcode;
+    int running = 0;
+    int rc;
+    bool quit;
+    bool abort;
+
+    Curl_mutex_acquire(&w->lock);
+    add = w->inbox;
+    w->inbox = w->inboxl = NULL;
+    quit = w->quit;
+    abort = w->abort;
+    Curl_mutex_release(&w->lock);
+
+    if(quit)
+      break;
+    if(abort && !aborting) {
+      worker_abort_all(w);
+      aborting = TRUE;
+    }
+
+    while(add) {
+      per = add;
+      add = per->qnext;
+      if(aborting)
+        per->abort = TRUE;
+      if(curl_multi_add_handle(w->multi, per->curl)) {
+        Curl_mutex_acquire(&w->lock);
+        worker_ended(w, per, CURLE_OUT_OF_MEMORY);
+        Curl_mutex_release(&w->lock);
+        curl_multi_wakeup(w->wakeup);
+      }
     }
-    per->added = TRUE;
 
-    result = pre_transfer(per);
-    if(result)
-      return result;
+    mcode = curl_multi_perform(w->multi, &running);
+    while(!mcode && (msg = curl_multi_info_read(w->multi, &rc))) {
+      if(msg->msg == CURLMSG_DONE) {
+        CURL *easy = msg->easy_handle;
+        per = NULL;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (void *)&per);
+        per->qresult = msg->data.result;
+        per->qnext = NULL;
+        curl_multi_remove_handle(w->multi, easy);
+        if(endedl)
+          endedl->qnext = per;
+        else
+          ended = per;
+        endedl = per;
+      }
+    }
 
-    errorbuf = malloc(CURL_ERROR_SIZE);
-    if(!errorbuf)
-      return CURLE_OUT_OF_MEMORY;
+    Curl_mutex_acquire(&w->lock);
+    for(per = ended; per; per = ended) {
+      ended = per->qnext;
+      worker_ended(w, per, per->qresult);
+    }
+    (void)curl_multi_get_offt(w->multi, CURLMINFO_XFERS_ADDED,
+                              &w->xfers_added);
+    (void)curl_multi_get_offt(w->multi, CURLMINFO_XFERS_RUNNING,
+                              &w->xfers_running);
+    Curl_mutex_release(&w->lock);
+    if(endedl)
+      curl_multi_wakeup(w->wakeup);
 
-    /* parallel connect means that we do not set PIPEWAIT since pipewait
-       will make libcurl prefer multiplexing */
-    (void)curl_easy_setopt(per->curl, CURLOPT_PIPEWAIT,
+    if(!mcode)
+      mcode = curl_multi_poll(w->multi, NULL, 0, 1000, NULL);
+    if(mcode) {
+      Curl_mutex_acquire(&w->lock);
+      w->mcode = mcode;
+      Curl_mutex_release(&w->lock);
+      curl_multi_wakeup(w->wakeup);
+      break;
+    }
+  }
+
+  worker_remove_all(w);
+  return 0;
+}
+
+static bool worker_start(struct parworker *w)
+{
+#ifdef USE_THREADS_POSIX
+  return !pthread_create(&w->thread, NULL, parallel_worker, w);
+#elif defined(CURL_WINDOWS_UWP) || defined(UNDER_CE)
+  w->thread = CreateThread(NULL, 0, parallel_worker, w, 0, NULL);
+  return w->thread != NULL;
+#else
+  uintptr_t th = _beginthreadex(NULL, 0, parallel_worker, w, 0, NULL);
+  w->thread = (HANDLE)th;
+  return th != 0;
+#endif
+}
+
+static void worker_join(struct parworker *w)
+{
+#ifdef USE_THREADS_POSIX
+  pthread_join(w->thread, NULL);
+#else
+  WaitForSingleObject(w->thread, INFINITE);
+  CloseHandle(w->thread);
+#endif
+}
+
+/* Start the worker threads, the main thread runs transfers as well. If not
+   all of them start, go on with the ones that did. */
+static CURLcode parallel_start_workers(struct parastate *s)
+{
+  unsigned int want = global->parallel_threads - 1;
+
+  s->workers = calloc(want, sizeof(struct parworker));
+  if(!s->workers)
+    return CURLE_OUT_OF_MEMORY;
+
+  /* the threads write to the sinks and the trace output */
+  Curl_mutex_init(&s->iolock);
+  global->iolock = &s->iolock;
+  Curl_mutex_init(&s->proglock);
+  global->proglock = &s->proglock;
+  if(global->tracetype && global->trace_dump)
+    tool_trace_start();
+
+  while(s->nworkers < want) {
+    struct parworker *w = &s->workers[s->nworkers];
+    w->multi = curl_multi_init();
+    if(!w->multi)
+      break;
+    if(global->runshare && global->runshare->maxconnects)
+      curl_multi_setopt(w->multi, CURLMOPT_MAXCONNECTS,
+                        global->runshare->maxconnects);
+    w->wakeup = s->multi;
+    w->global = global;
+    w->errstream = tool_stderr;
+    Curl_mutex_init(&w->lock);
+    if(!worker_start(w)) {
+      Curl_mutex_destroy(&w->lock);
+      curl_multi_cleanup(w->multi);
+      break;
+    }
+    s->nworkers++;
+  }
+  if(s->nworkers < want)
+    warnf("started %u of %u transfer threads", s->nworkers + 1, want + 1);
+  return CURLE_OK;
+}
+
+static void parallel_stop_workers(struct parastate *s)
+{
+  unsigned int i;
+
+  if(!s->workers)
+    return;
+  for(i = 0; i < s->nworkers; i++) {
+    struct parworker *w = &s->workers[i];
+    Curl_mutex_acquire(&w->lock);
+    w->quit = TRUE;
+    Curl_mutex_release(&w->lock);
+    curl_multi_wakeup(w->multi);
+  }
+  for(i = 0; i < s->nworkers; i++) {
+    struct parworker *w = &s->workers[i];
+    worker_join(w);
+    curl_multi_cleanup(w->multi);
+    Curl_mutex_destroy(&w->lock);
+  }
+  tool_safefree(s->workers);
+  s->nworkers = 0;
+  global->iolock = NULL;
+  Curl_mutex_destroy(&s->iolock);
+  global->proglock = NULL;
+  Curl_mutex_destroy(&s->proglock);
+}
+
+#endif /* USE_PARALLEL_THREADS */
+
+/* Add a retry to the heap of delayed transfers, the one to start first is on
+   top */
+static CURLcode delay_push(struct parastate *s, struct per_transfer *per)
+{
+  size_t i;
+  if(s->ndelayed == s->adelayed) {
+    size_t alloc = s->adelayed ? s->adelayed * 2 : 16;
+    struct per_transfer **d = realloc(s->delayed, alloc * sizeof(*d));
+    if(!d)
+      return CURLE_OUT_OF_MEMORY;
+    s->delayed = d;
+    s->adelayed = alloc;
+  }
+  for(i = s->ndelayed++; i; i = (i - 1) / 2) {
+    struct per_transfer *parent = s->delayed[(i - 1) / 2];
+    if(parent->startat <= per->startat)
+      break;
+    s->delayed[i] = parent;
+  }
+  s->delayed[i] = per;
+  return CURLE_OK;
+}
+
+/* Remove the top of the heap */
+static struct per_transfer *delay_pop(struct parastate *s)
+{
+  struct per_transfer *top = s->delayed[0];
+  struct per_transfer *last = s->delayed[--s->ndelayed];
+  size_t i = 0;
+
+  for(;;) {
+    size_t child = i * 2 + 1;
+    if(child >= s->ndelayed)
+      break;
+    if((child + 1 < s->ndelayed) &&
+       (s->delayed[child + 1]->startat < s->delayed[child]->startat))
+      child++;
+    if(last->startat <= s->delayed[child]->startat)
+      break;
+    s->delayed[i] = s->delayed[child];
+    i = child;
+  }
+  if(s->ndelayed)
+    s->delayed[i] = last;
+  return top;
+}
+
+/* Get a transfer going, in the thread running the fewest */
+static CURLMcode parallel_add(struct parastate *s, struct per_transfer *per)
+{
+  CURLMcode mcode;
+#ifdef USE_PARALLEL_THREADS
+  struct parworker *w = NULL;
+  unsigned int i;
+
+  for(i = 0; i < s->nworkers; i++) {
+    if(!w || (s->workers[i].assigned < w->assigned))
+      w = &s->workers[i];
+  }
+  if(w && (s->assigned < w->assigned))
+    w = NULL;
+  per->worker = w;
+  if(w) {
+    per->qnext = NULL;
+    Curl_mutex_acquire(&w->lock);
+    if(w->inboxl)
+      w->inboxl->qnext = per;
+    else
+      w->inbox = per;
+    w->inboxl = per;
+    Curl_mutex_release(&w->lock);
+    w->assigned++;
+    return curl_multi_wakeup(w->multi);
+  }
+#endif
+  mcode = curl_multi_add_handle(s->multi, per->curl);
+#ifdef USE_PARALLEL_THREADS
+  if(!mcode)
+    s->assigned++;
+#endif
+  return mcode;
+}
+
+/* the first transfer in the ready queue that the rate limits let start
+   now, or NULL. Sets s->rate_at if one of them can start later. */
+static struct per_transfer *ready_ratelimited(struct parastate *s)
+{
+  struct per_transfer *per;
+  struct curltime now = curlx_now();
+  timediff_t wait;
+  timediff_t minwait = 0;
+
+  s->rate_wait = FALSE;
+  if(!ratelimit_ok(&s->rl, NULL, now, &minwait))
+    /* no transfer may start before the --rate token is there */
+    per = NULL;
+  else {
+    for(per = global->ready; per; per = per->rnext) {
+      if(per->skip)
+        break;
+      if(!per->ratehost)
+        per->ratehost = ratelimit_host(&s->rl, per->url);
+      if(ratelimit_ok(&s->rl, per->ratehost, now, &wait))
+        break;
+      if((wait > 0) && (!minwait || (wait < minwait)))
+        minwait = wait;
+    }
+  }
+  if(!per && minwait) {
+    s->rate_at = now;
+    s->rate_at.tv_sec += (time_t)(minwait / 1000);
+    s->rate_at.tv_usec += (int)((minwait % 1000) * 1000);
+    if(s->rate_at.tv_usec >= 1000000) {
+      s->rate_at.tv_sec++;
+      s->rate_at.tv_usec -= 1000000;
+    }
+    s->rate_wait = TRUE;
+  }
+  return per;
+}
+
+static CURLcode add_parallel_transfers(struct parastate *s,
+                                       bool *morep, bool *addedp)
+{
+  struct per_transfer *per;
+  CURLcode result = CURLE_OK;
+  CURLMcode mcode;
+  char *errorbuf;
+  long nxfers;
+
+  *addedp = FALSE;
+  *morep = FALSE;
+  /* transfers are created no further ahead than this, so the memory use
+     depends on --parallel-max and not on the number of URLs */
+  nxfers = global->all_added + global->nready;
+  if(nxfers < (long)global->parallel_max * 2) {
+    bool skipped = FALSE;
+    do {
+      result = create_transfer(s->share, addedp, &skipped);
+      if(result)
+        return result;
+    } while(skipped);
+  }
+  if(s->ndelayed) {
+    /* retries done waiting go first */
+    time_t now = time(NULL);
+    while(s->ndelayed && (s->delayed[0]->startat <= now))
+      ready_retry(delay_pop(s));
+  }
+  while(global->ready && (global->all_added < global->parallel_max)) {
+    per = s->rl.active ? ready_ratelimited(s) : global->ready;
+    if(!per)
+      break;
+    ready_remove(per);
+    if(per->skip)
+      /* to be skipped */
+      continue;
+    per->added = TRUE;
+
+    result = pre_transfer(per);
+    if(result)
+      return result;
+
+    errorbuf = malloc(CURL_ERROR_SIZE);
+    if(!errorbuf)
+      return CURLE_OUT_OF_MEMORY;
+
+    /* parallel connect means that we do not set PIPEWAIT since pipewait
+       will make libcurl prefer multiplexing */
+    (void)curl_easy_setopt(per->curl, CURLOPT_PIPEWAIT,
                            global->parallel_connect ? 0L : 1L);
     (void)curl_easy_setopt(per->curl, CURLOPT_PRIVATE, per);
     /* curl does not use signals, switching this on saves some system calls */
@@ -1398,8 +2421,11 @@ static CURLcode add_parallel_transfers(CURLM *multi, CURLSH *share,
     if(getenv("CURL_FORBID_REUSE"))
       (void)curl_easy_setopt(per->curl, CURLOPT_FORBID_REUSE, 1L);
 #endif
+    errorbuf[0] = 0;
+    (void)curl_easy_setopt(per->curl, CURLOPT_ERRORBUFFER, errorbuf);
+    per->errorbuffer = errorbuf;
 
-    mcode = curl_multi_add_handle(multi, per->curl);
+    mcode = parallel_add(s, per);
     if(mcode) {
       DEBUGASSERT(mcode == CURLM_OUT_OF_MEMORY);
       result = CURLE_OUT_OF_MEMORY;
@@ -1409,42 +2435,30 @@ static CURLcode add_parallel_transfers(CURLM *multi, CURLSH *share,
       bool getadded = FALSE;
       bool skipped = FALSE;
       do {
-        result = create_transfer(share, &getadded, &skipped);
+        result = create_transfer(s->share, &getadded, &skipped);
         if(result)
           break;
       } while(skipped);
     }
-    if(result) {
-      free(errorbuf);
+    if(result)
       return result;
-    }
-    errorbuf[0] = 0;
-    (void)curl_easy_setopt(per->curl, CURLOPT_ERRORBUFFER, errorbuf);
-    per->errorbuffer = errorbuf;
     per->added = TRUE;
-    all_added++;
+    global->all_added++;
     *addedp = TRUE;
+#ifdef USE_IO_URING
+    if(!per->cache)
+      /* the stored copy may be written after the transfer */
+      per->uring = s->ring;
+#endif
+    if(s->rl.active) {
+      ratelimit_start(&s->rl, per->ratehost, curlx_now());
+      per->ratestarted = !!per->ratehost;
+    }
   }
-  *morep = (per || sleeping);
+  *morep = (global->ready || s->ndelayed);
   return CURLE_OK;
 }
 
-struct parastate {
-  CURLM *multi;
-  CURLSH *share;
-  CURLMcode mcode;
-  CURLcode result;
-  int still_running;
-  struct curltime start;
-  bool more_transfers;
-  bool added_transfers;
-  /* wrapitup is set TRUE after a critical error occurs to end all transfers */
-  bool wrapitup;
-  /* wrapitup_processed is set TRUE after the per transfer abort flag is set */
-  bool wrapitup_processed;
-  time_t tick;
-};
-
 #if defined(DEBUGBUILD) && defined(USE_LIBUV)
 
 #define DEBUG_UV    0
@@ -1473,8 +2487,7 @@ static void check_multi_info(struct datauv *uv)
     uv->s->result = result;
 
   if(uv->s->more_transfers) {
-    result = add_parallel_transfers(uv->s->multi, uv->s->share,
-                                    &uv->s->more_transfers,
+    result = add_parallel_transfers(uv->s, &uv->s->more_transfers,
                                     &uv->s->added_transfers);
     if(result && !uv->s->result)
       uv->s->result = result;
@@ -1646,7 +2659,7 @@ static CURLcode parallel_event(struct parastate *s)
     if(s->wrapitup) {
       if(s->still_running && !s->wrapitup_processed) {
         struct per_transfer *per;
-        for(per = transfers; per; per = per->next) {
+        for(per = global->transfers; per; per = per->next) {
           if(per->added)
             per->abort = TRUE;
         }
@@ -1656,7 +2669,7 @@ static CURLcode parallel_event(struct parastate *s)
     }
 
     if(s->more_transfers) {
-      result = add_parallel_transfers(s->multi, s->share, &s->more_transfers,
+      result = add_parallel_transfers(s, &s->more_transfers,
                                       &s->added_transfers);
       if(result && !s->result)
         s->result = result;
@@ -1675,6 +2688,8 @@ static CURLcode parallel_event(struct parastate *s)
 
   /* We need to cleanup the multi here, since the uv context lives on the
    * stack and will be gone. multi_cleanup can triggere events! */
+  tool_safefree(s->delayed);
+  ratelimit_cleanup(&s->rl);
   curl_multi_cleanup(s->multi);
 
 #if DEBUG_UV
@@ -1687,51 +2702,233 @@ static CURLcode parallel_event(struct parastate *s)
 
 #endif
 
+/* Deal with a transfer that is no longer in any multi handle */
+static CURLcode transfer_ended(struct parastate *s, struct per_transfer *ended,
+                               CURLcode tres, CURLcode result)
+{
+  bool retry;
+  long delay;
+
+  if(ended->abort && (tres == CURLE_ABORTED_BY_CALLBACK) &&
+     ended->errorbuffer) {
+    msnprintf(ended->errorbuffer, CURL_ERROR_SIZE,
+              "Transfer aborted due to critical error "
+              "in another transfer");
+  }
+#ifdef USE_PARALLEL_THREADS
+  if(ended->worker)
+    ended->worker->assigned--;
+  else
+    s->assigned--;
+  ended->worker = NULL;
+#endif
+#ifdef USE_IO_URING
+  if(ended->uring) {
+    int error = uring_done(ended);
+    if(error && !tres) {
+      errorf("Failed writing body: %s", strerror(error));
+      tres = CURLE_WRITE_ERROR;
+    }
+  }
+#endif
+  if(ended->ratestarted) {
+    long response = 0;
+    curl_off_t retry_after = 0;
+    (void)curl_easy_getinfo(ended->curl, CURLINFO_RESPONSE_CODE, &response);
+    (void)curl_easy_getinfo(ended->curl, CURLINFO_RETRY_AFTER, &retry_after);
+    ratelimit_done(&s->rl, ended->ratehost, response, retry_after);
+    ended->ratestarted = FALSE;
+  }
+  tres = post_per_transfer(ended, tres, &retry, &delay);
+  progress_finalize(ended); /* before it goes away */
+  global->all_added--; /* one fewer added */
+  if(retry) {
+    ended->added = FALSE; /* add it again */
+    /* we delay retries in full integer seconds only */
+    ended->startat = time(NULL) + delay/1000;
+    if(delay) {
+      CURLcode dres = delay_push(s, ended);
+      if(dres)
+        result = dres;
+    }
+    else
+      ready_retry(ended);
+  }
+  else {
+    /* result receives this transfer's error unless the transfer was
+       marked for abort due to a critical error in another transfer */
+    if(tres && (!ended->abort || !result))
+      result = tres;
+    if(is_fatal_error(result) || (result && global->fail_early))
+      s->wrapitup = TRUE;
+    (void)del_per_transfer(ended);
+  }
+  return result;
+}
+
+#ifdef USE_PARALLEL_THREADS
+/* Move the transfers the worker threads are done with to the done list */
+static void workers_finished(struct parastate *s, struct per_transfer **done,
+                             struct per_transfer **donel)
+{
+  unsigned int i;
+
+  for(i = 0; i < s->nworkers; i++) {
+    struct parworker *w = &s->workers[i];
+
+    Curl_mutex_acquire(&w->lock);
+    if(w->outbox) {
+      if(*donel)
+        (*donel)->qnext = w->outbox;
+      else
+        *done = w->outbox;
+      *donel = w->outboxl;
+      w->outbox = w->outboxl = NULL;
+    }
+    if(w->mcode && !s->mcode)
+      s->mcode = w->mcode;
+    Curl_mutex_release(&w->lock);
+  }
+}
+
+/* The progress meter for transfers spread over several multi handles */
+static void workers_progress(struct parastate *s, bool final)
+{
+  curl_off_t added = 0;
+  curl_off_t running = 0;
+  unsigned int i;
+
+  (void)curl_multi_get_offt(s->multi, CURLMINFO_XFERS_ADDED, &added);
+  (void)curl_multi_get_offt(s->multi, CURLMINFO_XFERS_RUNNING, &running);
+  /* the locks keep the threads from updating the numbers meanwhile */
+  for(i = 0; i < s->nworkers; i++) {
+    Curl_mutex_acquire(&s->workers[i].lock);
+    added += s->workers[i].xfers_added;
+    running += s->workers[i].xfers_running;
+  }
+  global->progress.xfers_added = added;
+  global->progress.xfers_running = running;
+  (void)progress_meter(NULL, &s->start, final);
+  for(i = 0; i < s->nworkers; i++)
+    Curl_mutex_release(&s->workers[i].lock);
+}
+#endif
+
+static void parallel_progress(struct parastate *s, bool final)
+{
+#ifdef USE_PARALLEL_THREADS
+  if(s->nworkers) {
+    workers_progress(s, final);
+    return;
+  }
+#endif
+  (void)progress_meter(s->multi, &s->start, final);
+}
+
+/* Signal all transfers that they should abort (via progress callback) */
+static void parallel_abort(struct parastate *s)
+{
+  struct per_transfer *per;
+#ifdef USE_PARALLEL_THREADS
+  unsigned int i;
+  for(i = 0; i < s->nworkers; i++) {
+    struct parworker *w = &s->workers[i];
+    Curl_mutex_acquire(&w->lock);
+    w->abort = TRUE;
+    Curl_mutex_release(&w->lock);
+    curl_multi_wakeup(w->multi);
+  }
+#endif
+  for(per = global->transfers; per; per = per->next) {
+#ifdef USE_PARALLEL_THREADS
+    if(per->worker)
+      /* its thread does this */
+      continue;
+#endif
+    if(per->added)
+      per->abort = TRUE;
+  }
+}
+
+#ifdef USE_IO_URING
+/* Move the ended transfers whose file writes are done to the done list */
+static void drained(struct parastate *s, struct per_transfer **done,
+                    struct per_transfer **donel)
+{
+  struct per_transfer **pp = &s->draining;
+  while(*pp) {
+    struct per_transfer *per = *pp;
+    if(per->uio.inflight) {
+      pp = &per->qnext;
+      continue;
+    }
+    *pp = per->qnext;
+    per->qnext = NULL;
+    if(*donel)
+      (*donel)->qnext = per;
+    else
+      *done = per;
+    *donel = per;
+  }
+}
+#endif
+
 static CURLcode check_finished(struct parastate *s)
 {
   CURLcode result = CURLE_OK;
   int rc;
   CURLMsg *msg;
   bool checkmore = FALSE;
-  progress_meter(s->multi, &s->start, FALSE);
+  struct per_transfer *done = NULL;
+  struct per_transfer *donel = NULL;
+  parallel_progress(s, FALSE);
   do {
     msg = curl_multi_info_read(s->multi, &rc);
     if(msg) {
-      bool retry;
-      long delay;
       struct per_transfer *ended;
       CURL *easy = msg->easy_handle;
-      CURLcode tres = msg->data.result;
       curl_easy_getinfo(easy, CURLINFO_PRIVATE, (void *)&ended);
       curl_multi_remove_handle(s->multi, easy);
-
-      if(ended->abort && (tres == CURLE_ABORTED_BY_CALLBACK) &&
-         ended->errorbuffer) {
-        msnprintf(ended->errorbuffer, CURL_ERROR_SIZE,
-                  "Transfer aborted due to critical error "
-                  "in another transfer");
-      }
-      tres = post_per_transfer(ended, tres, &retry, &delay);
-      progress_finalize(ended); /* before it goes away */
-      all_added--; /* one fewer added */
-      checkmore = TRUE;
-      if(retry) {
-        ended->added = FALSE; /* add it again */
-        /* we delay retries in full integer seconds only */
-        ended->startat = delay ? time(NULL) + delay/1000 : 0;
-      }
-      else {
-        /* result receives this transfer's error unless the transfer was
-           marked for abort due to a critical error in another transfer */
-        if(tres && (!ended->abort || !result))
-          result = tres;
-        if(is_fatal_error(result) || (result && global->fail_early))
-          s->wrapitup = TRUE;
-        (void)del_per_transfer(ended);
-      }
+      ended->qresult = msg->data.result;
+      ended->qnext = NULL;
+      if(donel)
+        donel->qnext = ended;
+      else
+        done = ended;
+      donel = ended;
     }
   } while(msg);
+#ifdef USE_PARALLEL_THREADS
+  workers_finished(s, &done, &donel);
+#endif
+#ifdef USE_IO_URING
+  if(s->draining)
+    drained(s, &done, &donel);
+#endif
+  while(done) {
+    struct per_transfer *ended = done;
+    done = ended->qnext;
+#ifdef USE_IO_URING
+    if(ended->uring && uring_finish(ended)) {
+      /* the file is not done until its writes are */
+      ended->qnext = s->draining;
+      s->draining = ended;
+      continue;
+    }
+#endif
+    result = transfer_ended(s, ended, ended->qresult, result);
+    checkmore = TRUE;
+  }
+#ifdef USE_PARALLEL_THREADS
+  /* keep going while the threads have transfers */
+  if(s->nworkers && global->all_added)
+    s->still_running = 1;
+#endif
   if(!s->wrapitup) {
+    if(!checkmore && s->rate_wait &&
+       (curlx_timediff(curlx_now(), s->rate_at) >= 0))
+      /* a transfer held back by the rate limits may start */
+      checkmore = TRUE;
     if(!checkmore) {
       time_t tock = time(NULL);
       if(s->tick != tock) {
@@ -1741,8 +2938,7 @@ static CURLcode check_finished(struct parastate *s)
     }
     if(checkmore) {
       /* one or more transfers completed, add more! */
-      CURLcode tres = add_parallel_transfers(s->multi, s->share,
-                                             &s->more_transfers,
+      CURLcode tres = add_parallel_transfers(s, &s->more_transfers,
                                              &s->added_transfers);
       if(tres)
         result = tres;
@@ -1756,11 +2952,258 @@ static CURLcode check_finished(struct parastate *s)
   return result;
 }
 
+/* milliseconds to wait for socket activity, at most 'ms' */
+static int parallel_timeout(struct parastate *s, int ms)
+{
+  if(s->rate_wait && s->more_transfers) {
+    timediff_t left = curlx_timediff_ceil(s->rate_at, curlx_now());
+    if(left < ms)
+      ms = (left > 0) ? (int)left : 0;
+  }
+#ifdef USE_IO_URING
+  if(s->ring && s->ring->freed && s->ring->waiters)
+    /* an ended transfer gave back a buffer others wait for */
+    ms = 0;
+#endif
+  return ms;
+}
+
+/* ended transfers are kept until their file writes are done */
+#ifdef USE_IO_URING
+#define parallel_draining(s) ((s)->draining != NULL)
+#else
+#define parallel_draining(s) FALSE
+#endif
+
+/* Run the parallel transfers, the multi handle polls the sockets */
+static CURLcode parallel_poll(struct parastate *s)
+{
+  CURLcode result = CURLE_OK;
+  while(!s->mcode && (s->still_running || s->more_transfers ||
+                      parallel_draining(s))) {
+    struct curl_waitfd extra;
+    unsigned int nextra = 0;
+    /* If stopping prematurely (eg due to a --fail-early condition) then
+       signal that any transfers in the multi should abort (via progress
+       callback). */
+    if(s->wrapitup) {
+      if(!s->still_running && !parallel_draining(s))
+        break;
+      if(!s->wrapitup_processed) {
+        parallel_abort(s);
+        s->wrapitup_processed = TRUE;
+      }
+    }
+
+#ifdef USE_IO_URING
+    if(s->ring) {
+      /* the file operation completions wake it up too */
+      uring_submit(s->ring);
+      extra.fd = s->ring->efd;
+      extra.events = CURL_WAIT_POLLIN;
+      extra.revents = 0;
+      nextra = 1;
+    }
+#endif
+    s->mcode = curl_multi_poll(s->multi, nextra ? &extra : NULL, nextra,
+                               parallel_timeout(s, 1000), NULL);
+#ifdef USE_IO_URING
+    if(s->ring) {
+      if(extra.revents)
+        uring_event(s->ring);
+      else
+        uring_complete(s->ring);
+    }
+#endif
+    if(!s->mcode)
+      s->mcode = curl_multi_perform(s->multi, &s->still_running);
+    if(!s->mcode)
+      result = check_finished(s);
+  }
+  return result;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#define EPOLL_MAXEVENTS 256
+
+/* CURLMOPT_SOCKETFUNCTION for the epoll loop. The socketp is set to the
+   parastate once the socket is in the epoll set. */
+static int epoll_socket_cb(CURL *easy, curl_socket_t sock, int what,
+                           void *userp, void *socketp)
+{
+  struct parastate *s = userp;
+  struct epoll_event ev;
+  (void)easy;
+
+  if(what == CURL_POLL_REMOVE) {
+    if(socketp)
+      (void)epoll_ctl(s->epfd, EPOLL_CTL_DEL, sock, NULL);
+    return 0;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  if(what & CURL_POLL_IN)
+    ev.events |= EPOLLIN;
+  if(what & CURL_POLL_OUT)
+    ev.events |= EPOLLOUT;
+  ev.data.fd = sock;
+  if(epoll_ctl(s->epfd, socketp ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, sock, &ev)) {
+    /* the socket was closed and its number reused without a remove, or the
+       other way around */
+    if((errno != EEXIST) && (errno != ENOENT))
+      return -1;
+    if(epoll_ctl(s->epfd, socketp ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+                 sock, &ev))
+      return -1;
+  }
+  if(!socketp)
+    curl_multi_assign(s->multi, sock, s);
+  return 0;
+}
+
+/* CURLMOPT_TIMERFUNCTION for the epoll loop */
+static int epoll_timer_cb(CURLM *multi, long timeout_ms, void *userp)
+{
+  struct parastate *s = userp;
+  (void)multi;
+  s->timer_set = (timeout_ms >= 0);
+  if(s->timer_set) {
+    s->timer_at = curlx_now();
+    s->timer_at.tv_sec += (time_t)(timeout_ms / 1000);
+    s->timer_at.tv_usec += (int)((timeout_ms % 1000) * 1000);
+    if(s->timer_at.tv_usec >= 1000000) {
+      s->timer_at.tv_sec++;
+      s->timer_at.tv_usec -= 1000000;
+    }
+  }
+  return 0;
+}
+
+/* Run the parallel transfers driven by socket events, only the sockets with
+   activity get serviced. Returns FALSE if epoll cannot be used. */
+static bool parallel_epoll(struct parastate *s, CURLcode *resultp)
+{
+  struct epoll_event events[EPOLL_MAXEVENTS];
+  CURLcode result = CURLE_OK;
+
+#ifdef USE_PARALLEL_THREADS
+  if(s->nworkers)
+    /* the threads wake up the main thread through its multi handle poll */
+    return FALSE;
+#endif
+  s->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if(s->epfd == -1)
+    return FALSE;
+
+#ifdef USE_IO_URING
+  if(s->ring) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = s->ring->efd;
+    if(epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->ring->efd, &ev)) {
+      close(s->epfd);
+      s->epfd = -1;
+      return FALSE;
+    }
+  }
+#endif
+  curl_multi_setopt(s->multi, CURLMOPT_SOCKETFUNCTION, epoll_socket_cb);
+  curl_multi_setopt(s->multi, CURLMOPT_SOCKETDATA, s);
+  curl_multi_setopt(s->multi, CURLMOPT_TIMERFUNCTION, epoll_timer_cb);
+  curl_multi_setopt(s->multi, CURLMOPT_TIMERDATA, s);
+
+  /* kickstart the thing */
+  s->mcode = curl_multi_socket_action(s->multi, CURL_SOCKET_TIMEOUT, 0,
+                                      &s->still_running);
+  if(!s->mcode)
+    /* transfers may be done already */
+    result = check_finished(s);
+
+  while(!s->mcode && (s->still_running || s->more_transfers ||
+                      parallel_draining(s))) {
+    /* for the progress meter, delayed retries and the rate limits */
+    int timeout = parallel_timeout(s, 1000);
+    int n;
+    int i;
+
+    if(s->wrapitup) {
+      if(!s->still_running && !parallel_draining(s))
+        break;
+      if(!s->wrapitup_processed) {
+        parallel_abort(s);
+        s->wrapitup_processed = TRUE;
+      }
+    }
+
+    if(s->timer_set) {
+      timediff_t left = curlx_timediff_ceil(s->timer_at, curlx_now());
+      if(left < timeout)
+        timeout = (left > 0) ? (int)left : 0;
+    }
+
+#ifdef USE_IO_URING
+    if(s->ring)
+      uring_submit(s->ring);
+#endif
+    n = epoll_wait(s->epfd, events, EPOLL_MAXEVENTS, timeout);
+    if(n < 0) {
+      int error = SOCKERRNO;
+      if(error != SOCKEINTR) {
+        errorf("epoll_wait() failed: %s", strerror(error));
+        s->mcode = CURLM_INTERNAL_ERROR;
+        break;
+      }
+      n = 0;
+    }
+    for(i = 0; (i < n) && !s->mcode; i++) {
+      int flags = 0;
+#ifdef USE_IO_URING
+      if(s->ring && (events[i].data.fd == s->ring->efd)) {
+        uring_event(s->ring);
+        continue;
+      }
+#endif
+      if(events[i].events & EPOLLIN)
+        flags |= CURL_CSELECT_IN;
+      if(events[i].events & EPOLLOUT)
+        flags |= CURL_CSELECT_OUT;
+      if(events[i].events & (EPOLLERR | EPOLLHUP))
+        flags |= CURL_CSELECT_ERR;
+      s->mcode = curl_multi_socket_action(s->multi, events[i].data.fd, flags,
+                                          &s->still_running);
+    }
+    if(!s->mcode && s->timer_set &&
+       (curlx_timediff(curlx_now(), s->timer_at) >= 0)) {
+      s->timer_set = FALSE;
+      s->mcode = curl_multi_socket_action(s->multi, CURL_SOCKET_TIMEOUT, 0,
+                                          &s->still_running);
+    }
+#ifdef USE_IO_URING
+    if(s->ring)
+      /* wakes up those waiting for buffers given back */
+      uring_complete(s->ring);
+#endif
+    if(!s->mcode)
+      result = check_finished(s);
+  }
+
+  curl_multi_setopt(s->multi, CURLMOPT_SOCKETFUNCTION, NULL);
+  curl_multi_setopt(s->multi, CURLMOPT_TIMERFUNCTION, NULL);
+  close(s->epfd);
+  s->epfd = -1;
+  *resultp = result;
+  return TRUE;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
 static CURLcode parallel_transfers(CURLSH *share)
 {
   CURLcode result;
   struct parastate p;
   struct parastate *s = &p;
+  memset(s, 0, sizeof(*s));
   s->share = share;
   s->mcode = CURLM_OK;
   s->result = CURLE_OK;
@@ -1769,13 +3212,56 @@ static CURLcode parallel_transfers(CURLSH *share)
   s->wrapitup = FALSE;
   s->wrapitup_processed = FALSE;
   s->tick = time(NULL);
+  ratelimit_init(&s->rl);
   s->multi = curl_multi_init();
   if(!s->multi)
     return CURLE_OUT_OF_MEMORY;
+  if(global->runshare && global->runshare->maxconnects)
+    curl_multi_setopt(s->multi, CURLMOPT_MAXCONNECTS,
+                      global->runshare->maxconnects);
+
+#ifdef USE_PARALLEL_THREADS
+  if((global->parallel_threads > 1)
+#ifdef DEBUGBUILD
+     && !global->test_event_based
+#endif
+    ) {
+    result = parallel_start_workers(s);
+    if(result) {
+      curl_multi_cleanup(s->multi);
+      return result;
+    }
+  }
+#endif
 
-  result = add_parallel_transfers(s->multi, s->share,
-                                  &s->more_transfers, &s->added_transfers);
+#ifdef USE_IO_URING
+  if(global->io_uring
+#ifdef USE_PARALLEL_THREADS
+     && !s->nworkers
+#endif
+#ifdef DEBUGBUILD
+     && !global->test_event_based
+#endif
+    ) {
+    /* two buffers for each transfer, one filled while one is written */
+    if(uring_init(&s->uring, 2 * (unsigned int)global->parallel_max))
+      s->ring = &s->uring;
+    else
+      warnf("io_uring is not available, --io-uring is ignored");
+  }
+#endif
+
+  result = add_parallel_transfers(s, &s->more_transfers, &s->added_transfers);
   if(result) {
+#ifdef USE_PARALLEL_THREADS
+    parallel_stop_workers(s);
+#endif
+#ifdef USE_IO_URING
+    if(s->ring)
+      uring_cleanup(s->ring);
+#endif
+    tool_safefree(s->delayed);
+    ratelimit_cleanup(&s->rl);
     curl_multi_cleanup(s->multi);
     return result;
   }
@@ -1790,34 +3276,22 @@ static CURLcode parallel_transfers(CURLSH *share)
   else
 #endif
 
-  if(all_added) {
-    while(!s->mcode && (s->still_running || s->more_transfers)) {
-      /* If stopping prematurely (eg due to a --fail-early condition) then
-         signal that any transfers in the multi should abort (via progress
-         callback). */
-      if(s->wrapitup) {
-        if(!s->still_running)
-          break;
-        if(!s->wrapitup_processed) {
-          struct per_transfer *per;
-          for(per = transfers; per; per = per->next) {
-            if(per->added)
-              per->abort = TRUE;
-          }
-          s->wrapitup_processed = TRUE;
-        }
-      }
-
-      s->mcode = curl_multi_poll(s->multi, NULL, 0, 1000, NULL);
-      if(!s->mcode)
-        s->mcode = curl_multi_perform(s->multi, &s->still_running);
-      if(!s->mcode)
-        result = check_finished(s);
-    }
-
-    (void)progress_meter(s->multi, &s->start, TRUE);
+  if(global->all_added) {
+#ifdef HAVE_SYS_EPOLL_H
+    if(
+#ifdef DEBUGBUILD
+       getenv("CURL_PARALLEL_POLL") ||
+#endif
+       !parallel_epoll(s, &result))
+#endif
+      result = parallel_poll(s);
+    parallel_progress(s, TRUE);
   }
 
+#ifdef USE_PARALLEL_THREADS
+  parallel_stop_workers(s);
+#endif
+
   /* Make sure to return some kind of error if there was a multi problem */
   if(s->mcode) {
     result = (s->mcode == CURLM_OUT_OF_MEMORY) ? CURLE_OUT_OF_MEMORY :
@@ -1826,6 +3300,12 @@ static CURLcode parallel_transfers(CURLSH *share)
       CURLE_BAD_FUNCTION_ARGUMENT;
   }
 
+#ifdef USE_IO_URING
+  if(s->ring)
+    uring_cleanup(s->ring);
+#endif
+  tool_safefree(s->delayed);
+  ratelimit_cleanup(&s->rl);
   curl_multi_cleanup(s->multi);
 
   return result;
@@ -1846,7 +3326,7 @@ static CURLcode serial_transfers(CURLSH *share)
     errorf("no transfer performed");
     return CURLE_READ_ERROR;
   }
-  for(per = transfers; per;) {
+  for(per = global->transfers; per;) {
     bool retry;
     long delay_ms;
     bool bailout = FALSE;
@@ -1895,7 +3375,9 @@ static CURLcode serial_transfers(CURLSH *share)
     /* Bail out upon critical errors or --fail-early */
     if(is_fatal_error(returncode) || (returncode && global->fail_early))
       bailout = TRUE;
-    else {
+    else if(!per->next) {
+      /* after skipped ones the next is set up already, a transfer set up
+         before that one is done could miss what it leaves in the cache */
       do {
         /* setup the next one just before we delete this */
         result = create_transfer(share, &added, &skipped);
@@ -1938,9 +3420,8 @@ static CURLcode serial_transfers(CURLSH *share)
 static CURLcode is_using_schannel(int *using)
 {
   CURLcode result = CURLE_OK;
-  static int using_schannel = -1; /* -1 = not checked
-                                     0 = nope
-                                     1 = yes */
+  /* -1 = not checked, 0 = nope, 1 = yes */
+  static TOOL_THREAD_LOCAL int using_schannel = -1;
   if(using_schannel == -1) {
     CURL *curltls = curl_easy_init();
     /* The TLS backend remains, so keep the info */
@@ -2096,9 +3577,6 @@ static CURLcode create_transfer(CURLSH *share,
 static CURLcode run_all_transfers(CURLSH *share,
                                   CURLcode result)
 {
-  /* Save the values of noprogress and isatty to restore them later on */
-  bool orig_noprogress = global->noprogress;
-  bool orig_isatty = global->isatty;
   struct per_transfer *per;
 
   /* Time to actually do the transfers */
@@ -2110,7 +3588,7 @@ static CURLcode run_all_transfers(CURLSH *share,
   }
 
   /* cleanup if there are any left */
-  for(per = transfers; per;) {
+  for(per = global->transfers; per;) {
     bool retry;
     long delay;
     CURLcode result2 = post_per_transfer(per, result, &retry, &delay);
@@ -2123,16 +3601,12 @@ static CURLcode run_all_transfers(CURLSH *share,
 
     per = del_per_transfer(per);
   }
-
-  /* Reset the global config variables */
-  global->noprogress = orig_noprogress;
-  global->isatty = orig_isatty;
-
+  dedupe_cleanup();
 
   return result;
 }
 
-CURLcode operate(int argc, argv_item_t argv[])
+CURLcode operate_parse(int argc, argv_item_t argv[], bool *done)
 {
   CURLcode result = CURLE_OK;
   const char *first_arg;
@@ -2142,11 +3616,7 @@ CURLcode operate(int argc, argv_item_t argv[])
   first_arg = argc > 1 ? convert_tchar_to_UTF8(argv[1]) : NULL;
 #endif
 
-#ifdef HAVE_SETLOCALE
-  /* Override locale for number parsing (only) */
-  setlocale(LC_ALL, "");
-  setlocale(LC_NUMERIC, "C");
-#endif
+  *done = FALSE;
 
   /* Parse .curlrc if necessary */
   if((argc == 1) ||
@@ -2168,6 +3638,7 @@ CURLcode operate(int argc, argv_item_t argv[])
     ParameterError res = parse_args(argc, argv);
     if(res) {
       result = CURLE_OK;
+      *done = TRUE;
 
       /* Check if we were asked for the help */
       if(res == PARAM_HELP_REQUESTED)
@@ -2200,75 +3671,146 @@ CURLcode operate(int argc, argv_item_t argv[])
         result = CURLE_FAILED_INIT;
     }
     else {
+      size_t count = 0;
+      struct OperationConfig *operation = global->first;
+
+      /* Get the required arguments for each operation */
+      do {
+        result = get_args(operation, count++);
+
+        operation = operation->next;
+      } while(!result && operation);
+    }
+  }
+
+  return result;
+}
+
+#ifdef USE_PARALLEL_THREADS
+/* the share is used by several threads with --parallel-threads */
+struct sharelocks {
+  curl_mutex_t lock[CURL_LOCK_DATA_LAST];
+};
+
+static void share_lock(CURL *handle, curl_lock_data data,
+                       curl_lock_access access, void *userptr)
+{
+  struct sharelocks *locks = userptr;
+  (void)handle;
+  (void)access;
+  Curl_mutex_acquire(&locks->lock[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+  struct sharelocks *locks = userptr;
+  (void)handle;
+  Curl_mutex_release(&locks->lock[data]);
+}
+#endif
+
+CURLcode operate_run(void)
+{
+  CURLcode result = CURLE_OK;
+#ifdef USE_PARALLEL_THREADS
+  struct sharelocks locks;
+  /* connections cannot move between threads, so a threaded run does not get
+     the runner's shared connections */
+  bool threaded = global->parallel && (global->parallel_threads > 1);
+#else
+  bool threaded = FALSE;
+#endif
+  bool ownshare = !global->runshare || threaded;
+
+  if(global->libcurl) {
+    /* Initialise the libcurl source output */
+    result = easysrc_init();
+  }
+
+  /* Perform the main operations */
+  if(!result) {
+    CURLSH *share = ownshare ? curl_share_init() :
+      global->runshare->share;
+    if(!share) {
       if(global->libcurl) {
-        /* Initialise the libcurl source output */
-        result = easysrc_init();
+        /* Cleanup the libcurl source output */
+        easysrc_cleanup();
       }
+      result = CURLE_OUT_OF_MEMORY;
+    }
 
-      /* Perform the main operations */
-      if(!result) {
-        size_t count = 0;
-        struct OperationConfig *operation = global->first;
-        CURLSH *share = curl_share_init();
-        if(!share) {
-          if(global->libcurl) {
-            /* Cleanup the libcurl source output */
-            easysrc_cleanup();
-          }
-          result = CURLE_OUT_OF_MEMORY;
-        }
+    if(!result && ownshare) {
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt(share, CURLSHOPT_SHARE,
+                        CURL_LOCK_DATA_SSL_SESSION);
+      /* Running parallel, use the multi connection cache */
+      if(!global->parallel)
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_PSL);
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_HSTS);
+#ifdef USE_PARALLEL_THREADS
+      if(threaded) {
+        int i;
+        for(i = 0; i < CURL_LOCK_DATA_LAST; i++)
+          Curl_mutex_init(&locks.lock[i]);
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, &locks);
+      }
+#endif
+    }
 
-        if(!result) {
-          curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
-          curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
-          curl_share_setopt(share, CURLSHOPT_SHARE,
-                            CURL_LOCK_DATA_SSL_SESSION);
-          /* Running parallel, use the multi connection cache */
-          if(!global->parallel)
-            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
-          curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_PSL);
-          curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_HSTS);
-
-          if(global->ssl_sessions && feature_ssls_export)
-            result = tool_ssls_load(global->first, share,
-                                    global->ssl_sessions);
-
-          if(!result) {
-            /* Get the required arguments for each operation */
-            do {
-              result = get_args(operation, count++);
-
-              operation = operation->next;
-            } while(!result && operation);
-
-            /* Set the current operation pointer */
-            global->current = global->first;
-
-            /* now run! */
-            result = run_all_transfers(share, result);
-
-            if(global->ssl_sessions && feature_ssls_export) {
-              CURLcode r2 = tool_ssls_save(global->first, share,
-                                           global->ssl_sessions);
-              if(r2 && !result)
-                result = r2;
-            }
-          }
+    if(!result) {
+      if(global->ssl_sessions && feature_ssls_export)
+        result = tool_ssls_load(global->first, share,
+                                global->ssl_sessions);
 
-          curl_share_cleanup(share);
-          if(global->libcurl) {
-            /* Cleanup the libcurl source output */
-            easysrc_cleanup();
+      /* Set the current operation pointer */
+      global->current = global->first;
 
-            /* Dump the libcurl code if previously enabled */
-            dumpeasysrc();
-          }
+      /* now run! */
+      result = run_all_transfers(share, result);
+
+      if(global->ssl_sessions && feature_ssls_export) {
+        CURLcode r2 = tool_ssls_save(global->first, share,
+                                     global->ssl_sessions);
+        if(r2 && !result)
+          result = r2;
+      }
+
+      if(ownshare) {
+        curl_share_cleanup(share);
+#ifdef USE_PARALLEL_THREADS
+        if(threaded) {
+          int i;
+          for(i = 0; i < CURL_LOCK_DATA_LAST; i++)
+            Curl_mutex_destroy(&locks.lock[i]);
         }
+#endif
+      }
+      if(global->libcurl) {
+        /* Cleanup the libcurl source output */
+        easysrc_cleanup();
+
+        /* Dump the libcurl code if previously enabled */
+        dumpeasysrc();
       }
-      else
-        errorf("out of memory");
     }
   }
+  else
+    errorf("out of memory");
+
+  return result;
+}
+
+CURLcode operate(int argc, argv_item_t argv[])
+{
+  bool done;
+  CURLcode result = operate_parse(argc, argv, &done);
+
+  if(!result && !done)
+    result = operate_run();
 
   varcleanup();
   curl_free(global->knownhosts);
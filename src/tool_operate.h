@@ -27,6 +27,26 @@
 #include "tool_cb_hdr.h"
 #include "tool_cb_prg.h"
 #include "tool_sdecls.h"
+#include "tool_uring.h"
+
+#ifdef USE_PARALLEL_THREADS
+#include "curl_threads.h"
+
+struct parworker;
+#endif
+
+struct cache_xfer;
+struct dupe;
+
+/* what the parts of a --segments download share */
+struct segments {
+  CURLSH *share; /* the parts are set up with */
+  char *etag; /* of the file as the HEAD request got it, or NULL */
+  char *lastmod; /* its Last-Modified: or NULL */
+  curl_off_t size; /* of the file */
+  long refs; /* transfers using this */
+  BIT(failed); /* a part failed for good */
+};
 
 struct per_transfer {
   /* double linked */
@@ -43,8 +63,11 @@ struct per_transfer {
   struct curltime retrystart;
   char *url;
   curl_off_t urlnum; /* the index of the given URL */
+  long num; /* sequence number of the transfer in this run */
+  struct CaptureBuffer body; /* for the curl_runner result record */
   char *outfile;
   int infd;
+  FILE *infile; /* 'infd' handed to libcurl to read and send itself */
   struct ProgressData progressbar;
   struct OutStruct outs;
   struct OutStruct heads;
@@ -61,27 +84,61 @@ struct per_transfer {
   curl_off_t ulnow;
   curl_off_t uploadfilesize; /* expected total amount */
   curl_off_t uploadedsofar; /* amount delivered from the callback */
-  BIT(dltotal_added); /* if the total has been added from this */
-  BIT(ultotal_added);
 
   /* NULL or malloced */
   char *uploadfile;
   char *errorbuffer; /* allocated and assigned while this is used for a
                         transfer */
+  /* parallel scheduling */
+  struct per_transfer *rnext; /* in the ready queue, global->ready */
+  struct per_transfer *rprev;
+  struct per_transfer *qnext; /* in a done list, or a worker's in queue */
+  CURLcode qresult; /* how it ended, in a done list */
+  struct ratehost *ratehost; /* its host in the rate limits, or NULL */
+  struct curl_slist *resumeheaders; /* config->headers and If-Range: when a
+                                       retry resumes */
+  struct cache_xfer *cache; /* --cache-dir, NULL when not used */
+  struct dupe *dupe; /* --dedupe, the request made for it or by it */
+  struct per_transfer *dnext; /* waiting for the same request */
+  struct segments *segs; /* --segments, NULL when not used */
+#ifdef USE_IO_URING
+  struct uring *uring; /* --io-uring, the ring of the parallel loop or NULL */
+  struct uring_io uio;
+#endif
+#ifdef USE_PARALLEL_THREADS
+  struct parworker *worker; /* the thread running it, NULL for the main one */
+#endif
+  /* not bits, a worker thread running the transfer sets these while the main
+     thread looks at the bits */
+  bool was_last_header_empty;
+  bool dltotal_added; /* if the total has been added to the sums */
+  bool ultotal_added;
+  bool abort; /* when doing parallel transfers and this is TRUE then a critical
+                 error (eg --fail-early) has occurred in another transfer and
+                 this transfer will be aborted in the progress callback */
   BIT(infdopen); /* TRUE if infd needs closing */
   BIT(noprogress);
-  BIT(was_last_header_empty);
+  BIT(isatty); /* the output goes to a terminal */
 
   BIT(added); /* set TRUE when added to the multi handle */
-  BIT(abort); /* when doing parallel transfers and this is TRUE then a critical
-                 error (eg --fail-early) has occurred in another transfer and
-                 this transfer will be aborted in the progress callback */
+  BIT(queued); /* in the ready queue */
+  BIT(retry); /* queued again after a failed attempt */
+  BIT(ratestarted); /* counted as running in its ratehost */
+  BIT(resumed); /* this attempt continues where the previous one stopped */
   BIT(skip);  /* considered already done */
+  BIT(deduped); /* got the output of another transfer's request */
+  BIT(segprobe); /* the HEAD request --segments starts with */
 };
 
 CURLcode operate(int argc, argv_item_t argv[]);
-void single_transfer_cleanup(void);
 
-extern struct per_transfer *transfers; /* first node */
+/* The two halves of operate(): parsing .curlrc and the arguments into the
+   global config, setting *done when they asked for something already taken
+   care of like --version, then running the transfers of that config. Kept
+   apart so that a curl_runner plan can parse once and run copies of the
+   parsed config any number of times. */
+CURLcode operate_parse(int argc, argv_item_t argv[], bool *done);
+CURLcode operate_run(void);
+void single_transfer_cleanup(void);
 
 #endif /* HEADER_CURL_TOOL_OPERATE_H */
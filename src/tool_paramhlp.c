@@ -39,8 +39,6 @@ struct getout *new_getout(struct OperationConfig *config)
   struct getout *node = calloc(1, sizeof(struct getout));
   struct getout *last = config->url_last;
   if(node) {
-    static int outnum = 0;
-
     /* append this new node last in the list */
     if(last)
       last->next = node;
@@ -51,7 +49,7 @@ struct getout *new_getout(struct OperationConfig *config)
     config->url_last = node;
 
     node->useremote = config->remote_name_all;
-    node->num = outnum++;
+    node->num = global->outnum++;
   }
   return node;
 }
@@ -83,6 +81,21 @@ static size_t memcrlf(char *orig,
   return total; /* no delimiter found */
 }
 
+/* A --url @- list is read from stdin while the transfers run, so stdin
+   cannot be read for anything else then. 'urls' is set for the list. */
+ParameterError stdin_claim(bool urls)
+{
+  if(global->stdin_urls || (urls && global->stdin_used)) {
+    errorf("stdin cannot be read for both --url @- and another option");
+    return PARAM_BAD_USE;
+  }
+  if(urls)
+    global->stdin_urls = TRUE;
+  else
+    global->stdin_used = TRUE;
+  return PARAM_OK;
+}
+
 #define MAX_FILE2STRING MAX_FILE2MEMORY
 
 ParameterError file2string(char **bufp, FILE *file)
@@ -119,7 +132,7 @@ ParameterError file2string(char **bufp, FILE *file)
   return PARAM_OK;
 }
 
-static int myfseek(void *stream, curl_off_t offset, int whence)
+int tool_fseek(void *stream, curl_off_t offset, int whence)
 {
 #if defined(_WIN32) && defined(USE_WIN32_LARGE_FILES)
   return _fseeki64(stream, (__int64)offset, whence);
@@ -143,7 +156,7 @@ ParameterError file2memory_range(char **bufp, size_t *size, FILE *file,
 
     if(starto) {
       if(file != stdin) {
-        if(myfseek(file, starto, SEEK_SET))
+        if(tool_fseek(file, starto, SEEK_SET))
           return PARAM_READ_ERROR;
         offset = starto;
       }
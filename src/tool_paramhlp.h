@@ -29,6 +29,7 @@
 struct getout *new_getout(struct OperationConfig *config);
 
 ParameterError file2string(char **bufp, FILE *file);
+ParameterError stdin_claim(bool urls);
 
 #if SIZEOF_SIZE_T > 4
 #define MAX_FILE2MEMORY (16LL*1024*1024*1024)
@@ -36,6 +37,9 @@ ParameterError file2string(char **bufp, FILE *file);
 #define MAX_FILE2MEMORY (INT_MAX)
 #endif
 
+/* fseek() that takes large file offsets where it can */
+int tool_fseek(void *stream, curl_off_t offset, int whence);
+
 ParameterError file2memory(char **bufp, size_t *size, FILE *file);
 ParameterError file2memory_range(char **bufp, size_t *size, FILE *file,
                                  curl_off_t starto, curl_off_t endo);
@@ -28,6 +28,7 @@
 #include "tool_helpers.h"
 #include "tool_findfile.h"
 #include "tool_msgs.h"
+#include "tool_paramhlp.h"
 #include "tool_parsecfg.h"
 #include "tool_util.h"
 #include "memdebug.h" /* keep this as LAST include */
@@ -116,6 +117,8 @@ int parseconfig(const char *filename)
   else {
     if(strcmp(filename, "-"))
       file = fopen(filename, FOPEN_READTEXT);
+    else if(stdin_claim(FALSE))
+      return 1;
     else
       file = stdin;
   }
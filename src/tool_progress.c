@@ -76,6 +76,23 @@ static char *max5data(curl_off_t bytes, char *max5)
   return max5;
 }
 
+/* with worker threads, the sums are changed from several threads */
+static void sums_lock(void)
+{
+#ifdef USE_PARALLEL_THREADS
+  if(global->proglock)
+    Curl_mutex_acquire(global->proglock);
+#endif
+}
+
+static void sums_unlock(void)
+{
+#ifdef USE_PARALLEL_THREADS
+  if(global->proglock)
+    Curl_mutex_release(global->proglock);
+#endif
+}
+
 int xferinfo_cb(void *clientp,
                 curl_off_t dltotal,
                 curl_off_t dlnow,
@@ -84,10 +101,34 @@ int xferinfo_cb(void *clientp,
 {
   struct per_transfer *per = clientp;
   struct OperationConfig *config = per->config;
-  per->dltotal = dltotal;
-  per->dlnow = dlnow;
-  per->ultotal = ultotal;
-  per->ulnow = ulnow;
+
+  /* only the thread running the transfer changes its numbers, the sums get
+     what changed since the last call */
+  if((dlnow != per->dlnow) || (ulnow != per->ulnow) ||
+     (dltotal != per->dltotal) || (ultotal != per->ultotal)) {
+    struct ProgressMeter *pm = &global->progress;
+    sums_lock();
+    pm->all_dlnow += dlnow - per->dlnow;
+    pm->all_ulnow += ulnow - per->ulnow;
+    if(!dltotal != !per->dltotal)
+      pm->dlunknown += dltotal ? -1 : 1;
+    if(!ultotal != !per->ultotal)
+      pm->ulunknown += ultotal ? -1 : 1;
+    if(dltotal && !per->dltotal_added) {
+      /* only add this amount once */
+      pm->all_dltotal += dltotal;
+      per->dltotal_added = TRUE;
+    }
+    if(ultotal && !per->ultotal_added) {
+      pm->all_ultotal += ultotal;
+      per->ultotal_added = TRUE;
+    }
+    sums_unlock();
+    per->dltotal = dltotal;
+    per->dlnow = dlnow;
+    per->ultotal = ultotal;
+    per->ulnow = ulnow;
+  }
 
   if(per->abort)
     return 1;
@@ -129,20 +170,39 @@ static void time2str(char *r, curl_off_t seconds)
   }
 }
 
-static curl_off_t all_dltotal = 0;
-static curl_off_t all_ultotal = 0;
-static curl_off_t all_dlalready = 0;
-static curl_off_t all_ulalready = 0;
-
-struct speedcount {
-  curl_off_t dl;
-  curl_off_t ul;
-  struct curltime stamp;
-};
-#define SPEEDCNT 10
-static unsigned int speedindex;
-static bool indexwrapped;
-static struct speedcount speedstore[SPEEDCNT];
+/* --progress-fd: one JSON object per line for programs to read */
+static void progress_json(bool final, curl_off_t spent_ms,
+                          curl_off_t dlnow, curl_off_t ulnow,
+                          curl_off_t dltotal, curl_off_t ultotal,
+                          curl_off_t xfers_added, curl_off_t xfers_running,
+                          curl_off_t speed)
+{
+  char line[320];
+  char dlt[24] = "null";
+  char ult[24] = "null";
+  ssize_t rc;
+  int len;
+
+  if(dltotal >= 0)
+    msnprintf(dlt, sizeof(dlt), "%" CURL_FORMAT_CURL_OFF_T, dltotal);
+  if(ultotal >= 0)
+    msnprintf(ult, sizeof(ult), "%" CURL_FORMAT_CURL_OFF_T, ultotal);
+  len = msnprintf(line, sizeof(line),
+                  "{\"time_ms\":%" CURL_FORMAT_CURL_OFF_T ","
+                  "\"dl\":%" CURL_FORMAT_CURL_OFF_T ","
+                  "\"ul\":%" CURL_FORMAT_CURL_OFF_T ","
+                  "\"dl_total\":%s,"
+                  "\"ul_total\":%s,"
+                  "\"xfers\":%" CURL_FORMAT_CURL_OFF_T ","
+                  "\"live\":%" CURL_FORMAT_CURL_OFF_T ","
+                  "\"speed\":%" CURL_FORMAT_CURL_OFF_T ","
+                  "\"final\":%s}\n",
+                  spent_ms, dlnow, ulnow, dlt, ult, xfers_added,
+                  xfers_running, speed, final ? "true" : "false");
+  /* a reader that went away does not stop the transfers */
+  rc = write(global->progress_fd, line, (size_t)len);
+  (void)rc;
+}
 
 /*
   |DL% UL%  Dled  Uled  Xfers  Live Total     Current  Left    Speed
@@ -152,19 +212,19 @@ bool progress_meter(CURLM *multi,
                     struct curltime *start,
                     bool final)
 {
-  static struct curltime stamp;
-  static bool header = FALSE;
+  struct ProgressMeter *pm = &global->progress;
   struct curltime now;
   timediff_t diff;
+  bool show = !global->noprogress && !pm->noprogress && !global->silent;
 
-  if(global->noprogress || global->silent)
+  if(!show && !global->progress_fd)
     return FALSE;
 
   now = curlx_now();
-  diff = curlx_timediff(now, stamp);
+  diff = curlx_timediff(now, pm->stamp);
 
-  if(!header) {
-    header = TRUE;
+  if(show && !pm->header) {
+    pm->header = TRUE;
     fputs("DL% UL%  Dled  Uled  Xfers  Live "
           "Total     Current  Left    Speed\n",
           tool_stderr);
@@ -177,39 +237,27 @@ bool progress_meter(CURLM *multi,
     curl_off_t spent = curlx_timediff(now, *start)/1000;
     char dlpercen[4]="--";
     char ulpercen[4]="--";
-    struct per_transfer *per;
-    curl_off_t all_dlnow = 0;
-    curl_off_t all_ulnow = 0;
+    curl_off_t all_dlnow;
+    curl_off_t all_ulnow;
+    curl_off_t all_dltotal;
+    curl_off_t all_ultotal;
     curl_off_t xfers_added = 0;
     curl_off_t xfers_running = 0;
-    bool dlknown = TRUE;
-    bool ulknown = TRUE;
+    bool dlknown;
+    bool ulknown;
     curl_off_t speed = 0;
     unsigned int i;
-    stamp = now;
-
-    /* first add the amounts of the already completed transfers */
-    all_dlnow += all_dlalready;
-    all_ulnow += all_ulalready;
-
-    for(per = transfers; per; per = per->next) {
-      all_dlnow += per->dlnow;
-      all_ulnow += per->ulnow;
-      if(!per->dltotal)
-        dlknown = FALSE;
-      else if(!per->dltotal_added) {
-        /* only add this amount once */
-        all_dltotal += per->dltotal;
-        per->dltotal_added = TRUE;
-      }
-      if(!per->ultotal)
-        ulknown = FALSE;
-      else if(!per->ultotal_added) {
-        /* only add this amount once */
-        all_ultotal += per->ultotal;
-        per->ultotal_added = TRUE;
-      }
-    }
+    pm->stamp = now;
+
+    sums_lock();
+    all_dlnow = pm->all_dlnow;
+    all_ulnow = pm->all_ulnow;
+    all_dltotal = pm->all_dltotal;
+    all_ultotal = pm->all_ultotal;
+    dlknown = !pm->dlunknown;
+    ulknown = !pm->ulunknown;
+    sums_unlock();
+
     if(dlknown && all_dltotal)
       msnprintf(dlpercen, sizeof(dlpercen), "%3" CURL_FORMAT_CURL_OFF_T,
                 all_dlnow < (CURL_OFF_T_MAX/100) ?
@@ -221,16 +269,15 @@ bool progress_meter(CURLM *multi,
                 all_ulnow < (CURL_OFF_T_MAX/100) ?
                 (all_ulnow * 100 / all_ultotal) :
                 (all_ulnow / (all_ultotal/100)));
-
     /* get the transfer speed, the higher of the two */
 
-    i = speedindex;
-    speedstore[i].dl = all_dlnow;
-    speedstore[i].ul = all_ulnow;
-    speedstore[i].stamp = now;
-    if(++speedindex >= SPEEDCNT) {
-      indexwrapped = TRUE;
-      speedindex = 0;
+    i = pm->speedindex;
+    pm->speedstore[i].dl = all_dlnow;
+    pm->speedstore[i].ul = all_ulnow;
+    pm->speedstore[i].stamp = now;
+    if(++pm->speedindex >= SPEEDCNT) {
+      pm->indexwrapped = TRUE;
+      pm->speedindex = 0;
     }
 
     {
@@ -239,11 +286,11 @@ bool progress_meter(CURLM *multi,
       curl_off_t ul;
       curl_off_t dls;
       curl_off_t uls;
-      if(indexwrapped) {
+      if(pm->indexwrapped) {
         /* 'speedindex' is the oldest stored data */
-        deltams = curlx_timediff(now, speedstore[speedindex].stamp);
-        dl = all_dlnow - speedstore[speedindex].dl;
-        ul = all_ulnow - speedstore[speedindex].ul;
+        deltams = curlx_timediff(now, pm->speedstore[pm->speedindex].stamp);
+        dl = all_dlnow - pm->speedstore[pm->speedindex].dl;
+        ul = all_ulnow - pm->speedstore[pm->speedindex].ul;
       }
       else {
         /* since the beginning */
@@ -271,8 +318,22 @@ bool progress_meter(CURLM *multi,
     }
     time2str(time_spent, spent);
 
-    (void)curl_multi_get_offt(multi, CURLMINFO_XFERS_ADDED, &xfers_added);
-    (void)curl_multi_get_offt(multi, CURLMINFO_XFERS_RUNNING, &xfers_running);
+    if(multi) {
+      (void)curl_multi_get_offt(multi, CURLMINFO_XFERS_ADDED, &xfers_added);
+      (void)curl_multi_get_offt(multi, CURLMINFO_XFERS_RUNNING,
+                                &xfers_running);
+    }
+    else {
+      /* added up by the caller */
+      xfers_added = pm->xfers_added;
+      xfers_running = pm->xfers_running;
+    }
+    if(global->progress_fd)
+      progress_json(final, curlx_timediff(now, *start), all_dlnow, all_ulnow,
+                    dlknown ? all_dltotal : -1, ulknown ? all_ultotal : -1,
+                    xfers_added, xfers_running, speed);
+    if(!show)
+      return FALSE;
     fprintf(tool_stderr,
             "\r"
             "%-3s " /* percent downloaded */
@@ -303,17 +364,42 @@ bool progress_meter(CURLM *multi,
   return FALSE;
 }
 
+void progress_add(struct per_transfer *per)
+{
+  struct ProgressMeter *pm = &global->progress;
+  sums_lock();
+  if(!per->dltotal)
+    pm->dlunknown++;
+  if(!per->ultotal)
+    pm->ulunknown++;
+  sums_unlock();
+}
+
 void progress_finalize(struct per_transfer *per)
 {
-  /* get the numbers before this transfer goes away */
-  all_dlalready += per->dlnow;
-  all_ulalready += per->ulnow;
+  struct ProgressMeter *pm = &global->progress;
+  /* what it got stays in the sums, a retry of it counts from zero again */
+  sums_lock();
   if(!per->dltotal_added) {
-    all_dltotal += per->dltotal;
+    pm->all_dltotal += per->dltotal;
     per->dltotal_added = TRUE;
   }
   if(!per->ultotal_added) {
-    all_ultotal += per->ultotal;
+    pm->all_ultotal += per->ultotal;
     per->ultotal_added = TRUE;
   }
+  sums_unlock();
+  per->dlnow = 0;
+  per->ulnow = 0;
+}
+
+void progress_remove(struct per_transfer *per)
+{
+  struct ProgressMeter *pm = &global->progress;
+  sums_lock();
+  if(!per->dltotal)
+    pm->dlunknown--;
+  if(!per->ultotal)
+    pm->ulunknown--;
+  sums_unlock();
 }
@@ -25,15 +25,49 @@
  ***************************************************************************/
 #include "tool_setup.h"
 
+struct per_transfer;
+
+struct speedcount {
+  curl_off_t dl;
+  curl_off_t ul;
+  struct curltime stamp;
+};
+#define SPEEDCNT 10
+
+/* state of the parallel progress meter, kept per GlobalConfig. The sums
+   are kept up to date as the numbers of the transfers change, so the meter
+   does not need to go through them. */
+struct ProgressMeter {
+  struct curltime stamp;
+  curl_off_t all_dltotal;
+  curl_off_t all_ultotal;
+  curl_off_t all_dlnow;     /* including the transfers that have ended */
+  curl_off_t all_ulnow;
+  curl_off_t dlunknown;     /* transfers not knowing their size (yet) */
+  curl_off_t ulunknown;
+  struct speedcount speedstore[SPEEDCNT];
+  unsigned int speedindex;
+  curl_off_t xfers_added;   /* the multi counters, when there are several */
+  curl_off_t xfers_running;
+  bool indexwrapped;
+  bool header;
+  bool noprogress;          /* the transfer set up last has no meter */
+};
+
 int xferinfo_cb(void *clientp,
                 curl_off_t dltotal,
                 curl_off_t dlnow,
                 curl_off_t ultotal,
                 curl_off_t ulnow);
 
+/* 'multi' may be NULL, the transfer counts are then in global->progress */
 bool progress_meter(CURLM *multi,
                     struct curltime *start,
                     bool final);
+
+/* a transfer is created, ends and is removed */
+void progress_add(struct per_transfer *per);
 void progress_finalize(struct per_transfer *per);
+void progress_remove(struct per_transfer *per);
 
 #endif /* HEADER_CURL_TOOL_PROGRESS_H */
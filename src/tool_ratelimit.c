@@ -0,0 +1,228 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+#include "tool_cfgable.h"
+#include "tool_ratelimit.h"
+
+#include "memdebug.h" /* keep this as LAST include */
+
+#define RATELIMIT_SLOTS 64 /* initial hash table size */
+
+void ratelimit_init(struct ratelimit *rl)
+{
+  memset(rl, 0, sizeof(*rl));
+  rl->all.interval = global->ms_per_transfer;
+  rl->host_interval = global->host_ms_per_transfer;
+  rl->adaptive = global->parallel_adaptive;
+  rl->host_max = global->parallel_host ? global->parallel_host :
+    global->parallel_max;
+  rl->active = (rl->all.interval || rl->host_interval || rl->adaptive);
+}
+
+void ratelimit_cleanup(struct ratelimit *rl)
+{
+  size_t i;
+  for(i = 0; i < rl->size; i++) {
+    struct ratehost *h = rl->table[i];
+    while(h) {
+      struct ratehost *next = h->next;
+      free(h->name);
+      free(h);
+      h = next;
+    }
+  }
+  tool_safefree(rl->table);
+  rl->size = rl->count = 0;
+}
+
+static size_t host_hash(const char *name)
+{
+  size_t h = 5381;
+  for(; *name; name++) {
+    unsigned char c = (unsigned char)*name;
+    if(ISUPPER(c))
+      c = (unsigned char)(c - 'A' + 'a');
+    h = (h * 33) ^ c;
+  }
+  return h;
+}
+
+/* double the table when it gets crowded, keep going with the old one if
+   that fails */
+static void ratelimit_grow(struct ratelimit *rl)
+{
+  size_t size = rl->size ? rl->size * 2 : RATELIMIT_SLOTS;
+  struct ratehost **table = calloc(size, sizeof(*table));
+  size_t i;
+  if(!table)
+    return;
+  for(i = 0; i < rl->size; i++) {
+    struct ratehost *h = rl->table[i];
+    while(h) {
+      struct ratehost *next = h->next;
+      size_t slot = host_hash(h->name) & (size - 1);
+      h->next = table[slot];
+      table[slot] = h;
+      h = next;
+    }
+  }
+  free(rl->table);
+  rl->table = table;
+  rl->size = size;
+}
+
+struct ratehost *ratelimit_host(struct ratelimit *rl, const char *url)
+{
+  struct ratehost *h;
+  char *name = NULL;
+  size_t slot;
+  CURLU *u = curl_url();
+
+  if(u) {
+    if(!curl_url_set(u, CURLUPART_URL, url,
+                     CURLU_GUESS_SCHEME | CURLU_NON_SUPPORT_SCHEME))
+      (void)curl_url_get(u, CURLUPART_HOST, &name, 0);
+    curl_url_cleanup(u);
+  }
+
+  if(rl->count >= rl->size)
+    ratelimit_grow(rl);
+  if(!rl->size) {
+    curl_free(name);
+    return NULL;
+  }
+
+  slot = host_hash(name ? name : "") & (rl->size - 1);
+  for(h = rl->table[slot]; h; h = h->next) {
+    if(curl_strequal(h->name, name ? name : ""))
+      break;
+  }
+  if(!h) {
+    h = calloc(1, sizeof(*h));
+    if(h) {
+      h->name = strdup(name ? name : "");
+      if(!h->name)
+        tool_safefree(h);
+    }
+    if(h) {
+      h->bucket.interval = rl->host_interval;
+      h->next = rl->table[slot];
+      rl->table[slot] = h;
+      rl->count++;
+    }
+  }
+  curl_free(name);
+  return h;
+}
+
+/* milliseconds until the bucket has a token */
+static timediff_t bucket_wait(struct tokenbucket *b, struct curltime now)
+{
+  timediff_t ms;
+  if(!b->interval)
+    return 0;
+  ms = curlx_timediff_ceil(b->next, now);
+  return (ms > 0) ? ms : 0;
+}
+
+static void bucket_take(struct tokenbucket *b, struct curltime now)
+{
+  if(b->interval) {
+    /* a token not taken when it was there is lost, there is no burst */
+    if(curlx_timediff(now, b->next) > 0)
+      b->next = now;
+    b->next.tv_sec += (time_t)(b->interval / 1000);
+    b->next.tv_usec += (int)((b->interval % 1000) * 1000);
+    if(b->next.tv_usec >= 1000000) {
+      b->next.tv_sec++;
+      b->next.tv_usec -= 1000000;
+    }
+  }
+}
+
+bool ratelimit_ok(struct ratelimit *rl, struct ratehost *host,
+                  struct curltime now, timediff_t *waitp)
+{
+  timediff_t wait = bucket_wait(&rl->all, now);
+
+  if(host) {
+    timediff_t hwait;
+    if(host->is_paused) {
+      hwait = curlx_timediff_ceil(host->paused, now);
+      if(hwait > 0) {
+        *waitp = hwait;
+        return FALSE;
+      }
+      host->is_paused = FALSE;
+    }
+    if(host->limit && (host->running >= host->limit)) {
+      *waitp = -1;
+      return FALSE;
+    }
+    hwait = bucket_wait(&host->bucket, now);
+    if(hwait > wait)
+      wait = hwait;
+  }
+  *waitp = wait;
+  return !wait;
+}
+
+void ratelimit_start(struct ratelimit *rl, struct ratehost *host,
+                     struct curltime now)
+{
+  bucket_take(&rl->all, now);
+  if(host) {
+    bucket_take(&host->bucket, now);
+    host->running++;
+  }
+}
+
+void ratelimit_done(struct ratelimit *rl, struct ratehost *host,
+                    long response, curl_off_t retry_after)
+{
+  if(!host)
+    return;
+  host->running--;
+  if(!rl->adaptive)
+    return;
+
+  if((response == 429) || (response == 503)) {
+    /* the server wants less, halve what it gets */
+    long now_running = host->limit ? host->limit : host->running + 1;
+    host->limit = (now_running > 1) ? now_running / 2 : 1;
+    if(retry_after > 0) {
+      host->paused = curlx_now();
+      if(retry_after > (curl_off_t)(TIME_T_MAX - host->paused.tv_sec))
+        host->paused.tv_sec = TIME_T_MAX;
+      else
+        host->paused.tv_sec += (time_t)retry_after;
+      host->is_paused = TRUE;
+    }
+  }
+  else if(host->limit && (response / 100 == 2 || response / 100 == 3)) {
+    /* it copes, give it one more */
+    if(++host->limit >= rl->host_max)
+      host->limit = 0;
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef HEADER_CURL_TOOL_RATELIMIT_H
+#define HEADER_CURL_TOOL_RATELIMIT_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+/* Pacing of transfer starts, a token bucket holding a single token. 'next'
+   is when the next token is there. */
+struct tokenbucket {
+  timediff_t interval;    /* milliseconds per token, 0 = unlimited */
+  struct curltime next;
+};
+
+/* what the parallel scheduler knows about a host */
+struct ratehost {
+  struct ratehost *next;  /* in the hash chain */
+  char *name;
+  struct tokenbucket bucket;
+  struct curltime paused; /* no new transfers before this, Retry-After */
+  long running;           /* transfers started and not ended */
+  long limit;             /* adaptive concurrency, 0 = no limit */
+  BIT(is_paused);
+};
+
+struct ratelimit {
+  struct ratehost **table;
+  size_t size;            /* slots in the table */
+  size_t count;           /* hosts in the table */
+  struct tokenbucket all; /* --rate */
+  timediff_t host_interval; /* --parallel-host-rate */
+  long host_max;          /* the adaptive limit grows up to this */
+  BIT(adaptive);          /* --parallel-adaptive */
+  BIT(active);            /* any of them */
+};
+
+void ratelimit_init(struct ratelimit *rl);
+void ratelimit_cleanup(struct ratelimit *rl);
+
+/* the host entry for a URL, NULL if out of memory */
+struct ratehost *ratelimit_host(struct ratelimit *rl, const char *url);
+
+/* TRUE if a transfer to 'host' may start now, otherwise '*waitp' is set to
+   the milliseconds until it might, or -1 if it waits for a transfer to end */
+bool ratelimit_ok(struct ratelimit *rl, struct ratehost *host,
+                  struct curltime now, timediff_t *waitp);
+
+void ratelimit_start(struct ratelimit *rl, struct ratehost *host,
+                     struct curltime now);
+
+/* a transfer to 'host' ended with this response code and Retry-After */
+void ratelimit_done(struct ratelimit *rl, struct ratehost *host,
+                    long response, curl_off_t retry_after);
+
+#endif /* HEADER_CURL_TOOL_RATELIMIT_H */
@@ -0,0 +1,946 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+
+/*
+ * The reentrant curl_runner entry points. Unlike curl_main(), which runs the
+ * whole tool including the libcurl global init and cleanup, these keep
+ * libcurl initialized in a context and run the tool with a GlobalConfig that
+ * is private to the call and the calling thread.
+ */
+
+#include "tool_setup.h"
+
+#include "curl_runner.h"
+
+#include "tool_cfgable.h"
+#include "tool_libinfo.h"
+#include "tool_main.h"
+#include "tool_msgs.h"
+#include "tool_operate.h"
+#include "tool_paramhlp.h"
+#include "tool_runner.h"
+#include "tool_stderr.h"
+#include "var.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "easy_lock.h"
+#include "curl_threads.h"
+
+#include "memdebug.h" /* keep this as LAST include */
+
+/* A warm share lent to one run at a time. libcurl does not allow concurrent
+   threads to use the same connection pool, so a context keeps a few of them
+   around and a run takes one for itself. */
+struct runner_pool {
+  struct runner_pool *next;
+  struct RunnerShare rs;
+  struct curltime idle_since;
+};
+
+#if defined(TOOL_NO_THREAD_LOCAL) && \
+  (defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32))
+/* the tool state is not thread-local, the runs of a context take turns */
+#define RUNNER_EXEC_MUTEX
+#endif
+
+struct curl_runner_ctx {
+#if defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)
+  curl_mutex_t mutex;             /* protects the pool list */
+#endif
+#ifdef RUNNER_EXEC_MUTEX
+  curl_mutex_t exec;              /* held by the running call */
+#endif
+  struct runner_pool *idle;       /* pools not in use, most recent first */
+  long num_idle;
+  long keep;                      /* CURLRUNNER_KEEP_* */
+  long maxpools;
+  long pool_idle_timeout;         /* seconds */
+  long maxconnects;
+  long maxage_conn;
+  long dns_cache_timeout;
+  BIT(libcurl_init); /* holds a curl_global_init() reference */
+};
+
+#if defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)
+#define ctx_lock(c) Curl_mutex_acquire(&(c)->mutex)
+#define ctx_unlock(c) Curl_mutex_release(&(c)->mutex)
+#else
+#define ctx_lock(c) tool_nop_stmt
+#define ctx_unlock(c) tool_nop_stmt
+#endif
+
+#define RUNNER_MAXPOOLS 4
+#define RUNNER_POOL_IDLE_TIMEOUT 300
+
+#ifdef GLOBAL_INIT_IS_THREADSAFE
+static curl_simple_lock s_lock = CURL_SIMPLE_LOCK_INIT;
+#define runner_lock() curl_simple_lock_lock(&s_lock)
+#define runner_unlock() curl_simple_lock_unlock(&s_lock)
+#else
+#define runner_lock() tool_nop_stmt
+#define runner_unlock() tool_nop_stmt
+#endif
+
+/* the tool's view of libcurl is process-wide and only set up once */
+static bool libinfo_done;
+
+#ifdef RUNNER_EXEC_MUTEX
+#define exec_lock(c) Curl_mutex_acquire(&(c)->exec)
+#define exec_unlock(c) Curl_mutex_release(&(c)->exec)
+#else
+/* either the tool state is thread-local, or there are no threads and the
+   application calls from one thread at a time */
+#define exec_lock(c) tool_nop_stmt
+#define exec_unlock(c) tool_nop_stmt
+#endif
+
+static void pool_free(struct runner_pool *pool)
+{
+  curl_share_cleanup(pool->rs.share);
+  free(pool);
+}
+
+static void pool_free_list(struct runner_pool *pool)
+{
+  while(pool) {
+    struct runner_pool *next = pool->next;
+    pool_free(pool);
+    pool = next;
+  }
+}
+
+/* Unlink the idle pools that have not been used for too long or that exceed
+   the maximum count and return them, the caller frees them unlocked since
+   that closes connections. The list is sorted by last use. */
+static struct runner_pool *pool_expire(curl_runner_ctx *ctx,
+                                       struct curltime now)
+{
+  struct runner_pool **anchor = &ctx->idle;
+  struct runner_pool *expired;
+  long count = 0;
+
+  while(*anchor) {
+    struct runner_pool *pool = *anchor;
+    if((count >= ctx->maxpools) ||
+       (curlx_timediff(now, pool->idle_since) >=
+        (timediff_t)ctx->pool_idle_timeout * 1000))
+      break;
+    count++;
+    anchor = &pool->next;
+  }
+  expired = *anchor;
+  *anchor = NULL;
+  ctx->num_idle = count;
+  return expired;
+}
+
+static struct runner_pool *pool_create(void)
+{
+  struct runner_pool *pool = calloc(1, sizeof(*pool));
+  if(!pool)
+    return NULL;
+  pool->rs.share = curl_share_init();
+  if(!pool->rs.share) {
+    free(pool);
+    return NULL;
+  }
+  /* the same data a single run of the tool shares between its transfers */
+  curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+  curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE,
+                    CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_PSL);
+  curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_HSTS);
+  return pool;
+}
+
+/* Drop what the context is not configured to carry over to the next run.
+   Returns FALSE if the pool cannot be reused. */
+static bool pool_forget(struct runner_pool *pool, long keep)
+{
+  static const struct {
+    long keep;
+    curl_lock_data data;
+  } resettable[] = {
+    { CURLRUNNER_KEEP_SSL_SESSION, CURL_LOCK_DATA_SSL_SESSION },
+    { CURLRUNNER_KEEP_COOKIE, CURL_LOCK_DATA_COOKIE },
+    { CURLRUNNER_KEEP_HSTS, CURL_LOCK_DATA_HSTS },
+  };
+  size_t i;
+
+  for(i = 0; i < CURL_ARRAYSIZE(resettable); i++) {
+    if(!(keep & resettable[i].keep) &&
+       (curl_share_setopt(pool->rs.share, CURLSHOPT_UNSHARE,
+                          resettable[i].data) ||
+        curl_share_setopt(pool->rs.share, CURLSHOPT_SHARE,
+                          resettable[i].data)))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Take a warm pool, or a fresh one, for a run */
+static struct runner_pool *pool_get(curl_runner_ctx *ctx)
+{
+  struct runner_pool *pool = NULL;
+  struct runner_pool *expired;
+
+  ctx_lock(ctx);
+  expired = pool_expire(ctx, curlx_now());
+  if(ctx->idle) {
+    pool = ctx->idle;
+    ctx->idle = pool->next;
+    ctx->num_idle--;
+  }
+  if(pool || ctx->maxpools) {
+    /* settings may have changed since the pool was last used */
+    if(!pool)
+      pool = pool_create();
+    if(pool) {
+      pool->next = NULL;
+      pool->rs.maxconnects = ctx->maxconnects;
+      pool->rs.maxage_conn = ctx->maxage_conn;
+      pool->rs.dns_cache_timeout = ctx->dns_cache_timeout;
+    }
+  }
+  ctx_unlock(ctx);
+
+  pool_free_list(expired);
+  return pool;
+}
+
+/* Return a pool after a run, keeping it warm for the next one */
+static void pool_put(curl_runner_ctx *ctx, struct runner_pool *pool)
+{
+  struct runner_pool *expired;
+  long keep;
+
+  ctx_lock(ctx);
+  keep = ctx->keep;
+  ctx_unlock(ctx);
+  if(!pool_forget(pool, keep)) {
+    pool_free(pool);
+    return;
+  }
+
+  ctx_lock(ctx);
+  pool->idle_since = curlx_now();
+  pool->next = ctx->idle;
+  ctx->idle = pool;
+  ctx->num_idle++;
+  expired = pool_expire(ctx, pool->idle_since);
+  ctx_unlock(ctx);
+
+  pool_free_list(expired);
+}
+
+curl_runner_ctx *curl_runner_init(void)
+{
+  CURLcode result;
+  curl_runner_ctx *ctx = calloc(1, sizeof(*ctx));
+  if(!ctx)
+    return NULL;
+
+#if defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)
+  Curl_mutex_init(&ctx->mutex);
+#endif
+#ifdef RUNNER_EXEC_MUTEX
+  Curl_mutex_init(&ctx->exec);
+#endif
+  ctx->keep = CURLRUNNER_KEEP_DEFAULT;
+  ctx->maxpools = RUNNER_MAXPOOLS;
+  ctx->pool_idle_timeout = RUNNER_POOL_IDLE_TIMEOUT;
+  ctx->maxage_conn = 118; /* libcurl's defaults */
+  ctx->dns_cache_timeout = 60;
+
+  result = curl_global_init(CURL_GLOBAL_DEFAULT);
+  if(!result) {
+    ctx->libcurl_init = TRUE;
+    runner_lock();
+    if(!libinfo_done) {
+      result = get_libcurl_info();
+      libinfo_done = !result;
+    }
+    runner_unlock();
+  }
+  if(result) {
+    curl_runner_cleanup(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+void curl_runner_cleanup(curl_runner_ctx *ctx)
+{
+  if(!ctx)
+    return;
+  pool_free_list(ctx->idle);
+  if(ctx->libcurl_init)
+    curl_global_cleanup();
+#if defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)
+  Curl_mutex_destroy(&ctx->mutex);
+#endif
+#ifdef RUNNER_EXEC_MUTEX
+  Curl_mutex_destroy(&ctx->exec);
+#endif
+  free(ctx);
+}
+
+int curl_runner_setopt(curl_runner_ctx *ctx, CURLRUNNERoption option,
+                       long value)
+{
+  struct runner_pool *expired = NULL;
+  CURLcode result = CURLE_OK;
+
+  if(!ctx)
+    return CURLE_BAD_FUNCTION_ARGUMENT;
+
+  ctx_lock(ctx);
+  switch(option) {
+  case CURLRUNNEROPT_KEEP:
+    if(value & ~CURLRUNNER_KEEP_ALL)
+      result = CURLE_BAD_FUNCTION_ARGUMENT;
+    else
+      ctx->keep = value;
+    break;
+  case CURLRUNNEROPT_MAXPOOLS:
+  case CURLRUNNEROPT_POOL_IDLE_TIMEOUT:
+    if(value < 0)
+      result = CURLE_BAD_FUNCTION_ARGUMENT;
+    else {
+      if(option == CURLRUNNEROPT_MAXPOOLS)
+        ctx->maxpools = value;
+      else
+        ctx->pool_idle_timeout = value;
+      expired = pool_expire(ctx, curlx_now());
+    }
+    break;
+  case CURLRUNNEROPT_MAXCONNECTS:
+    if(value < 0)
+      result = CURLE_BAD_FUNCTION_ARGUMENT;
+    else
+      ctx->maxconnects = value;
+    break;
+  case CURLRUNNEROPT_MAXAGE_CONN:
+    if(value < 0)
+      result = CURLE_BAD_FUNCTION_ARGUMENT;
+    else
+      ctx->maxage_conn = value;
+    break;
+  case CURLRUNNEROPT_DNS_CACHE_TIMEOUT:
+    if(value < -1)
+      result = CURLE_BAD_FUNCTION_ARGUMENT;
+    else
+      ctx->dns_cache_timeout = value;
+    break;
+  default:
+    result = CURLE_UNKNOWN_OPTION;
+    break;
+  }
+  ctx_unlock(ctx);
+
+  pool_free_list(expired);
+  return (int)result;
+}
+
+/* The headers of the last response, pointing into the handle's storage */
+static struct curl_runner_header *report_headers(CURL *curl, size_t *countp)
+{
+  struct curl_header *h = NULL;
+  struct curl_runner_header *headers;
+  size_t count = 0;
+  size_t i = 0;
+
+  while((h = curl_easy_nextheader(curl, CURLH_HEADER, -1, h)))
+    count++;
+  *countp = 0;
+  if(!count)
+    return NULL;
+  headers = malloc(count * sizeof(*headers));
+  if(!headers)
+    return NULL;
+  while((i < count) &&
+        (h = curl_easy_nextheader(curl, CURLH_HEADER, -1, h))) {
+    headers[i].name = h->name;
+    headers[i].value = h->value;
+    i++;
+  }
+  *countp = i;
+  return headers;
+}
+
+void runner_report(struct per_transfer *per, CURLcode result)
+{
+  struct curl_runner_result res;
+  struct curl_runner_header *headers = NULL;
+  CURL *curl = per->curl;
+
+  memset(&res, 0, sizeof(res));
+  res.index = per->num;
+  res.url = per->url;
+  res.exit_code = (int)result;
+  if(!per->skip) {
+    long size = 0;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &res.effective_url);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &res.response_code);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &res.http_version);
+    curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &res.remote_ip);
+    curl_easy_getinfo(curl, CURLINFO_PRIMARY_PORT, &res.remote_port);
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &res.content_type);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &res.num_connects);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_COUNT, &res.num_redirects);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &res.size_download);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &res.size_upload);
+    /* these two are only there as long */
+    if(!curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &size))
+      res.size_header = size;
+    if(!curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &size))
+      res.size_request = size;
+    curl_easy_getinfo(curl, CURLINFO_SPEED_DOWNLOAD_T, &res.speed_download);
+    curl_easy_getinfo(curl, CURLINFO_SPEED_UPLOAD_T, &res.speed_upload);
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &res.time_namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &res.time_connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &res.time_appconnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T,
+                      &res.time_pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T,
+                      &res.time_starttransfer);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_TIME_T, &res.time_redirect);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &res.time_total);
+    if(global->io.result_flags & CURLRUNNER_RESULT_HEADERS) {
+      headers = report_headers(curl, &res.num_headers);
+      res.headers = headers;
+    }
+  }
+  if(global->io.result_flags & CURLRUNNER_RESULT_BODY) {
+    res.body = per->body.data ? per->body.data : "";
+    res.body_len = per->body.size;
+  }
+
+  global->io.result(&res, global->io.result_userp);
+  free(headers);
+}
+
+int curl_runner_exec_io(curl_runner_ctx *ctx, int argc, char *argv[],
+                        const struct curl_runner_io *io)
+{
+  struct GlobalConfig config;
+  struct runner_pool *pool;
+  CURLcode result;
+#if defined(_UNICODE) && !defined(UNDER_CE)
+  wchar_t **wargv = NULL;
+#endif
+
+  if(!ctx || (argc < 1) || !argv)
+    return CURLE_BAD_FUNCTION_ARGUMENT;
+
+#if defined(_UNICODE) && !defined(UNDER_CE)
+  if(convert_argv_to_wargv(argc, argv, &wargv))
+    return CURLE_OUT_OF_MEMORY;
+#endif
+
+  pool = pool_get(ctx);
+
+  exec_lock(ctx);
+  tool_init_stderr();
+  result = globalconf_setup(&config);
+  if(!result) {
+    global->embedded = TRUE;
+    if(io)
+      global->io = *io;
+    global->runshare = pool ? &pool->rs : NULL;
+
+#if defined(_UNICODE) && !defined(UNDER_CE)
+    result = operate(argc, wargv);
+#else
+    result = operate(argc, argv);
+#endif
+
+    globalconf_teardown();
+  }
+  global = NULL;
+  exec_unlock(ctx);
+
+  if(pool)
+    pool_put(ctx, pool);
+
+#if defined(_UNICODE) && !defined(UNDER_CE)
+  free_wargv(argc, wargv);
+#endif
+  return (int)result;
+}
+
+int curl_runner_exec(curl_runner_ctx *ctx, int argc, char *argv[],
+                     struct CaptureBuffer *out, struct CaptureBuffer *err)
+{
+  struct curl_runner_io io;
+  memset(&io, 0, sizeof(io));
+  if(out) {
+    io.body = curl_runner_capture_sink;
+    io.body_userp = out;
+  }
+  if(err) {
+    io.err = curl_runner_capture_sink;
+    io.err_userp = err;
+  }
+  return curl_runner_exec_io(ctx, argc, argv, &io);
+}
+
+/* A command line parsed once and run many times. Runs work on copies of the
+   parsed config, so the plan itself is only read once it is compiled. */
+struct curl_runner_plan {
+  curl_runner_ctx *ctx;
+  struct GlobalConfig global;     /* as parsed */
+  int argc;
+  char **argv;                    /* to parse again for variables */
+  struct var_tmpls *templates;    /* its lines compiled for expansion, kept
+                                     for those parses */
+  BIT(done);                      /* nothing to run, like for --version */
+};
+
+static void plan_free_argv(struct curl_runner_plan *plan)
+{
+  int i;
+  if(!plan->argv)
+    return;
+  for(i = 0; i < plan->argc; i++)
+    free(plan->argv[i]);
+  free(plan->argv);
+  plan->argv = NULL;
+}
+
+/* Parse the command line into the plan, with the variables of 'ov' set
+   first and winning over the command line's own. '*tmplsp' holds the lines
+   compiled for expansion by earlier parses of the same command line. */
+static CURLcode plan_parse(struct curl_runner_plan *plan,
+                           const struct curl_runner_overrides *ov,
+                           const struct curl_runner_io *io,
+                           struct var_tmpls **tmplsp)
+{
+  CURLcode result;
+  bool done = FALSE;
+#if defined(_UNICODE) && !defined(UNDER_CE)
+  wchar_t **wargv = NULL;
+
+  if(convert_argv_to_wargv(plan->argc, plan->argv, &wargv))
+    return CURLE_OUT_OF_MEMORY;
+#endif
+
+  exec_lock(plan->ctx);
+  tool_init_stderr();
+  result = globalconf_setup(&plan->global);
+  if(!result) {
+    global->embedded = TRUE;
+    global->templates = *tmplsp;
+    if(io)
+      global->io = *io;
+
+    if(ov) {
+      size_t i;
+      for(i = 0; !result && (i < ov->num_vars); i++) {
+        const struct curl_runner_var *v = &ov->vars[i];
+        if(!v->name || !v->value ||
+           setvariable_pinned(v->name, v->value, strlen(v->value)))
+          result = CURLE_BAD_FUNCTION_ARGUMENT;
+      }
+    }
+
+#if defined(_UNICODE) && !defined(UNDER_CE)
+    if(!result)
+      result = operate_parse(plan->argc, wargv, &done);
+#else
+    if(!result)
+      result = operate_parse(plan->argc, plan->argv, &done);
+#endif
+    plan->done = done;
+
+    /* variables are only of use while parsing */
+    *tmplsp = global->templates;
+    global->templates = NULL;
+    varcleanup();
+    memset(&global->io, 0, sizeof(global->io));
+    if(result)
+      globalconf_teardown();
+  }
+  global = NULL;
+  exec_unlock(plan->ctx);
+
+#if defined(_UNICODE) && !defined(UNDER_CE)
+  free_wargv(plan->argc, wargv);
+#endif
+  return result;
+}
+
+static CURLcode plan_create(curl_runner_ctx *ctx, int argc, char *argv[],
+                            const struct curl_runner_overrides *ov,
+                            const struct curl_runner_io *io,
+                            struct var_tmpls **tmplsp,
+                            struct curl_runner_plan **planp)
+{
+  struct curl_runner_plan *plan = calloc(1, sizeof(*plan));
+  CURLcode result;
+
+  *planp = NULL;
+  if(!plan)
+    return CURLE_OUT_OF_MEMORY;
+  plan->ctx = ctx;
+  plan->argv = calloc(argc + 1, sizeof(char *));
+  if(!plan->argv) {
+    free(plan);
+    return CURLE_OUT_OF_MEMORY;
+  }
+  for(plan->argc = 0; plan->argc < argc; plan->argc++) {
+    plan->argv[plan->argc] = strdup(argv[plan->argc]);
+    if(!plan->argv[plan->argc]) {
+      plan_free_argv(plan);
+      free(plan);
+      return CURLE_OUT_OF_MEMORY;
+    }
+  }
+
+  result = plan_parse(plan, ov, io, tmplsp ? tmplsp : &plan->templates);
+  if(result) {
+    vartemplates_free(plan->templates);
+    plan_free_argv(plan);
+    free(plan);
+    return result;
+  }
+  *planp = plan;
+  return CURLE_OK;
+}
+
+/* Apply what a run changes to its copy of the first operation */
+static CURLcode plan_override(struct OperationConfig *config,
+                              const struct curl_runner_overrides *ov)
+{
+  size_t i;
+
+  if(ov->url) {
+    /* the list is the run's own copy, the first node keeps its output file
+       and flags */
+    struct getout *node = config->url_list;
+    if(!node) {
+      node = calloc(1, sizeof(*node));
+      if(!node)
+        return CURLE_OUT_OF_MEMORY;
+      node->useremote = config->remote_name_all;
+      config->url_list = node;
+    }
+    free(node->url);
+    node->url = strdup(ov->url);
+    if(!node->url)
+      return CURLE_OUT_OF_MEMORY;
+    node->urlset = TRUE;
+    node->fromfile = FALSE;
+  }
+
+  for(i = 0; i < ov->num_headers; i++) {
+    struct curl_slist *headers;
+    if(!ov->headers[i])
+      return CURLE_BAD_FUNCTION_ARGUMENT;
+    headers = curl_slist_append(config->headers, ov->headers[i]);
+    if(!headers)
+      return CURLE_OUT_OF_MEMORY;
+    config->headers = headers;
+  }
+
+  if(ov->body) {
+    curlx_dyn_init(&config->postdata, MAX_FILE2MEMORY);
+    if(curlx_dyn_addn(&config->postdata, ov->body, ov->body_len))
+      return CURLE_OUT_OF_MEMORY;
+    config->postfields = curlx_dyn_ptr(&config->postdata);
+  }
+  return CURLE_OK;
+}
+
+static CURLcode plan_run(struct curl_runner_plan *plan,
+                         const struct curl_runner_overrides *ov,
+                         const struct curl_runner_io *io)
+{
+  struct GlobalConfig config;
+  struct runner_pool *pool;
+  CURLcode result;
+
+  if(plan->done)
+    return CURLE_OK;
+
+  pool = pool_get(plan->ctx);
+
+  exec_lock(plan->ctx);
+  tool_init_stderr();
+  result = globalconf_clone(&config, &plan->global);
+  if(!result) {
+    if(io)
+      global->io = *io;
+    global->runshare = pool ? &pool->rs : NULL;
+
+    if(ov)
+      result = plan_override(global->first, ov);
+    if(!result)
+      result = operate_run();
+
+    curl_free(global->knownhosts);
+    globalconf_clone_teardown();
+  }
+  global = NULL;
+  exec_unlock(plan->ctx);
+
+  if(pool)
+    pool_put(plan->ctx, pool);
+  return result;
+}
+
+int curl_runner_compile(curl_runner_ctx *ctx, int argc, char *argv[],
+                        const struct curl_runner_io *io,
+                        curl_runner_plan **planp)
+{
+  CURLcode result;
+
+  if(!planp)
+    return CURLE_BAD_FUNCTION_ARGUMENT;
+  *planp = NULL;
+  if(!ctx || (argc < 1) || !argv)
+    return CURLE_BAD_FUNCTION_ARGUMENT;
+  result = plan_create(ctx, argc, argv, NULL, io, NULL, planp);
+  return (int)result;
+}
+
+int curl_runner_plan_exec(curl_runner_plan *plan,
+                          const struct curl_runner_overrides *ov,
+                          const struct curl_runner_io *io)
+{
+  CURLcode result;
+
+  if(!plan)
+    return CURLE_BAD_FUNCTION_ARGUMENT;
+
+  if(ov && ov->num_vars) {
+    /* variables are expanded while parsing, so they take a plan of their
+       own. The lines compiled for it are kept in this one. */
+    struct curl_runner_plan *varplan;
+    result = plan_create(plan->ctx, plan->argc, plan->argv, ov, io,
+                         &plan->templates, &varplan);
+    if(!result) {
+      result = plan_run(varplan, ov, io);
+      curl_runner_plan_free(varplan);
+    }
+  }
+  else
+    result = plan_run(plan, ov, io);
+  return (int)result;
+}
+
+void curl_runner_plan_free(curl_runner_plan *plan)
+{
+  if(!plan)
+    return;
+  exec_lock(plan->ctx);
+  global = &plan->global;
+  globalconf_teardown();
+  global = NULL;
+  vartemplates_free(plan->templates);
+  exec_unlock(plan->ctx);
+  plan_free_argv(plan);
+  free(plan);
+}
+
+/* The capture buffers are grown and freed here only, so that the same
+   allocator owns them whoever includes curl_capture.h */
+void capture_init(struct CaptureBuffer *cap, char *staticbuf, size_t capsize)
+{
+  cap->data = staticbuf;
+  cap->size = 0;
+  cap->capacity = staticbuf ? capsize : 0;
+  cap->is_static = staticbuf != NULL;
+  if(staticbuf && capsize > 0)
+    cap->data[0] = '\0';
+}
+
+int capture_append(struct CaptureBuffer *cap, const char *msg, size_t len)
+{
+  if(cap->size + len + 1 > cap->capacity) {
+    size_t newcap = (cap->size + len + 1) * 2;
+    char *newbuf;
+    if(cap->is_static) {
+      /* outgrown the caller's array, move over to the heap */
+      newbuf = malloc(newcap);
+      if(newbuf && cap->size)
+        memcpy(newbuf, cap->data, cap->size);
+    }
+    else
+      newbuf = realloc(cap->data, newcap);
+    if(!newbuf)
+      return -1;
+    cap->data = newbuf;
+    cap->capacity = newcap;
+    cap->is_static = 0;
+  }
+  memcpy(cap->data + cap->size, msg, len);
+  cap->size += len;
+  cap->data[cap->size] = '\0';
+  return 0;
+}
+
+void capture_free(struct CaptureBuffer *cap)
+{
+  if(!cap->is_static)
+    free(cap->data);
+  cap->data = NULL;
+  cap->size = 0;
+  cap->capacity = 0;
+  cap->is_static = 0;
+}
+
+size_t curl_runner_capture_sink(const char *ptr, size_t len, void *userp)
+{
+  struct CaptureBuffer *cap = userp;
+  if(capture_append(cap, ptr, len))
+    return 0;
+  return len;
+}
+
+#define RUNNER_CHUNK_SIZE (64 * 1024)
+
+size_t curl_runner_chunks_sink(const char *ptr, size_t len, void *userp)
+{
+  struct curl_runner_chunks *chunks = userp;
+  size_t left = len;
+
+  while(left) {
+    struct curl_runner_chunk *tail = chunks->tail;
+    size_t n;
+    if(!tail || (tail->len == tail->size)) {
+      size_t size = chunks->chunk_size ? chunks->chunk_size :
+        RUNNER_CHUNK_SIZE;
+      struct curl_runner_chunk *chunk =
+        malloc(sizeof(*chunk) - sizeof(chunk->data) + size);
+      if(!chunk)
+        return len - left;
+      chunk->next = NULL;
+      chunk->len = 0;
+      chunk->size = size;
+      if(tail)
+        tail->next = chunk;
+      else
+        chunks->head = chunk;
+      chunks->tail = tail = chunk;
+    }
+    n = CURLMIN(left, tail->size - tail->len);
+    memcpy(&tail->data[tail->len], ptr, n);
+    tail->len += n;
+    chunks->total += n;
+    ptr += n;
+    left -= n;
+  }
+  return len;
+}
+
+void curl_runner_chunks_free(struct curl_runner_chunks *chunks)
+{
+  struct curl_runner_chunk *chunk;
+  if(!chunks)
+    return;
+  chunk = chunks->head;
+  while(chunk) {
+    struct curl_runner_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  chunks->head = chunks->tail = NULL;
+  chunks->total = 0;
+}
+
+size_t curl_runner_mapfile_sink(const char *ptr, size_t len, void *userp)
+{
+  struct curl_runner_mapfile *mf = userp;
+  return fwrite(ptr, 1, len, mf->fp);
+}
+
+const char *curl_runner_mapfile_map(struct curl_runner_mapfile *mf,
+                                    size_t *lenp)
+{
+  struct_stat st;
+  size_t len;
+
+  if(!mf || !mf->fp || !lenp)
+    return NULL;
+  if(mf->map) {
+    *lenp = mf->maplen;
+    return mf->map;
+  }
+
+  if(fflush(mf->fp) || fstat(fileno(mf->fp), &st) || (st.st_size < 0) ||
+     ((curl_off_t)(size_t)st.st_size != (curl_off_t)st.st_size))
+    return NULL;
+  len = (size_t)st.st_size;
+  if(!len) {
+    *lenp = 0;
+    return "";
+  }
+
+#ifdef HAVE_SYS_MMAN_H
+  {
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fileno(mf->fp), 0);
+    if(map != MAP_FAILED) {
+      mf->map = map;
+      mf->mapped = TRUE;
+    }
+  }
+#endif
+  if(!mf->map) {
+    /* no mapping possible, read it back into memory instead */
+    char *buf = malloc(len);
+    if(!buf)
+      return NULL;
+    if(fseek(mf->fp, 0, SEEK_SET) || (fread(buf, 1, len, mf->fp) != len)) {
+      free(buf);
+      return NULL;
+    }
+    (void)fseek(mf->fp, 0, SEEK_END);
+    mf->map = buf;
+    mf->mapped = FALSE;
+  }
+  mf->maplen = len;
+  *lenp = len;
+  return mf->map;
+}
+
+void curl_runner_mapfile_unmap(struct curl_runner_mapfile *mf)
+{
+  if(!mf || !mf->map)
+    return;
+#ifdef HAVE_SYS_MMAN_H
+  if(mf->mapped)
+    munmap(mf->map, mf->maplen);
+  else
+#endif
+    free(mf->map);
+  mf->map = NULL;
+  mf->maplen = 0;
+  mf->mapped = FALSE;
+}
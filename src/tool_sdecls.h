@@ -25,6 +25,11 @@
  ***************************************************************************/
 #include "tool_setup.h"
 
+/* --output-buffer writes files with the file descriptor functions */
+#ifndef _WIN32
+#define USE_OUTPUT_BUFFER
+#endif
+
 /*
  * OutStruct variables keep track of information relative to curl's
  * output writing, which may take place to a standard stream or a file.
@@ -57,6 +62,16 @@
  * 'init' member holds original file size or offset at which truncation is
  * taking place. Always zero unless appending to a non-empty regular file.
  *
+ * 'segment' member is TRUE when this is one of the parts of a --segments
+ * download. It writes 'seglen' bytes at offset 'init' of a file that is
+ * already there in its full size.
+ *
+ * 'wbuf' member is the --output-buffer, aligned for O_DIRECT within the
+ * allocated 'wmem'. It holds 'wlen' of its 'wsize' bytes not yet written to
+ * the file descriptor of 'stream', they are included in 'bytes'. 'prealloc'
+ * is where the file has been allocated to, when the size was known up front,
+ * and 'direct' is TRUE while the file is written with O_DIRECT.
+ *
  * [Windows]
  * 'utf8seq' member holds an incomplete UTF-8 sequence destined for the console
  * until it can be completed (1-4 bytes) + NUL.
@@ -67,6 +82,12 @@ struct OutStruct {
   FILE *stream;
   curl_off_t bytes;
   curl_off_t init;
+  curl_off_t seglen;
+  curl_off_t prealloc;
+  char *wmem;
+  char *wbuf;
+  size_t wlen;
+  size_t wsize;
 #ifdef _WIN32
   unsigned char utf8seq[5];
 #endif
@@ -75,6 +96,8 @@ struct OutStruct {
   BIT(s_isreg);
   BIT(fopened);
   BIT(out_null);
+  BIT(segment);
+  BIT(direct);
 };
 
 /*
@@ -89,6 +112,8 @@ struct getout {
   char          *outfile;   /* where to store the output */
   char          *infile;    /* file to upload, if GETOUT_UPLOAD is set */
   curl_off_t    num;        /* which URL number in an invocation */
+  curl_off_t    fileskip;   /* URLs at the start of a URL file already
+                               split off into nodes of their own */
 
   BIT(outset);    /* when outfile is set */
   BIT(urlset);    /* when URL is set */
@@ -97,6 +122,7 @@ struct getout {
   BIT(noupload);  /* if set, -T "" has been used */
   BIT(noglob);    /* disable globbing for this URL */
   BIT(out_null);  /* discard output for this URL */
+  BIT(fromfile);  /* 'url' is a file to read URLs from, "-" for stdin */
 };
 /*
  * 'trace' enumeration represents curl's output look'n feel possibilities.
@@ -106,7 +132,8 @@ typedef enum {
   TRACE_NONE,  /* no trace/verbose output at all */
   TRACE_BIN,   /* tcpdump inspired look */
   TRACE_ASCII, /* like *BIN but without the hex output */
-  TRACE_PLAIN  /* -v/--verbose type */
+  TRACE_PLAIN, /* -v/--verbose type */
+  TRACE_RAW    /* --trace-raw, the events as they are */
 } trace;
 
 
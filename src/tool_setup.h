@@ -39,8 +39,6 @@
 
 #include "curl_setup.h" /* from the lib directory */
 
-extern FILE *tool_stderr;
-
 /*
  * curl tool certainly uses libcurl's external interface.
  */
@@ -74,6 +72,39 @@ extern FILE *tool_stderr;
 #define tool_nop_stmt do { } while(0)
 #endif
 
+/*
+ * Storage class for tool state that must be private to the calling thread so
+ * that several curl_runner invocations can run concurrently. When the
+ * compiler offers no thread-local storage, TOOL_NO_THREAD_LOCAL is defined
+ * and the invocations on a runner context take turns on a mutex of the
+ * context instead. Without thread support there is no mutex, and the
+ * runner must be called from one thread at a time.
+ */
+#if !defined(USE_THREADS_POSIX) && !defined(USE_THREADS_WIN32)
+#  define TOOL_NO_THREAD_LOCAL
+#elif defined(_MSC_VER)
+#  define TOOL_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#  define TOOL_THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+  !defined(__STDC_NO_THREADS__)
+#  define TOOL_THREAD_LOCAL _Thread_local
+#else
+#  define TOOL_NO_THREAD_LOCAL
+#endif
+#ifndef TOOL_THREAD_LOCAL
+#define TOOL_THREAD_LOCAL
+#endif
+
+/* --parallel-threads runs transfers in worker threads that each point their
+   thread-local tool state to the run's */
+#if (defined(USE_THREADS_POSIX) || defined(USE_THREADS_WIN32)) && \
+  !defined(TOOL_NO_THREAD_LOCAL)
+#define USE_PARALLEL_THREADS
+#endif
+
+extern TOOL_THREAD_LOCAL FILE *tool_stderr;
+
 #ifdef _WIN32
 #  define CURL_STRICMP(p1, p2)  _stricmp(p1, p2)
 #elif defined(HAVE_STRCASECMP)
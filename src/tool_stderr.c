@@ -28,7 +28,7 @@
 
 #include "memdebug.h" /* keep this as LAST include */
 
-FILE *tool_stderr;
+TOOL_THREAD_LOCAL FILE *tool_stderr;
 
 void tool_init_stderr(void)
 {
@@ -0,0 +1,289 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+#include "tool_cfgable.h"
+#include "tool_cb_dbg.h"
+#include "tool_trace.h"
+#include "tool_util.h"
+
+#include "memdebug.h" /* keep this as LAST include */
+
+static void put_le(unsigned char *p, curl_off_t val, int bytes)
+{
+  int i;
+  for(i = 0; i < bytes; i++) {
+    p[i] = (unsigned char)(val & 0xff);
+    val >>= 8;
+  }
+}
+
+void trace_raw_header(unsigned char *hdr, const struct trace_event *ev)
+{
+  memset(hdr, 0, TRACE_RAW_HDR);
+  hdr[0] = (unsigned char)ev->type;
+  put_le(&hdr[4], (curl_off_t)ev->tv.tv_usec, 4);
+  put_le(&hdr[8], (curl_off_t)ev->tv.tv_sec, 8);
+  put_le(&hdr[16], ev->xfer_id, 8);
+  put_le(&hdr[24], ev->conn_id, 8);
+  put_le(&hdr[32], (curl_off_t)ev->size, 8);
+  put_le(&hdr[40], (curl_off_t)ev->len, 4);
+}
+
+#ifdef USE_TRACE_RING
+
+/*
+ * --trace-async: the debug callback copies the events into a ring buffer and
+ * a thread of its own formats and writes them, so the transfers do not wait
+ * for that. There is one writer and the callers take turns with the lock of
+ * the sinks when worker threads run transfers, so the ring only needs the
+ * positions to be atomic. An event that does not fit is dropped and counted,
+ * the writer is told how many with the next event that fits. The writer sleeps
+ * on a condition variable while the ring is empty, a caller adding an event
+ * wakes it when it has said so.
+ */
+
+#define RING_SIZE (4*1024*1024) /* a power of two */
+
+#ifdef USE_THREADS_POSIX
+#define RING_RETURN_T void *
+#define RING_CALL
+#elif defined(CURL_WINDOWS_UWP) || defined(UNDER_CE)
+#define RING_RETURN_T DWORD
+#define RING_CALL WINAPI
+#else
+#define RING_RETURN_T unsigned int
+#define RING_CALL __stdcall
+#endif
+
+struct trace_ring {
+  unsigned char *mem;
+  size_t head;                /* written up to, changed by the callers */
+  size_t tail;                /* read up to, changed by the writer */
+  size_t dropped;             /* events not queued, the callers' */
+  bool quit;
+  bool sleeping;              /* the writer waits for 'wake' */
+  curl_mutex_t lock;          /* for 'wake' */
+  curl_cond_t wake;           /* signalled when there is more, or to quit */
+  struct GlobalConfig *global;
+  FILE *errstream;
+  unsigned char *data;        /* the writer's copy of an event's data */
+#ifdef USE_THREADS_POSIX
+  pthread_t thread;
+#else
+  HANDLE thread;
+#endif
+};
+
+/* the events are stored with their data right after, at positions that are
+   a multiple of this */
+#define RING_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+static void ring_copy_in(struct trace_ring *r, size_t pos, const void *src,
+                         size_t len)
+{
+  size_t at = pos & (RING_SIZE - 1);
+  size_t first = CURLMIN(len, RING_SIZE - at);
+  memcpy(&r->mem[at], src, first);
+  if(len > first)
+    memcpy(r->mem, (const unsigned char *)src + first, len - first);
+}
+
+static void ring_copy_out(struct trace_ring *r, size_t pos, void *dst,
+                          size_t len)
+{
+  size_t at = pos & (RING_SIZE - 1);
+  size_t first = CURLMIN(len, RING_SIZE - at);
+  memcpy(dst, &r->mem[at], first);
+  if(len > first)
+    memcpy((unsigned char *)dst + first, r->mem, len - first);
+}
+
+static bool ring_add(struct trace_ring *r, const struct trace_event *ev,
+                     const unsigned char *data)
+{
+  size_t head = r->head;
+  size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+  size_t need = RING_ALIGN(sizeof(*ev) + ev->len);
+
+  if(RING_SIZE - (head - tail) < need)
+    return FALSE;
+  ring_copy_in(r, head, ev, sizeof(*ev));
+  if(ev->len)
+    ring_copy_in(r, head + sizeof(*ev), data, ev->len);
+  /* ordered with the writer saying it sleeps, one of them sees the other */
+  __atomic_store_n(&r->head, head + need, __ATOMIC_SEQ_CST);
+  return TRUE;
+}
+
+static void ring_wake(struct trace_ring *r)
+{
+  Curl_mutex_acquire(&r->lock);
+  Curl_cond_signal(&r->wake);
+  Curl_mutex_release(&r->lock);
+}
+
+void trace_ring_put(const struct trace_event *ev, const unsigned char *data)
+{
+  struct trace_ring *r = global->trace_ring;
+
+  if(r->dropped) {
+    struct trace_event drop;
+    memset(&drop, 0, sizeof(drop));
+    drop.tv = ev->tv;
+    drop.xfer_id = drop.conn_id = -1;
+    drop.size = r->dropped;
+    drop.type = TRACE_DROPPED;
+    if(!ring_add(r, &drop, NULL)) {
+      r->dropped++;
+      return;
+    }
+    r->dropped = 0;
+  }
+  if(!ring_add(r, ev, data))
+    r->dropped++;
+  else if(__atomic_load_n(&r->sleeping, __ATOMIC_SEQ_CST))
+    ring_wake(r);
+}
+
+static RING_RETURN_T RING_CALL ring_writer(void *arg)
+{
+  struct trace_ring *r = arg;
+  bool flushed = TRUE;
+
+  global = r->global;
+  tool_stderr = r->errstream;
+
+  for(;;) {
+    struct trace_event ev;
+    bool quit = __atomic_load_n(&r->quit, __ATOMIC_ACQUIRE);
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    size_t tail = r->tail;
+
+    if(head == tail) {
+      if(quit)
+        break;
+      if(!flushed) {
+        /* written in bigger chunks than one line at a time */
+        tool_trace_flush();
+        flushed = TRUE;
+        continue;
+      }
+      Curl_mutex_acquire(&r->lock);
+      __atomic_store_n(&r->sleeping, TRUE, __ATOMIC_SEQ_CST);
+      if((__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) == tail) &&
+         !__atomic_load_n(&r->quit, __ATOMIC_ACQUIRE))
+        Curl_cond_wait(&r->wake, &r->lock);
+      __atomic_store_n(&r->sleeping, FALSE, __ATOMIC_RELAXED);
+      Curl_mutex_release(&r->lock);
+      continue;
+    }
+    ring_copy_out(r, tail, &ev, sizeof(ev));
+    if(ev.len)
+      ring_copy_out(r, tail + sizeof(ev), r->data, ev.len);
+    __atomic_store_n(&r->tail, tail + RING_ALIGN(sizeof(ev) + ev.len),
+                     __ATOMIC_RELEASE);
+    tool_trace_write(&ev, r->data);
+    flushed = FALSE;
+  }
+  tool_trace_flush();
+  return 0;
+}
+
+static bool ring_thread_start(struct trace_ring *r)
+{
+#ifdef USE_THREADS_POSIX
+  return !pthread_create(&r->thread, NULL, ring_writer, r);
+#elif defined(CURL_WINDOWS_UWP) || defined(UNDER_CE)
+  r->thread = CreateThread(NULL, 0, ring_writer, r, 0, NULL);
+  return r->thread != NULL;
+#else
+  uintptr_t th = _beginthreadex(NULL, 0, ring_writer, r, 0, NULL);
+  r->thread = (HANDLE)th;
+  return th != 0;
+#endif
+}
+
+static void ring_thread_join(struct trace_ring *r)
+{
+#ifdef USE_THREADS_POSIX
+  pthread_join(r->thread, NULL);
+#else
+  WaitForSingleObject(r->thread, INFINITE);
+  CloseHandle(r->thread);
+#endif
+}
+
+static void ring_free(struct trace_ring *r)
+{
+  Curl_cond_destroy(&r->wake);
+  Curl_mutex_destroy(&r->lock);
+  free(r->mem);
+  free(r->data);
+  free(r);
+}
+
+bool trace_ring_start(void)
+{
+  struct trace_ring *r = calloc(1, sizeof(*r));
+  if(!r)
+    return FALSE;
+  Curl_mutex_init(&r->lock);
+  Curl_cond_init(&r->wake);
+  r->mem = malloc(RING_SIZE);
+  r->data = malloc(TRACE_CAP);
+  r->global = global;
+  r->errstream = tool_stderr;
+  global->trace_ring = r;
+  if(!r->mem || !r->data || !ring_thread_start(r)) {
+    global->trace_ring = NULL;
+    ring_free(r);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+void trace_ring_stop(void)
+{
+  struct trace_ring *r = global->trace_ring;
+  if(!r)
+    return;
+  __atomic_store_n(&r->quit, TRUE, __ATOMIC_RELEASE);
+  ring_wake(r);
+  ring_thread_join(r);
+  global->trace_ring = NULL;
+  if(r->dropped) {
+    /* the last ones did not get told */
+    struct trace_event drop;
+    memset(&drop, 0, sizeof(drop));
+    drop.tv = tvrealnow();
+    drop.xfer_id = drop.conn_id = -1;
+    drop.size = r->dropped;
+    drop.type = TRACE_DROPPED;
+    tool_trace_write(&drop, NULL);
+    tool_trace_flush();
+  }
+  ring_free(r);
+}
+
+#endif /* USE_TRACE_RING */
@@ -0,0 +1,88 @@
+#ifndef HEADER_CURL_TOOL_TRACE_H
+#define HEADER_CURL_TOOL_TRACE_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+#ifdef USE_PARALLEL_THREADS
+#include "curl_threads.h"
+#endif
+
+/* the writer thread needs the thread support of --parallel-threads, condition
+   variables and the atomic builtins */
+#if defined(USE_PARALLEL_THREADS) && defined(USE_CURL_COND_T) && \
+  (defined(__GNUC__) || defined(__clang__))
+#define USE_TRACE_RING
+#endif
+
+#define TRACE_CAP (64*1024)   /* data bytes kept of an event at most */
+#define TRACE_DROPPED 0xff    /* the type of the event telling about drops */
+
+/* a trace event, as the debug callback got it */
+struct trace_event {
+  struct timeval tv;          /* when, if --trace-time or --trace-raw */
+  curl_off_t xfer_id;         /* -1 when not known */
+  curl_off_t conn_id;
+  size_t size;                /* bytes the callback got, or events dropped */
+  size_t len;                 /* bytes of them kept, less when cut */
+  int type;                   /* curl_infotype or TRACE_DROPPED */
+  bool tty;                   /* the transfer writes to a terminal */
+};
+
+/* --trace-raw: the file starts with TRACE_RAW_MAGIC and then has each event
+   as a TRACE_RAW_HDR bytes header and its 'len' data bytes. The numbers are
+   little endian:
+
+   offset  size  field
+        0     1  type
+        1     3  zero
+        4     4  microseconds
+        8     8  seconds since the epoch
+       16     8  transfer id, -1 when not known
+       24     8  connection id, -1 when not known
+       32     8  size
+       40     4  len
+
+   scripts/tracedecode shows them as --trace or --trace-ascii would have. */
+#define TRACE_RAW_MAGIC "CURLTRC1"
+#define TRACE_RAW_HDR 44
+
+void trace_raw_header(unsigned char *hdr, const struct trace_event *ev);
+
+#ifdef USE_TRACE_RING
+
+/* --trace-async: start the thread writing the events, FALSE if it did not
+   start */
+bool trace_ring_start(void);
+
+/* wait for the thread to write all events and end it */
+void trace_ring_stop(void);
+
+/* queue an event, the callers take turns. It is dropped when the ring is
+   full. */
+void trace_ring_put(const struct trace_event *ev, const unsigned char *data);
+
+#endif /* USE_TRACE_RING */
+
+#endif /* HEADER_CURL_TOOL_TRACE_H */
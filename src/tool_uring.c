@@ -0,0 +1,596 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+#include "tool_uring.h"
+
+#ifdef USE_IO_URING
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "tool_cfgable.h"
+#include "tool_operate.h"
+
+#include "memdebug.h" /* keep this as LAST include */
+
+#ifdef USE_IO_URING
+
+/*
+ * --io-uring: the file reads and writes of the parallel transfers are queued
+ * to an io_uring and complete while the transfers go on. A transfer that
+ * has to wait for one is paused and unpaused again when the completion
+ * arrives, which the eventfd of the ring tells the event loop about.
+ *
+ * The system calls are made directly, there is no need for liburing.
+ */
+
+static int sys_setup(unsigned int entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned int submit, unsigned int wait,
+                     unsigned int flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned int opcode, void *arg,
+                        unsigned int nargs)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+bool uring_init(struct uring *u, unsigned int nbufs)
+{
+  struct io_uring_params p;
+  struct iovec *iov;
+  unsigned int entries = 1;
+  unsigned int i;
+  char *sq;
+  char *cq;
+
+  memset(u, 0, sizeof(*u));
+  u->fd = u->efd = -1;
+  u->sqmap = u->cqmap = MAP_FAILED;
+  u->sqes = MAP_FAILED;
+
+  if(nbufs < URING_BUFS_MIN)
+    nbufs = URING_BUFS_MIN;
+  else if(nbufs > URING_BUFS_MAX)
+    nbufs = URING_BUFS_MAX;
+  /* each buffer has one operation in flight at most, they all fit */
+  while(entries < nbufs)
+    entries <<= 1;
+
+  memset(&p, 0, sizeof(p));
+  u->fd = sys_setup(entries, &p);
+  if(u->fd < 0)
+    goto fail;
+
+  u->sqmaplen = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  u->cqmaplen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    if(u->cqmaplen > u->sqmaplen)
+      u->sqmaplen = u->cqmaplen;
+  }
+  u->sqmap = mmap(NULL, u->sqmaplen, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if(u->sqmap == MAP_FAILED)
+    goto fail;
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    u->cqmap = u->sqmap;
+    u->cqmaplen = 0;
+  }
+  else {
+    u->cqmap = mmap(NULL, u->cqmaplen, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    if(u->cqmap == MAP_FAILED)
+      goto fail;
+  }
+  u->sqeslen = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap(NULL, u->sqeslen, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if(u->sqes == MAP_FAILED)
+    goto fail;
+
+  sq = u->sqmap;
+  cq = u->cqmap;
+  u->sq_tail = (unsigned int *)(void *)(sq + p.sq_off.tail);
+  u->sq_mask = (unsigned int *)(void *)(sq + p.sq_off.ring_mask);
+  u->sq_array = (unsigned int *)(void *)(sq + p.sq_off.array);
+  u->cq_head = (unsigned int *)(void *)(cq + p.cq_off.head);
+  u->cq_tail = (unsigned int *)(void *)(cq + p.cq_off.tail);
+  u->cq_mask = (unsigned int *)(void *)(cq + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(void *)(cq + p.cq_off.cqes);
+
+  u->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if((u->efd < 0) ||
+     sys_register(u->fd, IORING_REGISTER_EVENTFD, &u->efd, 1))
+    goto fail;
+
+  u->mem = malloc((size_t)nbufs * URING_BUFSIZE);
+  u->bufs = calloc(nbufs, sizeof(struct uring_buf));
+  iov = calloc(nbufs, sizeof(struct iovec));
+  if(!u->mem || !u->bufs || !iov) {
+    free(iov);
+    goto fail;
+  }
+  u->nbufs = nbufs;
+  for(i = nbufs; i--;) {
+    struct uring_buf *b = &u->bufs[i];
+    b->mem = &u->mem[(size_t)i * URING_BUFSIZE];
+    b->index = (unsigned short)i;
+    b->next = u->free;
+    u->free = b;
+    iov[i].iov_base = b->mem;
+    iov[i].iov_len = URING_BUFSIZE;
+  }
+  u->nfree = nbufs;
+  /* registered buffers save the kernel from mapping them for every
+     operation, the plain operations work when the locked memory limit does
+     not allow it */
+  u->fixed = !sys_register(u->fd, IORING_REGISTER_BUFFERS, iov, nbufs);
+  free(iov);
+  return TRUE;
+
+fail:
+  uring_cleanup(u);
+  return FALSE;
+}
+
+void uring_submit(struct uring *u)
+{
+  while(u->queued) {
+    int rc = sys_enter(u->fd, u->queued, 0, 0);
+    if(rc <= 0)
+      /* EINTR, EAGAIN or EBUSY, the next round gets them */
+      break;
+    u->queued -= (unsigned int)rc;
+  }
+}
+
+static void queue_op(struct uring *u, struct uring_buf *b, bool read)
+{
+  struct per_transfer *per = b->per;
+  unsigned int tail = *u->sq_tail;
+  unsigned int idx = tail & *u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[idx];
+  char *addr = read ? b->mem : &b->mem[b->done];
+  size_t len = read ? URING_BUFSIZE : b->len - b->done;
+
+  memset(sqe, 0, sizeof(*sqe));
+  if(read) {
+    sqe->fd = per->infd;
+    sqe->off = (__u64)b->offset;
+  }
+  else {
+    sqe->fd = fileno(per->outs.stream);
+    sqe->off = (__u64)(b->offset + (curl_off_t)b->done);
+  }
+  sqe->user_data = (__u64)(uintptr_t)b;
+  if(u->fixed) {
+    sqe->opcode = read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+    sqe->addr = (__u64)(uintptr_t)addr;
+    sqe->len = (__u32)len;
+    sqe->buf_index = b->index;
+  }
+  else {
+    b->iov.iov_base = addr;
+    b->iov.iov_len = len;
+    sqe->opcode = read ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->addr = (__u64)(uintptr_t)&b->iov;
+    sqe->len = 1;
+  }
+  u->sq_array[idx] = idx;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  u->queued++;
+  u->inflight++;
+  per->uio.inflight++;
+  b->read = read;
+  b->inflight = TRUE;
+}
+
+static struct uring_buf *take_buf(struct uring *u, struct per_transfer *per)
+{
+  struct uring_buf *b = u->free;
+  DEBUGASSERT(b);
+  u->free = b->next;
+  u->nfree--;
+  b->next = NULL;
+  b->per = per;
+  b->len = b->done = 0;
+  b->stale = FALSE;
+  return b;
+}
+
+static void release_buf(struct uring *u, struct uring_buf *b)
+{
+  b->per = NULL;
+  b->next = u->free;
+  u->free = b;
+  u->nfree++;
+  u->freed = TRUE;
+}
+
+/* pause the transfer until a buffer is freed */
+static void wait_buf(struct uring *u, struct per_transfer *per)
+{
+  if(!per->uio.listed) {
+    per->uio.wnext = u->waiters;
+    u->waiters = per;
+    per->uio.listed = TRUE;
+  }
+  per->uio.waiting = TRUE;
+}
+
+static void unlist(struct uring *u, struct per_transfer *per)
+{
+  struct per_transfer **pp;
+  if(!per->uio.listed)
+    return;
+  for(pp = &u->waiters; *pp; pp = &(*pp)->uio.wnext) {
+    if(*pp == per) {
+      *pp = per->uio.wnext;
+      break;
+    }
+  }
+  per->uio.wnext = NULL;
+  per->uio.listed = FALSE;
+}
+
+/* handle a completion, return the transfer to wake up or NULL */
+static struct per_transfer *completed(struct uring *u, struct uring_buf *b,
+                                      int res)
+{
+  struct per_transfer *per = b->per;
+  struct uring_io *io = &per->uio;
+
+  b->inflight = FALSE;
+  u->inflight--;
+  io->inflight--;
+
+  if(!b->read) {
+    if(res < 0) {
+      if(!io->error)
+        io->error = -res;
+      release_buf(u, b);
+    }
+    else if(!res) {
+      if(!io->error)
+        io->error = EIO;
+      release_buf(u, b);
+    }
+    else {
+      b->done += (size_t)res;
+      if((b->done < b->len) && !io->error && !u->closing)
+        /* a short write, the rest goes again */
+        queue_op(u, b, FALSE);
+      else
+        release_buf(u, b);
+    }
+    return NULL;
+  }
+
+  b->done = 0;
+  if(b->stale) {
+    /* repositioned while it was read, read again */
+    b->stale = FALSE;
+    b->len = 0;
+  }
+  else if(res < 0) {
+    if(!io->error)
+      io->error = -res;
+    b->len = 0;
+  }
+  else {
+    b->len = (size_t)res;
+    if(!res)
+      io->reof = TRUE;
+  }
+  if(io->waiting && !io->listed && !u->closing) {
+    io->waiting = FALSE;
+    return per;
+  }
+  return NULL;
+}
+
+void uring_complete(struct uring *u)
+{
+  struct per_transfer *wake = NULL;
+  unsigned int head = *u->cq_head;
+
+  for(;;) {
+    unsigned int tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    struct per_transfer *per;
+    struct io_uring_cqe *cqe;
+    struct uring_buf *b;
+    int res;
+    if(head == tail)
+      break;
+    cqe = &u->cqes[head & *u->cq_mask];
+    b = (struct uring_buf *)(uintptr_t)cqe->user_data;
+    res = cqe->res;
+    head++;
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    per = completed(u, b, res);
+    if(per) {
+      per->uio.wnext = wake;
+      wake = per;
+    }
+  }
+
+  if(u->closing)
+    return;
+
+  if(u->freed) {
+    /* the ones waiting for a buffer try again, those that do not get one
+       go back on the list */
+    struct per_transfer *per = u->waiters;
+    u->freed = FALSE;
+    u->waiters = NULL;
+    while(per) {
+      struct per_transfer *next = per->uio.wnext;
+      per->uio.listed = FALSE;
+      per->uio.waiting = FALSE;
+      per->uio.wnext = wake;
+      wake = per;
+      per = next;
+    }
+  }
+
+  while(wake) {
+    struct per_transfer *per = wake;
+    wake = per->uio.wnext;
+    per->uio.wnext = NULL;
+    /* this calls the callback again for what it paused on, which might
+       pause it again */
+    curl_easy_pause(per->curl, CURLPAUSE_CONT);
+  }
+}
+
+void uring_event(struct uring *u)
+{
+  uint64_t val;
+  /* reset the counter, completions that arrive later signal it again */
+  ssize_t rc = read(u->efd, &val, sizeof(val));
+  (void)rc;
+  uring_complete(u);
+}
+
+void uring_cleanup(struct uring *u)
+{
+  u->closing = TRUE;
+  if(u->fd >= 0) {
+    /* the kernel may not write into buffers that are gone */
+    while(u->inflight) {
+      uring_submit(u);
+      if((sys_enter(u->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) &&
+         /* !checksrc! disable ERRNOVAR 1 */
+         (errno != EINTR))
+        break;
+      uring_complete(u);
+    }
+  }
+  if(u->sqes != MAP_FAILED)
+    munmap(u->sqes, u->sqeslen);
+  if((u->cqmap != MAP_FAILED) && (u->cqmap != u->sqmap))
+    munmap(u->cqmap, u->cqmaplen);
+  if(u->sqmap != MAP_FAILED)
+    munmap(u->sqmap, u->sqmaplen);
+  if(u->efd >= 0)
+    close(u->efd);
+  if(u->fd >= 0)
+    close(u->fd);
+  tool_safefree(u->bufs);
+  tool_safefree(u->mem);
+  u->fd = u->efd = -1;
+  u->sqmap = u->cqmap = MAP_FAILED;
+  u->sqes = MAP_FAILED;
+}
+
+bool uring_output_ok(struct per_transfer *per)
+{
+  struct uring_io *io = &per->uio;
+  struct OutStruct *outs = &per->outs;
+  struct OperationConfig *config = per->config;
+
+  if(!outs->fopened || outs->segment || config->show_headers ||
+     config->nobuffer)
+    return FALSE;
+  if(!io->wchecked) {
+    int fd = fileno(outs->stream);
+    int flags = fcntl(fd, F_GETFL);
+    struct_stat st;
+    /* writes at their offsets, in any order, an appended file cannot have
+       that */
+    io->wok = (flags != -1) && !(flags & O_APPEND) &&
+      !fstat(fd, &st) && S_ISREG(st.st_mode) && !fflush(outs->stream);
+    io->wchecked = TRUE;
+  }
+  return io->wok;
+}
+
+bool uring_input_ok(struct per_transfer *per)
+{
+  struct uring_io *io = &per->uio;
+  if(!per->infdopen)
+    return FALSE;
+  if(!io->rchecked) {
+    struct_stat st;
+    io->rok = !fstat(per->infd, &st) && S_ISREG(st.st_mode);
+    io->rchecked = TRUE;
+  }
+  return io->rok;
+}
+
+size_t uring_write(struct per_transfer *per, char *buffer, size_t bytes)
+{
+  struct uring *u = per->uring;
+  struct uring_io *io = &per->uio;
+  struct OutStruct *outs = &per->outs;
+  curl_off_t offset = outs->init + outs->bytes;
+  size_t room = io->wbuf ? URING_BUFSIZE - io->wbuf->len : 0;
+  size_t total = bytes;
+
+  if(io->error) {
+    /* a write of an earlier part failed */
+    CURL_SETERRNO(io->error);
+    return 0;
+  }
+  if(bytes > room) {
+    size_t need = (bytes - room + URING_BUFSIZE - 1) / URING_BUFSIZE;
+    if(need > u->nbufs)
+      return 0;
+    if(need > u->nfree) {
+      wait_buf(u, per);
+      return CURL_WRITEFUNC_PAUSE;
+    }
+  }
+  while(bytes) {
+    struct uring_buf *b = io->wbuf;
+    size_t n;
+    if(!b) {
+      b = io->wbuf = take_buf(u, per);
+      b->offset = offset;
+    }
+    n = CURLMIN(bytes, URING_BUFSIZE - b->len);
+    memcpy(&b->mem[b->len], buffer, n);
+    b->len += n;
+    buffer += n;
+    bytes -= n;
+    offset += (curl_off_t)n;
+    if(b->len == URING_BUFSIZE) {
+      io->wbuf = NULL;
+      queue_op(u, b, FALSE);
+    }
+  }
+  return total;
+}
+
+size_t uring_read(struct per_transfer *per, char *buffer, size_t len)
+{
+  struct uring *u = per->uring;
+  struct uring_io *io = &per->uio;
+  struct uring_buf *b = io->rbuf;
+
+  if(io->error)
+    return CURL_READFUNC_ABORT;
+  if(!io->ropen) {
+    /* where the file is, the reads do not move it */
+    curl_off_t pos = (curl_off_t)lseek(per->infd, 0, SEEK_CUR);
+    if(pos < 0)
+      return CURL_READFUNC_ABORT;
+    io->roff = pos;
+    io->ropen = TRUE;
+    io->reof = FALSE;
+    if(b && !b->inflight)
+      b->len = b->done = 0;
+  }
+
+  if(b && !b->inflight && (b->done < b->len)) {
+    size_t n = CURLMIN(len, b->len - b->done);
+    memcpy(buffer, &b->mem[b->done], n);
+    b->done += n;
+    io->roff += (curl_off_t)n;
+    if(b->done == b->len) {
+      /* read the next part while this is sent */
+      b->offset = io->roff;
+      queue_op(u, b, TRUE);
+    }
+    return n;
+  }
+  if(io->reof && b && !b->inflight)
+    return 0;
+
+  if(!b) {
+    if(!u->nfree) {
+      wait_buf(u, per);
+      return CURL_READFUNC_PAUSE;
+    }
+    b = io->rbuf = take_buf(u, per);
+  }
+  if(!b->inflight) {
+    b->offset = io->roff;
+    queue_op(u, b, TRUE);
+  }
+  io->waiting = TRUE;
+  return CURL_READFUNC_PAUSE;
+}
+
+void uring_seek(struct per_transfer *per)
+{
+  struct uring_io *io = &per->uio;
+  io->ropen = FALSE;
+  io->reof = FALSE;
+  if(io->rbuf && io->rbuf->inflight)
+    io->rbuf->stale = TRUE;
+}
+
+bool uring_finish(struct per_transfer *per)
+{
+  struct uring *u = per->uring;
+  struct uring_io *io = &per->uio;
+
+  unlist(u, per);
+  io->waiting = FALSE;
+  if(io->wbuf) {
+    struct uring_buf *b = io->wbuf;
+    io->wbuf = NULL;
+    if(b->len && !io->error)
+      queue_op(u, b, FALSE);
+    else
+      release_buf(u, b);
+  }
+  if(io->rbuf && io->rbuf->inflight)
+    io->rbuf->stale = TRUE;
+  return io->inflight > 0;
+}
+
+int uring_done(struct per_transfer *per)
+{
+  struct uring *u = per->uring;
+  struct uring_io *io = &per->uio;
+  int error = io->error;
+
+  DEBUGASSERT(!io->inflight);
+  if(io->rbuf) {
+    release_buf(u, io->rbuf);
+    io->rbuf = NULL;
+  }
+  if(io->ropen) {
+    /* leave the file where plain reads would have, a retry may go on from
+       there */
+    (void)lseek(per->infd, (off_t)io->roff, SEEK_SET);
+    io->ropen = FALSE;
+  }
+  io->reof = FALSE;
+  io->error = 0;
+  return error;
+}
+
+#endif /* USE_IO_URING */
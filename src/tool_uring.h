@@ -0,0 +1,147 @@
+#ifndef HEADER_CURL_TOOL_URING_H
+#define HEADER_CURL_TOOL_URING_H
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "tool_setup.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_SYS_EVENTFD_H) && \
+  defined(HAVE_SYS_MMAN_H) && (defined(__GNUC__) || defined(__clang__))
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define USE_IO_URING
+#endif
+#endif
+
+#ifdef USE_IO_URING
+
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#define URING_BUFSIZE (64*1024) /* size of each buffer in the pool */
+#define URING_BUFS_MIN 8
+#define URING_BUFS_MAX 256
+
+struct per_transfer;
+
+/* A buffer of the pool. With --parallel, a download fills one before it is
+   written to the file, an upload gets the next part of the file read into
+   one while it sends what is in it. At most one operation is in flight for
+   each buffer. */
+struct uring_buf {
+  struct uring_buf *next;     /* in the free list */
+  struct per_transfer *per;   /* the transfer using it */
+  char *mem;
+  struct iovec iov;           /* for the operation when not registered */
+  curl_off_t offset;          /* file offset of the first byte */
+  size_t len;                 /* bytes in it */
+  size_t done;                /* bytes written, or handed to libcurl */
+  unsigned short index;       /* in the pool and the registered buffers */
+  BIT(read);                  /* the operation is a read */
+  BIT(inflight);
+  BIT(stale);                 /* the read data is not wanted anymore */
+};
+
+/* the state of a transfer using the ring */
+struct uring_io {
+  struct per_transfer *wnext; /* in the list waiting for a free buffer */
+  struct uring_buf *wbuf;     /* download data not written yet */
+  struct uring_buf *rbuf;     /* upload data read ahead */
+  curl_off_t roff;            /* file offset of the next upload byte */
+  unsigned int inflight;      /* operations not completed */
+  int error;                  /* errno of a failed operation */
+  BIT(wchecked);              /* the output file has been checked */
+  BIT(wok);                   /* and can be written with the ring */
+  BIT(rchecked);
+  BIT(rok);
+  BIT(ropen);                 /* 'roff' is set */
+  BIT(reof);                  /* the upload file has ended */
+  BIT(waiting);               /* paused until a completion wakes it */
+  BIT(listed);                /* in the wait list */
+};
+
+struct uring {
+  int fd;                     /* the ring */
+  int efd;                    /* eventfd signaled on completions */
+  void *sqmap;
+  size_t sqmaplen;
+  void *cqmap;
+  size_t cqmaplen;
+  struct io_uring_sqe *sqes;
+  size_t sqeslen;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned int queued;        /* entries not submitted yet */
+  unsigned int inflight;      /* operations not completed */
+  char *mem;                  /* all the buffers */
+  struct uring_buf *bufs;
+  unsigned int nbufs;
+  struct uring_buf *free;
+  unsigned int nfree;
+  struct per_transfer *waiters; /* paused for want of a free buffer */
+  BIT(fixed);                 /* the buffers are registered */
+  BIT(freed);                 /* a buffer was freed, wake the waiters */
+  BIT(closing);
+};
+
+/* set up a ring with 'nbufs' buffers, FALSE if the system has none */
+bool uring_init(struct uring *u, unsigned int nbufs);
+
+/* wait for what is in flight and take it down */
+void uring_cleanup(struct uring *u);
+
+/* hand the queued operations to the kernel */
+void uring_submit(struct uring *u);
+
+/* the eventfd was signaled: take the completions and unpause the transfers
+   they let go on */
+void uring_event(struct uring *u);
+void uring_complete(struct uring *u);
+
+/* TRUE if the transfer's output file or upload file can use the ring */
+bool uring_output_ok(struct per_transfer *per);
+bool uring_input_ok(struct per_transfer *per);
+
+/* the write and read callbacks, they may return the pause codes */
+size_t uring_write(struct per_transfer *per, char *buffer, size_t bytes);
+size_t uring_read(struct per_transfer *per, char *buffer, size_t len);
+
+/* the upload file has been repositioned by the seek callback */
+void uring_seek(struct per_transfer *per);
+
+/* the transfer has ended, queue what is left to write. TRUE while it has
+   operations in flight, the transfer must be kept until they are done. */
+bool uring_finish(struct per_transfer *per);
+
+/* the transfer's operations are done, give back its buffers and return the
+   errno of a failed write, or 0 */
+int uring_done(struct per_transfer *per);
+
+#endif /* USE_IO_URING */
+
+#endif /* HEADER_CURL_TOOL_URING_H */
@@ -37,28 +37,118 @@
 
 #define MAX_EXPAND_CONTENT 10000000
 #define MAX_VAR_LEN 128 /* max length of a name */
+#define VAR_SLOTS 64 /* initial hash table size */
+
+/* variables in a hash table, by name */
+struct tool_vars {
+  struct tool_var **table;
+  size_t size;  /* slots in the table */
+  size_t count; /* variables in the table */
+};
+
+/* A line compiled for expansion: the text between the references is kept as
+   is, a reference holds the hash of its name and the functions to apply. The
+   compiled lines are kept by their text, so a line parsed again only needs
+   the values looked up. */
+struct var_seg {
+  const char *str;      /* text, or the name of the variable */
+  size_t len;
+  size_t hash;          /* of the name, for a reference */
+  size_t func;          /* index of its first function in 'funcs' */
+  size_t nfuncs;
+  BIT(ref);
+};
+
+struct var_tmpl {
+  struct var_tmpl *next; /* in the hash chain */
+  char *line;            /* the line as given, the segments point into it */
+  size_t hash;
+  struct var_seg *segs;
+  size_t nsegs;
+  size_t asegs;          /* allocated */
+  unsigned char *funcs;
+  size_t nf;
+  size_t af;             /* allocated */
+  size_t nrefs;
+};
+
+struct var_tmpls {
+  struct var_tmpl **table;
+  size_t size;
+  size_t count;
+};
+
+static size_t var_hash(const char *name, size_t nlen)
+{
+  size_t h = 5381;
+  while(nlen--)
+    h = (h * 33) ^ (unsigned char)*name++;
+  return h;
+}
 
-/* free everything */
-void varcleanup(void)
+static void vars_free(struct tool_vars *vars)
 {
-  struct tool_var *list = global->variables;
-  while(list) {
-    struct tool_var *t = list;
-    list = list->next;
-    free(CURL_UNCONST(t->content));
-    free(t);
+  size_t i;
+  if(!vars)
+    return;
+  for(i = 0; i < vars->size; i++) {
+    struct tool_var *v = vars->table[i];
+    while(v) {
+      struct tool_var *next = v->next;
+      free(CURL_UNCONST(v->content));
+      free(v);
+      v = next;
+    }
   }
+  free(vars->table);
+  free(vars);
 }
 
-static const struct tool_var *varcontent(const char *name, size_t nlen)
+static void tmpl_free(struct var_tmpl *t)
 {
-  struct tool_var *list = global->variables;
-  while(list) {
-    if((strlen(list->name) == nlen) &&
-       !strncmp(name, list->name, nlen)) {
-      return list;
+  free(t->line);
+  free(t->segs);
+  free(t->funcs);
+  free(t);
+}
+
+void vartemplates_free(struct var_tmpls *tmpls)
+{
+  size_t i;
+  if(!tmpls)
+    return;
+  for(i = 0; i < tmpls->size; i++) {
+    struct var_tmpl *t = tmpls->table[i];
+    while(t) {
+      struct var_tmpl *next = t->next;
+      tmpl_free(t);
+      t = next;
     }
-    list = list->next;
+  }
+  free(tmpls->table);
+  free(tmpls);
+}
+
+/* free everything */
+void varcleanup(void)
+{
+  vars_free(global->variables);
+  global->variables = NULL;
+  vartemplates_free(global->templates);
+  global->templates = NULL;
+}
+
+static struct tool_var *varcontent(const char *name, size_t nlen,
+                                   size_t hash)
+{
+  struct tool_vars *vars = global->variables;
+  struct tool_var *v;
+  if(!vars)
+    return NULL;
+  for(v = vars->table[hash & (vars->size - 1)]; v; v = v->next) {
+    if((v->hash == hash) && (v->nlen == nlen) &&
+       !memcmp(name, v->name, nlen))
+      return v;
   }
   return NULL;
 }
@@ -78,28 +168,29 @@ static const struct tool_var *varcontent(const char *name, size_t nlen)
 #define FUNC_64DEC "64dec" /* base64 decode */
 #define FUNC_64DEC_LEN (sizeof(FUNC_64DEC) - 1)
 
+enum varfunc_id {
+  VF_TRIM,
+  VF_JSON,
+  VF_URL,
+  VF_B64,
+  VF_64DEC
+};
+
 static ParameterError varfunc(char *c, /* content */
                               size_t clen, /* content length */
-                              char *f, /* functions */
-                              size_t flen, /* function string length */
+                              const unsigned char *funcs,
+                              size_t nfuncs,
                               struct dynbuf *out)
 {
   bool alloc = FALSE;
   ParameterError err = PARAM_OK;
-  const char *finput = f;
+  size_t i;
 
   /* The functions are independent and runs left to right */
-  while(*f && !err) {
-    if(*f == '}')
-      /* end of functions */
-      break;
-    /* On entry, this is known to be a colon already. In subsequent laps, it
-       is also known to be a colon since that is part of the FUNCMATCH()
-       checks */
-    f++;
-    if(FUNCMATCH(f, FUNC_TRIM, FUNC_TRIM_LEN)) {
+  for(i = 0; (i < nfuncs) && !err; i++) {
+    switch(funcs[i]) {
+    case VF_TRIM: {
       size_t len = clen;
-      f += FUNC_TRIM_LEN;
       if(clen) {
         /* skip leading white space, including CRLF */
         while(ISSPACE(*c)) {
@@ -111,23 +202,18 @@ static ParameterError varfunc(char *c, /* content */
       }
       /* put it in the output */
       curlx_dyn_reset(out);
-      if(curlx_dyn_addn(out, c, len)) {
+      if(curlx_dyn_addn(out, c, len))
         err = PARAM_NO_MEM;
-        break;
-      }
+      break;
     }
-    else if(FUNCMATCH(f, FUNC_JSON, FUNC_JSON_LEN)) {
-      f += FUNC_JSON_LEN;
+    case VF_JSON:
       curlx_dyn_reset(out);
       if(clen) {
-        if(jsonquoted(c, clen, out, FALSE)) {
+        if(jsonquoted(c, clen, out, FALSE))
           err = PARAM_NO_MEM;
-          break;
-        }
       }
-    }
-    else if(FUNCMATCH(f, FUNC_URL, FUNC_URL_LEN)) {
-      f += FUNC_URL_LEN;
+      break;
+    case VF_URL:
       curlx_dyn_reset(out);
       if(clen) {
         char *enc = curl_easy_escape(NULL, c, (int)clen);
@@ -140,12 +226,9 @@ static ParameterError varfunc(char *c, /* content */
         if(curlx_dyn_add(out, enc))
           err = PARAM_NO_MEM;
         curl_free(enc);
-        if(err)
-          break;
       }
-    }
-    else if(FUNCMATCH(f, FUNC_B64, FUNC_B64_LEN)) {
-      f += FUNC_B64_LEN;
+      break;
+    case VF_B64:
       curlx_dyn_reset(out);
       if(clen) {
         char *enc;
@@ -160,12 +243,9 @@ static ParameterError varfunc(char *c, /* content */
         if(curlx_dyn_addn(out, enc, elen))
           err = PARAM_NO_MEM;
         curl_free(enc);
-        if(err)
-          break;
       }
-    }
-    else if(FUNCMATCH(f, FUNC_64DEC, FUNC_64DEC_LEN)) {
-      f += FUNC_64DEC_LEN;
+      break;
+    case VF_64DEC:
       curlx_dyn_reset(out);
       if(clen) {
         unsigned char *enc;
@@ -181,16 +261,11 @@ static ParameterError varfunc(char *c, /* content */
             err = PARAM_NO_MEM;
           curl_free(enc);
         }
-        if(err)
-          break;
       }
-    }
-    else {
-      /* unsupported function */
-      errorf("unknown variable function in '%.*s'", (int)flen, finput);
-      err = PARAM_EXPAND_ERROR;
       break;
     }
+    if(err)
+      break;
     if(alloc)
       free(c);
 
@@ -209,38 +284,107 @@ static ParameterError varfunc(char *c, /* content */
   return err;
 }
 
-ParameterError varexpand(const char *line, struct dynbuf *out,
-                         bool *replaced)
+static bool tmpl_seg(struct var_tmpl *t, const char *str, size_t len)
 {
-  CURLcode result;
-  char *envp;
-  bool added = FALSE;
-  const char *input = line;
-  *replaced = FALSE;
-  curlx_dyn_init(out, MAX_EXPAND_CONTENT);
+  struct var_seg *seg;
+  if(!len)
+    return TRUE;
+  if(t->nsegs == t->asegs) {
+    size_t asegs = t->asegs ? t->asegs * 2 : 8;
+    struct var_seg *segs = realloc(t->segs, asegs * sizeof(*segs));
+    if(!segs)
+      return FALSE;
+    t->segs = segs;
+    t->asegs = asegs;
+  }
+  seg = &t->segs[t->nsegs++];
+  memset(seg, 0, sizeof(*seg));
+  seg->str = str;
+  seg->len = len;
+  return TRUE;
+}
+
+static bool tmpl_func(struct var_tmpl *t, unsigned char id)
+{
+  if(t->nf == t->af) {
+    size_t af = t->af ? t->af * 2 : 8;
+    unsigned char *funcs = realloc(t->funcs, af);
+    if(!funcs)
+      return FALSE;
+    t->funcs = funcs;
+    t->af = af;
+  }
+  t->funcs[t->nf++] = id;
+  return TRUE;
+}
+
+/* the functions after the name of a reference, 'f' is at the colon */
+static ParameterError tmpl_funcs(struct var_tmpl *t, const char *f,
+                                 size_t flen)
+{
+  const char *finput = f;
+  while(*f) {
+    unsigned char id;
+    if(*f == '}')
+      /* end of functions */
+      break;
+    /* On entry, this is known to be a colon already. In subsequent laps, it
+       is also known to be a colon since that is part of the FUNCMATCH()
+       checks */
+    f++;
+    if(FUNCMATCH(f, FUNC_TRIM, FUNC_TRIM_LEN)) {
+      f += FUNC_TRIM_LEN;
+      id = VF_TRIM;
+    }
+    else if(FUNCMATCH(f, FUNC_JSON, FUNC_JSON_LEN)) {
+      f += FUNC_JSON_LEN;
+      id = VF_JSON;
+    }
+    else if(FUNCMATCH(f, FUNC_URL, FUNC_URL_LEN)) {
+      f += FUNC_URL_LEN;
+      id = VF_URL;
+    }
+    else if(FUNCMATCH(f, FUNC_B64, FUNC_B64_LEN)) {
+      f += FUNC_B64_LEN;
+      id = VF_B64;
+    }
+    else if(FUNCMATCH(f, FUNC_64DEC, FUNC_64DEC_LEN)) {
+      f += FUNC_64DEC_LEN;
+      id = VF_64DEC;
+    }
+    else {
+      /* unsupported function */
+      errorf("unknown variable function in '%.*s'", (int)flen, finput);
+      return PARAM_EXPAND_ERROR;
+    }
+    if(!tmpl_func(t, id))
+      return PARAM_NO_MEM;
+  }
+  return PARAM_OK;
+}
+
+/* split the line into text and references */
+static ParameterError tmpl_compile(struct var_tmpl *t)
+{
+  const char *input = t->line;
+  const char *line = input;
+  const char *envp;
+
   do {
     envp = strstr(line, "{{");
     if((envp > line) && envp[-1] == '\\') {
-      /* preceding backslash, we want this verbatim */
-
-      /* insert the text up to this point, minus the backslash */
-      result = curlx_dyn_addn(out, line, envp - line - 1);
-      if(result)
-        return PARAM_NO_MEM;
-
-      /* output '{{' then continue from here */
-      result = curlx_dyn_addn(out, "{{", 2);
-      if(result)
+      /* preceding backslash, we want this verbatim: the text up to this
+         point minus the backslash, then '{{' */
+      if(!tmpl_seg(t, line, envp - line - 1) || !tmpl_seg(t, envp, 2))
         return PARAM_NO_MEM;
       line = &envp[2];
     }
     else if(envp) {
-      char name[MAX_VAR_LEN];
       size_t nlen;
       size_t i;
-      char *funcp;
-      char *clp = strstr(envp, "}}");
-      size_t prefix;
+      const char *funcp;
+      const char *clp = strstr(envp, "}}");
+      const char *name;
 
       if(!clp) {
         /* uneven braces */
@@ -248,97 +392,186 @@ ParameterError varexpand(const char *line, struct dynbuf *out,
         break;
       }
 
-      prefix = 2;
-      envp += 2; /* move over the {{ */
+      name = envp + 2; /* move over the {{ */
 
       /* if there is a function, it ends the name with a colon */
-      funcp = memchr(envp, ':', clp - envp);
+      funcp = memchr(name, ':', clp - name);
       if(funcp)
-        nlen = funcp - envp;
+        nlen = funcp - name;
       else
-        nlen = clp - envp;
-      if(!nlen || (nlen >= sizeof(name))) {
+        nlen = clp - name;
+      if(!nlen || (nlen >= MAX_VAR_LEN)) {
         warnf("bad variable name length '%s'", input);
         /* insert the text as-is since this is not an env variable */
-        result = curlx_dyn_addn(out, line, clp - line + prefix);
-        if(result)
+        if(!tmpl_seg(t, line, clp - line + 2))
           return PARAM_NO_MEM;
       }
       else {
-        /* insert the text up to this point */
-        result = curlx_dyn_addn(out, line, envp - prefix - line);
-        if(result)
+        /* the text up to this point */
+        if(!tmpl_seg(t, line, envp - line))
           return PARAM_NO_MEM;
 
-        /* copy the name to separate buffer */
-        memcpy(name, envp, nlen);
-        name[nlen] = 0;
-
         /* verify that the name looks sensible */
         for(i = 0; (i < nlen) &&
               (ISALNUM(name[i]) || (name[i] == '_')); i++);
         if(i != nlen) {
-          warnf("bad variable name: %s", name);
+          warnf("bad variable name: %.*s", (int)nlen, name);
           /* insert the text as-is since this is not an env variable */
-          result = curlx_dyn_addn(out, envp - prefix,
-                                  clp - envp + prefix + 2);
-          if(result)
+          if(!tmpl_seg(t, envp, clp - envp + 2))
             return PARAM_NO_MEM;
         }
         else {
-          char *value;
-          size_t vlen = 0;
-          struct dynbuf buf;
-          const struct tool_var *v = varcontent(name, nlen);
-          if(v) {
-            value = (char *)CURL_UNCONST(v->content);
-            vlen = v->clen;
-          }
-          else
-            value = NULL;
-
-          curlx_dyn_init(&buf, MAX_EXPAND_CONTENT);
+          struct var_seg *seg;
+          size_t func = t->nf;
+          if(!tmpl_seg(t, name, nlen))
+            return PARAM_NO_MEM;
           if(funcp) {
-            /* apply the list of functions on the value */
-            size_t flen = clp - funcp;
-            ParameterError err = varfunc(value, vlen, funcp, flen, &buf);
+            ParameterError err = tmpl_funcs(t, funcp, clp - funcp);
             if(err)
               return err;
-            value = curlx_dyn_ptr(&buf);
-            vlen = curlx_dyn_len(&buf);
-          }
-
-          if(value && vlen > 0) {
-            /* A variable might contain null bytes. Such bytes cannot be shown
-               using normal means, this is an error. */
-            char *nb = memchr(value, '\0', vlen);
-            if(nb) {
-              errorf("variable contains null byte");
-              return PARAM_EXPAND_ERROR;
-            }
           }
-          /* insert the value */
-          result = curlx_dyn_addn(out, value, vlen);
-          curlx_dyn_free(&buf);
-          if(result)
-            return PARAM_NO_MEM;
-
-          added = true;
+          seg = &t->segs[t->nsegs - 1];
+          seg->ref = TRUE;
+          seg->hash = var_hash(name, nlen);
+          seg->func = func;
+          seg->nfuncs = t->nf - func;
+          t->nrefs++;
         }
       }
       line = &clp[2];
     }
-
   } while(envp);
-  if(added && *line) {
-    /* add the "suffix" as well */
-    result = curlx_dyn_add(out, line);
+
+  /* the rest of the line */
+  if(!tmpl_seg(t, line, strlen(line)))
+    return PARAM_NO_MEM;
+  return PARAM_OK;
+}
+
+/* the compiled line, from the ones compiled before if it is there */
+static ParameterError tmpl_get(const char *line, struct var_tmpl **tp)
+{
+  struct var_tmpls *tmpls = global->templates;
+  size_t hash = var_hash(line, strlen(line));
+  struct var_tmpl *t;
+  ParameterError err;
+
+  *tp = NULL;
+  if(!tmpls) {
+    tmpls = calloc(1, sizeof(*tmpls));
+    if(!tmpls)
+      return PARAM_NO_MEM;
+    global->templates = tmpls;
+  }
+  if(tmpls->count >= tmpls->size) {
+    size_t size = tmpls->size ? tmpls->size * 2 : VAR_SLOTS;
+    struct var_tmpl **table = calloc(size, sizeof(*table));
+    size_t i;
+    if(!table)
+      return PARAM_NO_MEM;
+    for(i = 0; i < tmpls->size; i++) {
+      while(tmpls->table[i]) {
+        t = tmpls->table[i];
+        tmpls->table[i] = t->next;
+        t->next = table[t->hash & (size - 1)];
+        table[t->hash & (size - 1)] = t;
+      }
+    }
+    free(tmpls->table);
+    tmpls->table = table;
+    tmpls->size = size;
+  }
+
+  for(t = tmpls->table[hash & (tmpls->size - 1)]; t; t = t->next) {
+    if((t->hash == hash) && !strcmp(t->line, line)) {
+      *tp = t;
+      return PARAM_OK;
+    }
+  }
+
+  t = calloc(1, sizeof(*t));
+  if(!t)
+    return PARAM_NO_MEM;
+  t->line = strdup(line);
+  if(!t->line) {
+    free(t);
+    return PARAM_NO_MEM;
+  }
+  t->hash = hash;
+  err = tmpl_compile(t);
+  if(err) {
+    tmpl_free(t);
+    return err;
+  }
+  t->next = tmpls->table[hash & (tmpls->size - 1)];
+  tmpls->table[hash & (tmpls->size - 1)] = t;
+  tmpls->count++;
+  *tp = t;
+  return PARAM_OK;
+}
+
+ParameterError varexpand(const char *line, struct dynbuf *out,
+                         bool *replaced)
+{
+  struct var_tmpl *t;
+  ParameterError err;
+  size_t i;
+
+  *replaced = FALSE;
+  curlx_dyn_init(out, MAX_EXPAND_CONTENT);
+  err = tmpl_get(line, &t);
+  if(err || !t->nrefs)
+    return err;
+
+  for(i = 0; i < t->nsegs; i++) {
+    const struct var_seg *seg = &t->segs[i];
+    char *value;
+    size_t vlen = 0;
+    struct dynbuf buf;
+    const struct tool_var *v;
+    CURLcode result;
+
+    if(!seg->ref) {
+      if(curlx_dyn_addn(out, seg->str, seg->len))
+        return PARAM_NO_MEM;
+      continue;
+    }
+
+    v = varcontent(seg->str, seg->len, seg->hash);
+    if(v) {
+      value = (char *)CURL_UNCONST(v->content);
+      vlen = v->clen;
+    }
+    else
+      value = NULL;
+
+    curlx_dyn_init(&buf, MAX_EXPAND_CONTENT);
+    if(seg->nfuncs) {
+      /* apply the list of functions on the value */
+      err = varfunc(value, vlen, &t->funcs[seg->func], seg->nfuncs, &buf);
+      if(err)
+        return err;
+      value = curlx_dyn_ptr(&buf);
+      vlen = curlx_dyn_len(&buf);
+    }
+
+    if(value && vlen > 0) {
+      /* A variable might contain null bytes. Such bytes cannot be shown
+         using normal means, this is an error. */
+      char *nb = memchr(value, '\0', vlen);
+      if(nb) {
+        errorf("variable contains null byte");
+        curlx_dyn_free(&buf);
+        return PARAM_EXPAND_ERROR;
+      }
+    }
+    /* insert the value */
+    result = curlx_dyn_addn(out, value, vlen);
+    curlx_dyn_free(&buf);
     if(result)
       return PARAM_NO_MEM;
   }
-  *replaced = added;
-  if(!added)
-    curlx_dyn_free(out);
+  *replaced = TRUE;
   return PARAM_OK;
 }
 
@@ -351,13 +584,56 @@ static ParameterError addvariable(const char *name,
                                   size_t nlen,
                                   const char *content,
                                   size_t clen,
-                                  bool contalloc)
+                                  bool contalloc,
+                                  bool pinned)
 {
+  struct tool_vars *vars = global->variables;
   struct tool_var *p;
-  const struct tool_var *check = varcontent(name, nlen);
+  size_t hash = var_hash(name, nlen);
+  struct tool_var *check = varcontent(name, nlen, hash);
   DEBUGASSERT(nlen);
-  if(check)
+  if(check && check->pinned) {
+    /* the value given for the run wins over the command line */
+    if(contalloc)
+      free(CURL_UNCONST(content));
+    return PARAM_OK;
+  }
+  if(check) {
+    const char *c = contalloc ? content : memdup0(content, clen);
+    if(!c)
+      return PARAM_NO_MEM;
     notef("Overwriting variable '%s'", check->name);
+    free(CURL_UNCONST(check->content));
+    check->content = c;
+    check->clen = clen;
+    check->pinned = pinned;
+    return PARAM_OK;
+  }
+
+  if(!vars) {
+    vars = calloc(1, sizeof(*vars));
+    if(!vars)
+      return PARAM_NO_MEM;
+    global->variables = vars;
+  }
+  if(vars->count >= vars->size) {
+    size_t size = vars->size ? vars->size * 2 : VAR_SLOTS;
+    struct tool_var **table = calloc(size, sizeof(*table));
+    size_t i;
+    if(!table)
+      return PARAM_NO_MEM;
+    for(i = 0; i < vars->size; i++) {
+      while(vars->table[i]) {
+        p = vars->table[i];
+        vars->table[i] = p->next;
+        p->next = table[p->hash & (size - 1)];
+        table[p->hash & (size - 1)] = p;
+      }
+    }
+    free(vars->table);
+    vars->table = table;
+    vars->size = size;
+  }
 
   p = calloc(1, sizeof(struct tool_var) + nlen);
   if(p) {
@@ -366,9 +642,13 @@ static ParameterError addvariable(const char *name,
     p->content = contalloc ? content : memdup0(content, clen);
     if(p->content) {
       p->clen = clen;
+      p->nlen = nlen;
+      p->hash = hash;
+      p->pinned = pinned;
 
-      p->next = global->variables;
-      global->variables = p;
+      p->next = vars->table[hash & (vars->size - 1)];
+      vars->table[hash & (vars->size - 1)] = p;
+      vars->count++;
       return PARAM_OK;
     }
     free(p);
@@ -376,6 +656,17 @@ static ParameterError addvariable(const char *name,
   return PARAM_NO_MEM;
 }
 
+ParameterError setvariable_pinned(const char *name, const char *content,
+                                  size_t clen)
+{
+  size_t nlen = 0;
+  while(ISALNUM(name[nlen]) || (name[nlen] == '_'))
+    nlen++;
+  if(!nlen || name[nlen] || (nlen >= MAX_VAR_LEN))
+    return PARAM_VAR_SYNTAX;
+  return addvariable(name, nlen, content, clen, FALSE, TRUE);
+}
+
 #define MAX_FILENAME 10000
 
 ParameterError setvariable(const char *input)
@@ -494,7 +785,7 @@ ParameterError setvariable(const char *input)
     warnf("Bad --variable syntax, skipping: %s", input);
     return PARAM_OK;
   }
-  err = addvariable(name, nlen, content, clen, contalloc);
+  err = addvariable(name, nlen, content, clen, contalloc, FALSE);
   if(err) {
     if(contalloc)
       free(content);
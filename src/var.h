@@ -26,18 +26,28 @@
 
 #include "tool_getparam.h"
 
+struct var_tmpls;
+
 struct tool_var {
-  struct tool_var *next;
+  struct tool_var *next; /* in the hash chain */
   const char *content;
   size_t clen; /* content length */
+  size_t nlen; /* name length */
+  size_t hash; /* of the name */
+  BIT(pinned); /* set by the application running a plan, not overwritten */
   char name[1]; /* allocated as part of the struct */
 };
 
 ParameterError setvariable(const char *input);
+ParameterError setvariable_pinned(const char *name, const char *content,
+                                  size_t clen);
 ParameterError varexpand(const char *line, struct dynbuf *out,
                          bool *replaced);
 
 /* free everything */
 void varcleanup(void);
 
+/* free lines compiled for expansion, kept apart from global->templates */
+void vartemplates_free(struct var_tmpls *tmpls);
+
 #endif /* HEADER_CURL_VAR_H */
@@ -0,0 +1,167 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "first.h"
+
+#include "memdebug.h"
+
+/* CURLMOPT_PERFORM_READY: transfers run by curl_multi_perform() only when
+   curl_multi_poll() saw activity for them or a timer expired. The last one
+   pauses when it gets data. Once it has no timer left, it is not run while
+   the multi handle is polled some more, until it is unpaused. */
+
+#define T3035_HANDLES 5
+#define T3035_IDLE (T3035_HANDLES - 1)
+#define T3035_ROUNDS 5 /* polls with only the paused transfer left */
+
+struct t3035_xfer {
+  size_t received;
+  bool paused;
+  int runs; /* progress callbacks while paused */
+};
+
+static size_t t3035_write_cb(char *ptr, size_t size, size_t nmemb,
+                             void *userp)
+{
+  struct t3035_xfer *x = userp;
+  (void)ptr;
+  if(x->paused) {
+    x->paused = FALSE;
+    return CURL_WRITEFUNC_PAUSE;
+  }
+  x->received += size * nmemb;
+  return size * nmemb;
+}
+
+static int t3035_progress_cb(void *userp, curl_off_t dltotal,
+                             curl_off_t dlnow, curl_off_t ultotal,
+                             curl_off_t ulnow)
+{
+  struct t3035_xfer *x = userp;
+  (void)dltotal;
+  (void)dlnow;
+  (void)ultotal;
+  (void)ulnow;
+  x->runs++;
+  return 0;
+}
+
+static CURLcode test_lib3035(const char *URL)
+{
+  CURLcode res = CURLE_OK;
+  CURL *curl[T3035_HANDLES] = {0};
+  struct t3035_xfer xfer[T3035_HANDLES];
+  CURLcode results[T3035_HANDLES];
+  CURLM *m = NULL;
+  CURLMsg *msg;
+  int running = 1;
+  int rounds = 0;
+  int idle_runs = -1;
+  int msgs;
+  size_t i;
+
+  start_test_timing();
+
+  global_init(CURL_GLOBAL_ALL);
+
+  multi_init(m);
+
+  multi_setopt(m, CURLMOPT_PERFORM_READY, 1L);
+
+  memset(xfer, 0, sizeof(xfer));
+  xfer[T3035_IDLE].paused = TRUE;
+  for(i = 0; i < CURL_ARRAYSIZE(curl); i++) {
+    results[i] = CURLE_AGAIN;
+    easy_init(curl[i]);
+    easy_setopt(curl[i], CURLOPT_URL, URL);
+    easy_setopt(curl[i], CURLOPT_WRITEFUNCTION, t3035_write_cb);
+    easy_setopt(curl[i], CURLOPT_WRITEDATA, &xfer[i]);
+    easy_setopt(curl[i], CURLOPT_PRIVATE, &results[i]);
+    multi_add_handle(m, curl[i]);
+  }
+  /* the paused one counts how often it is run */
+  easy_setopt(curl[T3035_IDLE], CURLOPT_XFERINFOFUNCTION, t3035_progress_cb);
+  easy_setopt(curl[T3035_IDLE], CURLOPT_XFERINFODATA, &xfer[T3035_IDLE]);
+  easy_setopt(curl[T3035_IDLE], CURLOPT_NOPROGRESS, 0L);
+
+  while(running) {
+    int num;
+    multi_perform(m, &running);
+
+    abort_on_test_timeout();
+
+    if(!running)
+      break; /* done */
+
+    if((running == 1) && (idle_runs < 0)) {
+      /* only the paused one is left, it is counted from when it waits for
+         nothing at all */
+      if(!rounds) {
+        long timeout_ms;
+        multi_timeout(m, &timeout_ms);
+        if(timeout_ms < 0) {
+          xfer[T3035_IDLE].runs = 0;
+          rounds = 1;
+        }
+      }
+      else if(++rounds > T3035_ROUNDS) {
+        idle_runs = xfer[T3035_IDLE].runs;
+        curl_easy_pause(curl[T3035_IDLE], CURLPAUSE_CONT);
+      }
+    }
+
+    multi_poll(m, NULL, 0, ((idle_runs < 0) && rounds) ? 100 : 1000, &num);
+
+    abort_on_test_timeout();
+  }
+
+  while((msg = curl_multi_info_read(m, &msgs))) {
+    if(msg->msg == CURLMSG_DONE) {
+      CURLcode *resultp;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &resultp);
+      *resultp = msg->data.result;
+    }
+  }
+
+  for(i = 0; i < CURL_ARRAYSIZE(curl); i++) {
+    curl_mprintf("[%zu] result %d, %zu bytes\n", i, (int)results[i],
+                 xfer[i].received);
+    if(results[i] != CURLE_OK)
+      res = TEST_ERR_MAJOR_BAD;
+  }
+  curl_mprintf("paused transfer run %d times\n", idle_runs);
+  if(idle_runs)
+    res = TEST_ERR_MAJOR_BAD;
+
+test_cleanup:
+
+  for(i = 0; i < CURL_ARRAYSIZE(curl); i++) {
+    curl_multi_remove_handle(m, curl[i]);
+    curl_easy_cleanup(curl[i]);
+  }
+
+  curl_multi_cleanup(m);
+  curl_global_cleanup();
+
+  return res;
+}
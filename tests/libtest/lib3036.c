@@ -0,0 +1,299 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "first.h"
+
+#include "memdebug.h"
+
+#ifdef HAVE_SOCKETPAIR
+
+/* The numfds of curl_multi_wait() and curl_multi_poll() counts the sockets
+   with events, whether the multi handle polls an epoll set of its sockets or
+   each socket. Each transfer runs over one end of a socketpair, the test
+   answers on the other end, so it controls which transfers are idle.
+
+   A late transfer is added after the first answers. Test 3037 makes adding
+   its socket to the epoll set fail, the counts then have to stay the same
+   with each socket polled. */
+
+#define T3036_HANDLES 4
+#define T3036_ACTIVE 2 /* transfers answered first */
+
+#define T3036_HEAD "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\n"
+#define T3036_BODY "abc"
+
+struct t3036_xfer {
+  curl_socket_t sock[2]; /* [0] for libcurl, [1] answered by the test */
+  size_t received;
+  CURLcode result;
+};
+
+static curl_socket_t t3036_opensocket_cb(void *clientp,
+                                         curlsocktype purpose,
+                                         struct curl_sockaddr *address)
+{
+  struct t3036_xfer *x = clientp;
+  (void)purpose;
+  (void)address;
+  return x->sock[0];
+}
+
+static int t3036_sockopt_cb(void *clientp, curl_socket_t curlfd,
+                            curlsocktype purpose)
+{
+  (void)clientp;
+  (void)curlfd;
+  (void)purpose;
+  return CURL_SOCKOPT_ALREADY_CONNECTED;
+}
+
+/* the test closes the sockets */
+static int t3036_closesocket_cb(void *clientp, curl_socket_t item)
+{
+  (void)clientp;
+  (void)item;
+  return 0;
+}
+
+static size_t t3036_write_cb(char *ptr, size_t size, size_t nmemb,
+                             void *userp)
+{
+  struct t3036_xfer *x = userp;
+  (void)ptr;
+  x->received += size * nmemb;
+  return size * nmemb;
+}
+
+static CURLcode t3036_answer(struct t3036_xfer *x, const char *str)
+{
+  size_t len = strlen(str);
+  if(swrite(x->sock[1], str, len) != (ssize_t)len) {
+    curl_mfprintf(stderr, "answering a transfer failed\n");
+    return TEST_ERR_FAILURE;
+  }
+  return CURLE_OK;
+}
+
+/* number of sockets with events, from curl_multi_wait() and, without
+   extra fds, also curl_multi_poll(). Both have to agree. */
+static CURLcode t3036_ready(CURLM *m, struct curl_waitfd *extra,
+                            unsigned int extra_nfds, int timeout_ms,
+                            int *numfds)
+{
+  CURLMcode mc;
+  int polled;
+
+  mc = curl_multi_wait(m, extra, extra_nfds, timeout_ms, numfds);
+  if(mc) {
+    curl_mfprintf(stderr, "curl_multi_wait() failed: %d\n", (int)mc);
+    return TEST_ERR_MULTI;
+  }
+  if(extra_nfds)
+    return CURLE_OK;
+  mc = curl_multi_poll(m, NULL, 0, timeout_ms, &polled);
+  if(mc) {
+    curl_mfprintf(stderr, "curl_multi_poll() failed: %d\n", (int)mc);
+    return TEST_ERR_MULTI;
+  }
+  if(polled != *numfds) {
+    curl_mfprintf(stderr, "curl_multi_poll() has %d fds, "
+                  "curl_multi_wait() %d\n", polled, *numfds);
+    return TEST_ERR_FAILURE;
+  }
+  return CURLE_OK;
+}
+
+static CURLcode t3036_add(CURLM *m, CURL **curl, struct t3036_xfer *x)
+{
+  CURLcode res = CURLE_OK;
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, x->sock)) {
+    curl_mfprintf(stderr, "socketpair() failed\n");
+    return TEST_ERR_FAILURE;
+  }
+  x->result = CURLE_AGAIN;
+
+  easy_init(*curl);
+  easy_setopt(*curl, CURLOPT_URL, "http://127.0.0.1:47/3036");
+  easy_setopt(*curl, CURLOPT_OPENSOCKETFUNCTION, t3036_opensocket_cb);
+  easy_setopt(*curl, CURLOPT_OPENSOCKETDATA, x);
+  easy_setopt(*curl, CURLOPT_SOCKOPTFUNCTION, t3036_sockopt_cb);
+  easy_setopt(*curl, CURLOPT_CLOSESOCKETFUNCTION, t3036_closesocket_cb);
+  easy_setopt(*curl, CURLOPT_WRITEFUNCTION, t3036_write_cb);
+  easy_setopt(*curl, CURLOPT_WRITEDATA, x);
+  easy_setopt(*curl, CURLOPT_PRIVATE, x);
+  multi_add_handle(m, *curl);
+
+test_cleanup:
+  return res;
+}
+
+/* run until all transfers have sent their requests and wait */
+static CURLcode t3036_settle(CURLM *m, int *numfds)
+{
+  CURLcode res = CURLE_OK;
+  int running;
+  int i;
+
+  for(i = 0; i < 10; i++) {
+    multi_perform(m, &running);
+    res = t3036_ready(m, NULL, 0, 0, numfds);
+    if(res || !*numfds)
+      break;
+  }
+
+test_cleanup:
+  return res;
+}
+
+static CURLcode test_lib3036(const char *URL)
+{
+  CURLcode res = CURLE_OK;
+  CURL *curl[T3036_HANDLES + 1] = {0};
+  struct t3036_xfer xfer[T3036_HANDLES + 1];
+  struct curl_waitfd extra;
+  CURLM *m = NULL;
+  CURLMsg *msg;
+  int running = 1;
+  int numfds;
+  int msgs;
+  size_t i;
+
+  if(!strcmp("check", URL))
+    return CURLE_OK; /* no output makes it not skipped */
+
+  for(i = 0; i < CURL_ARRAYSIZE(xfer); i++) {
+    xfer[i].sock[0] = xfer[i].sock[1] = CURL_SOCKET_BAD;
+    xfer[i].received = 0;
+    xfer[i].result = CURLE_OK;
+  }
+
+  start_test_timing();
+
+  global_init(CURL_GLOBAL_ALL);
+
+  multi_init(m);
+
+  for(i = 0; i < T3036_HANDLES; i++) {
+    res = t3036_add(m, &curl[i], &xfer[i]);
+    if(res)
+      goto test_cleanup;
+  }
+
+  res = t3036_settle(m, &numfds);
+  if(res)
+    goto test_cleanup;
+  curl_mprintf("idle: %d\n", numfds);
+
+  for(i = 0; i < T3036_ACTIVE; i++) {
+    res = t3036_answer(&xfer[i], T3036_HEAD);
+    if(res)
+      goto test_cleanup;
+  }
+  res = t3036_ready(m, NULL, 0, 1000, &numfds);
+  if(res)
+    goto test_cleanup;
+  curl_mprintf("answered: %d\n", numfds);
+
+  /* a socket the test answers on is writable */
+  extra.fd = xfer[T3036_HANDLES - 1].sock[1];
+  extra.events = CURL_WAIT_POLLOUT;
+  extra.revents = 0;
+  res = t3036_ready(m, &extra, 1, 1000, &numfds);
+  if(res)
+    goto test_cleanup;
+  curl_mprintf("answered and extra: %d, revents %d\n", numfds,
+               (int)extra.revents);
+
+  /* the late transfer */
+  res = t3036_add(m, &curl[T3036_HANDLES], &xfer[T3036_HANDLES]);
+  if(res)
+    goto test_cleanup;
+  res = t3036_settle(m, &numfds);
+  if(res)
+    goto test_cleanup;
+  curl_mprintf("idle again: %d\n", numfds);
+
+  for(i = 0; i < CURL_ARRAYSIZE(xfer); i++) {
+    res = t3036_answer(&xfer[i], (i < T3036_ACTIVE) ? T3036_BODY :
+                       T3036_HEAD T3036_BODY);
+    if(res)
+      goto test_cleanup;
+  }
+  res = t3036_ready(m, NULL, 0, 1000, &numfds);
+  if(res)
+    goto test_cleanup;
+  curl_mprintf("all answered: %d\n", numfds);
+
+  while(running) {
+    multi_perform(m, &running);
+
+    abort_on_test_timeout();
+
+    if(!running)
+      break; /* done */
+
+    multi_poll(m, NULL, 0, 1000, &numfds);
+
+    abort_on_test_timeout();
+  }
+
+  while((msg = curl_multi_info_read(m, &msgs))) {
+    if(msg->msg == CURLMSG_DONE) {
+      struct t3036_xfer *x;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &x);
+      x->result = msg->data.result;
+    }
+  }
+
+  for(i = 0; i < CURL_ARRAYSIZE(xfer); i++) {
+    curl_mprintf("[%zu] result %d, %zu bytes\n", i, (int)xfer[i].result,
+                 xfer[i].received);
+    if(xfer[i].result != CURLE_OK)
+      res = TEST_ERR_MAJOR_BAD;
+  }
+
+test_cleanup:
+
+  for(i = 0; i < CURL_ARRAYSIZE(curl); i++) {
+    curl_multi_remove_handle(m, curl[i]);
+    curl_easy_cleanup(curl[i]);
+    if(xfer[i].sock[0] != CURL_SOCKET_BAD)
+      sclose(xfer[i].sock[0]);
+    if(xfer[i].sock[1] != CURL_SOCKET_BAD)
+      sclose(xfer[i].sock[1]);
+  }
+
+  curl_multi_cleanup(m);
+  curl_global_cleanup();
+
+  return res;
+}
+#else
+static CURLcode test_lib3036(const char *URL)
+{
+  (void)URL;
+  curl_mprintf("lacks socketpair\n");
+  return CURLE_OK;
+}
+#endif
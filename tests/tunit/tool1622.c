@@ -0,0 +1,131 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "curl_runner.h"
+
+#ifdef USE_THREADS_POSIX
+#include <pthread.h>
+#endif
+
+#include "memdebug.h" /* LAST include file */
+
+#define T1622_THREADS 4
+#define T1622_RUNS 8
+
+#define T1622_DATA "runner contents\n"
+
+struct t1622_job {
+  curl_runner_ctx *ctx;
+  const char *url;
+  int fails;
+};
+
+static int t1622_run(curl_runner_ctx *ctx, const char *url)
+{
+  char name[] = "curl";
+  char silent[] = "-s";
+  char *argv[4];
+  struct CaptureBuffer out;
+  int fails = 0;
+  int i;
+
+  argv[0] = name;
+  argv[1] = silent;
+  argv[2] = strdup(url);
+  argv[3] = NULL;
+  if(!argv[2])
+    return T1622_RUNS;
+  for(i = 0; i < T1622_RUNS; i++) {
+    int rc;
+    capture_init(&out, NULL, 0);
+    rc = curl_runner_exec(ctx, 3, argv, &out, NULL);
+    if(rc || !out.data || (out.size != strlen(T1622_DATA)) ||
+       memcmp(out.data, T1622_DATA, out.size))
+      fails++;
+    capture_free(&out);
+  }
+  free(argv[2]);
+  return fails;
+}
+
+#ifdef USE_THREADS_POSIX
+static void *t1622_thread(void *ptr)
+{
+  struct t1622_job *job = ptr;
+  job->fails = t1622_run(job->ctx, job->url);
+  return NULL;
+}
+#endif
+
+static CURLcode test_tool1622(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  curl_runner_ctx *ctx = curl_runner_init();
+  fail_unless(ctx, "curl_runner_init failed");
+  if(ctx) {
+    char name[] = "curl";
+    char badopt[] = "--no-such-option";
+    char *badargv[3];
+    int rc;
+
+    /* a failed call reports its own exit code */
+    badargv[0] = name;
+    badargv[1] = badopt;
+    badargv[2] = NULL;
+    rc = curl_runner_exec(ctx, 2, badargv, NULL, NULL);
+    fail_unless(rc == CURLE_FAILED_INIT, "unexpected exit code");
+
+    /* and leaves nothing behind for the next one */
+    fail_if(t1622_run(ctx, arg), "serial run failed");
+
+#ifdef USE_THREADS_POSIX
+    {
+      pthread_t threads[T1622_THREADS];
+      struct t1622_job jobs[T1622_THREADS];
+      int started = 0;
+      int i;
+
+      for(i = 0; i < T1622_THREADS; i++) {
+        jobs[i].ctx = ctx;
+        jobs[i].url = arg;
+        jobs[i].fails = 0;
+        if(pthread_create(&threads[i], NULL, t1622_thread, &jobs[i]))
+          break;
+        started++;
+      }
+      fail_unless(started == T1622_THREADS, "pthread_create failed");
+      for(i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        fail_if(jobs[i].fails, "threaded run failed");
+      }
+    }
+#endif
+
+    curl_runner_cleanup(ctx);
+  }
+
+  UNITTEST_END_SIMPLE
+}
@@ -0,0 +1,90 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "curl_runner.h"
+
+#include "memdebug.h" /* LAST include file */
+
+/* run one transfer and return the number of connects it made, or -1 */
+static int t1623_connects(curl_runner_ctx *ctx, const char *url)
+{
+  char name[] = "curl";
+  char silent[] = "-s";
+  char wout[] = "-w";
+  char format[256];
+  char *argv[6];
+  int connects = -1;
+  FILE *f;
+
+  /* the body goes to stdout, the counter to a file */
+  curl_msnprintf(format, sizeof(format), "%%output{%s}%%{num_connects}",
+                 libtest_arg2);
+  argv[0] = name;
+  argv[1] = silent;
+  argv[2] = wout;
+  argv[3] = format;
+  argv[4] = strdup(url);
+  argv[5] = NULL;
+  if(!argv[4])
+    return -1;
+
+  if(!curl_runner_exec(ctx, 5, argv, NULL, NULL)) {
+    f = fopen(libtest_arg2, FOPEN_READTEXT);
+    if(f) {
+      if(fscanf(f, "%d", &connects) != 1)
+        connects = -1;
+      fclose(f);
+    }
+  }
+  free(argv[4]);
+  return connects;
+}
+
+static CURLcode test_tool1623(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  curl_runner_ctx *ctx = curl_runner_init();
+  fail_unless(ctx, "curl_runner_init failed");
+  if(ctx) {
+    /* the first call connects, the next one reuses that connection */
+    fail_unless(t1623_connects(ctx, arg) == 1, "first call did not connect");
+    fail_unless(t1623_connects(ctx, arg) == 0, "connection not reused");
+
+    /* without pools every call starts over */
+    fail_if(curl_runner_setopt(ctx, CURLRUNNEROPT_MAXPOOLS, 0), "setopt");
+    fail_unless(t1623_connects(ctx, arg) == 1, "pool was not dropped");
+    fail_unless(t1623_connects(ctx, arg) == 1, "pool was kept");
+
+    fail_unless(curl_runner_setopt(ctx, CURLRUNNEROPT_KEEP, 1L << 8) ==
+                CURLE_BAD_FUNCTION_ARGUMENT, "bad KEEP bits accepted");
+    fail_unless(curl_runner_setopt(ctx, CURLRUNNEROPT_MAXAGE_CONN, -1) ==
+                CURLE_BAD_FUNCTION_ARGUMENT, "negative age accepted");
+
+    curl_runner_cleanup(ctx);
+  }
+
+  UNITTEST_END_SIMPLE
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "curl_runner.h"
+
+#include "memdebug.h" /* LAST include file */
+
+#define T1624_BODY "-foo-\nbar\n-foo-\nbar\n"
+
+static int t1624_run(curl_runner_ctx *ctx, const char *opt, const char *url,
+                     const struct curl_runner_io *io)
+{
+  char name[] = "curl";
+  char *argv[4];
+  int rc;
+
+  argv[0] = name;
+  argv[1] = strdup(opt);
+  argv[2] = url ? strdup(url) : NULL;
+  argv[3] = NULL;
+  rc = curl_runner_exec_io(ctx, url ? 3 : 2, argv, io);
+  free(argv[1]);
+  free(argv[2]);
+  return rc;
+}
+
+static CURLcode test_tool1624(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  curl_runner_ctx *ctx = curl_runner_init();
+  fail_unless(ctx, "curl_runner_init failed");
+  if(ctx) {
+    struct curl_runner_io io;
+    struct curl_runner_chunks chunks;
+    struct curl_runner_chunk *chunk;
+    struct curl_runner_mapfile mf;
+    struct CaptureBuffer headers;
+    struct CaptureBuffer errors;
+    struct CaptureBuffer small;
+    char smallbuf[4];
+    char body[64];
+    const char *map;
+    size_t len = 0;
+
+    /* body in tiny chunks, headers as they arrive */
+    memset(&io, 0, sizeof(io));
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.chunk_size = 7;
+    capture_init(&headers, NULL, 0);
+    io.body = curl_runner_chunks_sink;
+    io.body_userp = &chunks;
+    io.header = curl_runner_capture_sink;
+    io.header_userp = &headers;
+    fail_if(t1624_run(ctx, "-s", arg, &io), "chunked run failed");
+    fail_unless(chunks.total == strlen(T1624_BODY), "wrong body size");
+    fail_unless(chunks.head && chunks.head->next, "not split in chunks");
+    for(chunk = chunks.head; chunk; chunk = chunk->next) {
+      fail_unless(chunk->len <= 7, "chunk overflow");
+      if(len + chunk->len < sizeof(body)) {
+        memcpy(&body[len], chunk->data, chunk->len);
+        len += chunk->len;
+      }
+    }
+    fail_unless(len == strlen(T1624_BODY) &&
+                !memcmp(body, T1624_BODY, len), "wrong body");
+    curl_runner_chunks_free(&chunks);
+    fail_unless(headers.data &&
+                !strncmp(headers.data, "HTTP/1.1 200 OK", 15),
+                "headers not captured");
+    capture_free(&headers);
+
+    /* body into a file mapped afterwards */
+    memset(&io, 0, sizeof(io));
+    memset(&mf, 0, sizeof(mf));
+    mf.fp = tmpfile();
+    fail_unless(mf.fp, "tmpfile failed");
+    if(mf.fp) {
+      io.body = curl_runner_mapfile_sink;
+      io.body_userp = &mf;
+      fail_if(t1624_run(ctx, "-s", arg, &io), "mapfile run failed");
+      map = curl_runner_mapfile_map(&mf, &len);
+      fail_unless(map && (len == strlen(T1624_BODY)) &&
+                  !memcmp(map, T1624_BODY, len), "wrong mapped body");
+      curl_runner_mapfile_unmap(&mf);
+      fclose(mf.fp);
+    }
+
+    /* a caller's array outgrown moves over to the heap */
+    capture_init(&small, smallbuf, sizeof(smallbuf));
+    fail_if(capture_append(&small, "ab", 2), "append failed");
+    fail_unless(small.data == smallbuf, "left the array early");
+    fail_if(capture_append(&small, "cdef", 4), "append failed");
+    fail_unless(small.data != smallbuf && !strcmp(small.data, "abcdef"),
+                "growing failed");
+    capture_free(&small);
+
+    /* messages go to the err sink */
+    memset(&io, 0, sizeof(io));
+    capture_init(&errors, NULL, 0);
+    io.err = curl_runner_capture_sink;
+    io.err_userp = &errors;
+    fail_unless(t1624_run(ctx, "--no-such-option", NULL, &io) ==
+                CURLE_FAILED_INIT, "unexpected exit code");
+    fail_unless(errors.data &&
+                strstr(errors.data, "option --no-such-option: is unknown"),
+                "message not captured");
+    capture_free(&errors);
+
+    curl_runner_cleanup(ctx);
+  }
+
+  UNITTEST_END_SIMPLE
+}
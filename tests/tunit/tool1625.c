@@ -0,0 +1,111 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "curl_runner.h"
+
+#include "memdebug.h" /* LAST include file */
+
+struct t1625_seen {
+  int count;
+  int fails;
+};
+
+static void t1625_result(const struct curl_runner_result *res, void *userp)
+{
+  struct t1625_seen *seen = userp;
+  size_t i;
+  int ctype = 0;
+
+  if((res->index != seen->count) || res->exit_code ||
+     (res->response_code != 200) ||
+     (res->http_version != CURL_HTTP_VERSION_1_1) ||
+     !res->remote_ip || !res->url || !res->effective_url ||
+     (res->num_connects != (seen->count ? 0 : 1)) ||
+     (res->size_download != 6) || (res->size_header != 60) ||
+     (res->size_request <= 0) || (res->time_total <= 0) ||
+     (res->time_total < res->time_starttransfer) ||
+     !res->content_type || strcmp(res->content_type, "text/plain") ||
+     !res->body || (res->body_len != 6) || memcmp(res->body, "hello\n", 6))
+    seen->fails++;
+
+  for(i = 0; i < res->num_headers; i++) {
+    if(!strcmp(res->headers[i].name, "Content-Type") &&
+       !strcmp(res->headers[i].value, "text/plain"))
+      ctype++;
+  }
+  if((res->num_headers != 2) || (ctype != 1))
+    seen->fails++;
+
+  seen->count++;
+}
+
+static size_t t1625_nobody(const char *ptr, size_t len, void *userp)
+{
+  int *calls = userp;
+  (void)ptr;
+  (*calls)++;
+  return len;
+}
+
+static CURLcode test_tool1625(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  curl_runner_ctx *ctx = curl_runner_init();
+  fail_unless(ctx, "curl_runner_init failed");
+  if(ctx) {
+    char name[] = "curl";
+    char silent[] = "-s";
+    char *argv[5];
+    struct curl_runner_io io;
+    struct t1625_seen seen;
+    int body_calls = 0;
+
+    argv[0] = name;
+    argv[1] = silent;
+    argv[2] = strdup(arg);
+    argv[3] = strdup(arg);
+    argv[4] = NULL;
+
+    memset(&io, 0, sizeof(io));
+    memset(&seen, 0, sizeof(seen));
+    io.body = t1625_nobody;
+    io.body_userp = &body_calls;
+    io.result = t1625_result;
+    io.result_userp = &seen;
+    io.result_flags = CURLRUNNER_RESULT_HEADERS | CURLRUNNER_RESULT_BODY;
+    if(argv[2] && argv[3])
+      fail_if(curl_runner_exec_io(ctx, 4, argv, &io), "run failed");
+    fail_unless(seen.count == 2, "wrong number of records");
+    fail_if(seen.fails, "wrong record contents");
+    fail_if(body_calls, "body went to the sink");
+
+    free(argv[2]);
+    free(argv[3]);
+    curl_runner_cleanup(ctx);
+  }
+
+  UNITTEST_END_SIMPLE
+}
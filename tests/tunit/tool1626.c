@@ -0,0 +1,141 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "curl_runner.h"
+
+#include "memdebug.h" /* LAST include file */
+
+static int t1626_run(curl_runner_plan *plan,
+                     const struct curl_runner_overrides *ov)
+{
+  struct CaptureBuffer out;
+  struct curl_runner_io io;
+  int rc;
+
+  capture_init(&out, NULL, 0);
+  memset(&io, 0, sizeof(io));
+  io.body = curl_runner_capture_sink;
+  io.body_userp = &out;
+  rc = curl_runner_plan_exec(plan, ov, &io);
+  if(!rc && ((out.size != 6) || memcmp(out.data, "hello\n", 6)))
+    rc = -1;
+  capture_free(&out);
+  return rc;
+}
+
+static CURLcode test_tool1626(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  curl_runner_ctx *ctx = curl_runner_init();
+  fail_unless(ctx, "curl_runner_init failed");
+  if(ctx) {
+    char name[] = "curl";
+    char silent[] = "-s";
+    char var[] = "--variable";
+    char what[] = "what=plan";
+    char hdr[] = "-H";
+    char plain[] = "X-Plan: yes";
+    char expand[] = "--expand-header";
+    char whathdr[] = "X-What: {{what}}";
+    char globoff[] = "-g";
+    char upload[] = "-T";
+    char *argv[9];
+    char url[256];
+    curl_runner_plan *plan = NULL;
+
+    argv[0] = name;
+    argv[1] = silent;
+    argv[2] = var;
+    argv[3] = what;
+    argv[4] = hdr;
+    argv[5] = plain;
+    argv[6] = expand;
+    argv[7] = whathdr;
+    argv[8] = strdup(arg);
+
+    if(argv[8])
+      fail_if(curl_runner_compile(ctx, 9, argv, NULL, &plan),
+              "compile failed");
+    fail_unless(plan, "no plan");
+    if(plan) {
+      static const char *const extra[] = { "X-Run: 4" };
+      struct curl_runner_var vars[1];
+      struct curl_runner_overrides ov;
+
+      /* as parsed */
+      fail_if(t1626_run(plan, NULL), "plain run failed");
+
+      memset(&ov, 0, sizeof(ov));
+      curl_msnprintf(url, sizeof(url), "%s?run=2", argv[8]);
+      ov.url = url;
+      fail_if(t1626_run(plan, &ov), "url run failed");
+
+      memset(&ov, 0, sizeof(ov));
+      vars[0].name = "what";
+      vars[0].value = "run3";
+      ov.vars = vars;
+      ov.num_vars = 1;
+      fail_if(t1626_run(plan, &ov), "variable run failed");
+
+      memset(&ov, 0, sizeof(ov));
+      ov.headers = extra;
+      ov.num_headers = 1;
+      ov.body = "run=4";
+      ov.body_len = 5;
+      fail_if(t1626_run(plan, &ov), "body run failed");
+
+      curl_runner_plan_free(plan);
+      plan = NULL;
+    }
+
+    /* each run uploads the file, without globbing its name is taken off
+       the URL list */
+    argv[2] = globoff;
+    argv[3] = upload;
+    argv[4] = (char *)CURL_UNCONST(libtest_arg2);
+    argv[5] = argv[8];
+    if(argv[8])
+      fail_if(curl_runner_compile(ctx, 6, argv, NULL, &plan),
+              "upload compile failed");
+    fail_unless(plan, "no upload plan");
+    if(plan) {
+      struct curl_runner_overrides ov;
+
+      fail_if(t1626_run(plan, NULL), "upload run failed");
+
+      memset(&ov, 0, sizeof(ov));
+      curl_msnprintf(url, sizeof(url), "%s?run=6", argv[8]);
+      ov.url = url;
+      fail_if(t1626_run(plan, &ov), "second upload run failed");
+
+      curl_runner_plan_free(plan);
+    }
+    free(argv[8]);
+    curl_runner_cleanup(ctx);
+  }
+
+  UNITTEST_END_SIMPLE
+}
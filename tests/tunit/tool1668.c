@@ -0,0 +1,108 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "tool_cache.h"
+
+#include "memdebug.h" /* LAST include file */
+
+/* hash 'len' bytes of 'data' given in pieces of 'chunk' bytes, 'times' times
+   over */
+static void t1668_hash(const char *data, size_t len, size_t chunk,
+                       long times, char *hex)
+{
+  struct tool_sha256 s;
+  long i;
+
+  tool_sha256_init(&s);
+  for(i = 0; i < times; i++) {
+    size_t done;
+    for(done = 0; done < len; done += chunk)
+      tool_sha256_update(&s, &data[done], CURLMIN(chunk, len - done));
+  }
+  tool_sha256_hex(&s, hex);
+}
+
+static CURLcode test_tool1668(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  /* the examples of FIPS 180-2, appendix B, and the 896-bit message of
+     FIPS 180-4's examples */
+  struct checkthis {
+    const char *input;
+    const char *output;
+  };
+
+  static const struct checkthis tests[] = {
+    { "",
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    /* 448 bits, the padding does not fit in the block */
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    /* 896 bits, two blocks of data */
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+      "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+      "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+    { NULL, NULL } /* end marker */
+  };
+
+  /* all at once, a byte at a time and in pieces not lining up with the
+     64 byte blocks */
+  static const size_t chunks[] = { 1000, 1, 7, 63, 65 };
+  static const char million[] =
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+  char thousand[1000];
+  size_t j;
+  int i;
+
+  for(i = 0; tests[i].input; i++) {
+    for(j = 0; j < CURL_ARRAYSIZE(chunks); j++) {
+      char hex[65];
+      const char *data = tests[i].input;
+      t1668_hash(data, strlen(data), chunks[j], 1, hex);
+      if(strcmp(hex, tests[i].output)) {
+        printf("Test %d in pieces of %zu bytes got %s, expected %s\n",
+               i, chunks[j], hex, tests[i].output);
+        fail_if(TRUE, "wrong SHA-256");
+      }
+    }
+  }
+
+  /* one million times 'a', many blocks */
+  memset(thousand, 'a', sizeof(thousand));
+  for(j = 0; j < CURL_ARRAYSIZE(chunks); j++) {
+    char hex[65];
+    t1668_hash(thousand, sizeof(thousand), chunks[j], 1000, hex);
+    if(strcmp(hex, million)) {
+      printf("A million 'a' in pieces of %zu bytes got %s, expected %s\n",
+             chunks[j], hex, million);
+      fail_if(TRUE, "wrong SHA-256");
+    }
+  }
+
+  UNITTEST_END_SIMPLE
+}
@@ -0,0 +1,187 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "timewheel.h"
+
+#include "memdebug.h" /* LAST include file */
+
+#define T1617_NODES 300
+#define T1617_DAY ((curl_off_t)86400 * 1000000)
+
+static struct curltime t1617_at(struct curltime t, curl_off_t us)
+{
+  t.tv_sec += (time_t)(us / 1000000);
+  t.tv_usec += (int)(us % 1000000);
+  if(t.tv_usec >= 1000000) {
+    t.tv_sec++;
+    t.tv_usec -= 1000000;
+  }
+  return t;
+}
+
+static unsigned int t1617_rand(unsigned int *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 8) & 0xffffff;
+}
+
+/* a random time from now on, on all levels of the wheel */
+static curl_off_t t1617_offset(unsigned int *seed)
+{
+  switch(t1617_rand(seed) % 6) {
+  case 0:
+    return t1617_rand(seed) % 1000; /* within the tick */
+  case 1:
+    return t1617_rand(seed) % 64000;
+  case 2:
+    return t1617_rand(seed) % 4096000;
+  case 3:
+    return (curl_off_t)(t1617_rand(seed) % 1000) * 1000000;
+  case 4:
+    return (curl_off_t)(t1617_rand(seed) % 100000) * 10000000;
+  default:
+    /* beyond the top level */
+    return (curl_off_t)(t1617_rand(seed) % 1000 + 70000000) * 1000000;
+  }
+}
+
+static CURLcode test_unit1617(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  struct Curl_twheel *w;
+  struct Curl_twnode nodes[T1617_NODES];
+  struct Curl_twnode *n;
+  struct curltime now = {1000, 500};
+  unsigned int seed = 1617;
+  int expired[T1617_NODES];
+  int i, round;
+
+  w = Curl_twheel_create(now);
+  abort_unless(w, "out of memory");
+  memset(nodes, 0, sizeof(nodes));
+  fail_unless(!Curl_twheel_first(w), "empty wheel has a first timer");
+  fail_unless(!Curl_twheel_expire(w, now), "empty wheel expires");
+
+  /* the earliest timer of a slot, not the first added */
+  Curl_twheel_add(w, &nodes[0], t1617_at(now, 5900), &nodes[0]);
+  Curl_twheel_add(w, &nodes[1], t1617_at(now, 5100), &nodes[1]);
+  Curl_twheel_add(w, &nodes[2], t1617_at(now, 90000000), &nodes[2]);
+  fail_unless(Curl_twheel_count(w) == 3, "wrong count");
+  fail_unless(Curl_twheel_first(w) == &nodes[1], "wrong first timer");
+
+  /* not expired before its time within the tick */
+  fail_unless(!Curl_twheel_expire(w, t1617_at(now, 5099)),
+              "expired too early");
+  n = Curl_twheel_expire(w, t1617_at(now, 5100));
+  fail_unless(n == &nodes[1] && !Curl_twnode_enext(n), "wrong expiry");
+  fail_unless(!Curl_twnode_queued(&nodes[1]), "expired timer queued");
+  fail_unless(Curl_twheel_first(w) == &nodes[0], "wrong first timer");
+
+  /* moving and removing */
+  Curl_twheel_add(w, &nodes[2], t1617_at(now, 5500), &nodes[2]);
+  fail_unless(Curl_twheel_first(w) == &nodes[2], "moved timer not first");
+  Curl_twheel_remove(w, &nodes[2]);
+  Curl_twheel_remove(w, &nodes[2]);
+  fail_unless(Curl_twheel_count(w) == 1, "wrong count after remove");
+  fail_unless(Curl_twheel_first(w) == &nodes[0], "wrong first timer");
+  Curl_twheel_remove(w, &nodes[0]);
+  fail_unless(!Curl_twheel_first(w), "empty wheel has a first timer");
+
+  /* random timers checked against a plain array */
+  memset(nodes, 0, sizeof(nodes));
+  for(round = 0; round < 2000; round++) {
+    struct curltime first = now;
+    bool have_first = FALSE;
+    unsigned int r = t1617_rand(&seed) % 10;
+
+    if(r < 5) {
+      i = (int)(t1617_rand(&seed) % T1617_NODES);
+      Curl_twheel_add(w, &nodes[i],
+                      t1617_at(now, t1617_offset(&seed)), &nodes[i]);
+    }
+    else if(r < 7) {
+      i = (int)(t1617_rand(&seed) % T1617_NODES);
+      Curl_twheel_remove(w, &nodes[i]);
+    }
+    else {
+      /* sometimes a long way forward */
+      now = t1617_at(now, (r == 9) ?
+                     (curl_off_t)(t1617_rand(&seed) % 100000) * 100000 :
+                     (curl_off_t)(t1617_rand(&seed) % 20000));
+      memset(expired, 0, sizeof(expired));
+      for(n = Curl_twheel_expire(w, now); n; n = Curl_twnode_enext(n)) {
+        struct Curl_twnode *node = Curl_twnode_get(n);
+        i = (int)(node - nodes);
+        fail_unless(!expired[i], "timer expired twice");
+        fail_unless(!Curl_twnode_queued(n), "expired timer queued");
+        fail_unless(curlx_timediff_us(n->time, now) <= 0,
+                    "timer expired early");
+        expired[i] = 1;
+      }
+    }
+
+    for(i = 0; i < T1617_NODES; i++) {
+      if(!Curl_twnode_queued(&nodes[i]))
+        continue;
+      if(r >= 7)
+        fail_unless(curlx_timediff_us(nodes[i].time, now) > 0,
+                    "expired timer left queued");
+      if(!have_first || curlx_timediff_us(nodes[i].time, first) < 0) {
+        first = nodes[i].time;
+        have_first = TRUE;
+      }
+    }
+    n = Curl_twheel_first(w);
+    if(have_first)
+      fail_unless(n && !curlx_timediff_us(n->time, first),
+                  "wrong first timer");
+    else
+      fail_unless(!n, "empty wheel has a first timer");
+  }
+
+  /* timers beyond the top level get their turn */
+  for(i = 0; i < T1617_NODES; i++)
+    Curl_twheel_remove(w, &nodes[i]);
+  fail_unless(!Curl_twheel_count(w), "timers left");
+  Curl_twheel_add(w, &nodes[0], t1617_at(now, T1617_DAY * 900), &nodes[0]);
+  Curl_twheel_add(w, &nodes[1], t1617_at(now, T1617_DAY * 800), &nodes[1]);
+  fail_unless(Curl_twheel_first(w) == &nodes[1], "wrong first timer");
+  fail_unless(!Curl_twheel_expire(w, t1617_at(now, T1617_DAY * 800 - 1)),
+              "expired too early");
+  n = Curl_twheel_expire(w, t1617_at(now, T1617_DAY * 800));
+  fail_unless(n == &nodes[1] && !Curl_twnode_enext(n), "wrong expiry");
+  fail_unless(Curl_twheel_first(w) == &nodes[0], "wrong first timer");
+  n = Curl_twheel_expire(w, t1617_at(now, T1617_DAY * 1000));
+  fail_unless(n == &nodes[0] && !Curl_twnode_enext(n), "wrong expiry");
+  fail_unless(!Curl_twheel_count(w), "timers left");
+
+  Curl_twheel_destroy(w);
+
+  UNITTEST_END_SIMPLE
+}
+
+#undef T1617_NODES
+#undef T1617_DAY
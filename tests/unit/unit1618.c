@@ -0,0 +1,205 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "splay.h"
+#include "timewheel.h"
+
+#include "memdebug.h" /* LAST include file */
+
+/*
+ * Runs the same timer load on the splay tree and on the timer wheel and
+ * shows how long each takes: many transfers with short timers that are set
+ * again before they expire, some cancelled, and the expired ones taken off
+ * each millisecond. Both must expire the same timers.
+ */
+
+#define T1618_TIMERS 20000
+#define T1618_ROUNDS 2000  /* milliseconds */
+#define T1618_OPS    20    /* timers set or cancelled per timer and second */
+
+struct t1618_load {
+  struct curltime now;
+  unsigned int seed;
+  size_t expired;   /* timers that expired */
+  size_t checksum;  /* of the ones that expired and when */
+};
+
+static unsigned int t1618_rand(unsigned int *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 8) & 0xffffff;
+}
+
+/* the time a timer is set to: mostly short ones, like for connect attempts
+   and speed checks, some longer. At least a millisecond away. */
+static struct curltime t1618_when(struct t1618_load *l, unsigned int r)
+{
+  struct curltime t = l->now;
+  int us = 1000 + ((r & 3) ? (int)(r % 200000) : (int)(r % 5000000));
+  t.tv_sec += us / 1000000;
+  t.tv_usec += us % 1000000;
+  if(t.tv_usec >= 1000000) {
+    t.tv_sec++;
+    t.tv_usec -= 1000000;
+  }
+  return t;
+}
+
+static void t1618_tick(struct t1618_load *l)
+{
+  l->now.tv_usec += 1000;
+  if(l->now.tv_usec >= 1000000) {
+    l->now.tv_sec++;
+    l->now.tv_usec -= 1000000;
+  }
+}
+
+/* an expired timer is set again, to a time not depending on the order the
+   expired ones are taken off in */
+static struct curltime t1618_expired(struct t1618_load *l, size_t i,
+                                     int round)
+{
+  unsigned int r = (unsigned int)i * 2654435761U + (unsigned int)round;
+  l->expired++;
+  l->checksum += i * (size_t)(round + 1);
+  return t1618_when(l, t1618_rand(&r));
+}
+
+static timediff_t t1618_splay(struct t1618_load *l, struct Curl_tree *nodes,
+                              bool *queued)
+{
+  struct curltime start = curlx_now();
+  struct Curl_tree *root = NULL;
+  struct Curl_tree *t;
+  size_t i;
+  int round;
+  int ops;
+
+  for(i = 0; i < T1618_TIMERS; i++) {
+    Curl_splayset(&nodes[i], &nodes[i]);
+    root = Curl_splayinsert(t1618_when(l, t1618_rand(&l->seed)), root,
+                            &nodes[i]);
+    queued[i] = TRUE;
+  }
+  for(round = 0; round < T1618_ROUNDS; round++) {
+    t1618_tick(l);
+    for(ops = 0; ops < T1618_TIMERS * T1618_OPS / 1000; ops++) {
+      unsigned int r = t1618_rand(&l->seed);
+      i = r % T1618_TIMERS;
+      if(queued[i])
+        (void)Curl_splayremove(root, &nodes[i], &root);
+      queued[i] = !!(r & 7);
+      if(queued[i])
+        root = Curl_splayinsert(t1618_when(l, r >> 3), root, &nodes[i]);
+    }
+    for(;;) {
+      root = Curl_splaygetbest(l->now, root, &t);
+      if(!t)
+        break;
+      i = (size_t)((struct Curl_tree *)Curl_splayget(t) - nodes);
+      root = Curl_splayinsert(t1618_expired(l, i, round), root, t);
+    }
+    /* what curl_multi_timeout() asks for */
+    if(root)
+      root = Curl_splay(l->now, root);
+  }
+  return curlx_timediff_us(curlx_now(), start);
+}
+
+static timediff_t t1618_wheel(struct t1618_load *l, struct Curl_twheel *w,
+                              struct Curl_twnode *nodes)
+{
+  struct curltime start = curlx_now();
+  struct Curl_twnode *n;
+  size_t i;
+  int round;
+  int ops;
+
+  for(i = 0; i < T1618_TIMERS; i++)
+    Curl_twheel_add(w, &nodes[i], t1618_when(l, t1618_rand(&l->seed)),
+                    &nodes[i]);
+  for(round = 0; round < T1618_ROUNDS; round++) {
+    t1618_tick(l);
+    for(ops = 0; ops < T1618_TIMERS * T1618_OPS / 1000; ops++) {
+      unsigned int r = t1618_rand(&l->seed);
+      i = r % T1618_TIMERS;
+      if(r & 7)
+        Curl_twheel_add(w, &nodes[i], t1618_when(l, r >> 3), &nodes[i]);
+      else
+        Curl_twheel_remove(w, &nodes[i]);
+    }
+    for(n = Curl_twheel_expire(w, l->now); n; n = Curl_twnode_enext(n)) {
+      i = (size_t)((struct Curl_twnode *)Curl_twnode_get(n) - nodes);
+      Curl_twheel_add(w, n, t1618_expired(l, i, round), n);
+    }
+    (void)Curl_twheel_first(w);
+  }
+  return curlx_timediff_us(curlx_now(), start);
+}
+
+static CURLcode test_unit1618(const char *arg)
+{
+  UNITTEST_BEGIN_SIMPLE
+
+  struct t1618_load splay;
+  struct t1618_load wheel;
+  struct Curl_tree *tnodes = calloc(T1618_TIMERS, sizeof(*tnodes));
+  struct Curl_twnode *wnodes = calloc(T1618_TIMERS, sizeof(*wnodes));
+  bool *queued = calloc(T1618_TIMERS, sizeof(*queued));
+  struct Curl_twheel *w;
+  timediff_t splay_us;
+  timediff_t wheel_us;
+
+  memset(&splay, 0, sizeof(splay));
+  splay.now.tv_sec = 1000;
+  splay.seed = 1618;
+  wheel = splay;
+  w = Curl_twheel_create(wheel.now);
+  abort_unless(tnodes && wnodes && queued && w, "out of memory");
+
+  splay_us = t1618_splay(&splay, tnodes, queued);
+  wheel_us = t1618_wheel(&wheel, w, wnodes);
+
+  curl_mfprintf(stderr, "%d timers, %d ms: %zu expired, "
+                "splay %" FMT_TIMEDIFF_T " us, wheel %" FMT_TIMEDIFF_T
+                " us\n", T1618_TIMERS, T1618_ROUNDS, wheel.expired,
+                splay_us, wheel_us);
+
+  fail_unless(splay.expired, "no timer expired");
+  fail_unless(splay.expired == wheel.expired, "not the same timers expired");
+  fail_unless(splay.checksum == wheel.checksum,
+              "not the same timers expired");
+
+  free(tnodes);
+  free(wnodes);
+  free(queued);
+  Curl_twheel_destroy(w);
+
+  UNITTEST_END_SIMPLE
+}
+
+#undef T1618_TIMERS
+#undef T1618_ROUNDS
+#undef T1618_OPS
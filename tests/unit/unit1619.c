@@ -0,0 +1,213 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ * SPDX-License-Identifier: curl
+ *
+ ***************************************************************************/
+#include "unitcheck.h"
+
+#include "urldata.h"
+#include "url.h"
+#include "conncache.h"
+#include "multihandle.h"
+
+#include "memdebug.h" /* LAST include file */
+
+/* Connections to one destination that differ only in what goes into their
+   reuse key. Curl_cpool_find() has to visit exactly the pooled connections
+   a transfer could reuse: other proxies, unix sockets or connect-to uses
+   are in other buckets, while names compared without case still find
+   theirs. */
+
+#if !defined(CURL_DISABLE_PROXY) && defined(USE_UNIX_SOCKETS)
+
+#define T1619_DEST "example.com:80"
+
+struct t1619_conf {
+  const char *http_proxy;
+  int http_port;
+  bool tunnel;
+  const char *socks_proxy;
+  const char *socks_user;
+  const char *unix_path;
+  bool abstract;
+  bool conn_to_host;
+};
+
+struct t1619_visit {
+  struct connectdata *conns;
+  unsigned int mask;
+};
+
+static const struct t1619_conf t1619_pool[] = {
+  /* 0, 1 */
+  { NULL, 0, FALSE, NULL, NULL, NULL, FALSE, FALSE },
+  { NULL, 0, FALSE, NULL, NULL, NULL, FALSE, FALSE },
+  /* 2 - 5 */
+  { "proxy1.example", 3128, FALSE, NULL, NULL, NULL, FALSE, FALSE },
+  { "proxy2.example", 3128, FALSE, NULL, NULL, NULL, FALSE, FALSE },
+  { "proxy1.example", 8080, FALSE, NULL, NULL, NULL, FALSE, FALSE },
+  { "proxy1.example", 3128, TRUE, NULL, NULL, NULL, FALSE, FALSE },
+  /* 6, 7 */
+  { NULL, 0, FALSE, "socks.example", NULL, NULL, FALSE, FALSE },
+  { NULL, 0, FALSE, "socks.example", "user", NULL, FALSE, FALSE },
+  /* 8 - 10 */
+  { NULL, 0, FALSE, NULL, NULL, "/tmp/curl.sock", FALSE, FALSE },
+  { NULL, 0, FALSE, NULL, NULL, "/tmp/other.sock", FALSE, FALSE },
+  { NULL, 0, FALSE, NULL, NULL, "/tmp/curl.sock", TRUE, FALSE },
+  /* 11 */
+  { NULL, 0, FALSE, NULL, NULL, NULL, FALSE, TRUE },
+};
+
+#define T1619_POOL CURL_ARRAYSIZE(t1619_pool)
+
+static void t1619_conn(struct connectdata *conn, const struct t1619_conf *c)
+{
+  memset(conn, 0, sizeof(*conn));
+  conn->destination = CURL_UNCONST(T1619_DEST);
+  if(c->http_proxy) {
+    conn->bits.httpproxy = TRUE;
+    conn->bits.tunnel_proxy = c->tunnel;
+    conn->http_proxy.proxytype = CURLPROXY_HTTP;
+    conn->http_proxy.host.name = CURL_UNCONST(c->http_proxy);
+    conn->http_proxy.port = c->http_port;
+  }
+  if(c->socks_proxy) {
+    conn->bits.socksproxy = TRUE;
+    conn->socks_proxy.proxytype = CURLPROXY_SOCKS5;
+    conn->socks_proxy.host.name = CURL_UNCONST(c->socks_proxy);
+    conn->socks_proxy.port = 1080;
+    conn->socks_proxy.user = CURL_UNCONST(c->socks_user);
+  }
+  conn->unix_domain_socket = CURL_UNCONST(c->unix_path);
+  conn->bits.abstract_unix_socket = c->abstract;
+  conn->bits.conn_to_host = c->conn_to_host;
+  conn->reuse_key = url_reuse_key(conn);
+}
+
+static bool t1619_visit_cb(struct connectdata *conn, void *userdata)
+{
+  struct t1619_visit *v = userdata;
+  v->mask |= 1u << (conn - v->conns);
+  return FALSE; /* look at them all */
+}
+
+static void t1619_find(struct Curl_easy *data, struct connectdata *conns,
+                       const char *dest, const struct t1619_conf *c,
+                       unsigned int expect, const char *what)
+{
+  struct connectdata needle;
+  struct t1619_visit v;
+
+  t1619_conn(&needle, c);
+  v.conns = conns;
+  v.mask = 0;
+  (void)Curl_cpool_find(data, dest, needle.reuse_key, t1619_visit_cb, NULL,
+                        &v);
+  if(v.mask != expect) {
+    curl_mfprintf(stderr, "%s: visited 0x%x, expected 0x%x\n",
+                  what, v.mask, expect);
+    unitfail++;
+  }
+}
+
+#endif
+
+static CURLcode t1619_setup(void)
+{
+  CURLcode res = CURLE_OK;
+  global_init(CURL_GLOBAL_ALL);
+  return res;
+}
+
+static CURLcode test_unit1619(const char *arg)
+{
+  UNITTEST_BEGIN(t1619_setup())
+
+#if !defined(CURL_DISABLE_PROXY) && defined(USE_UNIX_SOCKETS)
+  CURL *easy = curl_easy_init();
+  struct Curl_multi *multi = curl_multi_init();
+  struct connectdata *conns = calloc(T1619_POOL, sizeof(*conns));
+  struct t1619_conf c;
+  size_t i;
+  size_t added = 0;
+
+  abort_unless(easy && multi && conns, "out of memory");
+  abort_unless(!curl_multi_add_handle(multi, easy), "multi add failed");
+
+  for(i = 0; i < T1619_POOL; i++) {
+    t1619_conn(&conns[i], &t1619_pool[i]);
+    if(Curl_cpool_add(easy, &conns[i]))
+      break;
+    added++;
+  }
+  fail_unless(added == T1619_POOL, "adding to the pool failed");
+
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[0], 0x003, "direct");
+  t1619_find(easy, conns, "example.com:443", &t1619_pool[0], 0,
+             "other destination");
+
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[2], 0x004, "proxy");
+  c = t1619_pool[2];
+  c.http_proxy = "PROXY1.Example";
+  t1619_find(easy, conns, T1619_DEST, &c, 0x004, "proxy name case");
+  c.http_proxy = "proxy3.example";
+  t1619_find(easy, conns, T1619_DEST, &c, 0, "proxy not in the pool");
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[3], 0x008,
+             "other proxy");
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[4], 0x010,
+             "other proxy port");
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[5], 0x020,
+             "tunnel through proxy");
+
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[6], 0x040, "socks");
+  c = t1619_pool[6];
+  c.socks_proxy = "SOCKS.example";
+  t1619_find(easy, conns, T1619_DEST, &c, 0x040, "socks name case");
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[7], 0x080,
+             "socks user");
+  c = t1619_pool[7];
+  c.socks_user = "USER";
+  t1619_find(easy, conns, T1619_DEST, &c, 0, "socks user case");
+
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[8], 0x100,
+             "unix socket");
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[9], 0x200,
+             "other unix socket");
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[10], 0x400,
+             "abstract unix socket");
+
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[11], 0x800,
+             "connect-to");
+
+  for(i = 0; i < added; i++)
+    cpool_remove_conn(&multi->cpool, &conns[i]);
+
+  /* an emptied bucket is gone, its connections are not found */
+  t1619_find(easy, conns, T1619_DEST, &t1619_pool[0], 0, "removed");
+
+  curl_multi_remove_handle(multi, easy);
+  curl_multi_cleanup(multi);
+  curl_easy_cleanup(easy);
+  free(conns);
+#endif
+
+  UNITTEST_END(curl_global_cleanup())
+}